@@ -0,0 +1,126 @@
+#version 330 core
+
+// Checkerboard rendering, resolve: rebuilds the full-width frame from
+// the half that mandelbulb.frag marched this frame (CHECKERBOARD). Pixels
+// it marched are copied. Each of the others has four marched neighbours;
+// when they agree on a surface, that depth is projected into the previous
+// frame and, if the surface found there is the same, last frame's colour
+// is reused. Otherwise (disocclusion, silhouettes, no history) the pixel
+// is interpolated from the neighbour pair that differs least, and pixels
+// with only misses around them get the exact background.
+
+in vec2 v_uv;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec2 HitInfo;   // hit distance (-1 = miss), total steps
+
+#include "mandelbulb_common.glsl"
+
+uniform sampler2D u_checkerColor;   // this frame's half-width colour
+uniform sampler2D u_checkerHit;     // and HitInfo
+uniform int       u_checkerParity;
+
+// The previous frame's full colour is u_history.
+uniform int       u_reproject;      // 0 = no usable previous frame
+uniform sampler2D u_prevHitInfo;
+uniform vec2      u_prevResolution;
+uniform vec3      u_prevCamPos;
+uniform vec3      u_prevCamForward;
+uniform vec3      u_prevCamRight;
+uniform vec3      u_prevCamUp;
+uniform float     u_prevFov;
+
+// Neighbour depths must agree this closely, relative, to be trusted as
+// this pixel's depth.
+const float DEPTH_AGREEMENT = 0.02;
+
+ivec2 halfTexel(in ivec2 pixel)
+{
+    ivec2 texel = ivec2(pixel.x >> 1, pixel.y);
+    return clamp(texel, ivec2(0), ivec2((int(u_resolution.x) - 1) >> 1, int(u_resolution.y) - 1));
+}
+
+// Last frame's colour of the surface at distance t along rd, or a
+// negative alpha if that frame saw something else at its pixel there.
+vec4 previousColor(in vec3 rd, in float t, in float footprint)
+{
+    vec3 v = u_camPos + rd * t - u_prevCamPos;
+    float z = dot(v, u_prevCamForward);
+    if (z <= 0.0)
+        return vec4(-1.0);
+
+    vec2 ndc = vec2(dot(v, u_prevCamRight), dot(v, u_prevCamUp)) / (z * u_prevFov);
+    ndc.x *= u_prevResolution.y / u_prevResolution.x;
+    vec2 texel = (ndc * 0.5 + 0.5) * u_prevResolution;
+    if (any(lessThan(texel, vec2(0.5))) || any(greaterThan(texel, u_prevResolution - 0.5)))
+        return vec4(-1.0);
+
+    float prevT = texelFetch(u_prevHitInfo, ivec2(texel), 0).r;
+    if (prevT <= 0.0)
+        return vec4(-1.0);
+    vec3 prevQ = u_prevCamPos + prevT *
+                 rayDirection(floor(texel) + 0.5, u_prevResolution,
+                              u_prevCamForward, u_prevCamRight, u_prevCamUp, u_prevFov);
+    // Within two pixels of the ray, and at the same depth along it.
+    float along = dot(prevQ - u_camPos, rd);
+    if (length(u_camPos + rd * along - prevQ) > 2.0 * footprint * t ||
+        abs(along - t) > DEPTH_AGREEMENT * t)
+        return vec4(-1.0);
+
+    vec2 uv = texel / vec2(textureSize(u_history, 0));
+    return vec4(textureLod(u_history, uv, 0.0).rgb, 1.0);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    if (((pixel.x + pixel.y + u_checkerParity) & 1) == 0) {
+        ivec2 texel = halfTexel(pixel);
+        FragColor = texelFetch(u_checkerColor, texel, 0);
+        HitInfo   = texelFetch(u_checkerHit, texel, 0).rg;
+        return;
+    }
+
+    // Left, right, below, above: all marched this frame.
+    ivec2 offsets[4] = ivec2[4](ivec2(-1, 0), ivec2(1, 0), ivec2(0, -1), ivec2(0, 1));
+    vec3  color[4];
+    vec2  hit[4];
+    int   hits = 0;
+    float tMin = 1e20, tMax = 0.0, tSum = 0.0, stepSum = 0.0;
+    for (int k = 0; k < 4; k++) {
+        ivec2 texel = halfTexel(pixel + offsets[k]);
+        color[k] = texelFetch(u_checkerColor, texel, 0).rgb;
+        hit[k]   = texelFetch(u_checkerHit, texel, 0).rg;
+        stepSum += hit[k].g;
+        if (hit[k].r > 0.0) {
+            hits++;
+            tMin = min(tMin, hit[k].r);
+            tMax = max(tMax, hit[k].r);
+            tSum += hit[k].r;
+        }
+    }
+    // The nearest neighbour depth is the safer march start next frame.
+    HitInfo = vec2(hits == 4 ? tMin : -1.0, 0.25 * stepSum);
+
+    vec3 rd = cameraRay(gl_FragCoord.xy);
+    if (hits == 0) {
+        FragColor = vec4(background(rd), 1.0);
+        return;
+    }
+
+    if (u_reproject != 0 && hits == 4 && tMax - tMin < DEPTH_AGREEMENT * tMin) {
+        float t = 0.25 * tSum;
+        float footprint = 2.0 * u_fov / u_resolution.y;
+        vec4 prev = previousColor(rd, t, footprint);
+        if (prev.a > 0.0) {
+            FragColor = vec4(prev.rgb, 1.0);
+            return;
+        }
+    }
+
+    // Along an edge rather than across it: the pair that differs least.
+    vec3 luma = vec3(0.2126, 0.7152, 0.0722);
+    float dx = abs(dot(color[0] - color[1], luma));
+    float dy = abs(dot(color[2] - color[3], luma));
+    vec3 col = dx <= dy ? 0.5 * (color[0] + color[1]) : 0.5 * (color[2] + color[3]);
+    FragColor = vec4(col, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 330 core
+
+// Deferred shading, pass 2: shadow and AO at 1/u_lightingScale resolution.
+// Each texel traces the secondary rays of one representative G-buffer
+// pixel, the centre of the block it covers; deferred_shade.frag upsamples
+// the result against the full-resolution depth and normals.
+
+in vec2 v_uv;
+out vec2 Lighting;   // shadow, AO (1 = unoccluded)
+
+#include "mandelbulb_common.glsl"
+
+uniform sampler2D u_gNormal;   // normal, step ratio
+uniform sampler2D u_gHit;      // hit distance (-1 = miss), total steps
+uniform int       u_lightingScale;
+
+// The pixel a lighting texel stands for; deferred_shade.frag mirrors it.
+ivec2 representativePixel(in ivec2 texel)
+{
+    ivec2 pixel = texel * u_lightingScale + u_lightingScale / 2;
+    return min(pixel, ivec2(u_resolution) - 1);
+}
+
+void main()
+{
+    ivec2 pixel = representativePixel(ivec2(gl_FragCoord.xy));
+    float t = texelFetch(u_gHit, pixel, 0).r;
+    if (t <= 0.0) {
+        Lighting = vec2(1.0);
+        return;
+    }
+
+    vec3 rd = cameraRay(vec2(pixel) + 0.5 + u_jitter);
+    vec3 n  = texelFetch(u_gNormal, pixel, 0).xyz;
+    Lighting = secondaryTerms(u_camPos + rd * t, n);
+}
@@ -0,0 +1,99 @@
+#version 330 core
+
+// Deferred shading, pass 3: lights the G-buffer at full resolution. The
+// shadow and AO terms come from deferred_lighting.frag's coarse texture
+// through a bilateral upsample: the four nearest lighting texels are
+// weighted bilinearly, then by how well the depth and normal of the pixel
+// each one was traced for match this pixel's, so the terms don't bleed
+// across silhouettes or creases. Pixels no coarse texel saw the surface
+// for (thin features) trace their own terms.
+
+in vec2 v_uv;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec2 HitInfo;   // copied from the G-buffer
+
+#include "mandelbulb_common.glsl"
+
+uniform sampler2D u_gNormal;   // normal, step ratio
+uniform sampler2D u_gHit;      // hit distance (-1 = miss), total steps
+uniform sampler2D u_lighting;  // shadow, AO at 1/u_lightingScale
+uniform int       u_lightingScale;
+
+// Relative depth difference at which a tap's weight falls to 1/e.
+const float DEPTH_SIGMA    = 0.05;
+const float NORMAL_POWER   = 8.0;
+const float MIN_TAP_WEIGHT = 1e-3;
+
+// Mirrors deferred_lighting.frag.
+ivec2 representativePixel(in ivec2 texel)
+{
+    ivec2 pixel = texel * u_lightingScale + u_lightingScale / 2;
+    return min(pixel, ivec2(u_resolution) - 1);
+}
+
+vec2 upsampleTerms(in ivec2 pixel, in vec3 p, in vec3 n, in float t)
+{
+    ivec2 coarseSize = (ivec2(u_resolution) + u_lightingScale - 1) / u_lightingScale;
+    // Lighting texel centres sit on representative pixel centres.
+    vec2 q = (vec2(pixel) - float(u_lightingScale / 2)) / float(u_lightingScale);
+    ivec2 base = ivec2(floor(q));
+    vec2 f = q - vec2(base);
+
+    // Bilateral and plain bilinear sums over the taps that hit something.
+    vec2  terms  = vec2(0.0), plainTerms  = vec2(0.0);
+    float weight = 0.0,       plainWeight = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), coarseSize - 1);
+        ivec2 source = representativePixel(texel);
+
+        float tapT = texelFetch(u_gHit, source, 0).r;
+        if (tapT <= 0.0)
+            continue;
+        vec3 tapN = texelFetch(u_gNormal, source, 0).xyz;
+        vec2 tapTerms = texelFetch(u_lighting, texel, 0).rg;
+
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float b = bilinear.x * bilinear.y;
+        float dz = (tapT - t) / (DEPTH_SIGMA * t);
+        float w = b * exp(-dz * dz) * pow(max(dot(n, tapN), 0.0), NORMAL_POWER);
+
+        terms       += w * tapTerms;
+        weight      += w;
+        plainTerms  += b * tapTerms;
+        plainWeight += b;
+    }
+
+    if (weight >= MIN_TAP_WEIGHT)
+        return terms / weight;
+    // No tap resembles this pixel. Tracing here would stall the whole
+    // warp for a few scattered pixels, so only do it where no tap hit the
+    // surface at all (thin features the coarse pass missed entirely).
+    if (plainWeight >= MIN_TAP_WEIGHT)
+        return plainTerms / plainWeight;
+    return secondaryTerms(p, n);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec2 hit = texelFetch(u_gHit, pixel, 0).rg;
+    HitInfo = hit;
+
+    vec3 rd = cameraRay(gl_FragCoord.xy + u_jitter);
+    float t = hit.r;
+
+    vec3 col;
+    if (t <= 0.0) {
+        col = background(rd);
+    } else {
+        vec4 g = texelFetch(u_gNormal, pixel, 0);
+        vec3 n = g.xyz;
+        vec2 terms = vec2(1.0);
+        if (SHADOWS_ON || AO_ON)
+            terms = upsampleTerms(pixel, u_camPos + rd * t, n, t);
+        col = lightSurface(rd, n, g.a, terms.x, terms.y);
+    }
+
+    FragColor = vec4(accumulate(col, pixel), 1.0);
+}
@@ -0,0 +1,133 @@
+// Extended-precision scalars for deep zoom, included by
+// mandelbulb_common.glsl. A DF carries about twice float's significand:
+// with DEEP_ZOOM 2 it is a native double (GL_ARB_gpu_shader_fp64, which
+// the including stage enables), otherwise an unevaluated sum hi + lo of
+// two floats with |lo| <= ulp(hi) / 2 ("double-float", 48 bits), built
+// from the error-free sums and products of Knuth and Dekker. Those rely
+// on every float operation being rounded as written: compilers simplify
+// (a + b) - a to b unless told not to, so the temporaries are `precise`
+// (GLSL 4.00, or GL_ARB_gpu_shader5, which the including stage enables
+// and announces by defining DF_PRECISE). Without either, the emulation
+// falls back to little more than float precision.
+
+#if defined(DEEP_ZOOM) && DEEP_ZOOM == 2
+
+#define DF double
+
+DF    dfMake(in float hi, in float lo) { return double(hi) + double(lo); }
+float dfHi(in DF a)                    { return float(a); }
+float dfLo(in DF a)                    { return float(a - double(float(a))); }
+
+DF dfAdd(in DF a, in DF b)     { return a + b; }
+DF dfAddF(in DF a, in float b) { return a + double(b); }
+DF dfSub(in DF a, in DF b)     { return a - b; }
+DF dfMul(in DF a, in DF b)     { return a * b; }
+DF dfMulF(in DF a, in float b) { return a * double(b); }
+DF dfDiv(in DF a, in DF b)     { return a / b; }
+DF dfSqrt(in DF a)             { return sqrt(max(a, 0.0LF)); }
+
+#else
+
+#define DF vec2
+
+#ifndef DF_PRECISE
+#if __VERSION__ >= 400
+#define DF_PRECISE precise
+#else
+#define DF_PRECISE
+#endif
+#endif
+
+// s + e == a + b exactly, given |a| >= |b|.
+vec2 quickTwoSum(in float a, in float b)
+{
+    DF_PRECISE float s = a + b;
+    DF_PRECISE float e = b - (s - a);
+    return vec2(s, e);
+}
+
+// s + e == a + b exactly.
+vec2 twoSum(in float a, in float b)
+{
+    DF_PRECISE float s = a + b;
+    DF_PRECISE float v = s - a;
+    DF_PRECISE float e = (a - (s - v)) + (b - v);
+    return vec2(s, e);
+}
+
+// a == hi + lo with both halves 12 bits wide, so their products are exact.
+vec2 splitFloat(in float a)
+{
+    DF_PRECISE float t = 4097.0 * a;   // 2^12 + 1
+    DF_PRECISE float hi = t - (t - a);
+    DF_PRECISE float lo = a - hi;
+    return vec2(hi, lo);
+}
+
+// p + e == a * b exactly.
+vec2 twoProd(in float a, in float b)
+{
+    DF_PRECISE float p = a * b;
+    vec2 as = splitFloat(a), bs = splitFloat(b);
+    DF_PRECISE float e = ((as.x * bs.x - p) + as.x * bs.y + as.y * bs.x) + as.y * bs.y;
+    return vec2(p, e);
+}
+
+DF    dfMake(in float hi, in float lo) { return quickTwoSum(hi, lo); }
+float dfHi(in DF a)                    { return a.x; }
+float dfLo(in DF a)                    { return a.y; }
+
+DF dfAdd(in DF a, in DF b)
+{
+    vec2 s = twoSum(a.x, b.x);
+    vec2 t = twoSum(a.y, b.y);
+    s = quickTwoSum(s.x, s.y + t.x);
+    return quickTwoSum(s.x, s.y + t.y);
+}
+
+DF dfAddF(in DF a, in float b)
+{
+    vec2 s = twoSum(a.x, b);
+    return quickTwoSum(s.x, s.y + a.y);
+}
+
+DF dfSub(in DF a, in DF b)
+{
+    return dfAdd(a, -b);
+}
+
+DF dfMul(in DF a, in DF b)
+{
+    vec2 p = twoProd(a.x, b.x);
+    return quickTwoSum(p.x, p.y + (a.x * b.y + a.y * b.x));
+}
+
+DF dfMulF(in DF a, in float b)
+{
+    vec2 p = twoProd(a.x, b);
+    return quickTwoSum(p.x, p.y + a.y * b);
+}
+
+// Long division: one correction of the float quotient.
+DF dfDiv(in DF a, in DF b)
+{
+    float q = a.x / b.x;
+    vec2 r = dfSub(a, dfMulF(b, q));
+    return quickTwoSum(q, r.x / b.x);
+}
+
+// Karp's method: one Newton step from the float square root.
+DF dfSqrt(in DF a)
+{
+    if (a.x <= 0.0)
+        return vec2(0.0);
+    float x = inversesqrt(a.x);
+    float y = a.x * x;
+    vec2 r = dfSub(a, twoProd(y, y));
+    return quickTwoSum(y, r.x * x * 0.5);
+}
+
+#endif
+
+DF dfZero() { return dfMake(0.0, 0.0); }
+DF dfOne()  { return dfMake(1.0, 0.0); }
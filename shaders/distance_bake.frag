@@ -0,0 +1,25 @@
+#version 330 core
+
+// Bakes one z-slice of the distance cache (DistanceCache). Each texel
+// holds the estimate at its voxel centre minus a margin that keeps the
+// trilinear interpolation a lower bound: with distances 1-Lipschitz, the
+// interpolated value at p is at most d(p) + sum(w_i |p - c_i|), and by
+// Jensen that sum is at most sqrt(sum(w_i |p - c_i|^2)), which for
+// trilinear weights is sqrt(sum over axes of t(1 - t)) voxels: at most
+// half the voxel diagonal, at the cell centre.
+
+in vec2 v_uv;
+out float Distance;
+
+#include "mandelbulb_common.glsl"
+
+uniform int u_cacheSize;   // voxels per axis
+uniform int u_slice;
+
+void main()
+{
+    vec3 voxel = vec3(ivec3(ivec2(gl_FragCoord.xy), u_slice)) + 0.5;
+    vec3 pos = (voxel / float(u_cacheSize) * 2.0 - 1.0) * u_cacheExtent;
+
+    Distance = mandelbulbDE(pos) - 0.8660254 * u_cacheVoxel;
+}
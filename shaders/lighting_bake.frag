@@ -0,0 +1,41 @@
+#version 330 core
+
+// Bakes one z-slice of the lighting cache (LightingCache): the soft
+// shadow (r) and ambient occlusion (g) of the surface point nearest each
+// voxel centre, found by stepping the estimate along its gradient. The
+// light is fixed and the terms don't depend on the view, so the volume
+// holds for any camera until the surface parameters change. Shading only
+// samples it at surface points, whose trilinear footprint never reaches
+// a voxel further than a diagonal away, so the rest are left unoccluded
+// without tracing.
+
+in vec2 v_uv;
+out vec2 Lighting;
+
+#include "mandelbulb_common.glsl"
+
+uniform int u_cacheSize;   // voxels per axis
+uniform int u_slice;
+
+void main()
+{
+    vec3 voxel = vec3(ivec3(ivec2(gl_FragCoord.xy), u_slice)) + 0.5;
+    vec3 pos = (voxel / float(u_cacheSize) * 2.0 - 1.0) * u_lightCacheExtent;
+
+    float d = mandelbulbDE(pos);
+    if (d > 2.0 * u_lightCacheVoxel) {
+        Lighting = vec2(1.0);
+        return;
+    }
+
+    vec2 e = vec2(0.5 * u_lightCacheVoxel, 0.0);
+    vec3 n = normalize(vec3(
+        mandelbulbDE(pos + e.xyy) - mandelbulbDE(pos - e.xyy),
+        mandelbulbDE(pos + e.yxy) - mandelbulbDE(pos - e.yxy),
+        mandelbulbDE(pos + e.yyx) - mandelbulbDE(pos - e.yyx)) + 1e-9);
+    vec3 p = pos - n * max(d, 0.0);
+
+    // Light from behind doesn't show (lightSurface zeroes it), but the
+    // voxel's neighbours may face it, so it is traced regardless.
+    Lighting = vec2(softShadow(p + n * 0.01, LIGHT_DIR), ambientOcclusion(p, n));
+}
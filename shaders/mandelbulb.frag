@@ -1,204 +1,316 @@
 #version 330 core
+#if defined(DEEP_ZOOM) && DEEP_ZOOM == 2
+#extension GL_ARB_gpu_shader_fp64 : require
+#endif
+#ifdef GL_ARB_gpu_shader5
+#extension GL_ARB_gpu_shader5 : enable
+#define DF_PRECISE precise   // for df64.glsl
+#endif
+#ifdef COST_COUNTERS
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
 
 in vec2 v_uv;
-out vec4 FragColor;
-
-uniform vec2  u_resolution;
-uniform float u_time;
-
-// Camera
-uniform vec3 u_camPos;
-uniform vec3 u_camForward;
-uniform vec3 u_camRight;
-uniform vec3 u_camUp;
-uniform float u_fov;
-
-// Fractal parameters
-uniform float u_power;
-uniform int   u_maxIter;
-uniform float u_bailout;
-
-// Raymarch parameters
-uniform int   u_maxSteps;
-uniform float u_maxDist;
-uniform float u_epsilon;
-
-// Shading / color
-uniform vec3 u_colorA;
-uniform vec3 u_colorB;
-uniform int  u_enableAO;
-uniform int  u_enableShadows;
-
-// Distance Estimator
-float mandelbulbDE(in vec3 pos)
+layout(location = 0) out vec4 FragColor;   // GBUFFER: normal, step ratio
+#ifndef DEPTH_PREPASS
+layout(location = 1) out vec2 HitInfo;   // hit distance (-1 = miss), total steps
+#endif
+
+#include "mandelbulb_common.glsl"
+
+// Temporal depth reprojection: start near the surface seen last frame.
+uniform int       u_reproject;        // 0 = off
+uniform int       u_frameIndex;
+uniform float     u_reprojectMargin;  // fraction of the distance to back off
+uniform sampler2D u_prevHitInfo;      // previous frame's HitInfo
+uniform vec2      u_prevResolution;
+uniform vec3      u_prevCamPos;
+uniform vec3      u_prevCamForward;
+uniform vec3      u_prevCamRight;
+uniform vec3      u_prevCamUp;
+uniform float     u_prevFov;
+
+// Checkerboard rendering: the target is half as wide as the view and
+// fragment x marches pixel 2x or 2x + 1, alternating by row and by
+// u_checkerParity; checkerboard_resolve.frag fills in the rest.
+uniform int       u_checkerboard;     // 0 = off
+uniform int       u_checkerParity;
+
+#ifdef CHECKERBOARD
+#define CHECKER_ON (CHECKERBOARD != 0)
+#else
+#define CHECKER_ON (u_checkerboard != 0)
+#endif
+
+#ifdef DEPTH_PREPASS
+
+// Marches a cone enclosing every ray of one coarse tile. Any point of those
+// rays at distance t lies within t * slope of the cone axis, so advancing
+// by DE - radius can't step past a surface for any of them. Bounded
+// marching clips the cone to the bailout sphere grown by its widest
+// radius, which contains every one of those rays' own spans. The cone
+// stays in float; deep zoom widens it by the float error of its points,
+// and the per-pixel march resolves the rest.
+float coneMarch(in vec3 ro, in vec3 rd, in float slope, out int steps)
 {
-    vec3 z = pos;
-    float dr = 1.0;
-    float r  = 0.0;
-
-    const int HARD_MAX = 64; // compile-time upper bound
-
-    for (int i = 0; i < HARD_MAX; i++) {
-        if (i >= u_maxIter)
-            break;
+    float dist = 0.0;
+    float end  = u_maxDist;
+    if (MARCH_BOUNDED) {
+        vec2 span = boundingSpan(ro, rd, u_bailout + slope * u_maxDist);
+        dist = max(span.x, 0.0);
+        end  = min(end, span.y);
+    }
 
-        r = length(z);
-        if (r > u_bailout)
+    for (int i = 0; i < STEP_BOUND; i++) {
+#ifndef STEP_LIMIT
+        if (i >= u_stepLimit)
             break;
+#endif
 
-        float theta = acos(clamp(z.z / max(r, 1e-6), -1.0, 1.0));
-        float phi   = atan(z.y, z.x);
-
-        float zr = pow(r, u_power);
-        dr = pow(r, u_power - 1.0) * u_power * dr + 1.0;
+        if (dist > end) {
+            steps = i;
+            return dist;
+        }
 
-        theta *= u_power;
-        phi   *= u_power;
+        float radius = dist * slope;
+        if (DEEP_ACTIVE)
+            radius += floatSlack(ro) + FLOAT_SLACK * dist;
+        float threshold = hitThreshold(dist);
+        float dS = sceneDistance(ro + rd * dist, lodIterations(threshold)) - radius;
 
-        z = zr * vec3(
-            sin(theta) * cos(phi),
-            sin(theta) * sin(phi),
-            cos(theta)
-        );
+        // Progress would stall: leave the rest to the per-pixel march.
+        if (dS < threshold + 0.1 * radius) {
+            steps = i;
+            return dist;
+        }
 
-        z += pos;
+        dist += dS;
     }
 
-    return 0.5 * log(r) * r / dr;
+    steps = STEP_COUNT;
+    return dist;
 }
 
-float raymarch(in vec3 ro, in vec3 rd, out int steps)
+void main()
 {
-    float dist = 0.0;
-    const int HARD_MAX_STEPS = 512;
+    float scale = float(u_prepassScale);
+    vec3 rd = cameraRay(gl_FragCoord.xy * scale);
 
-    for (int i = 0; i < HARD_MAX_STEPS; i++) {
-        if (i >= u_maxSteps)
-            break;
+    // Half-diagonal of the tile plus the largest refinement jitter, as a
+    // ray-direction offset per unit distance (|dir| >= 1 before normalize).
+    float slope = (0.5 * scale + 0.5) * 1.41421356 * 2.0 * u_fov / u_resolution.y;
 
-        vec3 p = ro + rd * dist;
-        float dS = mandelbulbDE(p);
+    int steps;
+    float t = coneMarch(u_camPos, rd, slope, steps);
 
-        if (dS < u_epsilon) {
-            steps = i;
-            return dist;
-        }
+    FragColor = vec4(t, float(steps), 0.0, 1.0);
+}
 
-        if (dist > u_maxDist)
-            break;
+#else
 
-        dist += dS;
+#ifdef COST_COUNTERS
+const int COST_BINS = 16;
+
+// Totals over every pixel this pass shades; the host zeroes the buffer
+// before the frame (CostCounters). Mirrors CostCountersStd430.
+layout(std430) buffer CostCounters {
+    uint c_pixels;
+    uint c_steps;                        // steps marched in this pass
+    uint c_outcomes[3];                  // miss, hit, out of steps
+    uint c_evaluations[4];               // primary, normal, shadow, AO
+    uint c_stepBins[COST_BINS];          // steps, equal bins up to STEP_COUNT
+    uint c_evaluationBins[COST_BINS];    // bin k: [2^(k-1), 2^k) evaluations
+};
+
+void countCosts(in int steps, in int outcome)
+{
+    atomicAdd(c_pixels, 1u);
+    atomicAdd(c_steps, uint(steps));
+    atomicAdd(c_outcomes[outcome], 1u);
+
+    int total = 0;
+    for (int k = 0; k < 4; k++) {
+        if (costEvaluations[k] > 0)
+            atomicAdd(c_evaluations[k], uint(costEvaluations[k]));
+        total += costEvaluations[k];
     }
 
-    steps = u_maxSteps;
-    return -1.0;
+    int stepBin = min(steps * COST_BINS / max(STEP_COUNT, 1), COST_BINS - 1);
+    atomicAdd(c_stepBins[stepBin], 1u);
+    int evaluationBin = total > 0 ? int(log2(float(total))) + 1 : 0;
+    atomicAdd(c_evaluationBins[min(evaluationBin, COST_BINS - 1)], 1u);
 }
+#endif
 
-vec3 estimateNormal(in vec3 p)
+#ifdef COST_HEATMAP
+// Blue through green to red over [0, 1], in linear terms so that it
+// reads as such after the upscale pass's gamma.
+vec3 heatColor(in float x)
 {
-    float eps = u_epsilon * 2.0;
-    float d   = mandelbulbDE(p);
-    vec2 e = vec2(1.0, -1.0) * eps;
-
-    vec3 n = normalize(vec3(
-        mandelbulbDE(p + vec3(e.x, e.y, e.y)) - d,
-        mandelbulbDE(p + vec3(e.y, e.x, e.y)) - d,
-        mandelbulbDE(p + vec3(e.y, e.y, e.x)) - d
-    ));
-    return n;
+    x = clamp(x, 0.0, 1.0);
+    vec3 c = clamp(1.5 - abs(4.0 * x - vec3(3.0, 2.0, 1.0)), 0.0, 1.0);
+    return pow(c, vec3(2.2));
 }
 
-float softShadow(in vec3 ro, in vec3 rd)
+// COST_HEATMAP 1: steps against the limit; 2: DE evaluations on a log
+// scale up to 2048; 3: miss (blue), hit (green) or out of steps (red),
+// brighter for more steps.
+vec3 costColor(in int steps, in int outcome)
 {
-    float res = 1.0;
-    float t = 0.02;
-
-    for (int i = 0; i < 50; i++) {
-        vec3 p = ro + rd * t;
-        float h = mandelbulbDE(p);
-        if (h < 0.0005)
-            return 0.0;
-
-        res = min(res, 10.0 * h / t);
-        t += clamp(h, 0.02, 0.2);
-        if (t > 20.0)
-            break;
+#if COST_HEATMAP == 1
+    return heatColor(float(steps) / float(STEP_COUNT));
+#elif COST_HEATMAP == 2
+    int total = costEvaluations[0] + costEvaluations[1] + costEvaluations[2] + costEvaluations[3];
+    return heatColor(log2(float(total) + 1.0) / 11.0);
+#else
+    vec3 base = outcome == 0 ? vec3(0.05, 0.1, 0.6)
+              : outcome == 1 ? vec3(0.1, 0.6, 0.1) : vec3(0.8, 0.05, 0.05);
+    return base * (0.25 + 0.75 * clamp(float(steps) / float(STEP_COUNT), 0.0, 1.0));
+#endif
+}
+#endif
+
+// Every pixel re-marches from scratch once per this many frames, so the
+// step counts carried forward by reprojection stay fresh.
+const int REPROJECT_REFRESH = 8;
+
+// Finds where this pixel's ray meets the surface seen last frame. The
+// previous frame's depth at the same pixel is the first guess; projecting
+// that point into the previous camera gives a better texel, twice.
+// Returns -1 when the guess is unusable (miss, off-screen, or landing on
+// a surface that isn't on this ray, i.e. a disocclusion).
+float reprojectedStart(in vec2 fragCoord, in vec3 ro, in vec3 rd, out float prevSteps)
+{
+    vec2 texel = (fragCoord + u_tileOffset) * u_prevResolution / u_resolution;
+    vec2 prev  = texelFetch(u_prevHitInfo, ivec2(texel), 0).rg;
+    float t = prev.r;
+    if (t <= 0.0)
+        return -1.0;
+
+    // Ray-direction offset of one pixel per unit distance.
+    float footprint = 2.0 * u_fov / u_resolution.y;
+    float offRay = 0.0;
+
+    for (int k = 0; k < 2; k++) {
+        vec3 v = ro + rd * t - u_prevCamPos;
+        float z = dot(v, u_prevCamForward);
+        if (z <= 0.0)
+            return -1.0;
+
+        vec2 ndc = vec2(dot(v, u_prevCamRight), dot(v, u_prevCamUp)) / (z * u_prevFov);
+        ndc.x *= u_prevResolution.y / u_prevResolution.x;
+        texel = (ndc * 0.5 + 0.5) * u_prevResolution;
+        if (any(lessThan(texel, vec2(0.0))) || any(greaterThanEqual(texel, u_prevResolution)))
+            return -1.0;
+
+        prev = texelFetch(u_prevHitInfo, ivec2(texel), 0).rg;
+        if (prev.r <= 0.0)
+            return -1.0;
+
+        vec3 q = u_prevCamPos + prev.r *
+                 rayDirection(floor(texel) + 0.5, u_prevResolution,
+                              u_prevCamForward, u_prevCamRight, u_prevCamUp, u_prevFov);
+        t = dot(q - ro, rd);
+        offRay = length(ro + rd * t - q);
     }
 
-    return clamp(res, 0.0, 1.0);
+    if (t <= 0.0 || offRay > 2.0 * footprint * t)
+        return -1.0;
+
+    prevSteps = prev.g;
+    return max(t * (1.0 - u_reprojectMargin) - 2.0 * footprint * t, 0.0);
 }
 
-float ambientOcclusion(in vec3 p, in vec3 n)
+// The target-local view pixel centre this fragment marches.
+vec2 marchedPixel()
 {
-    float ao = 0.0;
-    float sca = 1.0;
-
-    for (int i = 0; i < 5; i++) {
-        float h = 0.01 + 0.12 * float(i) / 4.0;
-        float d = mandelbulbDE(p + n * h);
-        ao += (h - d) * sca;
-        sca *= 0.95;
-    }
-
-    return clamp(1.0 - 3.0 * ao, 0.0, 1.0);
+    if (!CHECKER_ON)
+        return gl_FragCoord.xy;
+    vec2 p = floor(gl_FragCoord.xy);
+    float odd = mod(p.y + float(u_checkerParity), 2.0);
+    return vec2(2.0 * p.x + odd, p.y) + 0.5;
 }
 
 void main()
 {
-    // Screen-space coordinates
-    vec2 uv = (gl_FragCoord.xy / u_resolution.xy) * 2.0 - 1.0;
-    uv.x *= u_resolution.x / u_resolution.y;
-
     // Camera ray
-    vec3 rd = normalize(u_camForward +
-                        uv.x * u_camRight * u_fov +
-                        uv.y * u_camUp * u_fov);
-
-    int steps;
-    float t = raymarch(u_camPos, rd, steps);
-
-    vec3 col;
-
-    if (t > 0.0) {
-        vec3 p = u_camPos + rd * t;
-        vec3 n = estimateNormal(p);
-
-        vec3 lightDir = normalize(vec3(0.4, 0.7, 0.2));
+    vec2 fragCoord = marchedPixel();
+    vec3 rd     = cameraRay(fragCoord + u_jitter);
+    vec3 offset = cameraOffset(fragCoord + u_jitter);
+
+    float startDist  = 0.0;
+    int   startSteps = 0;
+    if (u_prepassScale > 0) {
+        vec2 seed = texelFetch(u_startDist, ivec2(fragCoord) / u_prepassScale, 0).rg;
+        startDist  = seed.r;
+        startSteps = int(seed.g);
+    }
 
-        float diff = max(dot(n, lightDir), 0.0);
-        if (u_enableShadows != 0) {
-            float sh = softShadow(p + n * 0.01, lightDir);
-            diff *= sh;
+    bool  reprojected  = false;
+    float carriedSteps = 0.0;
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 global = ivec2(fragCoord) + ivec2(u_tileOffset);
+    bool  refresh = ((global.x + 3 * global.y + u_frameIndex) % REPROJECT_REFRESH) == 0;
+    if (u_reproject != 0 && !refresh) {
+        float reprojStart = reprojectedStart(fragCoord, u_camPos, rd, carriedSteps);
+        if (reprojStart > startDist) {
+            reprojected = true;
         }
+        startDist = max(startDist, reprojStart);
+    }
 
-        float spec = 0.0;
-        if (diff > 0.0) {
-            vec3 h = normalize(lightDir - rd);
-            spec = pow(max(dot(n, h), 0.0), 32.0);
+    int steps;
+    float tLo;
+    float t = raymarch(u_camPos, rd, offset, startDist, steps, tLo);
+#ifdef COST_STATS
+    // This pass's own work: both marches when reprojection falls back.
+    int costSteps = steps;
+#endif
+
+    if (reprojected && t > 0.0) {
+        // A full march would have spent about as many steps as last frame.
+        steps = int(carriedSteps);
+    } else {
+        if (reprojected) {
+            // Started past a thin feature: fall back to a full march.
+            startDist = u_prepassScale > 0
+                      ? texelFetch(u_startDist, ivec2(fragCoord) / u_prepassScale, 0).r : 0.0;
+            t = raymarch(u_camPos, rd, offset, startDist, steps, tLo);
+#ifdef COST_STATS
+            costSteps += steps;
+#endif
         }
+        // Count the prepass steps too so the step-ratio colouring matches
+        // a march from the camera.
+        steps += startSteps;
+    }
 
-        float ao = 1.0;
-        if (u_enableAO != 0) {
-            ao = ambientOcclusion(p, n);
-        }
+    HitInfo = vec2(t, float(steps));
+    Position p = rayPoint(u_camPos, rd, offset, t, tLo);
 
-        float stepRatio = clamp(float(steps) / float(u_maxSteps), 0.0, 1.0);
-        vec3 baseColor  = mix(u_colorA, u_colorB, stepRatio);
+#ifdef GBUFFER
+    // Deferred: shadows, AO and lighting run in later passes.
+    vec3 n = t > 0.0 ? estimateNormal(p, t) : vec3(0.0);
+    FragColor = vec4(n, stepRatio(steps));
+    return;
+#endif
 
-        vec3 ambient = 0.2 * ao * baseColor;
-        vec3 diffuse = diff * baseColor;
-        vec3 specCol = spec * vec3(1.0);
+    vec3 col = shadeRay(rd, p, t, steps);
 
-        col = ambient + diffuse + specCol;
-    } else {
-        // Background gradient
-        float h = 0.5 * (rd.y + 1.0);
-        col = mix(vec3(0.03, 0.03, 0.08),
-                  vec3(0.2, 0.3, 0.45), h);
-    }
+#ifdef COST_STATS
+    // raymarch() reports STEP_COUNT only when it ran out of steps.
+    int outcome = t > 0.0 ? 1 : (steps - startSteps >= STEP_COUNT ? 2 : 0);
+#ifdef COST_COUNTERS
+    countCosts(costSteps, outcome);
+#endif
+#ifdef COST_HEATMAP
+    col = costColor(costSteps, outcome);
+#endif
+#endif
 
-    // Gamma correction
-    col = pow(col, vec3(0.4545)); // ~1/2.2
+    col = accumulate(col, pixel);
 
     FragColor = vec4(col, 1.0);
 }
+
+#endif
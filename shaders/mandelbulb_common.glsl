@@ -0,0 +1,865 @@
+// Shared by mandelbulb.frag and mandelbulb.comp through #include (expanded
+// by the host when loading; see readShaderSource). Everything the two
+// raymarch backends must agree on lives here: the parameter block, the
+// distance estimator, the march step and the shading.
+
+// View parameters, shared by every program variant through one uniform
+// buffer (binding point 0). Mirrors FractalParamsStd140 in
+// fractal_program.h: each vec3 carries a scalar in its fourth slot.
+layout(std140) uniform FractalParams {
+    // Camera
+    vec3  u_camPos;      float u_fov;
+    vec3  u_camForward;  float u_power;
+    vec3  u_camRight;    float u_bailout;
+    vec3  u_camUp;       float u_maxDist;
+
+    // Shading / color
+    vec3  u_colorA;      float u_epsilon;
+    vec3  u_colorB;      int   u_maxIter;
+
+    int   u_maxSteps;
+    int   u_enableAO;
+    int   u_enableShadows;
+    int   u_prepassScale;
+
+    vec2  u_resolution;
+    int   u_analyticNormals;
+    int   u_boundedMarch;
+
+    float u_relaxation;  // over-relaxation factor of bounded marching
+    int   u_lod;
+    float u_lodBias;     // hit threshold in pixel footprints
+    float u_lodIterBias; // iterations dropped per power-fold coarser threshold
+
+    vec3  u_camPosLo;    int u_deepZoom;  // u_camPos's rounding error
+};
+
+uniform float u_time;
+
+// Pixel position of this draw's origin within the full u_resolution image,
+// for tiled rendering. Targets are tile-sized; rays use full-image
+// coordinates. A multiple of u_prepassScale so coarse tiles line up.
+uniform vec2  u_tileOffset;
+
+#ifdef SWEEP
+// Parameter sweep: each tile of the atlas is a tile-sized view of its own
+// fractal, its parameters and origin passed by sweep.vert in place of the
+// block's. u_resolution is the tile size.
+flat in vec3 v_sweepParams;   // power, bailout, iterations
+flat in vec2 v_sweepOrigin;
+#define u_power      v_sweepParams.x
+#define u_bailout    v_sweepParams.y
+#define u_maxIter    int(v_sweepParams.z)
+#define u_tileOffset (-v_sweepOrigin)
+#endif
+
+// Progressive refinement
+uniform vec2      u_jitter;       // sub-pixel ray offset in pixels
+uniform int       u_sampleIndex;  // 0 = first sample, history ignored
+uniform sampler2D u_history;      // running mean of previous samples
+
+// Depth prepass: coarse tiles of u_prepassScale pixels store a safe ray
+// start distance (r) and the steps spent reaching it (g). 0 = disabled.
+uniform sampler2D u_startDist;
+
+// Distance cache (DistanceCache): lower bounds of the distance to the
+// surface on a grid over the cube |p| <= u_cacheExtent, sampled
+// trilinearly. Marching takes those steps while they exceed
+// u_cacheVoxel and evaluates the formula closer in.
+uniform sampler3D u_distanceCache;
+uniform int       u_cacheEnabled;   // 0 = no volume for these parameters
+uniform float     u_cacheExtent;
+uniform float     u_cacheVoxel;     // grid spacing
+
+// Lighting cache (LightingCache): shadow (r) and AO (g) of the nearest
+// surface on a grid over the cube |p| <= u_lightCacheExtent, used by
+// secondaryTerms instead of tracing inside it wherever a pixel covers at
+// least a voxel.
+uniform sampler3D u_lightingCache;
+uniform int       u_lightCache;       // 0 = trace, 1 = cached shadow, 2 = and AO
+uniform float     u_lightCacheExtent;
+uniform float     u_lightCacheVoxel;  // grid spacing
+
+// Per-frame budgets: refinement raises these while the view holds still.
+uniform int   u_stepLimit;    // >= u_maxSteps while refining
+uniform int   u_shadowSteps;
+
+// Permutations: the host may inject any of these after #version. Each one
+// left out falls back to its runtime uniform (the generic variant).
+//   MAX_ITER n          exact iteration count          (u_maxIter)
+//   STEP_LIMIT n        exact march step limit         (u_stepLimit)
+//   SHADOW_STEPS n      exact soft-shadow step count   (u_shadowSteps)
+//   ENABLE_AO 0|1                                      (u_enableAO)
+//   ENABLE_SHADOWS 0|1                                 (u_enableShadows)
+//   POWER n             integer power; 8 is trig-free  (u_power)
+//   ANALYTIC_NORMALS 0|1                               (u_analyticNormals)
+//   DISTANCE_CACHE 0|1                                 (u_cacheEnabled)
+//   LIGHT_CACHE 0|1|2   cached shadow, and AO          (u_lightCache)
+//   BOUNDED_MARCH 0|1   bounding sphere, over-relaxed  (u_boundedMarch)
+//   DISTANCE_LOD 0|1    footprint threshold/iterations (u_lod)
+//   DEEP_ZOOM 0|1|2     extended precision near the surface, 1 emulated,
+//                       2 native fp64; 2 only as a define (u_deepZoom)
+// mandelbulb.frag's forward pass also takes
+//   CHECKERBOARD 0|1    march half the pixels (u_checkerboard)
+//   SWEEP               per-tile parameters from sweep.vert; never with
+//                       MAX_ITER or POWER
+// and two debug switches with no runtime form, which the normal variants
+// never see (mandelbulb.frag forward pass only):
+//   COST_HEATMAP 1|2|3  draw march steps, DE evaluations or the march
+//                       outcome instead of the shaded surface
+//   COST_COUNTERS       add this pass's costs to the CostCounters buffer
+
+#ifdef MAX_ITER
+#define ITER_BOUND MAX_ITER
+#define ITER_COUNT MAX_ITER
+#else
+#define ITER_BOUND 64
+#define ITER_COUNT u_maxIter
+#endif
+
+#ifdef STEP_LIMIT
+#define STEP_BOUND STEP_LIMIT
+#define STEP_COUNT STEP_LIMIT
+#else
+#define STEP_BOUND 1024
+#define STEP_COUNT u_stepLimit
+#endif
+
+#ifdef SHADOW_STEPS
+#define SHADOW_BOUND SHADOW_STEPS
+#else
+#define SHADOW_BOUND 128
+#endif
+
+#ifdef ENABLE_AO
+#define AO_ON (ENABLE_AO != 0)
+#else
+#define AO_ON (u_enableAO != 0)
+#endif
+
+#ifdef ENABLE_SHADOWS
+#define SHADOWS_ON (ENABLE_SHADOWS != 0)
+#else
+#define SHADOWS_ON (u_enableShadows != 0)
+#endif
+
+#ifdef ANALYTIC_NORMALS
+#define NORMALS_ANALYTIC (ANALYTIC_NORMALS != 0)
+#else
+#define NORMALS_ANALYTIC (u_analyticNormals != 0)
+#endif
+
+#ifdef DISTANCE_CACHE
+#define CACHE_ON (DISTANCE_CACHE != 0)
+#else
+#define CACHE_ON (u_cacheEnabled != 0)
+#endif
+
+#ifdef LIGHT_CACHE
+#define LIGHT_CACHE_MODE LIGHT_CACHE
+#else
+#define LIGHT_CACHE_MODE u_lightCache
+#endif
+
+#ifdef BOUNDED_MARCH
+#define MARCH_BOUNDED (BOUNDED_MARCH != 0)
+#else
+#define MARCH_BOUNDED (u_boundedMarch != 0)
+#endif
+
+#ifdef DISTANCE_LOD
+#define LOD_ON (DISTANCE_LOD != 0)
+#else
+#define LOD_ON (u_lod != 0)
+#endif
+
+#ifdef POWER
+#define FRACTAL_POWER float(POWER)
+#else
+#define FRACTAL_POWER u_power
+#endif
+
+#ifdef DEEP_ZOOM
+#define DEEP_ON (DEEP_ZOOM != 0)
+#else
+#define DEEP_ON (u_deepZoom != 0)
+#endif
+
+// The extended-precision formula (deepDE) takes integer powers only;
+// others stay in float.
+#ifdef POWER
+#define DEEP_POWER POWER
+#define DEEP_ACTIVE DEEP_ON
+#else
+#define DEEP_POWER int(u_power)
+#define DEEP_ACTIVE (DEEP_ON && floor(u_power) == u_power)
+#endif
+
+// Cost instrumentation: DE evaluations of this invocation, by what they
+// were for. Compiled out unless a COST_ define asks for it.
+#if defined(COST_HEATMAP) || defined(COST_COUNTERS)
+#define COST_STATS
+const int COST_PRIMARY = 0;
+const int COST_NORMAL  = 1;
+const int COST_SHADOW  = 2;
+const int COST_AO      = 3;
+int costPhase = COST_PRIMARY;
+int costEvaluations[4] = int[4](0, 0, 0, 0);
+#define COST_PHASE(phase) costPhase = (phase)
+#define COUNT_EVALUATION() costEvaluations[costPhase]++
+#else
+#define COST_PHASE(phase)
+#define COUNT_EVALUATION()
+#endif
+
+#include "df64.glsl"
+
+// z -> z^power in spherical coordinates; also advances the running
+// derivative dr = power * r^(power-1) * dr + 1.
+vec3 bulbPower(in vec3 z, in float r, inout float dr)
+{
+#if defined(POWER) && POWER == 8
+    // With rho = |z.xy|: (z.z + i rho)^8 expands to r^8 (cos 8theta +
+    // i sin 8theta) and (z.x + i z.y)^8 / rho^8 to cos 8phi + i sin 8phi,
+    // so the trig version reduces to polynomials plus one sqrt.
+    float x2 = z.x * z.x, y2 = z.y * z.y, z2 = z.z * z.z;
+    float x4 = x2 * x2, y4 = y2 * y2, z4 = z2 * z2, z6 = z4 * z2;
+    float rho2 = x2 + y2;
+    float rho4 = rho2 * rho2, rho6 = rho4 * rho2, rho8 = rho4 * rho4;
+
+    float re8 = x4 * x4 - 28.0 * x4 * x2 * y2 + 70.0 * x4 * y4
+              - 28.0 * x2 * y4 * y2 + y4 * y4;
+    float im8 = 8.0 * z.x * z.y * (x4 * x2 - 7.0 * x4 * y2 + 7.0 * x2 * y4 - y4 * y2);
+    float sinPart = 8.0 * z.z * sqrt(rho2) *
+                    (z6 - 7.0 * z4 * rho2 + 7.0 * z2 * rho4 - rho6) / max(rho8, 1e-30);
+
+    float r2 = r * r;
+    dr = 8.0 * r2 * r2 * r2 * r * dr + 1.0;
+
+    return vec3(sinPart * re8,
+                sinPart * im8,
+                z4 * z4 - 28.0 * z6 * rho2 + 70.0 * z4 * rho4 - 28.0 * z2 * rho6 + rho8);
+#else
+    float theta = acos(clamp(z.z / max(r, 1e-6), -1.0, 1.0));
+    float phi   = atan(z.y, z.x);
+
+#ifdef POWER
+    float rn1 = 1.0;
+    for (int k = 1; k < POWER; k++)
+        rn1 *= r;
+    float zr = rn1 * r;
+#else
+    float zr  = pow(r, u_power);
+    float rn1 = pow(r, u_power - 1.0);
+#endif
+    dr = rn1 * FRACTAL_POWER * dr + 1.0;
+
+    theta *= FRACTAL_POWER;
+    phi   *= FRACTAL_POWER;
+
+    return zr * vec3(
+        sin(theta) * cos(phi),
+        sin(theta) * sin(phi),
+        cos(theta)
+    );
+#endif
+}
+
+// Distance Estimator, of the surface after `iterations` iterations.
+float mandelbulbDE(in vec3 pos, in int iterations)
+{
+    vec3 z = pos;
+    float dr = 1.0;
+    float r  = 0.0;
+    COUNT_EVALUATION();
+
+    for (int i = 0; i < ITER_BOUND; i++) {
+        if (i >= iterations)
+            break;
+
+        r = length(z);
+        if (r > u_bailout)
+            break;
+
+        z = bulbPower(z, r, dr) + pos;
+    }
+
+    return 0.5 * log(r) * r / dr;
+}
+
+float mandelbulbDE(in vec3 pos)
+{
+    return mandelbulbDE(pos, ITER_COUNT);
+}
+
+// Level of detail: with LOD on, a ray stops once it is within u_lodBias
+// pixel footprints of the surface (the width of its pixel's cone at
+// `dist`) rather than u_epsilon. Deep zoom drops the u_epsilon floor, and
+// without LOD caps u_epsilon at half a footprint, so a tight field of view
+// resolves finer than the fixed threshold would.
+float pixelFootprint(in float dist)
+{
+    return dist * 2.0 * u_fov / u_resolution.y;
+}
+
+float hitThreshold(in float dist)
+{
+    float footprint = pixelFootprint(dist);
+    if (DEEP_ACTIVE)
+        return LOD_ON ? u_lodBias * footprint : min(u_epsilon, 0.5 * footprint);
+    if (!LOD_ON)
+        return u_epsilon;
+    return max(u_epsilon, u_lodBias * footprint);
+}
+
+// Iterations worth evaluating at a hit threshold. Each iteration adds
+// detail about FRACTAL_POWER times finer than the last, so every
+// power-fold of coarsening over u_epsilon drops u_lodIterBias of them.
+int lodIterations(in float threshold)
+{
+    if (!LOD_ON)
+        return ITER_COUNT;
+    float coarsening = log2(threshold / u_epsilon) / log2(max(FRACTAL_POWER, 2.0));
+    int drop = int(u_lodIterBias * coarsening);
+    return clamp(ITER_COUNT - drop, min(ITER_COUNT, 4), ITER_COUNT);
+}
+
+// Distance bound for marching: the cached value where it allows a step of
+// at least a voxel, else the exact estimate. The volume is baked at full
+// iterations; LOD surfaces differ from it only by detail finer than the
+// voxels it is used beyond.
+float sceneDistance(in vec3 pos, in int iterations)
+{
+    if (CACHE_ON && all(lessThanEqual(abs(pos), vec3(u_cacheExtent)))) {
+        vec3 uvw = pos / (2.0 * u_cacheExtent) + 0.5;
+        float d = textureLod(u_distanceCache, uvw, 0.0).r;
+        if (d > u_cacheVoxel)
+            return d;
+    }
+    return mandelbulbDE(pos, iterations);
+}
+
+// ---------------------------- deep zoom ---------------------------- //
+
+// A point to about twice float precision, hi + lo per component. lo is
+// zero outside deep zoom.
+struct Position {
+    vec3 hi;
+    vec3 lo;
+};
+
+Position offsetPosition(in Position p, in vec3 d)
+{
+    Position q;
+    for (int k = 0; k < 3; k++) {
+        DF c = dfAddF(dfMake(p.hi[k], p.lo[k]), d[k]);
+        q.hi[k] = dfHi(c);
+        q.lo[k] = dfLo(c);
+    }
+    return q;
+}
+
+// Eight float ulps, relative. Evaluating the formula in float at p is off
+// by about as much as moving p by a few ulps of |p| (rounding p itself,
+// plus the rounding of each iterate scaled back by the derivative).
+const float FLOAT_SLACK = 4.8e-7;
+
+float floatSlack(in vec3 p)
+{
+    return FLOAT_SLACK * max(length(p), 1e-3);
+}
+
+// (re + i im)^n in DF, by repeated squaring.
+void dfComplexPow(inout DF re, inout DF im, in int n)
+{
+    DF rr = dfOne(), ri = dfZero();
+    bool started = false;
+    for (int bit = 32; bit > 0; bit /= 2) {
+        if (started) {
+            DF sr = dfSub(dfMul(rr, rr), dfMul(ri, ri));
+            ri = dfMulF(dfMul(rr, ri), 2.0);
+            rr = sr;
+        }
+        if ((n & bit) != 0) {
+            if (started) {
+                DF mr = dfSub(dfMul(rr, re), dfMul(ri, im));
+                ri = dfAdd(dfMul(rr, im), dfMul(ri, re));
+                rr = mr;
+            } else {
+                rr = re;
+                ri = im;
+                started = true;
+            }
+        }
+    }
+    re = rr;
+    im = ri;
+}
+
+// bulbPower's map for an integer power n without trigonometry, as in its
+// POWER 8 path: with rho = |z.xy|, (z.z + i rho)^n = r^n (cos n theta +
+// i sin n theta) and (z.x + i z.y)^n = rho^n (cos n phi + i sin n phi).
+void dfBulbPower(inout DF x, inout DF y, inout DF z, in int n)
+{
+    DF rho = dfSqrt(dfAdd(dfMul(x, x), dfMul(y, y)));
+    DF rhoN = rho, unused = dfZero();
+    dfComplexPow(rhoN, unused, n);
+
+    DF ar = z, ai = rho;
+    dfComplexPow(ar, ai, n);
+    z = ar;
+    if (dfHi(rhoN) <= 0.0) {
+        // On the axis: phi is 0 by bulbPower's atan(0, 0).
+        x = ai;
+        y = dfZero();
+        return;
+    }
+
+    DF br = x, bi = y;
+    dfComplexPow(br, bi, n);
+    DF s = dfDiv(ai, rhoN);
+    x = dfMul(s, br);
+    y = dfMul(s, bi);
+}
+
+// mandelbulbDE at an extended-precision point, for DEEP_ACTIVE views.
+// Rounding z to float at some iteration moves the result about as much
+// as moving pos by ulp(|z|) / dr, and dr grows quickly, so iterations run
+// in DF only until that is below `tolerance` and in float after.
+float deepDE(in Position p, in int iterations, in float tolerance)
+{
+    DF px = dfMake(p.hi.x, p.lo.x), py = dfMake(p.hi.y, p.lo.y), pz = dfMake(p.hi.z, p.lo.z);
+    DF zx = px, zy = py, zz = pz;
+    vec3 z = p.hi;
+    float dr = 1.0;
+    float r  = 0.0;
+    float pLen = length(p.hi);
+    bool extended = true;
+    COUNT_EVALUATION();
+
+    for (int i = 0; i < ITER_BOUND; i++) {
+        if (i >= iterations)
+            break;
+
+        if (extended)
+            z = vec3(dfHi(zx), dfHi(zy), dfHi(zz));
+        r = length(z);
+        if (r > u_bailout)
+            break;
+
+        extended = extended && FLOAT_SLACK * max(r, pLen) >= tolerance * dr;
+        if (!extended) {
+            z = bulbPower(z, r, dr) + p.hi;
+            continue;
+        }
+
+        float rn1 = 1.0;
+        for (int k = 1; k < DEEP_POWER; k++)
+            rn1 *= r;
+        dr = rn1 * float(DEEP_POWER) * dr + 1.0;
+
+        dfBulbPower(zx, zy, zz, DEEP_POWER);
+        zx = dfAdd(zx, px);
+        zy = dfAdd(zy, py);
+        zz = dfAdd(zz, pz);
+    }
+
+    return 0.5 * log(r) * r / dr;
+}
+
+// sceneDistance at an extended-precision point, for a hit threshold of
+// `threshold`. Where float resolves the threshold, or the float distance
+// less its slack is still a long step, that is used; only rays closing in
+// on the surface of a deep view evaluate the DF formula.
+float sceneDistance(in Position p, in int iterations, in float threshold)
+{
+    float d = sceneDistance(p.hi, iterations);
+    if (!DEEP_ACTIVE)
+        return d;
+
+    float slack = floatSlack(p.hi);
+    if (slack < 0.25 * threshold)
+        return d;
+    if (d > 64.0 * slack)
+        return d - slack;
+    return deepDE(p, iterations, 0.25 * threshold);
+}
+
+// Entry and exit distances of the ray ro + t rd (rd unit length) through
+// the sphere |p| = radius; exit < entry if it misses. With radius
+// u_bailout nothing outside can be hit: points there escape on the first
+// iteration and estimate a positive distance.
+vec2 boundingSpan(in vec3 ro, in vec3 rd, in float radius)
+{
+    float b = dot(ro, rd);
+    float h = b * b - dot(ro, ro) + radius * radius;
+    if (h < 0.0)
+        return vec2(1e20, -1e20);
+    h = sqrt(h);
+    return vec2(-b - h, -b + h);
+}
+
+// Marching state between raymarch() steps. Bounded marching clips the
+// ray to the bailout sphere and steps u_relaxation times the distance
+// bound (over-relaxed sphere tracing). That is safe while the unbounding
+// spheres of consecutive points overlap; when they don't, the step may
+// have skipped a surface, so the march goes back to take the plain step
+// from the previous point instead, then carries on over-relaxed.
+struct MarchState {
+    float dist;
+    float distLo;      // dist's rounding error, deep zoom only
+    float end;         // leaves the scene beyond this distance
+    float radius;      // distance bound at the previous point
+    float stepLength;  // step taken from there
+};
+
+MarchState beginMarch(in vec3 ro, in vec3 rd, in float startDist)
+{
+    MarchState m;
+    m.dist       = startDist;
+    m.distLo     = 0.0;
+    m.end        = u_maxDist;
+    m.radius     = 0.0;
+    m.stepLength = 0.0;
+    if (MARCH_BOUNDED) {
+        vec2 span = boundingSpan(ro, rd, u_bailout);
+        m.dist = max(m.dist, span.x);
+        m.end  = min(m.end, span.y);
+    }
+    return m;
+}
+
+void advance(inout MarchState m, in float step)
+{
+    if (DEEP_ACTIVE) {
+        DF d = dfAddF(dfMake(m.dist, m.distLo), step);
+        m.dist   = dfHi(d);
+        m.distLo = dfLo(d);
+    } else {
+        m.dist += step;
+    }
+}
+
+// The point at dist + distLo along a camera ray: ro is u_camPos, rd the
+// ray's direction and offset its off-axis part (cameraOffset). Deep zoom
+// rebuilds it from u_camPos + u_camPosLo and the unnormalized direction
+// u_camForward + offset, all in DF, so the error doesn't grow with the
+// distance.
+Position rayPoint(in vec3 ro, in vec3 rd, in vec3 offset, in float dist, in float distLo)
+{
+    Position p;
+    p.hi = ro + rd * dist;
+    p.lo = vec3(0.0);
+    if (!DEEP_ACTIVE)
+        return p;
+
+    // |u_camForward| = 1 and offset is perpendicular to it.
+    DF s = dfMulF(dfMake(dist, distLo), inversesqrt(1.0 + dot(offset, offset)));
+    for (int k = 0; k < 3; k++) {
+        DF c = dfAdd(dfMake(u_camPos[k], u_camPosLo[k]), dfMulF(s, u_camForward[k]));
+        c = dfAddF(c, dfHi(s) * offset[k]);
+        p.hi[k] = dfHi(c);
+        p.lo[k] = dfLo(c);
+    }
+    return p;
+}
+
+// One raymarch() iteration: 1 = hit at m.dist, -1 = left the scene,
+// 0 = advanced, keep marching. Split out so the compute backend can
+// suspend a ray between steps.
+int marchStep(in vec3 ro, in vec3 rd, in vec3 offset, inout MarchState m)
+{
+    if (m.dist > m.end)
+        return -1;
+
+    float omega = MARCH_BOUNDED ? u_relaxation : 1.0;
+    float threshold = hitThreshold(m.dist);
+    float r = sceneDistance(rayPoint(ro, rd, offset, m.dist, m.distLo),
+                            lodIterations(threshold), threshold);
+
+    if (m.stepLength > m.radius && r + m.radius < m.stepLength) {
+        // Overshoot. The plain step is covered by the previous sphere, so
+        // the next point needs no check.
+        advance(m, m.radius - m.stepLength);
+        m.radius = m.stepLength = 0.0;
+        return 0;
+    }
+
+    if (r < threshold)
+        return 1;
+
+    m.radius     = r;
+    m.stepLength = omega * r;
+    advance(m, m.stepLength);
+    return 0;
+}
+
+// Misses report the steps actually taken; only running out of steps
+// reports STEP_COUNT. distLo receives a hit's rounding error (rayPoint).
+float raymarch(in vec3 ro, in vec3 rd, in vec3 offset, in float startDist,
+               out int steps, out float distLo)
+{
+    MarchState m = beginMarch(ro, rd, startDist);
+
+    for (int i = 0; i < STEP_BOUND; i++) {
+#ifndef STEP_LIMIT
+        if (i >= u_stepLimit)
+            break;
+#endif
+
+        int state = marchStep(ro, rd, offset, m);
+        if (state != 0) {
+            steps  = i;
+            distLo = m.distLo;
+            return state > 0 ? m.dist : -1.0;
+        }
+    }
+
+    steps  = STEP_COUNT;
+    distLo = 0.0;
+    return -1.0;
+}
+
+// Surface normal from one iteration of the formula in forward-mode dual
+// numbers: alongside z it carries gx, gy, gz, the gradients of z's
+// components with respect to pos (the rows of the iterated map's
+// Jacobian). The escape potential grows with |z|, whose gradient
+// J^T z / |z| is the normal. No epsilon is involved, so it stays smooth
+// where finite differences of a tiny u_epsilon turn noisy.
+vec3 analyticNormal(in vec3 pos, in int iterations)
+{
+    vec3 z  = pos;
+    vec3 gx = vec3(1.0, 0.0, 0.0);
+    vec3 gy = vec3(0.0, 1.0, 0.0);
+    vec3 gz = vec3(0.0, 0.0, 1.0);
+    COUNT_EVALUATION();
+
+    for (int i = 0; i < ITER_BOUND; i++) {
+        if (i >= iterations)
+            break;
+
+        float r = length(z);
+        if (r > u_bailout)
+            break;
+
+        // Same spherical map as bulbPower's general path; theta via atan
+        // so that its derivative has no pole at z.z = +-r.
+        float rho2 = max(dot(z.xy, z.xy), 1e-20);
+        float rho  = sqrt(rho2);
+        float r2   = max(r * r, 1e-20);
+        float theta = atan(rho, z.z);
+        float phi   = atan(z.y, z.x);
+
+        vec3 dr     = (z.x * gx + z.y * gy + z.z * gz) / max(r, 1e-10);
+        vec3 drho   = (z.x * gx + z.y * gy) / rho;
+        vec3 dtheta = (z.z * drho - rho * gz) / r2;
+        vec3 dphi   = (z.x * gy - z.y * gx) / rho2;
+
+        float rn1 = pow(r, FRACTAL_POWER - 1.0);
+        float zr  = rn1 * r;
+        vec3  dzr = FRACTAL_POWER * rn1 * dr;
+
+        float t = theta * FRACTAL_POWER, p = phi * FRACTAL_POWER;
+        vec3 dt = dtheta * FRACTAL_POWER, dp = dphi * FRACTAL_POWER;
+        float st = sin(t), ct = cos(t), sp = sin(p), cp = cos(p);
+
+        z  = zr * vec3(st * cp, st * sp, ct) + pos;
+        gx = dzr * (st * cp) + zr * (ct * cp * dt - st * sp * dp) + vec3(1.0, 0.0, 0.0);
+        gy = dzr * (st * sp) + zr * (ct * sp * dt + st * cp * dp) + vec3(0.0, 1.0, 0.0);
+        gz = dzr * ct        - zr * (st * dt)                     + vec3(0.0, 0.0, 1.0);
+    }
+
+    return normalize(z.x * gx + z.y * gy + z.z * gz);
+}
+
+// Normal of the surface a ray hit at distance `dist`, at that distance's
+// level of detail. Where float can't resolve the differences in a deep
+// view, they are taken of deepDE (analytic normals would need the same
+// precision, so they give way to it there).
+vec3 estimateNormal(in Position p, in float dist)
+{
+    float threshold = hitThreshold(dist);
+    int iterations = lodIterations(threshold);
+    float eps = threshold * 2.0;
+    bool deep = DEEP_ACTIVE && floatSlack(p.hi) >= 0.02 * eps;
+    if (NORMALS_ANALYTIC && !deep)
+        return analyticNormal(p.hi, iterations);
+
+    if (deep) {
+        // The float path's samples, from a loop so that the DF formula is
+        // expanded once: p, then p + eps e with e = (1, -1, -1) and its
+        // permutations.
+        float d[4];
+        for (int k = 0; k < 4; k++) {
+            vec3 e = k == 0 ? vec3(0.0) : 2.0 * vec3(equal(ivec3(1, 2, 3), ivec3(k))) - 1.0;
+            d[k] = deepDE(offsetPosition(p, e * eps), iterations, 0.02 * eps);
+        }
+        return normalize(vec3(d[1], d[2], d[3]) - d[0]);
+    }
+
+    vec2 e = vec2(1.0, -1.0) * eps;
+    float d = mandelbulbDE(p.hi, iterations);
+    vec3 n = normalize(vec3(
+        mandelbulbDE(p.hi + vec3(e.x, e.y, e.y), iterations) - d,
+        mandelbulbDE(p.hi + vec3(e.y, e.x, e.y), iterations) - d,
+        mandelbulbDE(p.hi + vec3(e.y, e.y, e.x), iterations) - d
+    ));
+    return n;
+}
+
+float softShadow(in vec3 ro, in vec3 rd)
+{
+    float res = 1.0;
+    float t = 0.02;
+
+    for (int i = 0; i < SHADOW_BOUND; i++) {
+#ifndef SHADOW_STEPS
+        if (i >= u_shadowSteps)
+            break;
+#endif
+
+        vec3 p = ro + rd * t;
+        float h = mandelbulbDE(p);
+        if (h < 0.0005)
+            return 0.0;
+
+        res = min(res, 10.0 * h / t);
+        t += clamp(h, 0.02, 0.2);
+        if (t > 20.0)
+            break;
+    }
+
+    return clamp(res, 0.0, 1.0);
+}
+
+float ambientOcclusion(in vec3 p, in vec3 n)
+{
+    float ao = 0.0;
+    float sca = 1.0;
+
+    for (int i = 0; i < 5; i++) {
+        float h = 0.01 + 0.12 * float(i) / 4.0;
+        float d = mandelbulbDE(p + n * h);
+        ao += (h - d) * sca;
+        sca *= 0.95;
+    }
+
+    return clamp(1.0 - 3.0 * ao, 0.0, 1.0);
+}
+
+// The ray direction past forward at fragCoord: the unit ray direction is
+// normalize(forward + rayOffset).
+vec3 rayOffset(in vec2 fragCoord, in vec2 resolution,
+               in vec3 right, in vec3 up, in float fov)
+{
+    // Screen-space coordinates
+    vec2 uv = (fragCoord / resolution.xy) * 2.0 - 1.0;
+    uv.x *= resolution.x / resolution.y;
+
+    return uv.x * right * fov +
+           uv.y * up * fov;
+}
+
+vec3 rayDirection(in vec2 fragCoord, in vec2 resolution,
+                  in vec3 forward, in vec3 right, in vec3 up, in float fov)
+{
+    return normalize(forward + rayOffset(fragCoord, resolution, right, up, fov));
+}
+
+vec3 cameraOffset(in vec2 fragCoord)
+{
+    return rayOffset(fragCoord + u_tileOffset, u_resolution, u_camRight, u_camUp, u_fov);
+}
+
+vec3 cameraRay(in vec2 fragCoord)
+{
+    return normalize(u_camForward + cameraOffset(fragCoord));
+}
+
+const vec3 LIGHT_DIR = normalize(vec3(0.4, 0.7, 0.2));
+
+float stepRatio(in int steps)
+{
+    return clamp(float(steps) / float(u_maxSteps), 0.0, 1.0);
+}
+
+vec3 background(in vec3 rd)
+{
+    float h = 0.5 * (rd.y + 1.0);
+    return mix(vec3(0.03, 0.03, 0.08),
+               vec3(0.2, 0.3, 0.45), h);
+}
+
+// The lighting model, given the secondary terms: `shadow` and `ao` are
+// 1 when disabled. The deferred path feeds it upsampled values.
+vec3 lightSurface(in vec3 rd, in vec3 n, in float ratio, in float shadow, in float ao)
+{
+    float diff = max(dot(n, LIGHT_DIR), 0.0) * shadow;
+
+    float spec = 0.0;
+    if (diff > 0.0) {
+        vec3 h = normalize(LIGHT_DIR - rd);
+        spec = pow(max(dot(n, h), 0.0), 32.0);
+    }
+
+    vec3 baseColor = mix(u_colorA, u_colorB, ratio);
+
+    vec3 ambient = 0.2 * ao * baseColor;
+    vec3 diffuse = diff * baseColor;
+    vec3 specCol = spec * vec3(1.0);
+
+    return ambient + diffuse + specCol;
+}
+
+// Shadow and AO terms at surface point p with normal n: from the lighting
+// cache where it covers p and its voxels are no coarser than p's pixel,
+// else traced, so close-ups keep sharp shadows. The shadow ray is skipped
+// where the light is behind the surface, as it can't show there.
+vec2 secondaryTerms(in vec3 p, in vec3 n)
+{
+    vec2 cached = vec2(-1.0);
+    if (LIGHT_CACHE_MODE != 0 && all(lessThanEqual(abs(p), vec3(u_lightCacheExtent))) &&
+        pixelFootprint(distance(p, u_camPos)) >= u_lightCacheVoxel)
+        cached = textureLod(u_lightingCache, p / (2.0 * u_lightCacheExtent) + 0.5, 0.0).rg;
+
+    float sh = 1.0;
+    if (SHADOWS_ON && cached.x >= 0.0) {
+        sh = cached.x;
+    } else if (SHADOWS_ON && dot(n, LIGHT_DIR) > 0.0) {
+        COST_PHASE(COST_SHADOW);
+        sh = softShadow(p + n * 0.01, LIGHT_DIR);
+    }
+
+    float ao = 1.0;
+    if (AO_ON && cached.y >= 0.0 && LIGHT_CACHE_MODE == 2) {
+        ao = cached.y;
+    } else if (AO_ON) {
+        COST_PHASE(COST_AO);
+        ao = ambientOcclusion(p, n);
+    }
+    return vec2(sh, ao);
+}
+
+// Linear colour of a marched ray: lit surface at p (rayPoint) for t > 0,
+// else background. Shadows and AO work at scales float resolves anyway.
+vec3 shadeRay(in vec3 rd, in Position p, in float t, in int steps)
+{
+    if (t <= 0.0)
+        return background(rd);
+
+    COST_PHASE(COST_NORMAL);
+    vec3 n = estimateNormal(p, t);
+    vec2 terms = secondaryTerms(p.hi, n);
+    return lightSurface(rd, n, stepRatio(steps), terms.x, terms.y);
+}
+
+// Folds this sample into the running mean at `pixel` (target-local).
+// Accumulation is in linear space; the upscale pass applies gamma.
+vec3 accumulate(in vec3 col, in ivec2 pixel)
+{
+    if (u_sampleIndex > 0) {
+        vec3 history = texelFetch(u_history, pixel, 0).rgb;
+        col = mix(history, col, 1.0 / float(u_sampleIndex + 1));
+    }
+    return col;
+}
@@ -0,0 +1,39 @@
+#version 330 core
+
+// Shading rate image for GL_NV_shading_rate_image: one texel per rate
+// tile of the fractal pass's target, palette index 1 (coarse) where the
+// previous frame saw only background over the tile and a margin around
+// it, else 0 (full rate). The background is a smooth gradient, so shading
+// it once per block costs nothing visible.
+
+layout(location = 0) out uint RateIndex;
+
+uniform sampler2D u_prevHitInfo;   // last frame's HitInfo, full width
+uniform vec2  u_prevResolution;
+uniform vec2  u_resolution;        // this frame's view
+uniform ivec2 u_rateTexel;         // target pixels per rate texel
+uniform int   u_targetScaleX;      // view pixels per target pixel in x
+
+// Checked beyond the tile on each side, in view pixels, for motion.
+const float MARGIN = 8.0;
+// Sample spacing within the region, in previous-frame pixels.
+const int STRIDE = 2;
+
+void main()
+{
+    vec2 tile  = floor(gl_FragCoord.xy);
+    vec2 scale = vec2(float(u_targetScaleX), 1.0) * vec2(u_rateTexel);
+    vec2 ratio = u_prevResolution / u_resolution;
+    ivec2 lo = ivec2(max((tile * scale - MARGIN) * ratio, vec2(0.0)));
+    ivec2 hi = ivec2(min(((tile + 1.0) * scale + MARGIN) * ratio, u_prevResolution - 1.0));
+
+    for (int y = lo.y; y <= hi.y; y += STRIDE) {
+        for (int x = lo.x; x <= hi.x; x += STRIDE) {
+            if (texelFetch(u_prevHitInfo, ivec2(x, y), 0).r > 0.0) {
+                RateIndex = 0u;
+                return;
+            }
+        }
+    }
+    RateIndex = 1u;
+}
@@ -0,0 +1,35 @@
+#version 330 core
+
+// Parameter sweep (ParameterSweep): one instanced draw of the full-screen
+// quad covers every tile of the atlas. Instance i is shrunk onto tile i,
+// row by row from the bottom left, and hands its fractal parameters to
+// mandelbulb.frag built with SWEEP.
+
+layout(location = 0) in vec2 a_pos;
+layout(location = 1) in vec2 a_uv;
+
+out vec2 v_uv;
+flat out vec3 v_sweepParams;   // power, bailout, iterations
+flat out vec2 v_sweepOrigin;   // tile origin in atlas pixels
+
+// Mirrors ParameterSweep::kMaxTiles: 16 KiB, the smallest block size GL
+// 3.3 must support.
+const int MAX_TILES = 1024;
+
+layout(std140) uniform SweepParams {
+    vec4 u_sweepTiles[MAX_TILES];   // xyz as v_sweepParams
+};
+
+uniform int  u_sweepColumns;
+uniform vec2 u_sweepTileSize;    // pixels
+uniform vec2 u_sweepAtlasSize;
+
+void main() {
+    ivec2 cell = ivec2(gl_InstanceID % u_sweepColumns, gl_InstanceID / u_sweepColumns);
+    v_sweepOrigin = vec2(cell) * u_sweepTileSize;
+    v_sweepParams = u_sweepTiles[gl_InstanceID].xyz;
+    v_uv = a_uv;
+
+    vec2 pixel = v_sweepOrigin + a_uv * u_sweepTileSize;
+    gl_Position = vec4(pixel / u_sweepAtlasSize * 2.0 - 1.0, 0.0, 1.0);
+}
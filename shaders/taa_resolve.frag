@@ -0,0 +1,119 @@
+#version 330 core
+
+// Temporal anti-aliasing resolve. The fractal pass marched this frame
+// through a Halton sub-pixel offset (u_jitter); this blends it into the
+// previous resolved frame. Each pixel's hit depth places its surface
+// point in the previous camera, where the history is sampled, and that
+// history is clamped to the colour box of this frame's 3x3 neighbourhood
+// so disocclusions and lighting changes cannot ghost.
+
+in vec2 v_uv;
+layout(location = 0) out vec4 FragColor;
+
+#include "mandelbulb_common.glsl"
+
+uniform sampler2D u_taaColor;     // this frame's colour
+uniform sampler2D u_taaHit;       // and HitInfo
+uniform sampler2D u_taaHistory;   // the previous resolve
+uniform float     u_taaBlend;     // weight of this frame
+
+uniform int       u_reproject;    // 0 = no usable previous frame
+uniform vec2      u_prevResolution;
+uniform vec3      u_prevCamPos;
+uniform vec3      u_prevCamForward;
+uniform vec3      u_prevCamRight;
+uniform vec3      u_prevCamUp;
+uniform float     u_prevFov;
+
+// The clamp is done in YCoCg, where the box hugs the colours far more
+// tightly than in RGB.
+vec3 toYCoCg(in vec3 c)
+{
+    return vec3(0.25 * c.r + 0.5 * c.g + 0.25 * c.b,
+                0.5 * c.r - 0.5 * c.b,
+                -0.25 * c.r + 0.5 * c.g - 0.25 * c.b);
+}
+
+vec3 fromYCoCg(in vec3 c)
+{
+    return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// Where the previous frame saw v, a point relative to its camera (or a
+// direction, for misses), in its pixels; negative if off screen.
+vec2 previousPixel(in vec3 v)
+{
+    float z = dot(v, u_prevCamForward);
+    if (z <= 0.0)
+        return vec2(-1.0);
+
+    vec2 ndc = vec2(dot(v, u_prevCamRight), dot(v, u_prevCamUp)) / (z * u_prevFov);
+    ndc.x *= u_prevResolution.y / u_prevResolution.x;
+    vec2 texel = (ndc * 0.5 + 0.5) * u_prevResolution;
+    if (any(lessThan(texel, vec2(0.0))) || any(greaterThan(texel, u_prevResolution)))
+        return vec2(-1.0);
+    return texel;
+}
+
+// History at texel (in pixels), Catmull-Rom filtered: bilinear fetches
+// would blur it a little more every frame the view moves. Five bilinear
+// taps, the corners of the 4x4 footprint dropped.
+vec3 sampleHistory(in vec2 texel)
+{
+    vec2 size = vec2(textureSize(u_taaHistory, 0));
+    vec2 centre = floor(texel - 0.5) + 0.5;
+    vec2 f  = texel - centre;
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+    vec2 w12 = w1 + w2;
+    vec2 p0  = (centre - 1.0) / size;
+    vec2 p12 = (centre + w2 / w12) / size;
+    vec2 p3  = (centre + 2.0) / size;
+
+    vec3 c = (textureLod(u_taaHistory, vec2(p12.x, p0.y), 0.0).rgb * w12.x * w0.y +
+              textureLod(u_taaHistory, vec2(p0.x, p12.y), 0.0).rgb * w0.x * w12.y +
+              textureLod(u_taaHistory, p12, 0.0).rgb * w12.x * w12.y +
+              textureLod(u_taaHistory, vec2(p3.x, p12.y), 0.0).rgb * w3.x * w12.y +
+              textureLod(u_taaHistory, vec2(p12.x, p3.y), 0.0).rgb * w12.x * w3.y);
+    float total = w12.x * w0.y + w0.x * w12.y + w12.x * w12.y + w3.x * w12.y + w12.x * w3.y;
+    return max(c / total, vec3(0.0));
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 last  = ivec2(u_resolution) - 1;
+    vec3 current = texelFetch(u_taaColor, pixel, 0).rgb;
+
+    if (u_reproject == 0 || u_taaBlend >= 1.0) {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+
+    vec3 lo = toYCoCg(current), hi = lo;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec3 c = toYCoCg(texelFetch(u_taaColor, clamp(pixel + ivec2(x, y), ivec2(0), last), 0).rgb);
+            lo = min(lo, c);
+            hi = max(hi, c);
+        }
+    }
+
+    // This frame's ray, as marched. The history holds pixel centres, so
+    // the motion of its point, rather than where it lies, is applied to
+    // this pixel's centre.
+    vec3 rd = cameraRay(gl_FragCoord.xy + u_jitter);
+    float t = texelFetch(u_taaHit, pixel, 0).r;
+    vec2 texel = previousPixel(t > 0.0 ? u_camPos + rd * t - u_prevCamPos : rd);
+    if (texel.x < 0.0) {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+    texel -= u_jitter;
+
+    vec3 history = toYCoCg(sampleHistory(texel));
+    history = fromYCoCg(clamp(history, lo, hi));
+    FragColor = vec4(mix(history, current, u_taaBlend), 1.0);
+}
@@ -0,0 +1,46 @@
+#version 330 core
+
+in vec2 v_uv;
+out vec4 FragColor;
+
+uniform sampler2D u_source;   // linear colour
+uniform vec2  u_uvScale;    // rendered sub-rectangle / texture size
+uniform vec2  u_texelSize;  // 1 / texture size
+uniform float u_sharpness;  // 0 = plain bilinear
+
+vec3 fetch(in vec2 uv)
+{
+    // Keep bilinear taps inside the part of the texture that was rendered.
+    vec2 lo = 0.5 * u_texelSize;
+    vec2 hi = u_uvScale - 0.5 * u_texelSize;
+    vec3 linear = texture(u_source, clamp(uv, lo, hi)).rgb;
+
+    // Gamma correction
+    return pow(max(linear, vec3(0.0)), vec3(0.4545)); // ~1/2.2
+}
+
+void main()
+{
+    vec2 uv = v_uv * u_uvScale;
+    vec3 c  = fetch(uv);
+
+    if (u_sharpness > 0.0) {
+        // Contrast-adaptive sharpening: the cross neighborhood decides how
+        // much to sharpen, backing off where contrast is already high so
+        // fractal edges don't ring.
+        vec3 n = fetch(uv + vec2(0.0,  u_texelSize.y));
+        vec3 s = fetch(uv - vec2(0.0,  u_texelSize.y));
+        vec3 e = fetch(uv + vec2(u_texelSize.x, 0.0));
+        vec3 w = fetch(uv - vec2(u_texelSize.x, 0.0));
+
+        vec3 mn = min(c, min(min(n, s), min(e, w)));
+        vec3 mx = max(c, max(max(n, s), max(e, w)));
+
+        vec3 amp = sqrt(clamp(min(mn, 1.0 - mx) / max(mx, vec3(1e-4)), 0.0, 1.0));
+        vec3 wgt = -amp / mix(8.0, 5.0, u_sharpness);
+
+        c = clamp((c + (n + s + e + w) * wgt) / (1.0 + 4.0 * wgt), 0.0, 1.0);
+    }
+
+    FragColor = vec4(c, 1.0);
+}
@@ -0,0 +1,125 @@
+#include "baked_volume.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+BakedVolume::BakedVolume(ProgramCache &cache, std::string vsPath, std::string fsPath,
+                         BakedVolumeFormat format, size_t budget, int slicesPerFrame)
+    : cache_(cache), vsPath_(std::move(vsPath)), fsPath_(std::move(fsPath)), format_(format),
+      budget_(budget), slicesPerFrame_(slicesPerFrame) {}
+
+void BakedVolume::destroy() {
+    glDeleteTextures(2, volumes_);
+    if (fbo_) glDeleteFramebuffers(1, &fbo_);
+    fbo_ = volumes_[0] = volumes_[1] = 0;
+    allocated_[0] = allocated_[1] = 0;
+    haveBuilt_ = haveBaking_ = false;
+    loaded_.clear();
+}
+
+int BakedVolume::resolution() const {
+    GLint maxSize = 256;
+    glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxSize);
+
+    double voxels = static_cast<double>(budget_) / (2 * format_.voxelBytes);
+    int n = static_cast<int>(std::cbrt(voxels));
+    n = std::clamp(n, 32, std::min(512, static_cast<int>(maxSize)));
+    return n / 8 * 8;
+}
+
+bool BakedVolume::needsBake(const BakedVolumeKey &key) const {
+    return !haveBuilt_ || built_ != key;
+}
+
+float BakedVolume::progress() const {
+    if (!haveBaking_ || baking_.resolution == 0) return 0.0f;
+    return static_cast<float>(nextSlice_) / baking_.resolution;
+}
+
+size_t BakedVolume::memoryBytes() const {
+    size_t bytes = 0;
+    for (int n : allocated_) bytes += static_cast<size_t>(n) * n * n * format_.voxelBytes;
+    return bytes;
+}
+
+const BakedVolume::BakeProgram *BakedVolume::program(const ShaderDefines &defines) {
+    // Same invalidation rule as FractalVariants.
+    if (cache_.generation() != generation_) {
+        loaded_.clear();
+        generation_ = cache_.generation();
+    }
+
+    GLuint program = cache_.get(vsPath_, fsPath_, defines);
+    if (!program) return nullptr;
+
+    auto it = loaded_.find(program);
+    if (it == loaded_.end()) {
+        BakeProgram bp;
+        bp.fractal    = loadFractalProgram(program);
+        bp.uCacheSize = glGetUniformLocation(program, "u_cacheSize");
+        bp.uSlice     = glGetUniformLocation(program, "u_slice");
+        it = loaded_.emplace(program, bp).first;
+    }
+    return &it->second;
+}
+
+bool BakedVolume::bake(const BakedVolumeKey &key, const ShaderDefines &defines,
+                       const FrameParams &frame, GLuint vao) {
+    if (!needsBake(key)) return false;
+
+    const BakeProgram *bp = program(defines);
+    if (!bp) bp = program({});
+    if (!bp) return false;
+
+    const int pending = 1 - current_;
+    const int n = key.resolution;
+    if (!haveBaking_ || baking_ != key) {
+        // The parameters moved (or this is the first bake): start over.
+        baking_     = key;
+        haveBaking_ = true;
+        nextSlice_  = 0;
+    }
+    if (allocated_[pending] != n) {
+        if (!volumes_[pending]) glGenTextures(1, &volumes_[pending]);
+        glBindTexture(GL_TEXTURE_3D, volumes_[pending]);
+        glTexImage3D(GL_TEXTURE_3D, 0, format_.internalFormat, n, n, n, 0, format_.format,
+                     format_.type, nullptr);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        for (GLenum wrap : {GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R}) {
+            glTexParameteri(GL_TEXTURE_3D, wrap, GL_CLAMP_TO_EDGE);
+        }
+        glBindTexture(GL_TEXTURE_3D, 0);
+        allocated_[pending] = n;
+    }
+    if (!fbo_) glGenFramebuffers(1, &fbo_);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glViewport(0, 0, n, n);
+    glUseProgram(bp->fractal.program);
+    uploadFractalUniforms(bp->fractal, frame);
+    glUniform1i(bp->uCacheSize, n);
+    glBindVertexArray(vao);
+
+    int end = std::min(nextSlice_ + slicesPerFrame_, n);
+    for (; nextSlice_ < end; nextSlice_++) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, volumes_[pending], 0,
+                                  nextSlice_);
+        glUniform1i(bp->uSlice, nextSlice_);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (nextSlice_ < n) return false;
+
+    current_    = pending;
+    built_      = key;
+    haveBuilt_  = true;
+    haveBaking_ = false;
+    return true;
+}
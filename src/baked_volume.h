@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+#include <GL/glew.h>
+
+#include "fractal_program.h"
+#include "shader.h"
+
+// --------------------------- baked volume -------------------------- //
+
+// Half the side of the cube baked volumes (and mesh export) cover. The
+// bulb stays inside radius ~1.2 for the powers the UI offers; beyond the
+// bailout radius the formula escapes at once, so nothing lies there.
+constexpr float kBakedVolumeExtent = 1.5f;
+
+// The cube's half side for a bailout radius.
+inline float bakedVolumeExtent(float bailout) {
+    return bailout < kBakedVolumeExtent ? bailout : kBakedVolumeExtent;
+}
+
+// Surface parameters (and grid size) a baked volume is valid for. The
+// camera and shading don't affect it, so they are left out.
+struct BakedVolumeKey {
+    float power = 0.0f;
+    int   maxIterations = 0;
+    float bailout = 0.0f;
+    float epsilon = 0.0f;   // for bakes that march; 0 otherwise
+    int   resolution = 0;
+
+    bool sameSurface(const BakedVolumeKey &o) const {
+        return power == o.power && maxIterations == o.maxIterations && bailout == o.bailout &&
+               epsilon == o.epsilon;
+    }
+    bool operator==(const BakedVolumeKey &o) const {
+        return sameSurface(o) && resolution == o.resolution;
+    }
+    bool operator!=(const BakedVolumeKey &o) const { return !(*this == o); }
+};
+
+// Texel layout of a volume.
+struct BakedVolumeFormat {
+    GLenum internalFormat;
+    GLenum format, type;   // for allocating it
+    size_t voxelBytes;
+};
+
+// A 3D texture over the cube baked by a fragment shader a few z-slices
+// per bake() call, shared by DistanceCache and LightingCache. Slices go
+// into a second volume, swapped in once every slice is done; a key change
+// restarts the bake, and the old volume stays current meanwhile. The
+// shader gets u_cacheSize and u_slice besides the FractalParams block.
+class BakedVolume {
+public:
+    BakedVolume(ProgramCache &cache, std::string vsPath, std::string fsPath,
+                BakedVolumeFormat format, size_t budget, int slicesPerFrame);
+
+    // Frees the volumes; the next bake() reallocates them.
+    void destroy();
+
+    // Memory for both volumes together. Takes effect with the next bake.
+    void   setBudget(size_t bytes) { budget_ = bytes; }
+    size_t budget() const { return budget_; }
+    // Voxels per axis the budget allows, capped by GL_MAX_3D_TEXTURE_SIZE.
+    int    resolution() const;
+
+    int  slicesPerFrame() const { return slicesPerFrame_; }
+    void setSlicesPerFrame(int slices) { slicesPerFrame_ = slices < 1 ? 1 : slices; }
+
+    // True until a finished volume matches key.
+    bool needsBake(const BakedVolumeKey &key) const;
+    // Bakes the next slicesPerFrame() slices for key with `frame`'s
+    // uniforms, restarting if key changed. The FractalParams buffer must
+    // hold the view. `defines` selects the bake variant (fractalDefines
+    // or empty). Returns true when this call finished the volume.
+    bool bake(const BakedVolumeKey &key, const ShaderDefines &defines, const FrameParams &frame,
+              GLuint vao);
+    // Whether a volume is partly baked, and what fraction of it.
+    bool  baking() const { return haveBaking_; }
+    float progress() const;
+    // Texture memory currently allocated.
+    size_t memoryBytes() const;
+
+    // Whether the current volume was baked for key's surface, at any
+    // resolution; built() is its key then.
+    bool hasSurface(const BakedVolumeKey &key) const {
+        return haveBuilt_ && built_.sameSurface(key);
+    }
+    const BakedVolumeKey &built() const { return built_; }
+    // The current volume.
+    GLuint texture() const { return volumes_[current_]; }
+
+private:
+    struct BakeProgram {
+        FractalProgram fractal;
+        GLint uCacheSize = -1, uSlice = -1;
+    };
+
+    const BakeProgram *program(const ShaderDefines &defines);
+
+    ProgramCache &cache_;
+    std::string   vsPath_, fsPath_;
+    BakedVolumeFormat format_;
+    unsigned      generation_ = 0;
+    std::unordered_map<GLuint, BakeProgram> loaded_;
+
+    GLuint fbo_ = 0;
+    GLuint volumes_[2]   = {0, 0};   // current, in progress
+    int    allocated_[2] = {0, 0};   // voxels per axis
+    int    current_ = 0;
+
+    BakedVolumeKey built_;           // of volumes_[current_]
+    bool           haveBuilt_ = false;
+    BakedVolumeKey baking_;          // of the other volume
+    bool           haveBaking_ = false;
+    int            nextSlice_ = 0;
+
+    size_t budget_;
+    int    slicesPerFrame_;
+};
@@ -0,0 +1,406 @@
+// mandelbulb_bench: renders a fixed set of scenarios (settings presets x
+// camera paths x resolutions) through the headless offscreen path and
+// writes GPU and CPU frame-time statistics as JSON, so two builds can be
+// compared run against run. Camera paths advance per frame, not per
+// second, so every run renders exactly the same frames.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "headless.h"
+#include "offline_renderer.h"
+#include "render_settings.h"
+#include "settings_io.h"
+
+static const char *kShaderDir = "../shaders";
+
+// ----------------------------- scenarios --------------------------- //
+
+struct Preset {
+    const char *name;
+    std::vector<std::string> assignments;   // applied to RenderSettings{}
+};
+
+static const std::vector<Preset> kPresets = {
+    {"default", {}},
+    {"fast",    {"enableShadows=0", "enableAO=0", "maxSteps=120", "maxIterations=12"}},
+    {"quality", {"maxSteps=400", "maxIterations=24", "epsilon=0.0005"}},
+    {"analytic", {"analyticNormals=1", "power=7"}},
+};
+
+enum class CameraPath {
+    Static,   // the default view, for frame-to-frame noise
+    Orbit,    // one camYaw revolution
+    Dolly,    // from the default distance in to the surface
+};
+
+static const struct {
+    const char *name;
+    CameraPath  path;
+} kPaths[] = {
+    {"static", CameraPath::Static},
+    {"orbit",  CameraPath::Orbit},
+    {"dolly",  CameraPath::Dolly},
+};
+
+static const struct {
+    int width, height;
+} kResolutions[] = {
+    {640, 360},
+    {1280, 720},
+    {1920, 1080},
+};
+
+// Places the camera at `u` in [0, 1] along the path.
+static void applyPath(CameraPath path, double u, RenderSettings &s) {
+    switch (path) {
+    case CameraPath::Static:
+        break;
+    case CameraPath::Orbit:
+        s.camYaw += 6.283185307179586 * u;
+        break;
+    case CameraPath::Dolly:
+        s.camDistance = s.camDistance + (1.6 - s.camDistance) * u;
+        s.camYaw += 0.5 * u;
+        break;
+    }
+}
+
+// ---------------------------- statistics --------------------------- //
+
+struct Summary {
+    double mean = 0.0, median = 0.0, p95 = 0.0, p99 = 0.0, min = 0.0, max = 0.0;
+};
+
+// Percentiles by nearest rank, as TimingHistory::stats.
+static Summary summarize(std::vector<double> v) {
+    Summary s;
+    if (v.empty()) return s;
+    std::sort(v.begin(), v.end());
+    const size_t n = v.size();
+    auto rank = [&](double p) {
+        size_t k = static_cast<size_t>(std::ceil(p * n));
+        return v[std::min(std::max<size_t>(k, 1), n) - 1];
+    };
+
+    double sum = 0.0;
+    for (double x : v) sum += x;
+    s.mean   = sum / n;
+    s.median = n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+    s.p95    = rank(0.95);
+    s.p99    = rank(0.99);
+    s.min    = v.front();
+    s.max    = v.back();
+    return s;
+}
+
+struct ScenarioResult {
+    std::string name, preset, path;
+    int width = 0, height = 0;
+    std::vector<double> gpuMs;     // GL_TIME_ELAPSED around the frame's draws
+    std::vector<double> cpuMs;     // submitting the frame
+    std::vector<double> frameMs;   // frame start to frame start
+};
+
+// ------------------------------- run ------------------------------- //
+
+struct BenchOptions {
+    std::string output = "bench.json";
+    std::string filter;                 // substring of scenario names
+    std::string contextApi = "native";
+    int frames = 120;
+    int warmup = 20;
+    bool list = false;
+    bool help = false;
+};
+
+// Frames in flight at most, as a double-buffered swap chain would allow;
+// also the depth of the timer query ring.
+static constexpr int kFramesInFlight = 3;
+
+static bool runScenario(OfflineRenderer &renderer, const Preset &preset, CameraPath path,
+                        const BenchOptions &options, ScenarioResult &result) {
+    RenderSettings base;
+    std::string error;
+    for (const std::string &assignment : preset.assignments) {
+        if (!applySettingAssignment(base, assignment, &error)) {
+            std::cerr << error << std::endl;
+            return false;
+        }
+    }
+    base.autoRotate = false;
+
+    GLuint queries[kFramesInFlight];
+    glGenQueries(kFramesInFlight, queries);
+
+    using Clock = std::chrono::steady_clock;
+    const int total = options.warmup + options.frames;
+    Clock::time_point previousStart;
+    bool ok = true;
+
+    auto collect = [&](int frame) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[frame % kFramesInFlight], GL_QUERY_RESULT, &ns);
+        if (frame >= options.warmup) result.gpuMs.push_back(ns * 1e-6);
+    };
+
+    for (int frame = 0; frame < total && ok; frame++) {
+        // Reusing the query slot waits for the frame that last used it,
+        // which is also what keeps kFramesInFlight frames queued at most.
+        if (frame >= kFramesInFlight) collect(frame - kFramesInFlight);
+
+        Clock::time_point start = Clock::now();
+        if (frame > options.warmup) {
+            std::chrono::duration<double, std::milli> ms = start - previousStart;
+            result.frameMs.push_back(ms.count());
+        }
+        previousStart = start;
+
+        RenderSettings s = base;
+        applyPath(path, total > 1 ? static_cast<double>(frame) / (total - 1) : 0.0, s);
+
+        glBeginQuery(GL_TIME_ELAPSED, queries[frame % kFramesInFlight]);
+        ok = renderer.render(s, result.width, result.height, 1, static_cast<float>(frame));
+        glEndQuery(GL_TIME_ELAPSED);
+        glFlush();
+
+        std::chrono::duration<double, std::milli> cpu = Clock::now() - start;
+        if (frame >= options.warmup) result.cpuMs.push_back(cpu.count());
+    }
+    if (ok) {
+        for (int frame = std::max(total - kFramesInFlight, 0); frame < total; frame++) collect(frame);
+        // The last frame's length, to its completion.
+        std::chrono::duration<double, std::milli> ms = Clock::now() - previousStart;
+        result.frameMs.push_back(ms.count());
+    }
+
+    glDeleteQueries(kFramesInFlight, queries);
+    if (!ok) std::cerr << "Failed to allocate render targets" << std::endl;
+    return ok;
+}
+
+// ------------------------------- JSON ------------------------------ //
+
+static std::string jsonString(const std::string &s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char esc[8];
+            std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string jsonSummary(const std::vector<double> &samples) {
+    Summary s = summarize(samples);
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+                  "{\"mean\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"p99\": %.4f, "
+                  "\"min\": %.4f, \"max\": %.4f}",
+                  s.mean, s.median, s.p95, s.p99, s.min, s.max);
+    return buf;
+}
+
+static bool writeReport(const std::string &path, const BenchOptions &options,
+                        const std::vector<ScenarioResult> &results) {
+    std::ofstream out(path);
+    if (!out) return false;
+
+    auto glString = [](GLenum name) {
+        const GLubyte *s = glGetString(name);
+        return std::string(s ? reinterpret_cast<const char *>(s) : "");
+    };
+
+    out << "{\n"
+        << "  \"version\": 1,\n"
+        << "  \"glVendor\": " << jsonString(glString(GL_VENDOR)) << ",\n"
+        << "  \"glRenderer\": " << jsonString(glString(GL_RENDERER)) << ",\n"
+        << "  \"glVersion\": " << jsonString(glString(GL_VERSION)) << ",\n"
+        << "  \"warmupFrames\": " << options.warmup << ",\n"
+        << "  \"frames\": " << options.frames << ",\n"
+        << "  \"scenarios\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const ScenarioResult &r = results[i];
+        out << (i ? ",\n" : "\n")
+            << "    {\n"
+            << "      \"name\": " << jsonString(r.name) << ",\n"
+            << "      \"preset\": " << jsonString(r.preset) << ",\n"
+            << "      \"path\": " << jsonString(r.path) << ",\n"
+            << "      \"width\": " << r.width << ",\n"
+            << "      \"height\": " << r.height << ",\n"
+            << "      \"gpuMs\": " << jsonSummary(r.gpuMs) << ",\n"
+            << "      \"cpuMs\": " << jsonSummary(r.cpuMs) << ",\n"
+            << "      \"frameMs\": " << jsonSummary(r.frameMs) << "\n"
+            << "    }";
+    }
+    out << "\n  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+// ------------------------------- main ------------------------------ //
+
+static bool parseBenchOptions(int argc, char **argv, BenchOptions &options, std::string &error) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc) {
+                error = arg + " needs a value";
+                return nullptr;
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--help" || arg == "-h") {
+            options.help = true;
+        } else if (arg == "--list") {
+            options.list = true;
+        } else if (arg == "--output" || arg == "-o" || arg == "--filter" || arg == "--context") {
+            const char *v = value();
+            if (!v) return false;
+            if (arg == "--filter")       options.filter = v;
+            else if (arg == "--context") options.contextApi = v;
+            else                         options.output = v;
+        } else if (arg == "--frames" || arg == "--warmup") {
+            const char *v = value();
+            if (!v) return false;
+            char *end = nullptr;
+            long n = std::strtol(v, &end, 10);
+            if (!end || *end != '\0' || n < (arg == "--frames" ? 1 : 0) || n > 100000) {
+                error = "bad " + arg + " '" + v + "'";
+                return false;
+            }
+            (arg == "--frames" ? options.frames : options.warmup) = static_cast<int>(n);
+        } else {
+            error = "unknown option '" + arg + "'";
+            return false;
+        }
+    }
+    if (options.contextApi != "native" && options.contextApi != "egl" &&
+        options.contextApi != "osmesa") {
+        error = "bad --context '" + options.contextApi + "'";
+        return false;
+    }
+    return true;
+}
+
+static void printBenchUsage(const char *program) {
+    std::cout <<
+        "Usage: " << program << " [options]\n"
+        "\n"
+        "Renders every scenario (preset/path/resolution) offscreen and writes\n"
+        "frame-time statistics as JSON.\n"
+        "  --output FILE     report path (default bench.json)\n"
+        "  --frames N        measured frames per scenario (default 120)\n"
+        "  --warmup N        unmeasured frames first (default 20)\n"
+        "  --filter TEXT     only scenarios whose name contains TEXT\n"
+        "  --context API     native, egl or osmesa (default native)\n"
+        "  --list            print the scenario names and exit\n";
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options;
+    std::string error;
+    if (!parseBenchOptions(argc, argv, options, error)) {
+        std::cerr << error << "\n\n";
+        printBenchUsage(argv[0]);
+        return 2;
+    }
+    if (options.help) {
+        printBenchUsage(argv[0]);
+        return 0;
+    }
+
+    struct Scenario {
+        std::string name;
+        const Preset *preset;
+        int pathIndex;
+        int width, height;
+    };
+    std::vector<Scenario> scenarios;
+    for (const Preset &preset : kPresets) {
+        for (int p = 0; p < static_cast<int>(sizeof(kPaths) / sizeof(kPaths[0])); p++) {
+            for (const auto &res : kResolutions) {
+                std::string name = std::string(preset.name) + "/" + kPaths[p].name + "/" +
+                                   std::to_string(res.width) + "x" + std::to_string(res.height);
+                if (name.find(options.filter) == std::string::npos) continue;
+                scenarios.push_back({name, &preset, p, res.width, res.height});
+            }
+        }
+    }
+    if (options.list) {
+        for (const Scenario &s : scenarios) std::cout << s.name << "\n";
+        return 0;
+    }
+    if (scenarios.empty()) {
+        std::cerr << "No scenario matches '" << options.filter << "'\n";
+        return 2;
+    }
+
+    GLFWwindow *window = createHeadlessContext(options.contextApi);
+    if (!window) return 1;
+    std::cout << "OpenGL renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+    int exitCode = 0;
+    {
+        OfflineRenderer renderer(kShaderDir);
+        if (!renderer.init()) {
+            flushShaderLog();
+            renderer.shutdown();
+            destroyHeadlessContext(window);
+            return 1;
+        }
+        flushShaderLog();
+
+        std::vector<ScenarioResult> results;
+        for (const Scenario &sc : scenarios) {
+            ScenarioResult r;
+            r.name   = sc.name;
+            r.preset = sc.preset->name;
+            r.path   = kPaths[sc.pathIndex].name;
+            r.width  = sc.width;
+            r.height = sc.height;
+            if (!runScenario(renderer, *sc.preset, kPaths[sc.pathIndex].path, options, r)) {
+                exitCode = 1;
+                break;
+            }
+            flushShaderLog();
+
+            Summary gpu = summarize(r.gpuMs), frame = summarize(r.frameMs);
+            std::printf("%-32s gpu %8.3f ms median %8.3f p99   frame %8.3f ms median\n",
+                        r.name.c_str(), gpu.median, gpu.p99, frame.median);
+            std::fflush(stdout);
+            results.push_back(std::move(r));
+        }
+
+        if (exitCode == 0) {
+            if (writeReport(options.output, options, results)) {
+                std::cout << "Wrote " << options.output << std::endl;
+            } else {
+                std::cerr << "Failed to write " << options.output << std::endl;
+                exitCode = 1;
+            }
+        }
+        renderer.shutdown();
+    }
+
+    destroyHeadlessContext(window);
+    return exitCode;
+}
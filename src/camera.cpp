@@ -0,0 +1,29 @@
+#include "camera.h"
+
+#include <algorithm>
+
+#include "render_settings.h"
+
+CameraBasis computeCameraBasis(RenderSettings &settings) {
+    settings.camPitch = std::clamp(settings.camPitch, -1.5, 1.5);
+    settings.camDistance = std::max(settings.camDistance, 0.5);
+
+    double cp = std::cos(settings.camPitch);
+    double sp = std::sin(settings.camPitch);
+    double cy = std::cos(settings.camYaw);
+    double sy = std::sin(settings.camYaw);
+
+    CameraBasis cam;
+    cam.pos = {
+        settings.camDistance * cp * cy,
+        settings.camDistance * sp,
+        settings.camDistance * cp * sy
+    };
+    Vec3d target = {0.0, 0.0, 0.0};
+
+    cam.forward = normalize_vec3(sub(target, cam.pos));
+    Vec3d worldUp = {0.0, 1.0, 0.0};
+    cam.right   = normalize_vec3(cross(cam.forward, worldUp));
+    cam.up      = cross(cam.right, cam.forward);
+    return cam;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cmath>
+
+struct RenderSettings;
+
+// -------------------------- small helpers -------------------------- //
+
+struct Vec3 {
+    float x, y, z;
+};
+
+inline Vec3 make_vec3(float x, float y, float z) {
+    return {x, y, z};
+}
+
+inline Vec3 sub(const Vec3 &a, const Vec3 &b) {
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+inline Vec3 cross(const Vec3 &a, const Vec3 &b) {
+    return {
+        a.y * b.z - a.z * b.y,
+        a.z * b.x - a.x * b.z,
+        a.x * b.y - a.y * b.x
+    };
+}
+
+inline Vec3 normalize_vec3(const Vec3 &v) {
+    float len = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    if (len <= 0.0f) return {0.0f, 0.0f, 0.0f};
+    return {v.x / len, v.y / len, v.z / len};
+}
+
+// Double-precision twin, for camera placement: a zoomed-in view needs the
+// position to more digits than a float holds (see ViewState::camPosLo).
+struct Vec3d {
+    double x, y, z;
+};
+
+inline Vec3d sub(const Vec3d &a, const Vec3d &b) {
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+inline Vec3d cross(const Vec3d &a, const Vec3d &b) {
+    return {
+        a.y * b.z - a.z * b.y,
+        a.z * b.x - a.x * b.z,
+        a.x * b.y - a.y * b.x
+    };
+}
+
+inline Vec3d normalize_vec3(const Vec3d &v) {
+    double len = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    if (len <= 0.0) return {0.0, 0.0, 0.0};
+    return {v.x / len, v.y / len, v.z / len};
+}
+
+// --------------------------- camera basis -------------------------- //
+
+// Orbit camera looking at the origin, in double throughout.
+struct CameraBasis {
+    Vec3d pos;
+    Vec3d forward;
+    Vec3d right;
+    Vec3d up;
+};
+
+// Clamps pitch/distance in-place, then builds the basis.
+CameraBasis computeCameraBasis(RenderSettings &settings);
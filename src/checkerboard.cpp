@@ -0,0 +1,123 @@
+#include "checkerboard.h"
+
+#include <utility>
+
+Checkerboard::Checkerboard(ProgramCache &cache, std::string vsPath, std::string resolvePath,
+                           std::string ratePath)
+    : cache_(cache), resolveVariants_(cache, vsPath, std::move(resolvePath)),
+      vsPath_(std::move(vsPath)), ratePath_(std::move(ratePath)) {}
+
+void Checkerboard::destroy() {
+    endShadingRate();
+    destroyRenderTarget(half_);
+    if (rateFbo_) glDeleteFramebuffers(1, &rateFbo_);
+    if (rateTexture_) glDeleteTextures(1, &rateTexture_);
+    rateFbo_ = rateTexture_ = 0;
+    rateWidth_ = rateHeight_ = 0;
+}
+
+bool Checkerboard::prepare(int allocWidth, int allocHeight) {
+    resolve_ = resolveVariants_.get({});
+    return resolve_ &&
+           ensureRenderTarget(half_, marchWidth(allocWidth), allocHeight, {GL_RGBA16F, GL_RG32F});
+}
+
+void Checkerboard::resolve(const FrameParams &frame, GLuint vao) {
+    glActiveTexture(GL_TEXTURE0 + kUnitCheckerColor);
+    glBindTexture(GL_TEXTURE_2D, half_.color[0]);
+    glActiveTexture(GL_TEXTURE0 + kUnitCheckerHit);
+    glBindTexture(GL_TEXTURE_2D, half_.color[1]);
+
+    glUseProgram(resolve_->program);
+    uploadFractalUniforms(*resolve_, frame);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    for (int unit : {kUnitCheckerHit, kUnitCheckerColor}) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// ---------------------------- shading rate ------------------------- //
+
+bool Checkerboard::shadingRateSupported() {
+#ifdef GL_NV_shading_rate_image
+    return GLEW_NV_shading_rate_image && (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage);
+#else
+    return false;
+#endif
+}
+
+bool Checkerboard::beginShadingRate(int targetWidth, int targetHeight, int targetScaleX,
+                                    int viewWidth, int viewHeight, int prevWidth,
+                                    int prevHeight, GLuint vao) {
+#ifdef GL_NV_shading_rate_image
+    if (!shadingRateSupported()) return false;
+    GLuint program = cache_.get(vsPath_, ratePath_);
+    if (!program) return false;
+
+    GLint texelWidth = 16, texelHeight = 16;
+    glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_WIDTH_NV, &texelWidth);
+    glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_HEIGHT_NV, &texelHeight);
+    int width  = (targetWidth + texelWidth - 1) / texelWidth;
+    int height = (targetHeight + texelHeight - 1) / texelHeight;
+
+    // The rate image must be immutable, so a new size means a new texture.
+    if (width != rateWidth_ || height != rateHeight_) {
+        if (rateTexture_) glDeleteTextures(1, &rateTexture_);
+        glGenTextures(1, &rateTexture_);
+        glBindTexture(GL_TEXTURE_2D, rateTexture_);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        if (!rateFbo_) glGenFramebuffers(1, &rateFbo_);
+        glBindFramebuffer(GL_FRAMEBUFFER, rateFbo_);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, rateTexture_, 0);
+        rateWidth_  = width;
+        rateHeight_ = height;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, rateFbo_);
+    glViewport(0, 0, width, height);
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "u_prevHitInfo"), kUnitPrevHit);
+    glUniform2f(glGetUniformLocation(program, "u_prevResolution"),
+                static_cast<float>(prevWidth), static_cast<float>(prevHeight));
+    glUniform2f(glGetUniformLocation(program, "u_resolution"),
+                static_cast<float>(viewWidth), static_cast<float>(viewHeight));
+    glUniform2i(glGetUniformLocation(program, "u_rateTexel"), texelWidth, texelHeight);
+    glUniform1i(glGetUniformLocation(program, "u_targetScaleX"), targetScaleX);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    const GLenum palette[2] = {GL_SHADING_RATE_1_INVOCATION_PER_PIXEL_NV,
+                               GL_SHADING_RATE_1_INVOCATION_PER_4X4_PIXELS_NV};
+    glShadingRateImagePaletteNV(0, 0, 2, palette);
+    glBindShadingRateImageNV(rateTexture_);
+    glEnable(GL_SHADING_RATE_IMAGE_NV);
+    rateEnabled_ = true;
+    return true;
+#else
+    (void)targetWidth; (void)targetHeight; (void)targetScaleX; (void)viewWidth;
+    (void)viewHeight; (void)prevWidth; (void)prevHeight; (void)vao;
+    return false;
+#endif
+}
+
+void Checkerboard::endShadingRate() {
+#ifdef GL_NV_shading_rate_image
+    if (!rateEnabled_) return;
+    glDisable(GL_SHADING_RATE_IMAGE_NV);
+    glBindShadingRateImageNV(0);
+    rateEnabled_ = false;
+#endif
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+
+#include <GL/glew.h>
+
+#include "fractal_program.h"
+#include "render_target.h"
+#include "shader.h"
+#include "view_state.h"
+
+// --------------------------- checkerboard -------------------------- //
+
+// Halves the primary pass of moving frames. mandelbulb.frag (CHECKERBOARD)
+// marches every other pixel, alternating by row and frame, into a target
+// half as wide; checkerboard_resolve.frag rebuilds the full frame from it
+// plus the previous frame, reprojected by depth where it saw the same
+// surface and interpolated elsewhere.
+//
+// Where GL_NV_shading_rate_image is available the fractal pass can also
+// shade tiles that the previous frame saw only background in at one
+// invocation per 4x4 pixels.
+class Checkerboard {
+public:
+    Checkerboard(ProgramCache &cache, std::string vsPath, std::string resolvePath,
+                 std::string ratePath);
+    void destroy();
+
+    // Target pixels the march covers for a view width.
+    static int marchWidth(int width) { return (width + 1) / 2; }
+
+    // Allocates the half-width RGBA16F + RG32F march target for views up
+    // to allocWidth x allocHeight and builds the resolve program. False
+    // if either failed: render that frame in full.
+    bool prepare(int allocWidth, int allocHeight);
+    const RenderTarget &target() const { return half_; }
+
+    // Draws the full frame into the bound framebuffer, viewport set by the
+    // caller. Expects the FractalParams buffer to hold the view, the last
+    // frame's colour and HitInfo at kUnitHistory / kUnitPrevHit and
+    // frame.previous set when they are usable. After prepare().
+    void resolve(const FrameParams &frame, GLuint vao);
+
+    // GL_NV_shading_rate_image (on a context that has immutable textures).
+    static bool shadingRateSupported();
+    // Builds the rate image for a targetWidth x targetHeight draw of a
+    // view of viewWidth x viewHeight pixels (targetScaleX view pixels per
+    // target pixel in x) from the last frame's HitInfo at kUnitPrevHit,
+    // of prevWidth x prevHeight pixels, and enables it for the draws up
+    // to endShadingRate(). Leaves the framebuffer binding to the caller.
+    bool beginShadingRate(int targetWidth, int targetHeight, int targetScaleX,
+                          int viewWidth, int viewHeight, int prevWidth, int prevHeight,
+                          GLuint vao);
+    void endShadingRate();
+
+private:
+    ProgramCache    &cache_;
+    FractalVariants  resolveVariants_;
+    std::string      vsPath_, ratePath_;
+
+    RenderTarget half_;
+    const FractalProgram *resolve_ = nullptr;   // from prepare()
+
+    GLuint rateTexture_ = 0;
+    GLuint rateFbo_     = 0;
+    int    rateWidth_ = 0, rateHeight_ = 0;
+    bool   rateEnabled_ = false;
+};
@@ -0,0 +1,147 @@
+#include "compute_raymarcher.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+// Bytes per queued ray: mandelbulb.comp's Ray { uint; float; float; int; float; float; }.
+static constexpr size_t kRayBytes = 24;
+
+static const char *kStageDefine[] = {"RAY_MARCH", "RAY_RESET", "RAY_SHADE"};
+
+bool ComputeRaymarcher::supported() {
+    return GLEW_VERSION_4_3 != 0;
+}
+
+ComputeRaymarcher::ComputeRaymarcher(ProgramCache &cache, std::string csPath)
+    : cache_(cache), csPath_(std::move(csPath)) {}
+
+bool ComputeRaymarcher::init() {
+    for (int s = 0; s < kStageCount; s++) {
+        if (!stage(static_cast<Stage>(s), {})) return false;
+    }
+    glGenBuffers(1, &counters_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counters_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(RayCountersStd430), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return counters_ != 0;
+}
+
+void ComputeRaymarcher::destroy() {
+    GLuint buffers[] = {counters_, rays_[0], rays_[1], hits_};
+    glDeleteBuffers(4, buffers);
+    counters_ = rays_[0] = rays_[1] = hits_ = 0;
+    capacity_ = 0;
+    loaded_.clear();
+}
+
+const ComputeRaymarcher::StageProgram *ComputeRaymarcher::stage(Stage s,
+                                                                const ShaderDefines &defines) {
+    // Same invalidation rule as FractalVariants.
+    if (cache_.generation() != generation_) {
+        loaded_.clear();
+        generation_ = cache_.generation();
+    }
+
+    ShaderDefines stageDefines = defines;
+    stageDefines[kStageDefine[s]] = "";
+    GLuint program = cache_.getCompute(csPath_, stageDefines);
+    if (!program) return nullptr;
+
+    auto it = loaded_.find(program);
+    if (it == loaded_.end()) {
+        StageProgram sp;
+        sp.fractal     = loadFractalProgram(program);
+        sp.uSize       = glGetUniformLocation(program, "u_size");
+        sp.uRound      = glGetUniformLocation(program, "u_round");
+        sp.uRoundSteps = glGetUniformLocation(program, "u_roundSteps");
+        sp.uMaxGroups  = glGetUniformLocation(program, "u_maxGroups");
+        it = loaded_.emplace(program, sp).first;
+    }
+    return &it->second;
+}
+
+void ComputeRaymarcher::ensureCapacity(size_t rays) {
+    if (rays <= capacity_) return;
+
+    // Grow-only: the queues follow the largest target seen.
+    if (!rays_[0]) glGenBuffers(2, rays_);
+    if (!hits_) glGenBuffers(1, &hits_);
+    for (GLuint buffer : {rays_[0], rays_[1], hits_}) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, rays * kRayBytes, nullptr, GL_DYNAMIC_COPY);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    capacity_ = rays;
+}
+
+bool ComputeRaymarcher::render(const FrameParams &frame, const ShaderDefines &defines,
+                               const RenderTarget &output, int width, int height) {
+    const StageProgram *march = stage(kMarch, defines);
+    const StageProgram *reset = stage(kReset, defines);
+    const StageProgram *shade = stage(kShade, defines);
+    if (!march || !reset || !shade) {
+        // A broken specialization falls back to the generic stages.
+        march = stage(kMarch, {});
+        reset = stage(kReset, {});
+        shade = stage(kShade, {});
+        if (!march || !reset || !shade) return false;
+    }
+
+    const size_t pixels = static_cast<size_t>(width) * height;
+    if (pixels == 0) return false;
+    ensureCapacity(static_cast<size_t>(output.width) * output.height);
+
+    RayCountersStd430 counters{};
+    counters.marchGroups[0] = static_cast<GLuint>(
+        std::min<size_t>((pixels + 63) / 64, persistentGroups_));
+    counters.marchGroups[1] = counters.marchGroups[2] = 1;
+    counters.inCount = static_cast<GLuint>(pixels);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counters_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), &counters);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, counters_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, hits_);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, counters_);
+    glBindImageTexture(0, output.color[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glBindImageTexture(1, output.color[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+
+    // Enough rounds for a ray to use its whole step budget; once every
+    // ray has finished the remaining dispatches have zero groups.
+    const int rounds = std::max(1, (frame.stepLimit + roundSteps_ - 1) / roundSteps_);
+    for (int round = 0; round < rounds; round++) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, rays_[round % 2]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, rays_[1 - round % 2]);
+
+        glUseProgram(march->fractal.program);
+        uploadFractalUniforms(march->fractal, frame);
+        glUniform2i(march->uSize, width, height);
+        glUniform1i(march->uRound, round);
+        glUniform1i(march->uRoundSteps, roundSteps_);
+        glDispatchComputeIndirect(offsetof(RayCountersStd430, marchGroups));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        glUseProgram(reset->fractal.program);
+        glUniform1i(reset->uMaxGroups, persistentGroups_);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+
+    glUseProgram(shade->fractal.program);
+    uploadFractalUniforms(shade->fractal, frame);
+    glDispatchComputeIndirect(offsetof(RayCountersStd430, shadeGroups));
+
+    // The target is sampled next (upscale, or history for the next sample).
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT |
+                    GL_FRAMEBUFFER_BARRIER_BIT);
+
+    glUseProgram(0);
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+    for (GLuint binding = 0; binding < 4; binding++) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+#include <GL/glew.h>
+
+#include "fractal_program.h"
+#include "render_target.h"
+#include "shader.h"
+
+// ------------------------ compute raymarcher ----------------------- //
+
+// std430 image of mandelbulb.comp's RayCounters block. The two dispatch
+// triples lead so the buffer is also the GL_DISPATCH_INDIRECT_BUFFER.
+struct RayCountersStd430 {
+    GLuint marchGroups[3];
+    GLuint shadeGroups[3];
+    GLuint inCount;
+    GLuint inHead;
+    GLuint outCount;
+    GLuint shadeCount;
+};
+static_assert(sizeof(RayCountersStd430) == 10 * 4, "must match the std430 block");
+
+// Alternative to the fragment pass on GL 4.3: mandelbulb.comp marches rays
+// in rounds of roundSteps() steps with persistent workgroups, compacting
+// the rays still running into a dense queue between rounds so late rounds
+// only occupy as many lanes as there are live rays. Hits are shaded in a
+// separate dispatch over a hit queue. Output goes into the same RGBA16F +
+// RG32F target the fragment pass draws into, and the same FractalParams
+// buffer and texture units are used, so the rest of the frame is shared.
+// Temporal reprojection is fragment-only.
+class ComputeRaymarcher {
+public:
+    // Compute shaders, SSBOs and indirect dispatch (GL 4.3).
+    static bool supported();
+
+    ComputeRaymarcher(ProgramCache &cache, std::string csPath);
+
+    // Builds the generic stage programs; false if they don't compile.
+    bool init();
+    void destroy();
+
+    // Marches width x height pixels from output's origin into its two
+    // attachments. `defines` selects the variant as for the fragment pass
+    // (fractalDefines or empty). History, start distances and
+    // FractalParams are bound by the caller as for the fragment pass.
+    bool render(const FrameParams &frame, const ShaderDefines &defines,
+                const RenderTarget &output, int width, int height);
+
+    int  roundSteps() const { return roundSteps_; }
+    void setRoundSteps(int steps) { roundSteps_ = steps < 1 ? 1 : steps; }
+    // Workgroups kept resident by each march round.
+    int  persistentGroups() const { return persistentGroups_; }
+
+private:
+    enum Stage { kMarch, kReset, kShade, kStageCount };
+
+    struct StageProgram {
+        FractalProgram fractal;
+        GLint uSize = -1, uRound = -1, uRoundSteps = -1, uMaxGroups = -1;
+    };
+
+    const StageProgram *stage(Stage s, const ShaderDefines &defines);
+    void ensureCapacity(size_t rays);
+
+    ProgramCache &cache_;
+    std::string   csPath_;
+    unsigned      generation_ = 0;
+    std::unordered_map<GLuint, StageProgram> loaded_;
+
+    GLuint counters_ = 0;
+    GLuint rays_[2]  = {0, 0};   // ping-pong input/output queues
+    GLuint hits_     = 0;
+    size_t capacity_ = 0;        // rays per queue
+
+    int roundSteps_       = 32;
+    int persistentGroups_ = 512;
+};
@@ -0,0 +1,80 @@
+#include "cost_counters.h"
+
+#include <cstring>
+
+#include "fractal_program.h"
+
+bool CostCounters::supported() {
+    // loadFractalProgram binds the block through the program interface
+    // query, which the SSBO extension alone doesn't bring.
+    return GLEW_VERSION_4_3 ||
+           (GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_program_interface_query);
+}
+
+void CostCounters::destroy() {
+    for (Slot &slot : slots_) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        if (slot.buffer) glDeleteBuffers(1, &slot.buffer);
+        slot = Slot();
+    }
+    head_ = inFlight_ = 0;
+    bound_ = false;
+    valid_ = false;
+}
+
+bool CostCounters::begin() {
+    if (inFlight_ == kRing) return false;
+
+    static const CostCountersStd430 zero{};
+    Slot &slot = slots_[(head_ + inFlight_) % kRing];
+    if (!slot.buffer) {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zero), &zero, GL_DYNAMIC_READ);
+    } else {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCostCountersBinding, slot.buffer);
+    bound_ = true;
+    return true;
+}
+
+void CostCounters::end() {
+    if (!bound_) return;
+    bound_ = false;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCostCountersBinding, 0);
+
+    // The atomics must land before the buffer is mapped.
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    Slot &slot = slots_[(head_ + inFlight_) % kRing];
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    inFlight_++;
+}
+
+bool CostCounters::poll() {
+    bool updated = false;
+    while (inFlight_ > 0) {
+        Slot &slot = slots_[head_];
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) break;
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        head_ = (head_ + 1) % kRing;
+        inFlight_--;
+        if (status == GL_WAIT_FAILED) continue;
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+        const void *data = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, sizeof(totals_),
+                                            GL_MAP_READ_BIT);
+        if (data) {
+            std::memcpy(&totals_, data, sizeof(totals_));
+            valid_  = true;
+            updated = true;
+            glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+    return updated;
+}
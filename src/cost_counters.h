@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+
+#include <GL/glew.h>
+
+// --------------------------- cost counters ------------------------- //
+
+// std430 image of mandelbulb.frag's CostCounters block (COST_COUNTERS).
+struct CostCountersStd430 {
+    static constexpr int kBins = 16;
+
+    GLuint pixels;
+    GLuint steps;               // primary march steps of this pass
+    GLuint outcomes[3];         // miss, hit, out of steps
+    GLuint evaluations[4];      // DE evaluations: primary, normal, shadow, AO
+    GLuint stepBins[kBins];     // pixels by steps, equal bins up to the limit
+    GLuint evaluationBins[kBins];   // bin k: [2^(k-1), 2^k) evaluations
+};
+static_assert(sizeof(CostCountersStd430) == (9 + 2 * CostCountersStd430::kBins) * 4,
+              "must match the std430 block");
+
+// Per-frame cost totals of the forward fragment pass. Each frame gets a
+// zeroed buffer from a ring bound at kCostCountersBinding, which the
+// shader adds to with atomics; a fence marks it readable, and poll() maps
+// it a few frames later, so reading never stalls the frame.
+class CostCounters {
+public:
+    static constexpr int kRing = 3;
+
+    // Fragment-shader storage buffers and the program interface query
+    // (GL 4.3 or both ARB extensions).
+    static bool supported();
+
+    void destroy();
+
+    // Binds a zeroed buffer for the next draws. False while every buffer
+    // is still in flight: that frame must render without COST_COUNTERS.
+    bool begin();
+    // Unbinds it and queues the readback; after the frame's draws.
+    void end();
+
+    // Picks up finished frames; true if new totals arrived.
+    bool poll();
+
+    bool valid() const { return valid_; }
+    const CostCountersStd430 &totals() const { return totals_; }
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence  = nullptr;
+    };
+
+    std::array<Slot, kRing> slots_{};
+    int head_     = 0;   // oldest slot in flight
+    int inFlight_ = 0;
+    bool bound_   = false;
+
+    bool valid_ = false;
+    CostCountersStd430 totals_{};
+};
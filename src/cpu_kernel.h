@@ -0,0 +1,47 @@
+#pragma once
+
+#include "view_state.h"
+
+// ---------------------------- CPU kernels -------------------------- //
+
+// The CPU renderer's marcher and shading, built once per instruction set
+// (cpu_kernel_*.cpp each compile cpu_kernel.inl with their own target
+// flags). CpuRenderer picks the widest one the running CPU supports.
+
+// A rectangle of pixels, origin bottom-left as in GL.
+struct CpuRect {
+    int x = 0, y = 0;
+    int width = 0, height = 0;
+};
+
+// What changes between the accumulated samples of one view; FrameParams'
+// counterparts.
+struct CpuSample {
+    float jitter[2]   = {0.0f, 0.0f};   // sub-pixel ray offset in pixels
+    int   sampleIndex = 0;              // 0 = first, history ignored
+    int   stepLimit   = 0;
+    int   shadowSteps = 0;
+};
+
+struct CpuKernel {
+    const char *name;   // "avx512", "avx2" or "scalar"
+    int lanes;          // rays per packet
+
+    // mandelbulb.frag's DEPTH_PREPASS pass over `coarse` (in prepass
+    // texels of view.prepassScale pixels): writes start distance and
+    // steps, two floats per texel, into `start` with a row stride of
+    // `stride` texels.
+    void (*prepass)(const ViewState &view, const CpuSample &sample, const CpuRect &coarse,
+                    float *start, int stride);
+
+    // The forward pass over `rect`: marches from the prepass results
+    // (`start`, as above; null without a prepass), shades, and folds the
+    // sample into the RGBA float image `linear` (row stride in pixels).
+    void (*shade)(const ViewState &view, const CpuSample &sample, const CpuRect &rect,
+                  const float *start, int startStride, float *linear, int stride);
+};
+
+// Null when the compiler couldn't target that instruction set.
+const CpuKernel *cpuKernelAvx512();
+const CpuKernel *cpuKernelAvx2();
+const CpuKernel *cpuKernelScalar();
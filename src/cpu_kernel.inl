@@ -0,0 +1,694 @@
+// CpuKernel implementation, included by cpu_kernel_avx512.cpp,
+// cpu_kernel_avx2.cpp and cpu_kernel_scalar.cpp after they define
+// CPU_KERNEL_LANES (16, 8 or 1) and CPU_KERNEL_NAME. This is
+// mandelbulb_common.glsl and the forward and prepass paths of
+// mandelbulb.frag, ported line for line onto packets of kLanes rays with
+// per-lane masks, so its images diff cleanly against the GPU's.
+//
+// Each including file is compiled with different target flags, so
+// everything here has internal linkage and only C library maths is
+// called: no inline function of a shared header may be emitted with
+// instructions the running CPU lacks.
+//
+// Left out: deep zoom (the CPU marches in float), the distance cache and
+// reprojection, which the offline GPU path doesn't use either.
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if CPU_KERNEL_LANES > 1
+#include <immintrin.h>
+#endif
+
+#include "cpu_kernel.h"
+
+namespace {
+
+constexpr int kLanes = CPU_KERNEL_LANES;
+
+// ------------------------------ lanes ------------------------------ //
+
+// F: a float per lane. M: a bool per lane.
+
+#if CPU_KERNEL_LANES == 16
+
+struct F { __m512 v; };
+struct M { __mmask16 v; };
+
+inline F splat(float x)                { return {_mm512_set1_ps(x)}; }
+inline F load(const float *p)          { return {_mm512_loadu_ps(p)}; }
+inline void store(float *p, F a)       { _mm512_storeu_ps(p, a.v); }
+
+inline F operator+(F a, F b) { return {_mm512_add_ps(a.v, b.v)}; }
+inline F operator-(F a, F b) { return {_mm512_sub_ps(a.v, b.v)}; }
+inline F operator*(F a, F b) { return {_mm512_mul_ps(a.v, b.v)}; }
+inline F operator/(F a, F b) { return {_mm512_div_ps(a.v, b.v)}; }
+inline F vmin(F a, F b)      { return {_mm512_min_ps(a.v, b.v)}; }
+inline F vmax(F a, F b)      { return {_mm512_max_ps(a.v, b.v)}; }
+inline F vsqrt(F a)          { return {_mm512_sqrt_ps(a.v)}; }
+inline F vtrunc(F a)         { return {_mm512_roundscale_ps(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)}; }
+
+inline M operator<(F a, F b)  { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)}; }
+inline M operator>(F a, F b)  { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ)}; }
+inline M operator<=(F a, F b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ)}; }
+
+inline M operator&(M a, M b) { return {static_cast<__mmask16>(a.v & b.v)}; }
+inline M operator|(M a, M b) { return {static_cast<__mmask16>(a.v | b.v)}; }
+inline M andNot(M a, M b)    { return {static_cast<__mmask16>(a.v & ~b.v)}; }
+inline bool any(M m)         { return m.v != 0; }
+
+inline F select(M m, F a, F b) { return {_mm512_mask_blend_ps(m.v, b.v, a.v)}; }
+
+// x = mantissa * 2^exponent with the mantissa in [1, 2), for x > 0.
+inline F exponentOf(F x) { return {_mm512_getexp_ps(x.v)}; }
+inline F mantissaOf(F x) { return {_mm512_getmant_ps(x.v, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero)}; }
+
+#elif CPU_KERNEL_LANES == 8
+
+struct F { __m256 v; };
+struct M { __m256 v; };
+
+inline F splat(float x)                { return {_mm256_set1_ps(x)}; }
+inline F load(const float *p)          { return {_mm256_loadu_ps(p)}; }
+inline void store(float *p, F a)       { _mm256_storeu_ps(p, a.v); }
+
+inline F operator+(F a, F b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline F operator-(F a, F b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline F operator*(F a, F b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline F operator/(F a, F b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline F vmin(F a, F b)      { return {_mm256_min_ps(a.v, b.v)}; }
+inline F vmax(F a, F b)      { return {_mm256_max_ps(a.v, b.v)}; }
+inline F vsqrt(F a)          { return {_mm256_sqrt_ps(a.v)}; }
+inline F vtrunc(F a)         { return {_mm256_round_ps(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)}; }
+
+inline M operator<(F a, F b)  { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline M operator>(F a, F b)  { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+inline M operator<=(F a, F b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+
+inline M operator&(M a, M b) { return {_mm256_and_ps(a.v, b.v)}; }
+inline M operator|(M a, M b) { return {_mm256_or_ps(a.v, b.v)}; }
+inline M andNot(M a, M b)    { return {_mm256_andnot_ps(b.v, a.v)}; }
+inline bool any(M m)         { return _mm256_movemask_ps(m.v) != 0; }
+
+inline F select(M m, F a, F b) { return {_mm256_blendv_ps(b.v, a.v, m.v)}; }
+
+inline F exponentOf(F x) {
+    __m256i bits = _mm256_castps_si256(x.v);
+    __m256i e = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+    return {_mm256_cvtepi32_ps(e)};
+}
+inline F mantissaOf(F x) {
+    __m256i bits = _mm256_castps_si256(x.v);
+    bits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+                           _mm256_set1_epi32(0x3f800000));
+    return {_mm256_castsi256_ps(bits)};
+}
+
+#else
+
+struct F { float v; };
+struct M { bool v; };
+
+inline F splat(float x)                { return {x}; }
+inline F load(const float *p)          { return {*p}; }
+inline void store(float *p, F a)       { *p = a.v; }
+
+inline F operator+(F a, F b) { return {a.v + b.v}; }
+inline F operator-(F a, F b) { return {a.v - b.v}; }
+inline F operator*(F a, F b) { return {a.v * b.v}; }
+inline F operator/(F a, F b) { return {a.v / b.v}; }
+inline F vmin(F a, F b)      { return {b.v < a.v ? b.v : a.v}; }
+inline F vmax(F a, F b)      { return {b.v > a.v ? b.v : a.v}; }
+inline F vsqrt(F a)          { return {sqrtf(a.v)}; }
+inline F vtrunc(F a)         { return {truncf(a.v)}; }
+
+inline M operator<(F a, F b)  { return {a.v < b.v}; }
+inline M operator>(F a, F b)  { return {a.v > b.v}; }
+inline M operator<=(F a, F b) { return {a.v <= b.v}; }
+
+inline M operator&(M a, M b) { return {a.v && b.v}; }
+inline M operator|(M a, M b) { return {a.v || b.v}; }
+inline M andNot(M a, M b)    { return {a.v && !b.v}; }
+inline bool any(M m)         { return m.v; }
+
+inline F select(M m, F a, F b) { return m.v ? a : b; }
+
+inline F exponentOf(F x) {
+    uint32_t bits;
+    memcpy(&bits, &x.v, sizeof(bits));
+    return {static_cast<float>(static_cast<int>(bits >> 23) - 127)};
+}
+inline F mantissaOf(F x) {
+    uint32_t bits;
+    memcpy(&bits, &x.v, sizeof(bits));
+    bits = (bits & 0x007fffffu) | 0x3f800000u;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    return {m};
+}
+
+#endif
+
+inline F operator-(F a) { return splat(0.0f) - a; }
+inline F clamp(F x, float lo, float hi) { return vmin(vmax(x, splat(lo)), splat(hi)); }
+inline F mix(F a, F b, F t) { return a * (splat(1.0f) - t) + b * t; }
+
+inline F laneIndex() {
+    static const float index[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    return load(index);
+}
+
+// Natural logarithm of x > 0 (Cephes' logf polynomial, about 1 ulp).
+F vlog(F x) {
+    F e = exponentOf(x);
+    F m = mantissaOf(x);
+    M high = m > splat(1.41421356f);
+    m = select(high, m * splat(0.5f), m);
+    e = select(high, e + splat(1.0f), e);
+
+    F f = m - splat(1.0f);
+    F z = f * f;
+    F y = splat(7.0376836292e-2f);
+    y = y * f - splat(1.1514610310e-1f);
+    y = y * f + splat(1.1676998740e-1f);
+    y = y * f - splat(1.2420140846e-1f);
+    y = y * f + splat(1.4249322787e-1f);
+    y = y * f - splat(1.6668057665e-1f);
+    y = y * f + splat(2.0000714765e-1f);
+    y = y * f - splat(2.4999993993e-1f);
+    y = y * f + splat(3.3333331174e-1f);
+    y = y * f * z;
+    y = y + e * splat(-2.12194440e-4f);
+    y = y - splat(0.5f) * z;
+    return f + y + e * splat(0.693359375f);
+}
+
+// fn applied lane by lane, for the rare paths left in scalar C maths.
+template <typename Fn>
+void perLane(Fn fn) {
+    for (int i = 0; i < kLanes; i++) fn(i);
+}
+
+struct V3 {
+    F x, y, z;
+};
+
+inline V3 splat3(const float v[3]) { return {splat(v[0]), splat(v[1]), splat(v[2])}; }
+inline V3 operator+(const V3 &a, const V3 &b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+inline V3 operator-(const V3 &a, const V3 &b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+inline V3 operator*(const V3 &a, F s)         { return {a.x * s, a.y * s, a.z * s}; }
+inline F  dot(const V3 &a, const V3 &b)       { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline F  length(const V3 &a)                 { return vsqrt(dot(a, a)); }
+inline V3 normalize(const V3 &a)              { return a * (splat(1.0f) / length(a)); }
+inline V3 select(M m, const V3 &a, const V3 &b) {
+    return {select(m, a.x, b.x), select(m, a.y, b.y), select(m, a.z, b.z)};
+}
+
+// ------------------------------ scene ------------------------------ //
+
+// The parameter block (FractalParams) and the per-sample uniforms.
+struct Scene {
+    const ViewState &view;
+    const CpuSample &sample;
+    int   integerPower;   // > 0 when the power is one: the trig-free path
+    float logPower;       // log2(max(power, 2)), for lodIterations
+};
+
+Scene makeScene(const ViewState &view, const CpuSample &sample) {
+    Scene s{view, sample, 0, log2f(view.power > 2.0f ? view.power : 2.0f)};
+    if (floorf(view.power) == view.power && view.power >= 1.0f && view.power <= 64.0f) {
+        s.integerPower = static_cast<int>(view.power);
+    }
+    return s;
+}
+
+// (re + i im)^n, n >= 1, by repeated squaring.
+void complexPow(F &re, F &im, int n) {
+    int bit = 1;
+    while (bit * 2 <= n) bit *= 2;
+    F rr = re, ri = im;
+    for (bit /= 2; bit > 0; bit /= 2) {
+        F sr = rr * rr - ri * ri;
+        ri = splat(2.0f) * rr * ri;
+        rr = sr;
+        if (n & bit) {
+            F mr = rr * re - ri * im;
+            ri = rr * im + ri * re;
+            rr = mr;
+        }
+    }
+    re = rr;
+    im = ri;
+}
+
+// bulbPower: z -> z^power in spherical coordinates, and the running
+// derivative. Integer powers take the shader's POWER 8 route generalised:
+// with rho = |z.xy|, (z.z + i rho)^n = r^n (cos n theta + i sin n theta)
+// and ((z.x + i z.y) / rho)^n = cos n phi + i sin n phi.
+V3 bulbPower(const Scene &s, const V3 &z, F r, F &dr) {
+    const int n = s.integerPower;
+    if (n > 0) {
+        F rn1 = splat(1.0f);
+        for (int k = 1; k < n; k++) rn1 = rn1 * r;
+        dr = rn1 * splat(static_cast<float>(n)) * dr + splat(1.0f);
+
+        F rho = vsqrt(z.x * z.x + z.y * z.y);
+        F ar = z.z, ai = rho;
+        complexPow(ar, ai, n);
+
+        // On the axis phi is 0, as atan(0, 0) gives the shader.
+        M axis = rho <= splat(0.0f);
+        F inv = splat(1.0f) / select(axis, splat(1.0f), rho);
+        F br = select(axis, splat(1.0f), z.x * inv);
+        F bi = select(axis, splat(0.0f), z.y * inv);
+        complexPow(br, bi, n);
+        return {ai * br, ai * bi, ar};
+    }
+
+    const float power = s.view.power;
+    float zx[kLanes], zy[kLanes], zz[kLanes], rs[kLanes], drs[kLanes];
+    store(zx, z.x); store(zy, z.y); store(zz, z.z); store(rs, r); store(drs, dr);
+    perLane([&](int i) {
+        float ri = rs[i];
+        float c = zz[i] / (ri > 1e-6f ? ri : 1e-6f);
+        float theta = acosf(c < -1.0f ? -1.0f : (c > 1.0f ? 1.0f : c)) * power;
+        float phi   = atan2f(zy[i], zx[i]) * power;
+        float zr  = powf(ri, power);
+        float rn1 = powf(ri, power - 1.0f);
+        drs[i] = rn1 * power * drs[i] + 1.0f;
+        zx[i] = zr * sinf(theta) * cosf(phi);
+        zy[i] = zr * sinf(theta) * sinf(phi);
+        zz[i] = zr * cosf(theta);
+    });
+    dr = load(drs);
+    return {load(zx), load(zy), load(zz)};
+}
+
+// mandelbulbDE after `iterations` (per lane) iterations.
+F mandelbulbDE(const Scene &s, const V3 &pos, F iterations) {
+    V3 z = pos;
+    F dr = splat(1.0f);
+    F r  = splat(0.0f);
+    M active = splat(0.0f) < iterations;
+
+    for (int i = 0; i < s.view.maxIterations; i++) {
+        active = active & (splat(static_cast<float>(i)) < iterations);
+        if (!any(active)) break;
+
+        F len = length(z);
+        r = select(active, len, r);
+        active = andNot(active, len > splat(s.view.bailout));
+        if (!any(active)) break;
+
+        F ndr = dr;
+        V3 zn = bulbPower(s, z, len, ndr) + pos;
+        z  = select(active, zn, z);
+        dr = select(active, ndr, dr);
+    }
+
+    return splat(0.5f) * vlog(r) * r / dr;
+}
+
+F mandelbulbDE(const Scene &s, const V3 &pos) {
+    return mandelbulbDE(s, pos, splat(static_cast<float>(s.view.maxIterations)));
+}
+
+F hitThreshold(const Scene &s, F dist) {
+    const ViewState &v = s.view;
+    if (!v.lod) return splat(v.epsilon);
+    F footprint = dist * splat(2.0f) * splat(v.fov) / splat(static_cast<float>(v.height));
+    return vmax(splat(v.epsilon), splat(v.lodBias) * footprint);
+}
+
+F lodIterations(const Scene &s, F threshold) {
+    const ViewState &v = s.view;
+    const float iterCount = static_cast<float>(v.maxIterations);
+    if (!v.lod) return splat(iterCount);
+    F coarsening = vlog(threshold / splat(v.epsilon)) * splat(1.44269504f / s.logPower);
+    F drop = vtrunc(splat(v.lodIterBias) * coarsening);
+    return clamp(splat(iterCount) - drop, iterCount < 4.0f ? iterCount : 4.0f, iterCount);
+}
+
+// Entry and exit distances through the sphere |p| = radius, exit < entry
+// on a miss.
+void boundingSpan(const V3 &ro, const V3 &rd, F radius, F &entry, F &exit) {
+    F b = dot(ro, rd);
+    F h = b * b - dot(ro, ro) + radius * radius;
+    M miss = h < splat(0.0f);
+    h = vsqrt(vmax(h, splat(0.0f)));
+    entry = select(miss, splat(1e20f), -b - h);
+    exit  = select(miss, splat(-1e20f), -b + h);
+}
+
+// cameraRay at fragCoord (x, y), in full-image pixels.
+V3 cameraRay(const Scene &s, F x, F y) {
+    const ViewState &v = s.view;
+    const float w = static_cast<float>(v.width), h = static_cast<float>(v.height);
+    F u = (x / splat(w)) * splat(2.0f) - splat(1.0f);
+    F t = (y / splat(h)) * splat(2.0f) - splat(1.0f);
+    u = u * splat(w / h);
+
+    V3 offset = splat3(v.camRight) * u * splat(v.fov) + splat3(v.camUp) * t * splat(v.fov);
+    return normalize(splat3(v.camForward) + offset);
+}
+
+// ----------------------------- marching ---------------------------- //
+
+// raymarch() for a packet: distances of hits (-1 for misses) and the
+// steps each lane spent. Lanes outside `live` are left alone.
+F raymarch(const Scene &s, const V3 &ro, const V3 &rd, F startDist, M live, F &steps) {
+    const ViewState &v = s.view;
+    F dist = startDist;
+    F end  = splat(v.maxDist);
+    F radius = splat(0.0f), stepLength = splat(0.0f);
+    if (v.boundedMarch) {
+        F entry, exit;
+        boundingSpan(ro, rd, splat(v.bailout), entry, exit);
+        dist = vmax(dist, entry);
+        end  = vmin(end, exit);
+    }
+    const F omega = splat(v.boundedMarch ? v.relaxation : 1.0f);
+
+    M hit = andNot(live, live);
+    steps = splat(static_cast<float>(s.sample.stepLimit));
+    for (int i = 0; i < s.sample.stepLimit && any(live); i++) {
+        const F index = splat(static_cast<float>(i));
+        M left = live & (dist > end);
+        steps = select(left, index, steps);
+        live  = andNot(live, left);
+
+        F threshold = hitThreshold(s, dist);
+        F r = mandelbulbDE(s, ro + rd * dist, lodIterations(s, threshold));
+
+        // Overshoot: back to the plain step from the previous point.
+        M over = live & (radius < stepLength) & (r + radius < stepLength);
+        dist = select(over, dist + radius - stepLength, dist);
+        radius     = select(over, splat(0.0f), radius);
+        stepLength = select(over, splat(0.0f), stepLength);
+
+        M found = andNot(live, over) & (r < threshold);
+        steps = select(found, index, steps);
+        hit   = hit | found;
+        live  = andNot(live, found);
+
+        M advance  = andNot(live, over);
+        radius     = select(advance, r, radius);
+        stepLength = select(advance, omega * r, stepLength);
+        dist       = select(advance, dist + stepLength, dist);
+    }
+
+    return select(hit, dist, splat(-1.0f));
+}
+
+// coneMarch for a packet of prepass texels.
+F coneMarch(const Scene &s, const V3 &ro, const V3 &rd, F slope, F &steps) {
+    const ViewState &v = s.view;
+    F dist = splat(0.0f);
+    F end  = splat(v.maxDist);
+    if (v.boundedMarch) {
+        F entry, exit;
+        boundingSpan(ro, rd, splat(v.bailout) + slope * splat(v.maxDist), entry, exit);
+        dist = vmax(entry, splat(0.0f));
+        end  = vmin(end, exit);
+    }
+
+    M live = splat(0.0f) <= splat(0.0f);
+    steps = splat(static_cast<float>(s.sample.stepLimit));
+    for (int i = 0; i < s.sample.stepLimit && any(live); i++) {
+        const F index = splat(static_cast<float>(i));
+        M left = live & (dist > end);
+
+        F radius = dist * slope;
+        F threshold = hitThreshold(s, dist);
+        F dS = mandelbulbDE(s, ro + rd * dist, lodIterations(s, threshold)) - radius;
+
+        // Progress would stall: the per-pixel march takes over.
+        M stall = dS < threshold + splat(0.1f) * radius;
+        M stop = live & (left | stall);
+        steps = select(stop, index, steps);
+        live  = andNot(live, stop);
+        dist  = select(live, dist + dS, dist);
+    }
+    return dist;
+}
+
+// ----------------------------- shading ----------------------------- //
+
+// normalize(vec3(0.4, 0.7, 0.2)), spelled out: a computed constant would
+// need a dynamic initializer built with this file's target flags.
+const float kLightDir[3] = {0.481543412f, 0.842700972f, 0.240771706f};
+
+// analyticNormal at one point, in C maths; called per hit lane.
+void analyticNormal(const ViewState &v, const float pos[3], int iterations, float n[3]) {
+    float z[3]  = {pos[0], pos[1], pos[2]};
+    float gx[3] = {1.0f, 0.0f, 0.0f};
+    float gy[3] = {0.0f, 1.0f, 0.0f};
+    float gz[3] = {0.0f, 0.0f, 1.0f};
+    const float power = v.power;
+
+    for (int i = 0; i < iterations; i++) {
+        float r = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+        if (r > v.bailout) break;
+
+        float rho2 = z[0] * z[0] + z[1] * z[1];
+        if (rho2 < 1e-20f) rho2 = 1e-20f;
+        float rho = sqrtf(rho2);
+        float r2  = r * r > 1e-20f ? r * r : 1e-20f;
+        float theta = atan2f(rho, z[2]);
+        float phi   = atan2f(z[1], z[0]);
+        float rInv  = 1.0f / (r > 1e-10f ? r : 1e-10f);
+
+        float dr[3], drho[3], dtheta[3], dphi[3];
+        for (int k = 0; k < 3; k++) {
+            dr[k]     = (z[0] * gx[k] + z[1] * gy[k] + z[2] * gz[k]) * rInv;
+            drho[k]   = (z[0] * gx[k] + z[1] * gy[k]) / rho;
+            dtheta[k] = (z[2] * drho[k] - rho * gz[k]) / r2;
+            dphi[k]   = (z[0] * gy[k] - z[1] * gx[k]) / rho2;
+        }
+
+        float rn1 = powf(r, power - 1.0f);
+        float zr  = rn1 * r;
+        float t = theta * power, p = phi * power;
+        float st = sinf(t), ct = cosf(t), sp = sinf(p), cp = cosf(p);
+
+        for (int k = 0; k < 3; k++) {
+            float dzr = power * rn1 * dr[k];
+            float dt = dtheta[k] * power, dp = dphi[k] * power;
+            gx[k] = dzr * (st * cp) + zr * (ct * cp * dt - st * sp * dp) + (k == 0 ? 1.0f : 0.0f);
+            gy[k] = dzr * (st * sp) + zr * (ct * sp * dt + st * cp * dp) + (k == 1 ? 1.0f : 0.0f);
+            gz[k] = dzr * ct        - zr * (st * dt)                     + (k == 2 ? 1.0f : 0.0f);
+        }
+        z[0] = zr * st * cp + pos[0];
+        z[1] = zr * st * sp + pos[1];
+        z[2] = zr * ct + pos[2];
+    }
+
+    float g[3], len2 = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        g[k] = z[0] * gx[k] + z[1] * gy[k] + z[2] * gz[k];
+        len2 += g[k] * g[k];
+    }
+    float inv = 1.0f / sqrtf(len2);
+    for (int k = 0; k < 3; k++) n[k] = g[k] * inv;
+}
+
+V3 estimateNormal(const Scene &s, const V3 &p, F dist) {
+    F threshold = hitThreshold(s, dist);
+    F iterations = lodIterations(s, threshold);
+    F eps = threshold * splat(2.0f);
+
+    if (s.view.analyticNormals) {
+        float px[kLanes], py[kLanes], pz[kLanes], it[kLanes];
+        float nx[kLanes], ny[kLanes], nz[kLanes];
+        store(px, p.x); store(py, p.y); store(pz, p.z); store(it, iterations);
+        perLane([&](int i) {
+            const float pos[3] = {px[i], py[i], pz[i]};
+            float n[3];
+            analyticNormal(s.view, pos, static_cast<int>(it[i]), n);
+            nx[i] = n[0];
+            ny[i] = n[1];
+            nz[i] = n[2];
+        });
+        return {load(nx), load(ny), load(nz)};
+    }
+
+    F d = mandelbulbDE(s, p, iterations);
+    F dx = mandelbulbDE(s, {p.x + eps, p.y - eps, p.z - eps}, iterations);
+    F dy = mandelbulbDE(s, {p.x - eps, p.y + eps, p.z - eps}, iterations);
+    F dz = mandelbulbDE(s, {p.x - eps, p.y - eps, p.z + eps}, iterations);
+    return normalize(V3{dx - d, dy - d, dz - d});
+}
+
+F softShadow(const Scene &s, const V3 &ro, M live) {
+    const V3 rd = splat3(kLightDir);
+    F res = splat(1.0f);
+    F t   = splat(0.02f);
+
+    for (int i = 0; i < s.sample.shadowSteps && any(live); i++) {
+        F h = mandelbulbDE(s, ro + rd * t);
+        M blocked = live & (h < splat(0.0005f));
+        res  = select(blocked, splat(0.0f), res);
+        live = andNot(live, blocked);
+
+        res = select(live, vmin(res, splat(10.0f) * h / t), res);
+        t   = select(live, t + clamp(h, 0.02f, 0.2f), t);
+        live = andNot(live, t > splat(20.0f));
+    }
+    return clamp(res, 0.0f, 1.0f);
+}
+
+F ambientOcclusion(const Scene &s, const V3 &p, const V3 &n) {
+    F ao  = splat(0.0f);
+    F sca = splat(1.0f);
+    for (int i = 0; i < 5; i++) {
+        F h = splat(0.01f + 0.12f * static_cast<float>(i) / 4.0f);
+        F d = mandelbulbDE(s, p + n * h);
+        ao  = ao + (h - d) * sca;
+        sca = sca * splat(0.95f);
+    }
+    return clamp(splat(1.0f) - splat(3.0f) * ao, 0.0f, 1.0f);
+}
+
+V3 background(const V3 &rd) {
+    F h = splat(0.5f) * (rd.y + splat(1.0f));
+    return {mix(splat(0.03f), splat(0.2f), h),
+            mix(splat(0.03f), splat(0.3f), h),
+            mix(splat(0.08f), splat(0.45f), h)};
+}
+
+// shadeRay for a packet; `hit` marks the lanes with t > 0.
+V3 shadeRay(const Scene &s, const V3 &rd, const V3 &p, F t, F steps, M hit) {
+    const ViewState &v = s.view;
+    V3 col = background(rd);
+    if (!any(hit)) return col;
+
+    const V3 light = splat3(kLightDir);
+    V3 n = estimateNormal(s, p, t);
+    F facing = dot(n, light);
+
+    F sh = splat(1.0f);
+    if (v.enableShadows) {
+        M lit = hit & (splat(0.0f) < facing);
+        if (any(lit)) sh = select(lit, softShadow(s, p + n * splat(0.01f), lit), sh);
+    }
+    F ao = v.enableAO ? ambientOcclusion(s, p, n) : splat(1.0f);
+
+    // lightSurface
+    F ratio = clamp(steps / splat(static_cast<float>(v.maxSteps)), 0.0f, 1.0f);
+    F diff = vmax(facing, splat(0.0f)) * sh;
+    F spec = vmax(dot(n, normalize(light - rd)), splat(0.0f));
+    for (int k = 0; k < 5; k++) spec = spec * spec;   // ^32
+    spec = select(splat(0.0f) < diff, spec, splat(0.0f));
+
+    V3 base = {mix(splat(v.colorA[0]), splat(v.colorB[0]), ratio),
+               mix(splat(v.colorA[1]), splat(v.colorB[1]), ratio),
+               mix(splat(v.colorA[2]), splat(v.colorB[2]), ratio)};
+    V3 lightCol = base * (splat(0.2f) * ao) + base * diff + V3{spec, spec, spec};
+    return select(hit, lightCol, col);
+}
+
+// ------------------------------ passes ----------------------------- //
+
+// Packets cover kPacketW x kPacketH pixels, square-ish for coherence.
+constexpr int kPacketW = kLanes >= 4 ? 4 : 1;
+constexpr int kPacketH = kLanes / kPacketW;
+
+void packetCoords(int x0, int y0, F &x, F &y) {
+    F lane = laneIndex();
+    F row = vtrunc(lane * splat(1.0f / kPacketW));
+    x = splat(static_cast<float>(x0)) + lane - row * splat(static_cast<float>(kPacketW));
+    y = splat(static_cast<float>(y0)) + row;
+}
+
+void prepassPass(const ViewState &view, const CpuSample &sample, const CpuRect &coarse,
+                 float *start, int stride) {
+    const Scene s = makeScene(view, sample);
+    const float scale = static_cast<float>(view.prepassScale);
+    const V3 ro = splat3(view.camPos);
+    // Half-diagonal of the tile plus the largest refinement jitter, as in
+    // mandelbulb.frag.
+    const F slope = splat((0.5f * scale + 0.5f) * 1.41421356f * 2.0f * view.fov /
+                          static_cast<float>(view.height));
+
+    for (int y0 = coarse.y; y0 < coarse.y + coarse.height; y0 += kPacketH) {
+        for (int x0 = coarse.x; x0 < coarse.x + coarse.width; x0 += kPacketW) {
+            F x, y;
+            packetCoords(x0, y0, x, y);
+            V3 rd = cameraRay(s, (x + splat(0.5f)) * splat(scale), (y + splat(0.5f)) * splat(scale));
+            F steps;
+            F t = coneMarch(s, ro, rd, slope, steps);
+
+            float ts[kLanes], ss[kLanes];
+            store(ts, t);
+            store(ss, steps);
+            for (int i = 0; i < kLanes; i++) {
+                int px = x0 + i % kPacketW, py = y0 + i / kPacketW;
+                if (px >= coarse.x + coarse.width || py >= coarse.y + coarse.height) continue;
+                float *texel = start + 2 * (static_cast<size_t>(py) * stride + px);
+                texel[0] = ts[i];
+                texel[1] = ss[i];
+            }
+        }
+    }
+}
+
+void shadePass(const ViewState &view, const CpuSample &sample, const CpuRect &rect,
+               const float *start, int startStride, float *linear, int stride) {
+    const Scene s = makeScene(view, sample);
+    const V3 ro = splat3(view.camPos);
+    const int scale = view.prepassScale;
+    const float weight = 1.0f / static_cast<float>(sample.sampleIndex + 1);
+
+    for (int y0 = rect.y; y0 < rect.y + rect.height; y0 += kPacketH) {
+        for (int x0 = rect.x; x0 < rect.x + rect.width; x0 += kPacketW) {
+            F x, y;
+            packetCoords(x0, y0, x, y);
+            M live = (x < splat(static_cast<float>(rect.x + rect.width))) &
+                     (y < splat(static_cast<float>(rect.y + rect.height)));
+
+            V3 rd = cameraRay(s, x + splat(0.5f) + splat(sample.jitter[0]),
+                              y + splat(0.5f) + splat(sample.jitter[1]));
+
+            float seedDist[kLanes] = {}, seedSteps[kLanes] = {};
+            if (scale > 0 && start) {
+                for (int i = 0; i < kLanes; i++) {
+                    int px = x0 + i % kPacketW, py = y0 + i / kPacketW;
+                    if (px >= rect.x + rect.width || py >= rect.y + rect.height) continue;
+                    const float *texel =
+                        start + 2 * (static_cast<size_t>(py / scale) * startStride + px / scale);
+                    seedDist[i]  = texel[0];
+                    seedSteps[i] = texel[1];
+                }
+            }
+
+            F steps;
+            F t = raymarch(s, ro, rd, load(seedDist), live, steps);
+            steps = steps + load(seedSteps);
+
+            M hit = live & (splat(0.0f) < t);
+            V3 col = shadeRay(s, rd, ro + rd * t, t, steps, hit);
+
+            float cr[kLanes], cg[kLanes], cb[kLanes];
+            store(cr, col.x);
+            store(cg, col.y);
+            store(cb, col.z);
+            for (int i = 0; i < kLanes; i++) {
+                int px = x0 + i % kPacketW, py = y0 + i / kPacketW;
+                if (px >= rect.x + rect.width || py >= rect.y + rect.height) continue;
+                float *out = linear + 4 * (static_cast<size_t>(py) * stride + px);
+                const float c[3] = {cr[i], cg[i], cb[i]};
+                for (int k = 0; k < 3; k++) {
+                    // accumulate(): mix(history, col, 1 / (n + 1))
+                    out[k] = sample.sampleIndex > 0 ? out[k] * (1.0f - weight) + c[k] * weight
+                                                    : c[k];
+                }
+                out[3] = 1.0f;
+            }
+        }
+    }
+}
+
+const CpuKernel kKernel = {CPU_KERNEL_NAME, kLanes, prepassPass, shadePass};
+
+}  // namespace
@@ -0,0 +1,17 @@
+// AVX2 build of the CPU kernel: 8 rays per packet.
+
+#if defined(__AVX2__)
+
+#define CPU_KERNEL_LANES 8
+#define CPU_KERNEL_NAME "avx2"
+#include "cpu_kernel.inl"
+
+const CpuKernel *cpuKernelAvx2() { return &kKernel; }
+
+#else
+
+#include "cpu_kernel.h"
+
+const CpuKernel *cpuKernelAvx2() { return nullptr; }
+
+#endif
@@ -0,0 +1,28 @@
+// AVX-512 build of the CPU kernel: 16 rays per packet.
+
+#if defined(__AVX512F__)
+
+#define CPU_KERNEL_LANES 16
+#define CPU_KERNEL_NAME "avx512"
+// GCC 12's unmasked AVX-512 intrinsics (getexp, getmant, min, sqrt, ...)
+// pass _mm512_undefined_ps() as their merge source, which -Wall reports
+// as uninitialized wherever the kernel inlines them.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include "cpu_kernel.inl"
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+const CpuKernel *cpuKernelAvx512() { return &kKernel; }
+
+#else
+
+#include "cpu_kernel.h"
+
+const CpuKernel *cpuKernelAvx512() { return nullptr; }
+
+#endif
@@ -0,0 +1,8 @@
+// Portable build of the CPU kernel: one ray at a time, for CPUs (or
+// compilers) without the vector paths.
+
+#define CPU_KERNEL_LANES 1
+#define CPU_KERNEL_NAME "scalar"
+#include "cpu_kernel.inl"
+
+const CpuKernel *cpuKernelScalar() { return &kKernel; }
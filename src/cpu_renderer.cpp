@@ -0,0 +1,143 @@
+#include "cpu_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "camera.h"
+#include "sampling.h"
+#include "view_state.h"
+
+// Without a way to ask the CPU (non-GCC/Clang compilers) only the scalar
+// kernel is trusted.
+static bool cpuSupports(const std::string &isa) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (isa == "avx512") return __builtin_cpu_supports("avx512f");
+    if (isa == "avx2")   return __builtin_cpu_supports("avx2");
+#endif
+    return isa == "scalar";
+}
+
+// IEEE half with round-to-nearest-even, as GL_HALF_FLOAT reads return.
+static uint16_t floatToHalf(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    const uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000u);
+    const uint32_t a = x & 0x7fffffffu;
+
+    if (a >= 0x7f800000u) return sign | 0x7c00u | (a > 0x7f800000u ? 0x0200u : 0u);
+    if (a >= 0x477ff000u) return sign | 0x7c00u;   // rounds past the largest half
+    if (a < 0x38800000u) {
+        // Subnormal: a multiple of 2^-24.
+        float v;
+        std::memcpy(&v, &a, sizeof(v));
+        return sign | static_cast<uint16_t>(std::lrint(v * 16777216.0f));
+    }
+    // Rebias the exponent by -112 and round the 13 dropped bits to even.
+    uint32_t h = a + 0xc8000fffu + ((a >> 13) & 1u);
+    return sign | static_cast<uint16_t>(h >> 13);
+}
+
+CpuRenderer::CpuRenderer(int threads) : pool_(threads) {}
+
+bool CpuRenderer::init(const std::string &isa) {
+    const struct {
+        const char *name;
+        const CpuKernel *kernel;
+    } kernels[] = {
+        {"avx512", cpuKernelAvx512()},
+        {"avx2",   cpuKernelAvx2()},
+        {"scalar", cpuKernelScalar()},
+    };
+    for (const auto &k : kernels) {
+        if (isa != "auto" && isa != k.name) continue;
+        if (k.kernel && cpuSupports(k.name)) {
+            kernel_ = k.kernel;
+            return true;
+        }
+        if (isa != "auto") return false;
+    }
+    return false;
+}
+
+void CpuRenderer::render(const RenderSettings &settings, int width, int height, int samples) {
+    RenderSettings s = settings;
+    s.prepassFactor = s.prepassFactor <= 4 ? 4 : 8;
+
+    CameraBasis cam = computeCameraBasis(s);
+    ViewState view = makeViewState(s, cam, width, height);
+
+    // OfflineRenderer::renderTile's per-sample parameters.
+    std::vector<CpuSample> sequence(std::max(samples, 1));
+    for (int sample = 0; sample < static_cast<int>(sequence.size()); sample++) {
+        float boost = s.refineQuality ? refineBoost(sample) : 0.0f;
+        CpuSample &p = sequence[sample];
+        p.sampleIndex = sample;
+        if (sample > 0) {
+            p.jitter[0] = halton(sample, 2) - 0.5f;
+            p.jitter[1] = halton(sample, 3) - 0.5f;
+        }
+        p.stepLimit   = std::min(static_cast<int>(s.maxSteps * (1.0f + boost)), 1024);
+        p.shadowSteps = static_cast<int>(kBaseShadowSteps * (1.0f + boost));
+    }
+
+    width_  = width;
+    height_ = height;
+    linear_.assign(static_cast<size_t>(width) * height * 4, 0.0f);
+
+    const int scale = view.prepassScale;
+    const int startStride = scale > 0 ? (width + scale - 1) / scale : 0;
+    if (scale > 0) {
+        start_.assign(static_cast<size_t>(startStride) * ((height + scale - 1) / scale) * 2, 0.0f);
+    }
+
+    // Tiles keep all their samples, and the prepass texels under them, to
+    // themselves, so one batch covers the whole frame.
+    const int tilesX = (width + kTileSize - 1) / kTileSize;
+    const int tilesY = (height + kTileSize - 1) / kTileSize;
+    pool_.run(tilesX * tilesY, [&](int index, int) {
+        CpuRect rect;
+        rect.x = index % tilesX * kTileSize;
+        rect.y = index / tilesX * kTileSize;
+        rect.width  = std::min(kTileSize, width - rect.x);
+        rect.height = std::min(kTileSize, height - rect.y);
+
+        if (scale > 0) {
+            CpuRect coarse;
+            coarse.x = rect.x / scale;
+            coarse.y = rect.y / scale;
+            coarse.width  = (rect.width + scale - 1) / scale;
+            coarse.height = (rect.height + scale - 1) / scale;
+            kernel_->prepass(view, sequence[0], coarse, start_.data(), startStride);
+        }
+        for (const CpuSample &sample : sequence) {
+            kernel_->shade(view, sample, rect, scale > 0 ? start_.data() : nullptr, startStride,
+                           linear_.data(), width);
+        }
+    });
+}
+
+Image CpuRenderer::image(Image::Format format) const {
+    Image image;
+    image.width  = width_;
+    image.height = height_;
+    image.format = format;
+
+    const size_t count = static_cast<size_t>(width_) * height_ * 4;
+    if (format == Image::RgbaHalf) {
+        image.pixels.resize(count * sizeof(uint16_t));
+        uint16_t *out = reinterpret_cast<uint16_t *>(image.pixels.data());
+        for (size_t i = 0; i < count; i++) out[i] = floatToHalf(linear_[i]);
+        return image;
+    }
+
+    // upscale.frag's gamma, then unorm conversion.
+    image.pixels.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        float c = i % 4 == 3 ? linear_[i] : std::pow(std::max(linear_[i], 0.0f), 0.4545f);
+        c = std::min(std::max(c, 0.0f), 1.0f);
+        image.pixels[i] = static_cast<uint8_t>(c * 255.0f + 0.5f);
+    }
+    return image;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "cpu_kernel.h"
+#include "image_io.h"
+#include "render_settings.h"
+#include "work_stealing_pool.h"
+
+// --------------------------- CPU renderer -------------------------- //
+
+// OfflineRenderer's output without a GPU, for GPU-less machines and for
+// checking the shaders: the same view, depth prepass, jittered samples
+// and refinement budgets, marched by a CpuKernel (packets of 16 or 8
+// rays with AVX-512 or AVX2, else one at a time) over 32-pixel tiles
+// spread across cores by a WorkStealingPool.
+class CpuRenderer {
+public:
+    // 0 threads = every hardware thread.
+    explicit CpuRenderer(int threads = 0);
+
+    // Picks the kernel: "auto" takes the widest one this CPU runs, else
+    // "avx512", "avx2" or "scalar". False if that one wasn't built or
+    // the CPU lacks it.
+    bool init(const std::string &isa = "auto");
+
+    const CpuKernel &kernel() const { return *kernel_; }
+    int threads() const { return pool_.threads(); }
+
+    // Accumulates `samples` jittered samples at width x height, like
+    // OfflineRenderer::render. Deep zoom isn't supported: it marches in
+    // float.
+    void render(const RenderSettings &settings, int width, int height, int samples);
+
+    // The last render as PixelReadback would return it from the GPU
+    // targets, rows bottom-up: Rgba8 gamma-encoded as resolve() does,
+    // RgbaHalf linear.
+    Image image(Image::Format format) const;
+
+private:
+    static constexpr int kTileSize = 32;   // a multiple of every prepass factor
+
+    const CpuKernel *kernel_ = nullptr;
+    WorkStealingPool pool_;
+
+    int width_ = 0, height_ = 0;
+    std::vector<float> linear_;   // RGBA, rows bottom-up
+    std::vector<float> start_;    // prepass: start distance, steps
+};
@@ -0,0 +1,32 @@
+#include "distance_cache.h"
+
+#include <utility>
+
+DistanceCache::DistanceCache(ProgramCache &cache, std::string vsPath, std::string fsPath)
+    : volume_(cache, std::move(vsPath), std::move(fsPath),
+              BakedVolumeFormat{GL_R16F, GL_RED, GL_FLOAT, 2}, 64u << 20, 8) {}
+
+BakedVolumeKey DistanceCache::keyFor(const ViewState &view) const {
+    BakedVolumeKey key;
+    key.power         = view.power;
+    key.maxIterations = view.maxIterations;
+    key.bailout       = view.bailout;
+    key.resolution    = volume_.resolution();
+    return key;
+}
+
+bool DistanceCache::bake(const ViewState &view, const ShaderDefines &defines, GLuint vao) {
+    BakedVolumeKey key = keyFor(view);
+    FrameParams frame;
+    frame.cacheExtent = bakedVolumeExtent(key.bailout);
+    frame.cacheVoxel  = 2.0f * frame.cacheExtent / key.resolution;
+    return volume_.bake(key, defines, frame, vao);
+}
+
+bool DistanceCache::apply(const ViewState &view, FrameParams &frame) const {
+    if (!volume_.hasSurface(keyFor(view))) return false;
+    frame.distanceCache = true;
+    frame.cacheExtent   = bakedVolumeExtent(volume_.built().bailout);
+    frame.cacheVoxel    = 2.0f * frame.cacheExtent / volume_.built().resolution;
+    return true;
+}
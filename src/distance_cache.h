@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <GL/glew.h>
+
+#include "baked_volume.h"
+#include "fractal_program.h"
+#include "shader.h"
+#include "view_state.h"
+
+// -------------------------- distance cache ------------------------- //
+
+// A volume of conservative distances around the bulb, so marching can
+// take its long steps from a texture lookup and only evaluate the formula
+// near the surface (sceneDistance in mandelbulb_common.glsl).
+//
+// distance_bake.frag fills an R16F BakedVolume a few z-slices per bake()
+// call. A change of power, iterations or bailout restarts the bake, and
+// until it finishes frames march with the exact estimate only. After a
+// budget change the old grid stays in use until the new one is ready.
+class DistanceCache {
+public:
+    DistanceCache(ProgramCache &cache, std::string vsPath, std::string fsPath);
+
+    // Frees the volumes; the next bake() reallocates them.
+    void destroy() { volume_.destroy(); }
+
+    // Memory for both volumes together. Takes effect with the next bake.
+    void   setBudget(size_t bytes) { volume_.setBudget(bytes); }
+    size_t budget() const { return volume_.budget(); }
+    // Voxels per axis the budget allows, capped by GL_MAX_3D_TEXTURE_SIZE.
+    int    resolution() const { return volume_.resolution(); }
+
+    int  slicesPerFrame() const { return volume_.slicesPerFrame(); }
+    void setSlicesPerFrame(int slices) { volume_.setSlicesPerFrame(slices); }
+
+    // True until a finished volume matches view's surface.
+    bool needsBake(const ViewState &view) const { return volume_.needsBake(keyFor(view)); }
+    // Bakes the next slicesPerFrame() slices for view, restarting if its
+    // surface changed. The FractalParams buffer must hold view. `defines`
+    // selects the bake variant (fractalDefines or empty). Returns true
+    // when this call finished the volume.
+    bool bake(const ViewState &view, const ShaderDefines &defines, GLuint vao);
+    // Whether a volume is partly baked, and what fraction of it.
+    bool  baking() const { return volume_.baking(); }
+    float progress() const { return volume_.progress(); }
+    // Texture memory currently allocated.
+    size_t memoryBytes() const { return volume_.memoryBytes(); }
+
+    // Points frame at the current volume if it was baked for view's
+    // surface, at any resolution.
+    bool apply(const ViewState &view, FrameParams &frame) const;
+    // The current volume, for kUnitDistanceCache.
+    GLuint texture() const { return volume_.texture(); }
+
+private:
+    BakedVolumeKey keyFor(const ViewState &view) const;
+
+    BakedVolume volume_;
+};
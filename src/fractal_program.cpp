@@ -0,0 +1,210 @@
+#include "fractal_program.h"
+
+#include <cmath>
+#include <utility>
+
+#include "cost_counters.h"
+
+FractalParamsStd140 packFractalParams(const ViewState &view) {
+    FractalParamsStd140 p{};
+    for (int i = 0; i < 3; i++) {
+        p.camPos[i]     = view.camPos[i];
+        p.camForward[i] = view.camForward[i];
+        p.camRight[i]   = view.camRight[i];
+        p.camUp[i]      = view.camUp[i];
+        p.camPosLo[i]   = view.camPosLo[i];
+        p.colorA[i]     = view.colorA[i];
+        p.colorB[i]     = view.colorB[i];
+    }
+    p.fov           = view.fov;
+    p.power         = view.power;
+    p.bailout       = view.bailout;
+    p.maxDist       = view.maxDist;
+    p.epsilon       = view.epsilon;
+    p.maxIterations = view.maxIterations;
+    p.maxSteps      = view.maxSteps;
+    p.enableAO      = view.enableAO;
+    p.enableShadows = view.enableShadows;
+    p.prepassScale  = view.prepassScale;
+    p.analyticNormals = view.analyticNormals;
+    p.boundedMarch  = view.boundedMarch;
+    p.relaxation    = view.relaxation;
+    p.lod           = view.lod;
+    p.lodBias       = view.lodBias;
+    p.lodIterBias   = view.lodIterBias;
+    p.deepZoom      = view.deepZoom;
+    p.resolution[0] = static_cast<float>(view.width);
+    p.resolution[1] = static_cast<float>(view.height);
+    return p;
+}
+
+FractalProgram loadFractalProgram(GLuint program) {
+    FractalProgram fp;
+    fp.program = program;
+
+    glUseProgram(program);
+    fp.uTime          = glGetUniformLocation(program, "u_time");
+    fp.uTileOffset    = glGetUniformLocation(program, "u_tileOffset");
+    fp.uStepLimit     = glGetUniformLocation(program, "u_stepLimit");
+    fp.uShadowSteps   = glGetUniformLocation(program, "u_shadowSteps");
+    fp.uJitter        = glGetUniformLocation(program, "u_jitter");
+    fp.uSampleIndex   = glGetUniformLocation(program, "u_sampleIndex");
+    fp.uLightingScale = glGetUniformLocation(program, "u_lightingScale");
+    fp.uCacheEnabled  = glGetUniformLocation(program, "u_cacheEnabled");
+    fp.uCacheExtent   = glGetUniformLocation(program, "u_cacheExtent");
+    fp.uCacheVoxel    = glGetUniformLocation(program, "u_cacheVoxel");
+    fp.uLightCache       = glGetUniformLocation(program, "u_lightCache");
+    fp.uLightCacheExtent = glGetUniformLocation(program, "u_lightCacheExtent");
+    fp.uLightCacheVoxel  = glGetUniformLocation(program, "u_lightCacheVoxel");
+    fp.uReproject       = glGetUniformLocation(program, "u_reproject");
+    fp.uFrameIndex      = glGetUniformLocation(program, "u_frameIndex");
+    fp.uReprojectMargin = glGetUniformLocation(program, "u_reprojectMargin");
+    fp.uPrevResolution  = glGetUniformLocation(program, "u_prevResolution");
+    fp.uPrevCamPos      = glGetUniformLocation(program, "u_prevCamPos");
+    fp.uPrevCamForward  = glGetUniformLocation(program, "u_prevCamForward");
+    fp.uPrevCamRight    = glGetUniformLocation(program, "u_prevCamRight");
+    fp.uPrevCamUp       = glGetUniformLocation(program, "u_prevCamUp");
+    fp.uPrevFov         = glGetUniformLocation(program, "u_prevFov");
+    fp.uCheckerboard    = glGetUniformLocation(program, "u_checkerboard");
+    fp.uCheckerParity   = glGetUniformLocation(program, "u_checkerParity");
+    fp.uTaaBlend        = glGetUniformLocation(program, "u_taaBlend");
+
+    glUniform1i(glGetUniformLocation(program, "u_history"), kUnitHistory);
+    glUniform1i(glGetUniformLocation(program, "u_startDist"), kUnitStartDist);
+    glUniform1i(glGetUniformLocation(program, "u_prevHitInfo"), kUnitPrevHit);
+    glUniform1i(glGetUniformLocation(program, "u_gNormal"), kUnitGNormal);
+    glUniform1i(glGetUniformLocation(program, "u_gHit"), kUnitGHit);
+    glUniform1i(glGetUniformLocation(program, "u_lighting"), kUnitLighting);
+    glUniform1i(glGetUniformLocation(program, "u_distanceCache"), kUnitDistanceCache);
+    glUniform1i(glGetUniformLocation(program, "u_lightingCache"), kUnitLightingCache);
+    glUniform1i(glGetUniformLocation(program, "u_checkerColor"), kUnitCheckerColor);
+    glUniform1i(glGetUniformLocation(program, "u_checkerHit"), kUnitCheckerHit);
+    glUniform1i(glGetUniformLocation(program, "u_taaColor"), kUnitTaaColor);
+    glUniform1i(glGetUniformLocation(program, "u_taaHit"), kUnitTaaHit);
+    glUniform1i(glGetUniformLocation(program, "u_taaHistory"), kUnitTaaHistory);
+    glUseProgram(0);
+
+    GLuint block = glGetUniformBlockIndex(program, "FractalParams");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, block, kFractalParamsBinding);
+    }
+    if (CostCounters::supported()) {
+        GLuint counters = glGetProgramResourceIndex(program, GL_SHADER_STORAGE_BLOCK, "CostCounters");
+        if (counters != GL_INVALID_INDEX) {
+            glShaderStorageBlockBinding(program, counters, kCostCountersBinding);
+        }
+    }
+
+    return fp;
+}
+
+void uploadFractalUniforms(const FractalProgram &fp, const FrameParams &frame) {
+    glUniform1f(fp.uTime, frame.time);
+    glUniform2f(fp.uTileOffset, frame.tileOffset[0], frame.tileOffset[1]);
+    glUniform1i(fp.uStepLimit, frame.stepLimit);
+    glUniform1i(fp.uShadowSteps, frame.shadowSteps);
+
+    glUniform2f(fp.uJitter, frame.jitter[0], frame.jitter[1]);
+    glUniform1i(fp.uSampleIndex, frame.sampleIndex);
+    glUniform1i(fp.uLightingScale, frame.lightingScale);
+    glUniform1i(fp.uCacheEnabled, frame.distanceCache ? 1 : 0);
+    glUniform1f(fp.uCacheExtent, frame.cacheExtent);
+    glUniform1f(fp.uCacheVoxel, frame.cacheVoxel);
+    glUniform1i(fp.uLightCache, frame.lightCache);
+    glUniform1f(fp.uLightCacheExtent, frame.lightCacheExtent);
+    glUniform1f(fp.uLightCacheVoxel, frame.lightCacheVoxel);
+
+    glUniform1i(fp.uFrameIndex, frame.frameIndex);
+    glUniform1i(fp.uCheckerboard, frame.checkerboard ? 1 : 0);
+    glUniform1i(fp.uCheckerParity, frame.checkerParity);
+    glUniform1f(fp.uTaaBlend, frame.taaBlend);
+    glUniform1i(fp.uReproject, frame.previous ? 1 : 0);
+    if (frame.previous) {
+        const ViewState &prev = *frame.previous;
+        glUniform1f(fp.uReprojectMargin, frame.reprojectMargin);
+        glUniform2f(fp.uPrevResolution, static_cast<float>(prev.width),
+                    static_cast<float>(prev.height));
+        glUniform3fv(fp.uPrevCamPos, 1, prev.camPos);
+        glUniform3fv(fp.uPrevCamForward, 1, prev.camForward);
+        glUniform3fv(fp.uPrevCamRight, 1, prev.camRight);
+        glUniform3fv(fp.uPrevCamUp, 1, prev.camUp);
+        glUniform1f(fp.uPrevFov, prev.fov);
+    }
+}
+
+// -------------------------- permutations --------------------------- //
+
+ShaderDefines fractalDefines(const ViewState &view, const FrameParams &frame, FractalPass pass) {
+    ShaderDefines defines;
+    defines["MAX_ITER"] = std::to_string(view.maxIterations);
+    if (std::floor(view.power) == view.power) {
+        defines["POWER"] = std::to_string(static_cast<int>(view.power));
+    }
+
+    if (pass == FractalPass::Bake) {
+        return defines;
+    }
+
+    bool boosted = frame.stepLimit != view.maxSteps;
+    bool marches = pass == FractalPass::Forward || pass == FractalPass::Prepass ||
+                   pass == FractalPass::GBuffer;
+    if (marches) {
+        if (!boosted) defines["STEP_LIMIT"] = std::to_string(frame.stepLimit);
+        defines["DISTANCE_CACHE"] = frame.distanceCache ? "1" : "0";
+        defines["BOUNDED_MARCH"]  = view.boundedMarch ? "1" : "0";
+        defines["DISTANCE_LOD"]   = view.lod ? "1" : "0";
+        defines["DEEP_ZOOM"]      = std::to_string(view.deepZoom);
+    }
+
+    if (pass == FractalPass::Prepass) {
+        defines["DEPTH_PREPASS"] = "";
+        return defines;
+    }
+    if (pass == FractalPass::Forward || pass == FractalPass::GBuffer) {
+        defines["ANALYTIC_NORMALS"] = view.analyticNormals ? "1" : "0";
+    }
+    if (pass == FractalPass::GBuffer) {
+        defines["GBUFFER"] = "";
+        return defines;
+    }
+    if (pass == FractalPass::Forward) {
+        defines["CHECKERBOARD"] = frame.checkerboard ? "1" : "0";
+        for (const auto &define : costDefines(view, frame)) defines.insert(define);
+    }
+
+    defines["ENABLE_AO"]      = view.enableAO ? "1" : "0";
+    defines["LIGHT_CACHE"]    = std::to_string(frame.lightCache);
+    defines["ENABLE_SHADOWS"] = view.enableShadows ? "1" : "0";
+    if (!boosted && view.enableShadows) {
+        defines["SHADOW_STEPS"] = std::to_string(frame.shadowSteps);
+    }
+    return defines;
+}
+
+ShaderDefines costDefines(const ViewState &view, const FrameParams &frame) {
+    ShaderDefines defines;
+    if (view.costView > 0) defines["COST_HEATMAP"] = std::to_string(view.costView);
+    if (frame.costCounters) defines["COST_COUNTERS"] = "";
+    return defines;
+}
+
+FractalVariants::FractalVariants(ProgramCache &cache, std::string vsPath, std::string fsPath)
+    : cache_(cache), vsPath_(std::move(vsPath)), fsPath_(std::move(fsPath)) {}
+
+const FractalProgram *FractalVariants::get(const ShaderDefines &defines) {
+    // Program names can be recycled after a reload, so drop every cached
+    // location set once the cache has swapped anything.
+    if (cache_.generation() != generation_) {
+        loaded_.clear();
+        generation_ = cache_.generation();
+    }
+
+    GLuint program = cache_.get(vsPath_, fsPath_, defines);
+    if (!program) return nullptr;
+
+    auto it = loaded_.find(program);
+    if (it == loaded_.end()) {
+        it = loaded_.emplace(program, loadFractalProgram(program)).first;
+    }
+    return &it->second;
+}
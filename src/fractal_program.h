@@ -0,0 +1,171 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include <GL/glew.h>
+
+#include "shader.h"
+#include "view_state.h"
+
+// -------------------------- fractal program ------------------------ //
+
+// Texture units used by mandelbulb.frag samplers.
+enum FractalTextureUnit {
+    kUnitHistory   = 0,
+    kUnitStartDist = 1,
+    kUnitPrevHit   = 2,
+    kUnitGNormal   = 3,   // deferred shading G-buffer
+    kUnitGHit      = 4,
+    kUnitLighting  = 5,   // coarse shadow / AO terms
+    kUnitDistanceCache = 6,   // 3D texture (DistanceCache)
+    kUnitCheckerColor  = 7,   // half-width march (Checkerboard)
+    kUnitCheckerHit    = 8,
+    kUnitTaaColor      = 9,   // temporal AA resolve (TemporalAA)
+    kUnitTaaHit        = 10,
+    kUnitTaaHistory    = 11,
+    kUnitLightingCache = 12,  // 3D texture (LightingCache)
+};
+
+// Uniform buffer binding point of mandelbulb.frag's FractalParams block.
+constexpr GLuint kFractalParamsBinding = 0;
+
+// Shader storage binding point of its CostCounters block (CostCounters).
+constexpr GLuint kCostCountersBinding = 0;
+
+// std140 image of the FractalParams block: the view parameters that all
+// variants share. Each vec3 is followed by a scalar, which std140 packs
+// into the vec3's padding.
+struct FractalParamsStd140 {
+    float camPos[3];      float fov;
+    float camForward[3];  float power;
+    float camRight[3];    float bailout;
+    float camUp[3];       float maxDist;
+    float colorA[3];      float epsilon;
+    float colorB[3];      int   maxIterations;
+    int   maxSteps;
+    int   enableAO;
+    int   enableShadows;
+    int   prepassScale;
+    float resolution[2];
+    int   analyticNormals;
+    int   boundedMarch;
+    float relaxation;
+    int   lod;
+    float lodBias;
+    float lodIterBias;
+    float camPosLo[3];    int   deepZoom;
+};
+static_assert(sizeof(FractalParamsStd140) == 10 * 16, "must match the std140 block size");
+
+FractalParamsStd140 packFractalParams(const ViewState &view);
+
+// Per-frame inputs that are not part of ViewState because they change
+// while the view itself stays put.
+struct FrameParams {
+    float time        = 0.0f;
+    float jitter[2]   = {0.0f, 0.0f};
+    int   sampleIndex = 0;
+    int   stepLimit   = 0;
+    int   shadowSteps = 50;
+    int   frameIndex  = 0;
+
+    // Origin of the rendered tile within the full view, in pixels; the
+    // target itself is tile-sized. Must be a multiple of prepassScale.
+    float tileOffset[2] = {0.0f, 0.0f};
+
+    // Deferred shading: G-buffer pixels per coarse shadow/AO texel edge
+    // (ViewState::lightingScale).
+    int lightingScale = 2;
+
+    // Distance cache volume to march through (DistanceCache::apply).
+    bool  distanceCache = false;
+    float cacheExtent   = 0.0f;
+    float cacheVoxel    = 0.0f;
+
+    // Lighting cache volume for shadows (1) or shadows and AO (2), 0 to
+    // trace them (LightingCache::apply).
+    int   lightCache       = 0;
+    float lightCacheExtent = 0.0f;
+    float lightCacheVoxel  = 0.0f;
+
+    // Set to the view the previous HitInfo was rendered with to enable
+    // temporal depth reprojection.
+    const ViewState *previous = nullptr;
+    float reprojectMargin = 0.05f;
+
+    // Forward pass adds its costs to the bound CostCounters buffer.
+    bool costCounters = false;
+
+    // Checkerboard: the forward pass marches half the pixels into a
+    // half-width target, the ones with (x + y + parity) even.
+    bool checkerboard  = false;
+    int  checkerParity = 0;
+
+    // Temporal AA resolve: weight of this frame against the reprojected
+    // history (1 = history ignored).
+    float taaBlend = 1.0f;
+};
+
+// A linked mandelbulb.frag variant plus its cached uniform locations. The
+// view parameters come from the FractalParams buffer instead.
+struct FractalProgram {
+    GLuint program = 0;
+
+    GLint uTime, uTileOffset;
+    GLint uStepLimit, uShadowSteps;
+    GLint uJitter, uSampleIndex;
+    GLint uLightingScale;
+    GLint uCacheEnabled, uCacheExtent, uCacheVoxel;
+    GLint uLightCache, uLightCacheExtent, uLightCacheVoxel;
+    GLint uReproject, uFrameIndex, uReprojectMargin, uPrevResolution;
+    GLint uPrevCamPos, uPrevCamForward, uPrevCamRight, uPrevCamUp, uPrevFov;
+    GLint uCheckerboard, uCheckerParity;
+    GLint uTaaBlend;
+};
+
+// Caches locations, binds samplers to their FractalTextureUnit, the
+// FractalParams block to kFractalParamsBinding and a CostCounters block
+// to kCostCountersBinding.
+FractalProgram loadFractalProgram(GLuint program);
+
+// Uploads the per-frame uniforms; expects fp.program to be bound.
+void uploadFractalUniforms(const FractalProgram &fp, const FrameParams &frame);
+
+// -------------------------- permutations --------------------------- //
+
+// Which program the defines are for. Forward marches and shades in one
+// pass; deferred shading splits that into a GBuffer march, a coarse
+// Lighting pass (deferred_lighting.frag) and a Shade pass
+// (deferred_shade.frag). Bake fills the distance cache
+// (distance_bake.frag) and the lighting cache (lighting_bake.frag).
+enum class FractalPass { Forward, Prepass, GBuffer, Lighting, Shade, Bake };
+
+// Defines that bake the view's feature toggles, iteration/step limits and
+// an integral power into a variant of the pass's shader. Boosted
+// refinement frames keep their step limits as uniforms so the ramp doesn't
+// compile a variant per level.
+ShaderDefines fractalDefines(const ViewState &view, const FrameParams &frame, FractalPass pass);
+
+// Just the cost heatmap / counter defines of a Forward pass (included in
+// fractalDefines), for when the generic program would otherwise run:
+// those have no runtime form. Empty when both are off.
+ShaderDefines costDefines(const ViewState &view, const FrameParams &frame);
+
+// Specialized mandelbulb.frag programs with their uniform locations,
+// compiled on first use through a ProgramCache.
+class FractalVariants {
+public:
+    FractalVariants(ProgramCache &cache, std::string vsPath, std::string fsPath);
+
+    // nullptr if the variant failed to build. The pointer stays valid
+    // until the cache replaces a program (see ProgramCache::generation).
+    const FractalProgram *get(const ShaderDefines &defines);
+    size_t size() const { return loaded_.size(); }
+
+private:
+    ProgramCache &cache_;
+    std::string vsPath_, fsPath_;
+    unsigned generation_ = 0;
+    std::unordered_map<GLuint, FractalProgram> loaded_;
+};
@@ -0,0 +1,98 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <GLFW/glfw3.h>
+
+// Sleeps routinely overshoot by a scheduler tick; the last stretch before
+// a limiter deadline is spun instead.
+static constexpr double kSpinSeconds = 0.002;
+
+void FramePacer::init() {
+    adaptive_ = glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+                glfwExtensionSupported("GLX_EXT_swap_control_tear");
+    glfwSwapInterval(1);
+    interval_ = 1;
+    mode_ = PresentMode::Vsync;
+}
+
+void FramePacer::destroy() {
+    for (GLsync &fence : fences_) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    head_ = inFlight_ = 0;
+}
+
+void FramePacer::setMode(PresentMode mode) {
+    int interval = 1;
+    if (mode == PresentMode::AdaptiveVsync) {
+        interval = adaptive_ ? -1 : 1;
+    } else if (mode == PresentMode::Uncapped || mode == PresentMode::Limited) {
+        interval = 0;
+    }
+    if (mode != mode_) deadline_ = 0.0;
+    mode_ = mode;
+
+    if (interval != interval_) {
+        glfwSwapInterval(interval);
+        interval_ = interval;
+    }
+}
+
+void FramePacer::wait(int maxFramesAhead, float fpsLimit) {
+    double start = glfwGetTime();
+
+    // The frame about to start may only begin once frame N - maxFramesAhead
+    // has finished on the GPU.
+    maxFramesAhead = std::clamp(maxFramesAhead, 1, kMaxFramesAhead);
+    while (inFlight_ >= maxFramesAhead) {
+        GLsync &fence = fences_[head_];
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        glDeleteSync(fence);
+        fence = nullptr;
+        head_ = (head_ + 1) % kMaxFramesAhead;
+        inFlight_--;
+    }
+    // Retire finished frames too, so the count stays meaningful.
+    while (inFlight_ > 0 && glClientWaitSync(fences_[head_], 0, 0) != GL_TIMEOUT_EXPIRED) {
+        glDeleteSync(fences_[head_]);
+        fences_[head_] = nullptr;
+        head_ = (head_ + 1) % kMaxFramesAhead;
+        inFlight_--;
+    }
+
+    if (mode_ == PresentMode::Limited && fpsLimit > 0.0f) {
+        double period = 1.0 / fpsLimit;
+        double now = glfwGetTime();
+        // More than a frame behind (a stall, or the first limited frame):
+        // start over from now rather than rushing to catch up.
+        if (deadline_ == 0.0 || now > deadline_ + period) deadline_ = now;
+
+        double sleep = deadline_ - now - kSpinSeconds;
+        if (sleep > 0.0) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(sleep));
+        }
+        while (glfwGetTime() < deadline_) {
+            std::this_thread::yield();
+        }
+        deadline_ += period;
+    }
+
+    waitMs_ = static_cast<float>((glfwGetTime() - start) * 1000.0);
+}
+
+void FramePacer::endFrame() {
+    if (inFlight_ == kMaxFramesAhead) {
+        // Only reachable if wait() was skipped; drop the oldest.
+        glDeleteSync(fences_[head_]);
+        fences_[head_] = nullptr;
+        head_ = (head_ + 1) % kMaxFramesAhead;
+        inFlight_--;
+    }
+    fences_[(head_ + inFlight_) % kMaxFramesAhead] =
+        glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    inFlight_++;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+
+#include <GL/glew.h>
+
+// --------------------------- frame pacing -------------------------- //
+
+// How frames are presented (RenderSettings::presentMode).
+enum class PresentMode {
+    Vsync         = 0,
+    AdaptiveVsync = 1,   // tears instead of waiting a whole interval when late
+    Uncapped      = 2,
+    Limited       = 3,   // no vsync, fixed rate from the CPU
+};
+
+// Controls when the main loop may start a frame. The swap interval picks
+// the present mode; a fence per presented frame keeps the CPU from
+// running more than maxFramesAhead frames in front of the GPU, and the
+// limiter sleeps (then spins the last stretch, as sleeps overshoot) to a
+// fixed-rate deadline. Both waits come before input is sampled, so time
+// spent waiting doesn't add to input latency.
+class FramePacer {
+public:
+    static constexpr int kMaxFramesAhead = 4;
+
+    // With the window's context current; starts in Vsync.
+    void init();
+    void destroy();
+
+    // Adaptive vsync needs {WGL,GLX}_EXT_swap_control_tear; without it
+    // AdaptiveVsync presents as Vsync.
+    bool adaptiveSupported() const { return adaptive_; }
+
+    // Sets the swap interval when the mode changed.
+    void setMode(PresentMode mode);
+
+    // Before the frame samples input. fpsLimit is used in Limited mode.
+    void wait(int maxFramesAhead, float fpsLimit);
+
+    // Right after the buffer swap.
+    void endFrame();
+
+    // Time the last wait() blocked, and the GPU frames in flight after
+    // it, for the UI.
+    float waitMs() const { return waitMs_; }
+    int   framesInFlight() const { return inFlight_; }
+
+private:
+    bool adaptive_ = false;
+    int  interval_ = 1;   // what glfwSwapInterval was last given
+    PresentMode mode_ = PresentMode::Vsync;
+
+    std::array<GLsync, kMaxFramesAhead> fences_{};
+    int head_     = 0;   // oldest frame in flight
+    int inFlight_ = 0;
+
+    double deadline_ = 0.0;   // glfwGetTime() of the next limited frame
+    float  waitMs_   = 0.0f;
+};
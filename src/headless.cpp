@@ -0,0 +1,733 @@
+#include "headless.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "cpu_renderer.h"
+#include "image_io.h"
+#include "mesh_export.h"
+#include "offline_renderer.h"
+#include "pixel_readback.h"
+#include "render_farm.h"
+#include "render_settings.h"
+#include "settings_io.h"
+#include "shader_log.h"
+#include "timeline.h"
+#include "video_export.h"
+
+static const char *kShaderDir = "../shaders";
+
+static bool parseInt(const char *text, int &out) {
+    char *end = nullptr;
+    long v = std::strtol(text, &end, 10);
+    if (!end || *end != '\0' || v <= 0 || v > (1 << 30)) return false;
+    out = static_cast<int>(v);
+    return true;
+}
+
+static bool endsWith(const std::string &s, const std::string &suffix) {
+    if (s.size() < suffix.size()) return false;
+    return std::equal(suffix.rbegin(), suffix.rend(), s.rbegin(),
+                      [](char a, char b) { return std::tolower(a) == std::tolower(b); });
+}
+
+bool parseCommandLine(int argc, char **argv, HeadlessOptions &options, std::string &error) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&](const char *name) -> const char * {
+            if (i + 1 >= argc) {
+                error = std::string(name) + " needs a value";
+                return nullptr;
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--help" || arg == "-h") {
+            options.help = true;
+        } else if (arg == "--turntable") {
+            options.turntable = true;
+        } else if (arg == "--settings") {
+            const char *v = value("--settings");
+            if (!v) return false;
+            options.settingsFile = v;
+        } else if (arg == "--set") {
+            const char *v = value("--set");
+            if (!v) return false;
+            options.overrides.push_back(v);
+        } else if (arg == "--size") {
+            const char *v = value("--size");
+            if (!v) return false;
+            int w = 0, h = 0;
+            if (std::sscanf(v, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) {
+                error = std::string("bad --size '") + v + "', expected WIDTHxHEIGHT";
+                return false;
+            }
+            options.width  = w;
+            options.height = h;
+        } else if (arg == "--samples" || arg == "--frames" || arg == "--threads" ||
+                   arg == "--tile" || arg == "--cpu-threads" || arg == "--farm-listen" ||
+                   arg == "--farm-timeout" || arg == "--mesh-depth") {
+            const char *v = value(arg.c_str());
+            if (!v) return false;
+            int n = 0;
+            if (!parseInt(v, n)) {
+                error = "bad " + arg + " '" + v + "'";
+                return false;
+            }
+            if (arg == "--samples")          options.samples = n;
+            else if (arg == "--frames")      options.frames = n;
+            else if (arg == "--tile")        options.tileSize = n;
+            else if (arg == "--cpu-threads") options.cpuThreads = n;
+            else if (arg == "--farm-listen") options.farmPort = n;
+            else if (arg == "--farm-timeout") options.farmTimeout = n;
+            else if (arg == "--mesh-depth")   options.meshDepth = n;
+            else                             options.writerThreads = n;
+        } else if (arg == "--fps") {
+            const char *v = value("--fps");
+            if (!v) return false;
+            char *end = nullptr;
+            options.fps = std::strtod(v, &end);
+            if (!end || *end != '\0' || !(options.fps > 0.0 && options.fps <= 1000.0)) {
+                error = std::string("bad --fps '") + v + "'";
+                return false;
+            }
+        } else if (arg == "--timeline" || arg == "--video" || arg == "--ffmpeg" ||
+                   arg == "--mesh") {
+            const char *v = value(arg.c_str());
+            if (!v) return false;
+            if (arg == "--timeline")   options.timelineFile = v;
+            else if (arg == "--video") options.video = v;
+            else if (arg == "--mesh")  options.mesh = v;
+            else                       options.ffmpeg = v;
+        } else if (arg == "--farm-worker") {
+            const char *v = value("--farm-worker");
+            if (!v) return false;
+            options.farmCoordinator = v;
+        } else if (arg == "--output" || arg == "-o") {
+            const char *v = value("--output");
+            if (!v) return false;
+            options.output = v;
+        } else if (arg == "--backend") {
+            const char *v = value("--backend");
+            if (!v) return false;
+            options.backend = v;
+            if (options.backend != "fragment" && options.backend != "compute" &&
+                options.backend != "cpu") {
+                error = "bad --backend '" + options.backend + "'";
+                return false;
+            }
+        } else if (arg == "--cpu-isa") {
+            const char *v = value("--cpu-isa");
+            if (!v) return false;
+            options.cpuIsa = v;
+            if (options.cpuIsa != "auto" && options.cpuIsa != "avx512" &&
+                options.cpuIsa != "avx2" && options.cpuIsa != "scalar") {
+                error = "bad --cpu-isa '" + options.cpuIsa + "'";
+                return false;
+            }
+        } else if (arg == "--context") {
+            const char *v = value("--context");
+            if (!v) return false;
+            options.contextApi = v;
+            if (options.contextApi != "native" && options.contextApi != "egl" &&
+                options.contextApi != "osmesa") {
+                error = "bad --context '" + options.contextApi + "'";
+                return false;
+            }
+        } else {
+            error = "unknown option '" + arg + "'";
+            return false;
+        }
+    }
+    if (options.backend == "cpu" && !options.headless && !options.help) {
+        error = "--backend cpu needs --headless";
+        return false;
+    }
+    if (options.backend == "cpu" && !options.video.empty()) {
+        error = "--video needs a GL backend";
+        return false;
+    }
+    if (options.farmPort > 65535) {
+        error = "bad --farm-listen port";
+        return false;
+    }
+    if ((options.farmPort > 0 || !options.farmCoordinator.empty()) &&
+        (!options.headless || options.backend == "cpu" || !options.video.empty() ||
+         (options.farmPort > 0 && !options.farmCoordinator.empty()))) {
+        error = "--farm-listen or --farm-worker needs --headless, a GL backend and no --video";
+        return false;
+    }
+    if (options.farmPort > 0 && options.tileSize > kFarmMaxTileSize) {
+        error = "bad --tile for --farm-listen, at most " + std::to_string(kFarmMaxTileSize);
+        return false;
+    }
+    if (options.meshDepth > MeshExporter::kMaxDepth) {
+        error = "bad --mesh-depth, at most " + std::to_string(MeshExporter::kMaxDepth);
+        return false;
+    }
+    if (!options.mesh.empty() &&
+        (!options.headless || options.backend == "cpu" || !options.video.empty() ||
+         options.farmPort > 0 || !options.farmCoordinator.empty())) {
+        error = "--mesh needs --headless, a GL backend and no --video or render farm";
+        return false;
+    }
+    return true;
+}
+
+void printUsage(const char *program) {
+    std::cout <<
+        "Usage: " << program << " [--headless [options]]\n"
+        "\n"
+        "Without --headless the interactive viewer starts.\n"
+        "  --backend NAME       fragment or compute raymarching (default fragment);\n"
+        "                       compute needs OpenGL 4.3. Headless: fragment, or\n"
+        "                       cpu to render on the CPU with no GL context\n"
+        "\n"
+        "Headless options:\n"
+        "  --settings FILE      load settings (name = value per line)\n"
+        "  --set NAME=VALUE     override one setting; may repeat\n"
+        "  --size WxH           output resolution (default 1920x1080)\n"
+        "  --samples N          accumulated samples per frame (default 64)\n"
+        "  --frames N           number of frames (default 1)\n"
+        "  --turntable          rotate camYaw one full turn over the frames\n"
+        "  --timeline FILE      animate keyframes ([key TIME MODE] sections of\n"
+        "                       settings); the frame count follows from --fps\n"
+        "  --fps N              timeline / video frame rate (default 30)\n"
+        "  --video PATH         encode the frames into PATH with ffmpeg instead of\n"
+        "                       writing images (.mp4, .mov, .mkv use H.264)\n"
+        "  --ffmpeg PATH        encoder executable (default ffmpeg)\n"
+        "  --output PATTERN     printf-style frame path (default frame_%04d.png);\n"
+        "                       .exr writes linear half-float images\n"
+        "  --context API        native, egl or osmesa (default native)\n"
+        "  --threads N          image encoder threads (default: automatic)\n"
+        "  --tile N             render in NxN tiles, streaming rows of tiles to\n"
+        "                       disk (default: only above 4K or the GPU limit)\n"
+        "  --cpu-threads N      cpu backend render threads (default: all)\n"
+        "  --cpu-isa NAME       cpu backend kernel: auto, avx512, avx2 or scalar\n"
+        "\n"
+        "Render farm:\n"
+        "  --farm-listen PORT   coordinate: hand the frames out as --tile tiles\n"
+        "                       (default 512) to workers and write them; needs no GPU\n"
+        "  --farm-worker H:P    render tiles for the coordinator at host H, port P;\n"
+        "                       takes only --context and is told everything else\n"
+        "  --farm-timeout S     re-issue tiles out for S seconds (default 300)\n"
+        "\n"
+        "Mesh export (OpenGL 4.3):\n"
+        "  --mesh PATH          triangulate the surface into PATH instead of\n"
+        "                       rendering: binary .ply, else .obj\n"
+        "  --mesh-depth N       octree levels, 2^N cells per axis (default 10,\n"
+        "                       at most 16)\n";
+}
+
+std::string framePath(const std::string &pattern, int frame, int frameCount) {
+    // Only a single integer conversion is honoured; the pattern is never
+    // handed to printf itself.
+    size_t pct = pattern.find('%');
+    while (pct != std::string::npos) {
+        size_t end = pct + 1;
+        while (end < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[end]))) end++;
+        if (end < pattern.size() && pattern[end] == 'd') {
+            std::string spec = pattern.substr(pct, end - pct + 1);
+            char number[32];
+            std::snprintf(number, sizeof(number), spec.c_str(), frame);
+            return pattern.substr(0, pct) + number + pattern.substr(end + 1);
+        }
+        pct = pattern.find('%', pct + 1);
+    }
+
+    if (frameCount <= 1) return pattern;
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), "_%04d", frame);
+    size_t dot = pattern.find_last_of('.');
+    size_t slash = pattern.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return pattern + suffix;
+    }
+    return pattern.substr(0, dot) + suffix + pattern.substr(dot);
+}
+
+static void headlessErrorCallback(int code, const char *desc) {
+    std::cerr << "GLFW error (" << code << "): " << desc << std::endl;
+}
+
+GLFWwindow *createHeadlessContext(const std::string &contextApi, bool compute) {
+    glfwSetErrorCallback(headlessErrorCallback);
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW\n";
+        return nullptr;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    if (contextApi == "egl") {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    } else if (contextApi == "osmesa") {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    }
+
+    // Everything renders into FBOs; the window only owns the context.
+    GLFWwindow *window = nullptr;
+    if (compute) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(16, 16, "Mandelbulb (headless)", nullptr, nullptr);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    }
+    if (!window) {
+        window = glfwCreateWindow(16, 16, "Mandelbulb (headless)", nullptr, nullptr);
+    }
+    if (!window) {
+        std::cerr << "Failed to create a " << contextApi << " GL context\n";
+        glfwTerminate();
+        return nullptr;
+    }
+    glfwMakeContextCurrent(window);
+    // Nothing is presented, but keep drivers from pacing us to a display.
+    glfwSwapInterval(0);
+
+    glewExperimental = GL_TRUE;
+    GLenum glewStatus = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLX-built GLEW reports this for EGL/OSMesa contexts after loading
+    // the GL entry points, which is all we need.
+    if (glewStatus == GLEW_ERROR_NO_GLX_DISPLAY) glewStatus = GLEW_OK;
+#endif
+    if (glewStatus != GLEW_OK) {
+        std::cerr << "Failed to initialize GLEW: "
+                  << reinterpret_cast<const char *>(glewGetErrorString(glewStatus))
+                  << std::endl;
+        destroyHeadlessContext(window);
+        return nullptr;
+    }
+    glGetError();
+    return window;
+}
+
+void destroyHeadlessContext(GLFWwindow *window) {
+    if (window) glfwDestroyWindow(window);
+    glfwTerminate();
+}
+
+void flushShaderLog() {
+    for (const ShaderLogEntry &entry : shaderLogEntries()) {
+        (entry.level == ShaderLogLevel::Error ? std::cerr : std::cout) << entry.text << std::endl;
+    }
+    clearShaderLog();
+}
+
+// Images above this many pixels are tiled even when the GPU could take
+// them whole, so no single draw runs long enough to trip a driver
+// watchdog.
+static const long long kTileAbovePixels = 3840LL * 2160;
+static const int kDefaultTileSize = 512;
+
+static int chooseTileSize(const HeadlessOptions &options, int maxDimension) {
+    const int align = OfflineRenderer::kTileAlignment;
+    int tile = options.tileSize;
+    if (tile == 0) {
+        bool fits = options.width <= maxDimension && options.height <= maxDimension;
+        if (fits && static_cast<long long>(options.width) * options.height <= kTileAbovePixels) {
+            return 0;
+        }
+        tile = kDefaultTileSize;
+    }
+    tile = (tile + align - 1) / align * align;
+    return std::min(tile, maxDimension / align * align);
+}
+
+// Renders one frame as rows of tiles, top row first, and streams every
+// finished row to `path` while the next one renders. Only two strips of
+// width x tile pixels are ever held on the CPU, and each draw covers a
+// single tile.
+static bool renderTiledFrame(OfflineRenderer &renderer, const RenderSettings &settings,
+                             const HeadlessOptions &options, int tileSize, bool hdr,
+                             float time, const std::string &path) {
+    const int width = options.width, height = options.height;
+    const Image::Format format = hdr ? Image::RgbaHalf : Image::Rgba8;
+    const size_t pixelBytes = hdr ? 8 : 4;
+    const std::ptrdiff_t stride = static_cast<std::ptrdiff_t>(width) * pixelBytes;
+
+    ImageStreamWriter writer;
+    if (!writer.open(path, width, height, format)) return false;
+
+    PixelReadback readback;
+    std::vector<uint8_t> strips[2];
+    int current = 0;
+    std::future<bool> encoding;
+    bool ok = true;
+
+    // Tiles come back bottom-up; strips are stored top-down for the
+    // writer, so each tile row lands at its mirrored strip row.
+    auto place = [&](std::vector<uint8_t> &strip, int rows, bool wait) {
+        for (PixelReadback::Result &r : readback.collect(wait)) {
+            const Image &tile = r.image;
+            size_t rowBytes = static_cast<size_t>(tile.width) * pixelBytes;
+            for (int y = 0; y < tile.height; y++) {
+                std::memcpy(strip.data() + (rows - 1 - y) * stride + r.tag * pixelBytes,
+                            tile.pixels.data() + y * rowBytes, rowBytes);
+            }
+        }
+    };
+
+    // Strip origins are multiples of the tile size counted from the
+    // bottom, which keeps every tile on the prepass grid; the top strip
+    // takes the remainder.
+    const int stripCount = (height + tileSize - 1) / tileSize;
+    for (int k = stripCount - 1; k >= 0 && ok; k--) {
+        const int y0 = k * tileSize;
+        const int rows = std::min(tileSize, height - y0);
+        std::vector<uint8_t> &strip = strips[current];
+        strip.resize(static_cast<size_t>(rows) * stride);
+
+        for (int x0 = 0; x0 < width && ok; x0 += tileSize) {
+            TileRect tile;
+            tile.x = x0;
+            tile.y = y0;
+            tile.width  = std::min(tileSize, width - x0);
+            tile.height = rows;
+            if (!renderer.renderTile(settings, width, height, tile, options.samples, time) ||
+                (!hdr && !renderer.resolve())) {
+                std::cerr << "Failed to allocate render targets" << std::endl;
+                ok = false;
+                break;
+            }
+            const RenderTarget &source = hdr ? renderer.linear() : renderer.resolved();
+            readback.start(source.fbo, GL_COLOR_ATTACHMENT0, source.width, source.height,
+                           format, x0);
+            place(strip, rows, false);
+        }
+        if (!ok) break;
+        place(strip, rows, true);
+        flushShaderLog();
+
+        // The writer keeps deflate state between strips, so strips are
+        // encoded strictly in order: one in flight at a time.
+        if (encoding.valid() && !encoding.get()) {
+            ok = false;
+            break;
+        }
+        encoding = std::async(std::launch::async, [&writer, &strip, rows, stride] {
+            return writer.writeRows(strip.data(), rows, stride);
+        });
+        current = 1 - current;
+
+        std::printf("  rows %d-%d of %d\n", height - y0 - rows, height - y0 - 1, height);
+        std::fflush(stdout);
+    }
+    if (encoding.valid()) ok = encoding.get() && ok;
+    readback.destroy();
+
+    ok = writer.close() && ok;
+    if (!ok) std::cerr << "Failed to write " << path << std::endl;
+    return ok;
+}
+
+// What the frames show: the --timeline file, or the settings held still or
+// turned once around (--turntable) over --frames. Frame i is at i / fps.
+static bool headlessTimeline(const HeadlessOptions &options, const RenderSettings &settings,
+                             Timeline &timeline, int &frames, std::string &error) {
+    if (!options.timelineFile.empty()) {
+        if (!loadTimeline(options.timelineFile, settings, timeline, &error)) return false;
+        if (timeline.empty()) {
+            error = options.timelineFile + " has no keys";
+            return false;
+        }
+        frames = timelineFrameCount(timeline, options.fps);
+        return true;
+    }
+
+    frames = options.frames;
+    timeline.setKey(0.0, settings, Interpolation::Linear);
+    if (options.turntable) {
+        // The last key is one frame past the end, which would repeat the first.
+        RenderSettings turned = settings;
+        turned.camYaw += 6.283185307179586;
+        timeline.setKey(frames / options.fps, turned, Interpolation::Linear);
+    }
+    return true;
+}
+
+// The cpu backend: the same frames and files as the GPU path below, with
+// no GL context. Whole frames are held in memory, so --tile is ignored.
+static int runCpuHeadless(const HeadlessOptions &options, const Timeline &timeline, int frames) {
+    CpuRenderer renderer(options.cpuThreads);
+    if (!renderer.init(options.cpuIsa)) {
+        std::cerr << "CPU kernel '" << options.cpuIsa << "' is unavailable on this machine\n";
+        return 1;
+    }
+    std::printf("CPU renderer: %s kernel (%d rays per packet), %d threads\n",
+                renderer.kernel().name, renderer.kernel().lanes, renderer.threads());
+    if (timeline.keys().front().settings.deepZoom != 0) {
+        std::cout << "Deep zoom isn't supported by the cpu backend; marching in float\n";
+    }
+
+    bool hdr = endsWith(options.output, ".exr");
+    ImageWriterPool writers(options.writerThreads);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+        RenderSettings settings = timeline.evaluate(frame / options.fps, RenderSettings());
+
+        auto frameStart = std::chrono::steady_clock::now();
+        renderer.render(settings, options.width, options.height, options.samples);
+        writers.submit(framePath(options.output, frame, frames),
+                       renderer.image(hdr ? Image::RgbaHalf : Image::Rgba8));
+
+        std::chrono::duration<double, std::milli> ms =
+            std::chrono::steady_clock::now() - frameStart;
+        std::printf("frame %d/%d rendered (%.1f ms)\n", frame + 1, frames, ms.count());
+        std::fflush(stdout);
+    }
+    writers.wait();
+
+    std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+    std::printf("%d frame(s) written, %d failed, %.2f s\n", writers.written(),
+                writers.failures(), total.count());
+    return writers.failures() > 0 ? 1 : 0;
+}
+
+// --video: the frames go through the readback ring straight into ffmpeg.
+// They are rendered whole, so --tile is ignored.
+static int encodeVideo(const HeadlessOptions &options, const Timeline &timeline, int frames) {
+    VideoExportOptions video;
+    video.path    = options.video;
+    video.width   = options.width;
+    video.height  = options.height;
+    video.fps     = options.fps;
+    video.samples = options.samples;
+    video.frames  = frames;
+    video.ffmpeg  = options.ffmpeg;
+
+    VideoExport exporter(kShaderDir);
+    std::string error;
+    if (!exporter.start(timeline, video, &error)) {
+        flushShaderLog();
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    flushShaderLog();
+
+    auto start = std::chrono::steady_clock::now();
+    for (bool more = true; more;) {
+        more = exporter.step();
+        std::printf("frame %d/%d submitted\n", exporter.frame(), exporter.frameCount());
+        std::fflush(stdout);
+        flushShaderLog();
+    }
+    bool ok = exporter.finish();
+    flushShaderLog();
+
+    std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+    if (ok) {
+        std::printf("%d frame(s) encoded into %s, %.2f s\n", exporter.frameCount(),
+                    options.video.c_str(), total.count());
+    } else {
+        std::cerr << "Failed to encode " << options.video << std::endl;
+    }
+    return ok ? 0 : 1;
+}
+
+// --mesh: the surface of the first frame's settings, streamed to disk.
+static int exportMesh(const HeadlessOptions &options, const RenderSettings &settings) {
+    if (!MeshExporter::supported()) {
+        std::cerr << "Mesh export needs OpenGL 4.3" << std::endl;
+        return 1;
+    }
+    ProgramCache programs;
+    MeshExporter exporter(programs, std::string(kShaderDir) + "/mesh_extract.comp");
+    if (!exporter.init()) {
+        flushShaderLog();
+        exporter.destroy();
+        programs.clear();
+        return 1;
+    }
+    flushShaderLog();
+
+    MeshWriter writer;
+    if (!writer.open(options.mesh)) {
+        std::cerr << "Failed to open " << options.mesh << std::endl;
+        exporter.destroy();
+        programs.clear();
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool ok = exporter.extract(settings, options.meshDepth, writer);
+    ok = writer.close() && ok;
+    flushShaderLog();
+    exporter.destroy();
+    programs.clear();
+
+    std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+    const MeshStats &stats = exporter.stats();
+    if (!ok) {
+        std::cerr << "Failed to write " << options.mesh << std::endl;
+        return 1;
+    }
+    std::printf("%llu triangles, %llu vertices from %llu of %llu^3 leaves written to %s, "
+                "%.2f s (%.0f MB of GPU buffers, %zu open seam edges at most)\n",
+                static_cast<unsigned long long>(stats.triangles),
+                static_cast<unsigned long long>(stats.vertices),
+                static_cast<unsigned long long>(stats.leaves), 1ull << options.meshDepth,
+                options.mesh.c_str(), total.count(), stats.gpuBytes / 1048576.0,
+                stats.openEdges);
+    if (stats.unmerged > 0) {
+        std::printf("warning: %llu seam vertices past %zu open edges were not merged; "
+                    "weld the mesh before printing\n",
+                    static_cast<unsigned long long>(stats.unmerged), MeshExporter::kMaxOpenEdges);
+    }
+    return 0;
+}
+
+int runHeadless(const HeadlessOptions &options) {
+    RenderSettings settings;
+    std::string error;
+    if (!options.settingsFile.empty() &&
+        !loadSettingsFile(options.settingsFile, settings, &error)) {
+        std::cerr << error << std::endl;
+        return 2;
+    }
+    for (const std::string &assignment : options.overrides) {
+        if (!applySettingAssignment(settings, assignment, &error)) {
+            std::cerr << error << std::endl;
+            return 2;
+        }
+    }
+    Timeline timeline;
+    int frames = 0;
+    if (!headlessTimeline(options, settings, timeline, frames, error)) {
+        std::cerr << error << std::endl;
+        return 2;
+    }
+    if (options.backend == "cpu") {
+        return runCpuHeadless(options, timeline, frames);
+    }
+    if (options.farmPort > 0) {
+        int tile = options.tileSize > 0 ? options.tileSize : kDefaultTileSize;
+        const int align = OfflineRenderer::kTileAlignment;
+        return runFarmCoordinator(options, timeline, frames, (tile + align - 1) / align * align);
+    }
+
+    // ------------- hidden window / offscreen context ------------ //
+    GLFWwindow *window = createHeadlessContext(options.contextApi, !options.mesh.empty());
+    if (!window) return 1;
+
+    std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
+
+    if (!options.video.empty()) {
+        int exitCode = encodeVideo(options, timeline, frames);
+        destroyHeadlessContext(window);
+        return exitCode;
+    }
+    if (!options.farmCoordinator.empty()) {
+        int exitCode = runFarmWorker(options, kShaderDir);
+        destroyHeadlessContext(window);
+        return exitCode;
+    }
+    if (!options.mesh.empty()) {
+        int exitCode = exportMesh(options, timeline.evaluate(0.0, settings));
+        destroyHeadlessContext(window);
+        return exitCode;
+    }
+
+    int exitCode = 0;
+    {
+        OfflineRenderer renderer(kShaderDir);
+        if (!renderer.init()) {
+            flushShaderLog();
+            renderer.shutdown();
+            destroyHeadlessContext(window);
+            return 1;
+        }
+        flushShaderLog();
+
+        const int tileSize = chooseTileSize(options, renderer.maxDimension());
+        if (tileSize > 0) {
+            std::printf("Rendering %dx%d in %dx%d tiles\n", options.width, options.height,
+                        tileSize, tileSize);
+        }
+
+        bool hdr = endsWith(options.output, ".exr");
+        ImageWriterPool writers(options.writerThreads);
+        PixelReadback readback;
+
+        auto submitFinished = [&](bool wait) {
+            for (PixelReadback::Result &r : readback.collect(wait)) {
+                writers.submit(framePath(options.output, r.tag, frames), std::move(r.image));
+            }
+        };
+
+        int tiledWritten = 0, tiledFailed = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++) {
+            settings = timeline.evaluate(frame / options.fps, settings);
+
+            auto frameStart = std::chrono::steady_clock::now();
+            float time = static_cast<float>(frame / options.fps);
+            if (tileSize > 0) {
+                // Tiled frames are encoded while they render, so they skip
+                // the readback ring and writer pool.
+                std::string path = framePath(options.output, frame, frames);
+                if (renderTiledFrame(renderer, settings, options, tileSize, hdr, time, path)) {
+                    tiledWritten++;
+                } else {
+                    tiledFailed++;
+                }
+                std::chrono::duration<double, std::milli> ms =
+                    std::chrono::steady_clock::now() - frameStart;
+                std::printf("frame %d/%d written (%.1f ms)\n", frame + 1, frames, ms.count());
+                std::fflush(stdout);
+                continue;
+            }
+            if (!renderer.render(settings, options.width, options.height, options.samples, time) ||
+                (!hdr && !renderer.resolve())) {
+                std::cerr << "Failed to allocate render targets" << std::endl;
+                exitCode = 1;
+                break;
+            }
+
+            // The read is queued behind this frame's draws; the previous
+            // frames' pixels are picked up once their fences signal.
+            const RenderTarget &source = hdr ? renderer.linear() : renderer.resolved();
+            readback.start(source.fbo, GL_COLOR_ATTACHMENT0, source.width, source.height,
+                           hdr ? Image::RgbaHalf : Image::Rgba8, frame);
+            submitFinished(false);
+            flushShaderLog();
+
+            std::chrono::duration<double, std::milli> ms =
+                std::chrono::steady_clock::now() - frameStart;
+            std::printf("frame %d/%d submitted (%.1f ms CPU)\n", frame + 1, frames, ms.count());
+            std::fflush(stdout);
+        }
+        submitFinished(true);
+        writers.wait();
+
+        std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+        std::printf("%d frame(s) written, %d failed, %.2f s\n",
+                    writers.written() + tiledWritten, writers.failures() + tiledFailed,
+                    total.count());
+        if (writers.failures() + tiledFailed > 0) exitCode = 1;
+
+        readback.destroy();
+        renderer.shutdown();
+    }
+
+    destroyHeadlessContext(window);
+    return exitCode;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct GLFWwindow;
+
+// ------------------------- headless rendering ---------------------- //
+
+// Command-line driven batch rendering with no visible window and no UI.
+struct HeadlessOptions {
+    bool headless = false;
+    bool help     = false;
+
+    std::string settingsFile;            // --settings
+    std::vector<std::string> overrides;  // --set name=value, applied in order
+
+    int width   = 1920;
+    int height  = 1080;
+    int samples = 64;     // accumulated samples per frame
+    int frames  = 1;
+    bool turntable = false;   // one full camYaw revolution over the frames
+
+    // Keyframes to animate (loadTimeline), starting from the settings
+    // above; the frame count then follows from its length and fps.
+    std::string timelineFile;   // --timeline
+    double fps = 30.0;
+
+    // Encode the frames into this video through ffmpeg instead of
+    // writing images.
+    std::string video;          // --video
+    std::string ffmpeg = "ffmpeg";
+
+    // printf-style frame number ("%04d"); .exr writes linear half floats,
+    // anything else PNG.
+    std::string output = "frame_%04d.png";
+
+    std::string contextApi = "native";   // native | egl | osmesa
+    int writerThreads = 0;               // 0 = automatic
+
+    // Tile edge in pixels for tiled rendering; 0 tiles automatically only
+    // when the image is larger than 4K or the GPU's size limit. Tiled
+    // frames stream to disk one row of tiles at a time.
+    int tileSize = 0;
+
+    // Interactive viewer: fragment | compute (falls back to fragment
+    // without GL 4.3). Headless: fragment, or cpu to render without GL
+    // at all (CpuRenderer).
+    std::string backend = "fragment";
+
+    int cpuThreads = 0;            // cpu backend render threads, 0 = all
+    std::string cpuIsa = "auto";   // auto | avx512 | avx2 | scalar
+
+    // Render farm (render_farm.h): serve the frames as tiles to workers
+    // on this port, or be a worker of the coordinator at HOST:PORT. A tile
+    // out for longer than farmTimeout seconds is re-issued.
+    int farmPort = 0;              // --farm-listen
+    std::string farmCoordinator;   // --farm-worker
+    int farmTimeout = 300;         // --farm-timeout
+
+    // Triangulate the surface into this .ply or .obj (MeshExporter)
+    // instead of rendering, on an octree of meshDepth levels.
+    std::string mesh;              // --mesh
+    int meshDepth = 10;            // --mesh-depth
+};
+
+// Fills `options` from argv. Returns false with a message on bad input.
+bool parseCommandLine(int argc, char **argv, HeadlessOptions &options, std::string &error);
+void printUsage(const char *program);
+
+// Output path for a frame: substitutes the first %d / %0Nd in the
+// pattern, or appends _NNNN before the extension when there are several
+// frames and no placeholder.
+std::string framePath(const std::string &pattern, int frame, int frameCount);
+
+// A hidden window whose GL 3.3 core context is current, with GLEW
+// loaded and vsync off; `contextApi` as HeadlessOptions::contextApi.
+// `compute` asks for 4.3 first. Null on failure, after printing why.
+GLFWwindow *createHeadlessContext(const std::string &contextApi, bool compute = false);
+// Destroys the window and shuts GLFW down.
+void destroyHeadlessContext(GLFWwindow *window);
+
+// Prints and clears the shader log: errors to stderr, the rest to stdout.
+void flushShaderLog();
+
+// Creates its own hidden context; returns the process exit code.
+int runHeadless(const HeadlessOptions &options);
@@ -0,0 +1,605 @@
+#include "image_io.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// ------------------------------ checksums -------------------------- //
+
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t size) {
+    static uint32_t table[256];
+    static bool ready = [] {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        return true;
+    }();
+    (void)ready;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+void adler32Update(uint32_t &a, uint32_t &b, const uint8_t *data, size_t size) {
+    // 5552 is the largest run that can't overflow before the modulo.
+    while (size > 0) {
+        size_t n = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < n; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521u;
+        b %= 65521u;
+        data += n;
+        size -= n;
+    }
+}
+
+void putBE32(uint8_t *p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+// -------------------------------- deflate -------------------------- //
+
+const uint16_t kLengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27,
+                                  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                  2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t kDistBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                6145, 8193, 12289, 16385, 24577};
+const uint8_t kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+constexpr int kWindow   = 32768;
+constexpr int kMinMatch = 3;
+constexpr int kMaxMatch = 258;
+constexpr int kMaxChain = 48;
+constexpr int kHashBits = 15;
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t> &out) : out_(out) {}
+
+    void bits(uint32_t value, int count) {
+        acc_ |= value << used_;
+        used_ += count;
+        while (used_ >= 8) {
+            out_.push_back(static_cast<uint8_t>(acc_));
+            acc_ >>= 8;
+            used_ -= 8;
+        }
+    }
+
+    // Huffman codes are defined MSB-first but packed LSB-first.
+    void code(uint32_t value, int count) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < count; i++) reversed |= ((value >> i) & 1u) << (count - 1 - i);
+        bits(reversed, count);
+    }
+
+    void flush() {
+        if (used_ > 0) out_.push_back(static_cast<uint8_t>(acc_));
+        acc_ = 0;
+        used_ = 0;
+    }
+
+    // A BitWriter may be rebuilt around a new output buffer between
+    // blocks; these carry the partial byte across.
+    uint32_t pending() const { return acc_; }
+    int      pendingBits() const { return used_; }
+    void     restore(uint32_t acc, int used) { acc_ = acc; used_ = used; }
+
+private:
+    std::vector<uint8_t> &out_;
+    uint32_t acc_  = 0;
+    int      used_ = 0;
+};
+
+void putLiteral(BitWriter &bw, int v) {
+    if (v < 144)      bw.code(0x30 + v, 8);
+    else if (v < 256) bw.code(0x190 + (v - 144), 9);
+    else if (v < 280) bw.code(v - 256, 7);
+    else              bw.code(0xC0 + (v - 280), 8);
+}
+
+void putMatch(BitWriter &bw, int length, int distance) {
+    int lc = 0;
+    while (lc < 28 && kLengthBase[lc + 1] <= length) lc++;
+    putLiteral(bw, 257 + lc);
+    if (kLengthExtra[lc]) bw.bits(length - kLengthBase[lc], kLengthExtra[lc]);
+
+    int dc = 0;
+    while (dc < 29 && kDistBase[dc + 1] <= distance) dc++;
+    bw.code(dc, 5);
+    if (kDistExtra[dc]) bw.bits(distance - kDistBase[dc], kDistExtra[dc]);
+}
+
+} // namespace
+
+// Streaming zlib encoder: LZ77 over a 32 KiB window with hash chains and
+// the fixed Huffman code. The window carries over between compress()
+// calls so matches can span strips.
+struct PngWriter::Deflater {
+    std::vector<uint8_t> window;   // history (<= kWindow) + current input
+    uint32_t adlerA = 1, adlerB = 0;
+    uint32_t bitAcc = 0;
+    int      bitUsed = 0;
+    bool     headerDone = false;
+
+    static uint32_t hash3(const uint8_t *p) {
+        uint32_t v = (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2];
+        return (v * 2654435761u) >> (32 - kHashBits);
+    }
+
+    void compress(const uint8_t *data, size_t size, bool final, std::vector<uint8_t> &out) {
+        BitWriter bw(out);
+        bw.restore(bitAcc, bitUsed);
+        if (!headerDone) {
+            out.push_back(0x78);   // deflate, 32 KiB window
+            out.push_back(0x01);   // fastest-level hint, no dictionary
+            headerDone = true;
+        }
+
+        adler32Update(adlerA, adlerB, data, size);
+
+        size_t history = window.size();
+        window.insert(window.end(), data, data + size);
+        const uint8_t *buf = window.data();
+        size_t end = window.size();
+
+        std::vector<int> head(size_t(1) << kHashBits, -1);
+        std::vector<int> prev(end, -1);
+        auto insert = [&](size_t pos) {
+            if (pos + kMinMatch > end) return;
+            uint32_t h = hash3(buf + pos);
+            prev[pos] = head[h];
+            head[h] = static_cast<int>(pos);
+        };
+        for (size_t pos = 0; pos < history; pos++) insert(pos);
+
+        bw.bits(final ? 1 : 0, 1);
+        bw.bits(1, 2);   // fixed Huffman
+
+        size_t pos = history;
+        while (pos < end) {
+            int bestLen = 0, bestDist = 0;
+            if (pos + kMinMatch <= end) {
+                int limit = static_cast<int>(std::min<size_t>(kMaxMatch, end - pos));
+                int candidate = head[hash3(buf + pos)];
+                for (int chain = 0; candidate >= 0 && chain < kMaxChain; chain++) {
+                    int dist = static_cast<int>(pos) - candidate;
+                    if (dist > kWindow) break;
+                    int len = 0;
+                    while (len < limit && buf[candidate + len] == buf[pos + len]) len++;
+                    if (len > bestLen) {
+                        bestLen  = len;
+                        bestDist = dist;
+                        if (len == limit) break;
+                    }
+                    candidate = prev[candidate];
+                }
+            }
+
+            if (bestLen >= kMinMatch) {
+                putMatch(bw, bestLen, bestDist);
+                for (int i = 0; i < bestLen; i++) insert(pos + i);
+                pos += bestLen;
+            } else {
+                putLiteral(bw, buf[pos]);
+                insert(pos);
+                pos++;
+            }
+        }
+        putLiteral(bw, 256);   // end of block
+
+        if (final) {
+            bw.flush();
+            uint8_t adler[4];
+            putBE32(adler, (adlerB << 16) | adlerA);
+            out.insert(out.end(), adler, adler + 4);
+        }
+        bitAcc  = bw.pending();
+        bitUsed = bw.pendingBits();
+
+        if (window.size() > static_cast<size_t>(kWindow)) {
+            window.erase(window.begin(), window.end() - kWindow);
+        }
+    }
+};
+
+// ------------------------------ PngWriter -------------------------- //
+
+PngWriter::PngWriter() = default;
+
+PngWriter::~PngWriter() {
+    delete deflater_;
+}
+
+bool PngWriter::writeChunk(const char type[4], const uint8_t *data, size_t size) {
+    uint8_t header[8];
+    putBE32(header, static_cast<uint32_t>(size));
+    std::memcpy(header + 4, type, 4);
+    uint32_t crc = crc32Update(0, header + 4, 4);
+    crc = crc32Update(crc, data, size);
+    uint8_t trailer[4];
+    putBE32(trailer, crc);
+
+    file_.write(reinterpret_cast<const char *>(header), 8);
+    if (size) file_.write(reinterpret_cast<const char *>(data), size);
+    file_.write(reinterpret_cast<const char *>(trailer), 4);
+    return static_cast<bool>(file_);
+}
+
+bool PngWriter::open(const std::string &path, int width, int height, int channels) {
+    if (width <= 0 || height <= 0 || (channels != 3 && channels != 4)) return false;
+
+    file_.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file_) {
+        std::cerr << "Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    width_ = width;
+    height_ = height;
+    channels_ = channels;
+    rowsWritten_ = 0;
+    prevRow_.assign(static_cast<size_t>(width) * channels, 0);
+    delete deflater_;
+    deflater_ = new Deflater();
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    file_.write(reinterpret_cast<const char *>(signature), 8);
+
+    uint8_t ihdr[13];
+    putBE32(ihdr, static_cast<uint32_t>(width));
+    putBE32(ihdr + 4, static_cast<uint32_t>(height));
+    ihdr[8]  = 8;                        // bit depth
+    ihdr[9]  = channels == 4 ? 6 : 2;    // RGBA / RGB
+    ihdr[10] = 0;                        // deflate
+    ihdr[11] = 0;                        // adaptive filtering
+    ihdr[12] = 0;                        // no interlace
+    ok_ = writeChunk("IHDR", ihdr, sizeof(ihdr));
+    return ok_;
+}
+
+bool PngWriter::writeRows(const uint8_t *firstRow, int rows, std::ptrdiff_t stride) {
+    if (!ok_ || rowsWritten_ + rows > height_) return false;
+
+    const size_t rowBytes = static_cast<size_t>(width_) * channels_;
+    const int bpp = channels_;
+    filtered_.resize((rowBytes + 1) * rows);
+    std::vector<uint8_t> candidate(rowBytes);
+
+    for (int r = 0; r < rows; r++) {
+        const uint8_t *row = firstRow + r * stride;
+        const uint8_t *up  = prevRow_.data();
+        uint8_t *dst = filtered_.data() + r * (rowBytes + 1);
+
+        // Try None, Sub, Up and Paeth; keep the one with the smallest sum
+        // of absolute (signed) residuals, the usual heuristic.
+        int bestFilter = 0;
+        long bestScore = -1;
+        for (int filter : {0, 1, 2, 4}) {
+            long score = 0;
+            for (size_t i = 0; i < rowBytes; i++) {
+                int a = i >= static_cast<size_t>(bpp) ? row[i - bpp] : 0;
+                int b = up[i];
+                int c = i >= static_cast<size_t>(bpp) ? up[i - bpp] : 0;
+                int predicted = 0;
+                switch (filter) {
+                case 1: predicted = a; break;
+                case 2: predicted = b; break;
+                case 4: {
+                    int p = a + b - c;
+                    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                    predicted = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                    break;
+                }
+                default: break;
+                }
+                uint8_t v = static_cast<uint8_t>(row[i] - predicted);
+                candidate[i] = v;
+                score += v < 128 ? v : 256 - v;
+            }
+            if (bestScore < 0 || score < bestScore) {
+                bestScore  = score;
+                bestFilter = filter;
+                std::memcpy(dst + 1, candidate.data(), rowBytes);
+            }
+        }
+        dst[0] = static_cast<uint8_t>(bestFilter);
+        std::memcpy(prevRow_.data(), row, rowBytes);
+    }
+
+    std::vector<uint8_t> compressed;
+    deflater_->compress(filtered_.data(), filtered_.size(), false, compressed);
+    rowsWritten_ += rows;
+    ok_ = compressed.empty() || writeChunk("IDAT", compressed.data(), compressed.size());
+    return ok_;
+}
+
+bool PngWriter::close() {
+    if (!file_.is_open()) return false;
+
+    bool complete = ok_ && rowsWritten_ == height_;
+    if (complete) {
+        std::vector<uint8_t> tail;
+        deflater_->compress(nullptr, 0, true, tail);
+        complete = writeChunk("IDAT", tail.data(), tail.size()) &&
+                   writeChunk("IEND", nullptr, 0);
+    }
+    file_.close();
+    ok_ = false;
+    return complete && !file_.fail();
+}
+
+bool writePng(const std::string &path, int width, int height, int channels,
+              const uint8_t *firstRow, std::ptrdiff_t stride) {
+    PngWriter png;
+    if (!png.open(path, width, height, channels)) return false;
+    // Strips keep the filter scratch buffer small for big images.
+    const int strip = 64;
+    for (int y = 0; y < height; y += strip) {
+        int rows = std::min(strip, height - y);
+        if (!png.writeRows(firstRow + y * stride, rows, stride)) {
+            png.close();
+            return false;
+        }
+    }
+    return png.close();
+}
+
+// ------------------------------- EXR ------------------------------- //
+
+namespace {
+
+void putLE32(std::string &out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void putLE64(std::string &out, uint64_t v) {
+    for (int i = 0; i < 8; i++) out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void putFloat(std::string &out, float f) {
+    uint32_t v;
+    std::memcpy(&v, &f, 4);
+    putLE32(out, v);
+}
+
+void putAttribute(std::string &out, const char *name, const char *type,
+                  const std::string &value) {
+    out += name;
+    out.push_back('\0');
+    out += type;
+    out.push_back('\0');
+    putLE32(out, static_cast<uint32_t>(value.size()));
+    out += value;
+}
+
+// Channels are stored in alphabetical order, each as one run per line.
+const char kExrChannelNames[4] = {'A', 'B', 'G', 'R'};
+const int  kExrSourceIndex[4]  = {3, 2, 1, 0};
+
+} // namespace
+
+// ------------------------------ ExrWriter -------------------------- //
+
+bool ExrWriter::open(const std::string &path, int width, int height) {
+    if (width <= 0 || height <= 0) return false;
+
+    std::string header;
+    putLE32(header, 20000630u);   // magic
+    putLE32(header, 2u);          // version 2, scanline
+
+    std::string channels;
+    for (char name : kExrChannelNames) {
+        channels.push_back(name);
+        channels.push_back('\0');
+        putLE32(channels, 1u);    // HALF
+        putLE32(channels, 0u);    // pLinear + reserved
+        putLE32(channels, 1u);    // x sampling
+        putLE32(channels, 1u);    // y sampling
+    }
+    channels.push_back('\0');
+    putAttribute(header, "channels", "chlist", channels);
+    putAttribute(header, "compression", "compression", std::string(1, '\0'));
+
+    std::string window;
+    putLE32(window, 0);
+    putLE32(window, 0);
+    putLE32(window, static_cast<uint32_t>(width - 1));
+    putLE32(window, static_cast<uint32_t>(height - 1));
+    putAttribute(header, "dataWindow", "box2i", window);
+    putAttribute(header, "displayWindow", "box2i", window);
+    putAttribute(header, "lineOrder", "lineOrder", std::string(1, '\0'));
+
+    std::string aspect, center, screenWidth;
+    putFloat(aspect, 1.0f);
+    putFloat(center, 0.0f);
+    putFloat(center, 0.0f);
+    putFloat(screenWidth, 1.0f);
+    putAttribute(header, "pixelAspectRatio", "float", aspect);
+    putAttribute(header, "screenWindowCenter", "v2f", center);
+    putAttribute(header, "screenWindowWidth", "float", screenWidth);
+    header.push_back('\0');
+
+    // Uncompressed lines all have the same size, so the offset table can
+    // be written up front and the lines streamed after it.
+    const uint64_t lineBytes = 8 + static_cast<uint64_t>(width) * 4 * 2;
+    const uint64_t firstLine = header.size() + static_cast<uint64_t>(height) * 8;
+    for (int y = 0; y < height; y++) putLE64(header, firstLine + y * lineBytes);
+
+    file_.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file_) {
+        std::cerr << "Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    width_ = width;
+    height_ = height;
+    rowsWritten_ = 0;
+    file_.write(header.data(), header.size());
+    ok_ = static_cast<bool>(file_);
+    return ok_;
+}
+
+bool ExrWriter::writeRows(const uint16_t *firstRow, int rows, std::ptrdiff_t stride) {
+    if (!ok_ || rowsWritten_ + rows > height_) return false;
+
+    for (int r = 0; r < rows; r++) {
+        const uint16_t *row = firstRow + r * stride;
+        line_.clear();
+        putLE32(line_, static_cast<uint32_t>(rowsWritten_ + r));
+        putLE32(line_, static_cast<uint32_t>(width_ * 4 * 2));
+        for (int c = 0; c < 4; c++) {
+            for (int x = 0; x < width_; x++) {
+                uint16_t h = row[x * 4 + kExrSourceIndex[c]];
+                line_.push_back(static_cast<char>(h & 0xFF));
+                line_.push_back(static_cast<char>(h >> 8));
+            }
+        }
+        file_.write(line_.data(), line_.size());
+    }
+    rowsWritten_ += rows;
+    ok_ = static_cast<bool>(file_);
+    return ok_;
+}
+
+bool ExrWriter::close() {
+    if (!file_.is_open()) return false;
+
+    bool complete = ok_ && rowsWritten_ == height_;
+    file_.close();
+    ok_ = false;
+    return complete && !file_.fail();
+}
+
+bool writeExrHalf(const std::string &path, int width, int height,
+                  const uint16_t *firstRow, std::ptrdiff_t stride) {
+    ExrWriter exr;
+    if (!exr.open(path, width, height)) return false;
+    if (!exr.writeRows(firstRow, height, stride)) {
+        exr.close();
+        return false;
+    }
+    return exr.close();
+}
+
+// --------------------------- ImageStreamWriter --------------------- //
+
+bool ImageStreamWriter::open(const std::string &path, int width, int height,
+                             Image::Format format) {
+    format_ = format;
+    return format == Image::RgbaHalf ? exr_.open(path, width, height)
+                                     : png_.open(path, width, height, 4);
+}
+
+bool ImageStreamWriter::writeRows(const uint8_t *firstRow, int rows, std::ptrdiff_t stride) {
+    if (format_ == Image::RgbaHalf) {
+        return exr_.writeRows(reinterpret_cast<const uint16_t *>(firstRow), rows,
+                              stride / static_cast<std::ptrdiff_t>(sizeof(uint16_t)));
+    }
+    return png_.writeRows(firstRow, rows, stride);
+}
+
+bool ImageStreamWriter::close() {
+    return format_ == Image::RgbaHalf ? exr_.close() : png_.close();
+}
+
+int ImageStreamWriter::rowsWritten() const {
+    return format_ == Image::RgbaHalf ? exr_.rowsWritten() : png_.rowsWritten();
+}
+
+// ---------------------------- writer pool -------------------------- //
+
+bool writeImage(const std::string &path, const Image &image) {
+    if (image.width <= 0 || image.height <= 0) return false;
+
+    // Bottom-up rows: start at the last one and step backwards.
+    if (image.format == Image::RgbaHalf) {
+        const uint16_t *pixels = reinterpret_cast<const uint16_t *>(image.pixels.data());
+        std::ptrdiff_t stride = static_cast<std::ptrdiff_t>(image.width) * 4;
+        return writeExrHalf(path, image.width, image.height,
+                            pixels + (image.height - 1) * stride, -stride);
+    }
+    std::ptrdiff_t stride = static_cast<std::ptrdiff_t>(image.width) * 4;
+    return writePng(path, image.width, image.height, 4,
+                    image.pixels.data() + (image.height - 1) * stride, -stride);
+}
+
+ImageWriterPool::ImageWriterPool(int threads, int maxQueued)
+    : maxQueued_(std::max(1, maxQueued)) {
+    if (threads <= 0) {
+        threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 2);
+    }
+    for (int i = 0; i < threads; i++) {
+        workers_.emplace_back(&ImageWriterPool::workerLoop, this);
+    }
+}
+
+ImageWriterPool::~ImageWriterPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    hasWork_.notify_all();
+    for (std::thread &t : workers_) t.join();
+}
+
+void ImageWriterPool::submit(std::string path, Image image) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    hasRoom_.wait(lock, [this] { return static_cast<int>(queue_.size()) < maxQueued_; });
+    queue_.push_back(Job{std::move(path), std::move(image)});
+    lock.unlock();
+    hasWork_.notify_one();
+}
+
+void ImageWriterPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return queue_.empty() && busy_ == 0; });
+}
+
+int ImageWriterPool::written() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_;
+}
+
+int ImageWriterPool::failures() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failures_;
+}
+
+void ImageWriterPool::workerLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            hasWork_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) return;   // stopping
+            job = std::move(queue_.front());
+            queue_.pop_front();
+            busy_++;
+        }
+        hasRoom_.notify_one();
+
+        bool ok = writeImage(job.path, job.image);
+        if (!ok) std::cerr << "Failed to write " << job.path << std::endl;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy_--;
+            (ok ? written_ : failures_)++;
+        }
+        idle_.notify_all();
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ---------------------------- PNG output --------------------------- //
+
+// Streams an 8-bit RGB(A) PNG: rows go in top to bottom over any number of
+// writeRows() calls and are filtered and deflated as they arrive, each call
+// becoming one IDAT chunk. Only the deflate window and the previous row are
+// kept, so images far larger than memory can be written strip by strip.
+// `stride` is the byte step between rows and may be negative, which lets a
+// bottom-up glReadPixels buffer go in without a flip.
+class PngWriter {
+public:
+    PngWriter();
+    ~PngWriter();
+
+    bool open(const std::string &path, int width, int height, int channels);
+    bool writeRows(const uint8_t *firstRow, int rows, std::ptrdiff_t stride);
+    // Fails if fewer than `height` rows were written.
+    bool close();
+
+    int rowsWritten() const { return rowsWritten_; }
+
+private:
+    struct Deflater;
+
+    bool writeChunk(const char type[4], const uint8_t *data, size_t size);
+
+    std::ofstream file_;
+    int width_ = 0, height_ = 0, channels_ = 0;
+    int rowsWritten_ = 0;
+    bool ok_ = false;
+    std::vector<uint8_t> prevRow_, filtered_;
+    Deflater *deflater_ = nullptr;
+};
+
+bool writePng(const std::string &path, int width, int height, int channels,
+              const uint8_t *firstRow, std::ptrdiff_t stride);
+
+// ---------------------------- EXR output --------------------------- //
+
+// Uncompressed scanline OpenEXR with half-float R, G, B, A channels, for
+// the linear HDR image. Pixels are interleaved RGBA halves (as read back
+// with GL_HALF_FLOAT); `stride` counts halves between rows. Like
+// PngWriter, rows go in top to bottom over any number of writeRows().
+class ExrWriter {
+public:
+    bool open(const std::string &path, int width, int height);
+    bool writeRows(const uint16_t *firstRow, int rows, std::ptrdiff_t stride);
+    // Fails if fewer than `height` rows were written.
+    bool close();
+
+    int rowsWritten() const { return rowsWritten_; }
+
+private:
+    std::ofstream file_;
+    int width_ = 0, height_ = 0;
+    int rowsWritten_ = 0;
+    bool ok_ = false;
+    std::string line_;
+};
+
+bool writeExrHalf(const std::string &path, int width, int height,
+                  const uint16_t *firstRow, std::ptrdiff_t stride);
+
+// ---------------------------- writer pool -------------------------- //
+
+// A read-back frame waiting to be encoded. Rows are stored bottom-up, as
+// glReadPixels returns them.
+struct Image {
+    enum Format {
+        Rgba8,      // written as PNG
+        RgbaHalf,   // written as EXR
+    };
+
+    int    width  = 0;
+    int    height = 0;
+    Format format = Rgba8;
+    std::vector<uint8_t> pixels;
+};
+
+// Picks PNG or EXR from the image format.
+bool writeImage(const std::string &path, const Image &image);
+
+// Streams an image of either format to disk strip by strip: PNG for
+// Rgba8, EXR for RgbaHalf. `stride` is in bytes for both.
+class ImageStreamWriter {
+public:
+    bool open(const std::string &path, int width, int height, Image::Format format);
+    bool writeRows(const uint8_t *firstRow, int rows, std::ptrdiff_t stride);
+    bool close();
+
+    int rowsWritten() const;
+
+private:
+    Image::Format format_ = Image::Rgba8;
+    PngWriter png_;
+    ExrWriter exr_;
+};
+
+// Encodes and writes images on worker threads so the render loop can keep
+// the GPU busy. submit() blocks while too many images are queued, which
+// bounds memory when the disk is slower than the GPU.
+class ImageWriterPool {
+public:
+    // 0 threads = half the hardware threads, at least one.
+    explicit ImageWriterPool(int threads = 0, int maxQueued = 4);
+    ~ImageWriterPool();
+
+    void submit(std::string path, Image image);
+    // Returns once every submitted image has been written.
+    void wait();
+
+    int written() const;
+    int failures() const;
+
+private:
+    struct Job {
+        std::string path;
+        Image       image;
+    };
+
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    mutable std::mutex       mutex_;
+    std::condition_variable  hasWork_, hasRoom_, idle_;
+    std::deque<Job>          queue_;
+    int  maxQueued_ = 4;
+    int  busy_      = 0;
+    int  written_   = 0;
+    int  failures_  = 0;
+    bool stop_      = false;
+};
@@ -0,0 +1,35 @@
+#include "lighting_cache.h"
+
+#include <utility>
+
+LightingCache::LightingCache(ProgramCache &cache, std::string vsPath, std::string fsPath)
+    : volume_(cache, std::move(vsPath), std::move(fsPath),
+              BakedVolumeFormat{GL_RG8, GL_RG, GL_UNSIGNED_BYTE, 2}, 32u << 20, 2) {}
+
+BakedVolumeKey LightingCache::keyFor(const ViewState &view) const {
+    BakedVolumeKey key;
+    key.power         = view.power;
+    key.maxIterations = view.maxIterations;
+    key.bailout       = view.bailout;
+    key.epsilon       = view.epsilon;   // the bake marches with it
+    key.resolution    = volume_.resolution();
+    return key;
+}
+
+bool LightingCache::bake(const ViewState &view, const ShaderDefines &defines, GLuint vao) {
+    BakedVolumeKey key = keyFor(view);
+    FrameParams frame;
+    frame.shadowSteps      = kBakeShadowSteps;
+    frame.lightCacheExtent = bakedVolumeExtent(key.bailout);
+    frame.lightCacheVoxel  = 2.0f * frame.lightCacheExtent / key.resolution;
+    return volume_.bake(key, defines, frame, vao);
+}
+
+bool LightingCache::apply(const ViewState &view, bool ao, FrameParams &frame) const {
+    if (view.deepZoom != 0) return false;
+    if (!volume_.hasSurface(keyFor(view))) return false;
+    frame.lightCache       = ao ? 2 : 1;
+    frame.lightCacheExtent = bakedVolumeExtent(volume_.built().bailout);
+    frame.lightCacheVoxel  = 2.0f * frame.lightCacheExtent / volume_.built().resolution;
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <GL/glew.h>
+
+#include "baked_volume.h"
+#include "fractal_program.h"
+#include "shader.h"
+#include "view_state.h"
+
+// -------------------------- lighting cache ------------------------- //
+
+// Soft shadows and AO baked into a volume around the bulb, so shading
+// looks them up instead of tracing them (secondaryTerms in
+// mandelbulb_common.glsl). The light never moves, so unlike everything
+// else the terms stay valid while the camera does: a volume is keyed by
+// the surface parameters alone, like the distance cache's.
+//
+// lighting_bake.frag fills an RG8 BakedVolume (shadow, AO) a few z-slices
+// per bake() call. Its shadow rays take kBakeShadowSteps whatever the
+// refinement budget. A change of power, iterations, bailout or epsilon
+// restarts the bake, and frames trace until it finishes. Points outside
+// the volume, or whose pixel is finer than a voxel, always trace, as do
+// deep-zoom views.
+class LightingCache {
+public:
+    static constexpr int kBakeShadowSteps = 128;
+
+    LightingCache(ProgramCache &cache, std::string vsPath, std::string fsPath);
+
+    // Frees the volumes; the next bake() reallocates them.
+    void destroy() { volume_.destroy(); }
+
+    // Memory for both volumes together. Takes effect with the next bake.
+    void   setBudget(size_t bytes) { volume_.setBudget(bytes); }
+    size_t budget() const { return volume_.budget(); }
+    // Voxels per axis the budget allows, capped by GL_MAX_3D_TEXTURE_SIZE.
+    int    resolution() const { return volume_.resolution(); }
+
+    int  slicesPerFrame() const { return volume_.slicesPerFrame(); }
+    void setSlicesPerFrame(int slices) { volume_.setSlicesPerFrame(slices); }
+
+    // True until a finished volume matches view's surface.
+    bool needsBake(const ViewState &view) const { return volume_.needsBake(keyFor(view)); }
+    // Bakes the next slicesPerFrame() slices for view, restarting if its
+    // surface changed. The FractalParams buffer must hold view. `defines`
+    // selects the bake variant (fractalDefines or empty). Returns true
+    // when this call finished the volume.
+    bool bake(const ViewState &view, const ShaderDefines &defines, GLuint vao);
+    // Whether a volume is partly baked, and what fraction of it.
+    bool  baking() const { return volume_.baking(); }
+    float progress() const { return volume_.progress(); }
+    // Texture memory currently allocated.
+    size_t memoryBytes() const { return volume_.memoryBytes(); }
+
+    // Points frame at the current volume for shadows, and AO too if `ao`,
+    // if it was baked for view's surface at any resolution and view is
+    // not a deep zoom.
+    bool apply(const ViewState &view, bool ao, FrameParams &frame) const;
+    // The current volume, for kUnitLightingCache.
+    GLuint texture() const { return volume_.texture(); }
+
+private:
+    BakedVolumeKey keyFor(const ViewState &view) const;
+
+    BakedVolume volume_;
+};
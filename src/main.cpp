@@ -1,9 +1,10 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
 #include <cmath>
 #include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -12,136 +13,94 @@
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_opengl3.h"
 
-// -------------------------- small helpers -------------------------- //
+#include "camera.h"
+#include "checkerboard.h"
+#include "compute_raymarcher.h"
+#include "cost_counters.h"
+#include "distance_cache.h"
+#include "fractal_program.h"
+#include "frame_pacer.h"
+#include "headless.h"
+#include "lighting_cache.h"
+#include "parameter_sweep.h"
+#include "profiler.h"
+#include "program_binary_cache.h"
+#include "render_settings.h"
+#include "render_target.h"
+#include "resolution_controller.h"
+#include "sampling.h"
+#include "shader.h"
+#include "shader_log.h"
+#include "shader_reloader.h"
+#include "step_stats.h"
+#include "temporal_aa.h"
+#include "timeline.h"
+#include "uniform_buffer.h"
+#include "video_export.h"
+#include "view_state.h"
+
+// How long to block in glfwWaitEventsTimeout while the view is unchanged.
+// Bounded so ImGui hover/blink state still refreshes occasionally.
+static constexpr double kIdleWaitSeconds = 0.5;
+
+// Orbit drag speed, in radians per pixel at FOV 1.
+static constexpr double kOrbitRadiansPerPixel = 0.005;
+
+static const char *kVertexShader  = "../shaders/mandelbulb.vert";
+static const char *kFractalShader = "../shaders/mandelbulb.frag";
+static const char *kComputeShader = "../shaders/mandelbulb.comp";
+static const char *kCommonShader  = "../shaders/mandelbulb_common.glsl";
+static const char *kDoubleShader  = "../shaders/df64.glsl";
+static const char *kUpscaleShader = "../shaders/upscale.frag";
+static const char *kLightingShader = "../shaders/deferred_lighting.frag";
+static const char *kShadeShader    = "../shaders/deferred_shade.frag";
+static const char *kBakeShader     = "../shaders/distance_bake.frag";
+static const char *kLightBakeShader = "../shaders/lighting_bake.frag";
+static const char *kCheckerShader  = "../shaders/checkerboard_resolve.frag";
+static const char *kRateShader     = "../shaders/shading_rate.frag";
+static const char *kTaaShader      = "../shaders/taa_resolve.frag";
+static const char *kSweepShader    = "../shaders/sweep.vert";
+static const char *kShaderDir      = "../shaders";
 
-struct Vec3 {
-    float x, y, z;
-};
-
-static Vec3 make_vec3(float x, float y, float z) {
-    return {x, y, z};
+static void errorCallback(int code, const char *desc) {
+    std::cerr << "GLFW error (" << code << "): " << desc << std::endl;
 }
 
-static Vec3 sub(const Vec3 &a, const Vec3 &b) {
-    return {a.x - b.x, a.y - b.y, a.z - b.z};
-}
+struct UpscaleProgram {
+    GLuint program = 0;
+    GLint  uUVScale = -1, uTexelSize = -1, uSharpness = -1;
+};
 
-static Vec3 cross(const Vec3 &a, const Vec3 &b) {
-    return {
-        a.y * b.z - a.z * b.y,
-        a.z * b.x - a.x * b.z,
-        a.x * b.y - a.y * b.x
-    };
-}
+static UpscaleProgram loadUpscaleProgram(GLuint program) {
+    UpscaleProgram up;
+    up.program = program;
+    if (!program) return up;
 
-static Vec3 normalize_vec3(const Vec3 &v) {
-    float len = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
-    if (len <= 0.0f) return {0.0f, 0.0f, 0.0f};
-    return {v.x / len, v.y / len, v.z / len};
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "u_source"), 0);
+    up.uUVScale   = glGetUniformLocation(program, "u_uvScale");
+    up.uTexelSize = glGetUniformLocation(program, "u_texelSize");
+    up.uSharpness = glGetUniformLocation(program, "u_sharpness");
+    glUseProgram(0);
+    return up;
 }
 
-static std::string readFile(const std::string &path) {
-    std::ifstream file(path, std::ios::in | std::ios::binary);
-    if (!file) {
-        throw std::runtime_error("Failed to open file: " + path);
+int main(int argc, char **argv) {
+    HeadlessOptions options;
+    std::string argError;
+    if (!parseCommandLine(argc, argv, options, argError)) {
+        std::cerr << argError << "\n\n";
+        printUsage(argv[0]);
+        return 2;
     }
-    std::ostringstream contents;
-    contents << file.rdbuf();
-    return contents.str();
-}
-
-static GLuint compileShader(GLenum type, const std::string &src) {
-    GLuint shader = glCreateShader(type);
-    const char *c_str = src.c_str();
-    glShaderSource(shader, 1, &c_str, nullptr);
-    glCompileShader(shader);
-
-    GLint status = GL_FALSE;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-    if (status != GL_TRUE) {
-        GLint logLen = 0;
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLen);
-        std::string log(logLen, '\0');
-        glGetShaderInfoLog(shader, logLen, nullptr, log.data());
-        std::string typeStr = (type == GL_VERTEX_SHADER) ? "VERTEX" : "FRAGMENT";
-        std::cerr << "Error compiling " << typeStr << " shader:\n"
-                  << log << std::endl;
-        glDeleteShader(shader);
+    if (options.help) {
+        printUsage(argv[0]);
         return 0;
     }
-
-    return shader;
-}
-
-static GLuint createProgram(const std::string &vsPath, const std::string &fsPath) {
-    std::string vsSource = readFile(vsPath);
-    std::string fsSource = readFile(fsPath);
-
-    GLuint vs = compileShader(GL_VERTEX_SHADER, vsSource);
-    if (!vs) return 0;
-    GLuint fs = compileShader(GL_FRAGMENT_SHADER, fsSource);
-    if (!fs) {
-        glDeleteShader(vs);
-        return 0;
-    }
-
-    GLuint prog = glCreateProgram();
-    glAttachShader(prog, vs);
-    glAttachShader(prog, fs);
-    glLinkProgram(prog);
-
-    glDeleteShader(vs);
-    glDeleteShader(fs);
-
-    GLint status = GL_FALSE;
-    glGetProgramiv(prog, GL_LINK_STATUS, &status);
-    if (status != GL_TRUE) {
-        GLint logLen = 0;
-        glGetProgramiv(prog, GL_INFO_LOG_LENGTH, &logLen);
-        std::string log(logLen, '\0');
-        glGetProgramInfoLog(prog, logLen, nullptr, log.data());
-        std::cerr << "Error linking shader program:\n"
-                  << log << std::endl;
-        glDeleteProgram(prog);
-        return 0;
+    if (options.headless) {
+        return runHeadless(options);
     }
 
-    return prog;
-}
-
-static void errorCallback(int code, const char *desc) {
-    std::cerr << "GLFW error (" << code << "): " << desc << std::endl;
-}
-
-// ------------------------ render settings -------------------------- //
-
-struct RenderSettings {
-    // Camera
-    float camDistance = 4.0f;
-    float camYaw      = 0.0f;   // around Y
-    float camPitch    = 0.4f;   // up/down
-    float fov         = 1.0f;
-    bool  autoRotate  = true;
-    float rotationSpeed = 0.2f; // radians per second
-
-    // Fractal
-    float power       = 8.0f;
-    int   maxIterations = 18;
-    float bailout     = 2.0f;
-
-    // Raymarch
-    int   maxSteps    = 200;
-    float maxDist     = 25.0f;
-    float epsilon     = 0.001f;
-
-    // Shading
-    bool  enableAO      = true;
-    bool  enableShadows = true;
-    float colorA[3]   = {0.2f, 0.3f, 0.6f};
-    float colorB[3]   = {0.8f, 0.9f, 1.0f};
-};
-
-int main() {
     // ----------------- GLFW + OpenGL init ----------------- //
     glfwSetErrorCallback(errorCallback);
     if (!glfwInit()) {
@@ -156,7 +115,21 @@ int main() {
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    GLFWwindow *window = glfwCreateWindow(1280, 720, "GPU Mandelbulb (ImGui)", nullptr, nullptr);
+    GLFWwindow *window = nullptr;
+    if (options.backend == "compute") {
+        // Most drivers hand out their newest version for a 3.3 request
+        // anyway; asking explicitly covers the ones that don't.
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(1280, 720, "GPU Mandelbulb (ImGui)", nullptr, nullptr);
+        if (!window) {
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        }
+    }
+    if (!window) {
+        window = glfwCreateWindow(1280, 720, "GPU Mandelbulb (ImGui)", nullptr, nullptr);
+    }
     if (!window) {
         std::cerr << "Failed to create GLFW window\n";
         glfwTerminate();
@@ -164,7 +137,6 @@ int main() {
     }
 
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1); // vsync
 
     glewExperimental = GL_TRUE;
     GLenum glewStatus = glewInit();
@@ -180,24 +152,73 @@ int main() {
     // Clear GLEW spurious error
     glGetError();
 
+    // Starts in vsync; the UI switches present modes.
+    FramePacer pacer;
+    pacer.init();
+
     std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
 
     // ------------------- Shader program ------------------- //
-    GLuint program = 0;
-    try {
-        program = createProgram("../shaders/mandelbulb.vert",
-                                "../shaders/mandelbulb.frag");
-    } catch (const std::exception &e) {
-        std::cerr << "Exception while creating program: " << e.what() << std::endl;
+    // The generic fractal programs read every setting from uniforms; they
+    // are built up front and used while a slider is being dragged or when
+    // a specialized variant fails to compile.
+    ProgramBinaryCache binaryCache("shader_cache");
+    ProgramCache programCache;
+    programCache.setBinaryCache(&binaryCache);
+    FractalVariants fractalVariants(programCache, kVertexShader, kFractalShader);
+    const FractalProgram *genericFractal = fractalVariants.get({});
+    const FractalProgram *genericPrepass = fractalVariants.get({{"DEPTH_PREPASS", ""}});
+    UpscaleProgram upscale = loadUpscaleProgram(programCache.get(kVertexShader, kUpscaleShader));
+
+    // Deferred shading passes. Optional: without them frames are shaded
+    // in the forward pass.
+    FractalVariants lightingVariants(programCache, kVertexShader, kLightingShader);
+    FractalVariants shadeVariants(programCache, kVertexShader, kShadeShader);
+    const FractalProgram *genericGBuffer  = fractalVariants.get({{"GBUFFER", ""}});
+    const FractalProgram *genericLighting = lightingVariants.get({});
+    const FractalProgram *genericShade    = shadeVariants.get({});
+
+    if (!genericFractal || !genericPrepass || !upscale.program) {
+        // No UI to show the log in yet.
+        for (const ShaderLogEntry &entry : shaderLogEntries()) {
+            std::cerr << entry.text << std::endl;
+        }
+        programCache.clear();
         glfwDestroyWindow(window);
         glfwTerminate();
         return 1;
     }
-    if (!program) {
-        glfwDestroyWindow(window);
-        glfwTerminate();
-        return 1;
+
+    // The compute backend shares the program cache (and so hot reload and
+    // the binary cache) with the fragment programs.
+    ComputeRaymarcher computeMarcher(programCache, kComputeShader);
+    bool computeAvailable = ComputeRaymarcher::supported() && computeMarcher.init();
+    bool useCompute = options.backend == "compute" && computeAvailable;
+    if (options.backend == "compute" && !computeAvailable) {
+        shaderLog(ShaderLogLevel::Info, "Compute backend unavailable, using the fragment path");
     }
+    bool compareBackends = false;
+
+    // Native doubles for deep zoom; without them only the emulated mode is offered.
+    const bool fp64Available = GLEW_ARB_gpu_shader_fp64 != 0;
+
+    DistanceCache distanceCache(programCache, kVertexShader, kBakeShader);
+    LightingCache lightingCache(programCache, kVertexShader, kLightBakeShader);
+    StepStats stepStats;
+    CostCounters costCounters;
+    Checkerboard checkerboard(programCache, kVertexShader, kCheckerShader, kRateShader);
+    const bool shadingRateAvailable = Checkerboard::shadingRateSupported();
+    bool lastFrameCheckerboard = false;
+    TemporalAA temporalAA(programCache, kVertexShader, kTaaShader);
+    // The last rendered frame went through the TAA resolve, whose result
+    // is then what's shown.
+    bool lastFrameTaa = false;
+    ParameterSweep parameterSweep(programCache, kSweepShader, kFractalShader, kVertexShader,
+                                  kUpscaleShader);
+    SweepRanges sweepRanges;
+    // Tiles are shown at this size whatever they render at.
+    int sweepThumbnail = 96;
+    const bool costCountersAvailable = CostCounters::supported();
 
     // ------------------- Fullscreen quad ------------------ //
     float quadVertices[] = {
@@ -224,26 +245,29 @@ int main() {
 
     glBindVertexArray(0);
 
-    // -------------- Uniform locations (cached) ------------- //
-    glUseProgram(program);
-    GLint uTimeLoc          = glGetUniformLocation(program, "u_time");
-    GLint uResLoc           = glGetUniformLocation(program, "u_resolution");
-    GLint uCamPosLoc        = glGetUniformLocation(program, "u_camPos");
-    GLint uCamForwardLoc    = glGetUniformLocation(program, "u_camForward");
-    GLint uCamRightLoc      = glGetUniformLocation(program, "u_camRight");
-    GLint uCamUpLoc         = glGetUniformLocation(program, "u_camUp");
-    GLint uFovLoc           = glGetUniformLocation(program, "u_fov");
-    GLint uPowerLoc         = glGetUniformLocation(program, "u_power");
-    GLint uMaxIterLoc       = glGetUniformLocation(program, "u_maxIter");
-    GLint uBailoutLoc       = glGetUniformLocation(program, "u_bailout");
-    GLint uMaxStepsLoc      = glGetUniformLocation(program, "u_maxSteps");
-    GLint uMaxDistLoc       = glGetUniformLocation(program, "u_maxDist");
-    GLint uEpsilonLoc       = glGetUniformLocation(program, "u_epsilon");
-    GLint uColorALoc        = glGetUniformLocation(program, "u_colorA");
-    GLint uColorBLoc        = glGetUniformLocation(program, "u_colorB");
-    GLint uEnableAOLoc      = glGetUniformLocation(program, "u_enableAO");
-    GLint uEnableShadowsLoc = glGetUniformLocation(program, "u_enableShadows");
-    glUseProgram(0);
+    // View parameters shared by every fractal variant.
+    UniformBuffer fractalParams;
+    fractalParams.init(kFractalParamsBinding, sizeof(FractalParamsStd140));
+
+    // ------------------ Shader hot reload ------------------ //
+    // Edited shaders are rebuilt in the background; until a rebuild links
+    // the previous programs keep rendering.
+    ShaderReloader reloader(programCache);
+    reloader.init(window);
+    reloader.watch(kVertexShader);
+    reloader.watch(kFractalShader);
+    reloader.watch(kComputeShader);
+    reloader.watch(kCommonShader);
+    reloader.watch(kDoubleShader);
+    reloader.watch(kUpscaleShader);
+    reloader.watch(kLightingShader);
+    reloader.watch(kShadeShader);
+    reloader.watch(kBakeShader);
+    reloader.watch(kLightBakeShader);
+    reloader.watch(kCheckerShader);
+    reloader.watch(kRateShader);
+    reloader.watch(kTaaShader);
+    reloader.watch(kSweepShader);
 
     // -------------- ImGui initialization ------------------- //
     IMGUI_CHECKVERSION();
@@ -263,20 +287,138 @@ int main() {
 
     RenderSettings settings;
 
+    // The fractal is marched into an offscreen target sized for maxScale
+    // and drawn into its lower-left sub-rectangle at the current scale, so
+    // scale changes never reallocate. Two float targets ping-pong so that
+    // progressive refinement can read the running mean it is adding to,
+    // and depth reprojection the previous frame's hit distances.
+    RenderTarget fractalTargets[2];
+    int currentTarget = 0;
+    int sampleIndex = 0;
+    int frameIndex = 0;
+    RenderTarget prepassTarget;   // coarse start distances (RG32F)
+    // Deferred shading: the G-buffer (normal + step ratio, HitInfo) and
+    // the coarse shadow/AO terms.
+    RenderTarget gbufferTarget;
+    RenderTarget lightingTarget;
+    // Refinement frames cost more than live ones; keep them away from the
+    // resolution controller so it doesn't drop the scale and reset history.
+    bool lastRenderWasLive = true;
+    ResolutionController resolution;
+    int internalWidth = 0, internalHeight = 0;
+    unsigned long long lastScaleSample = 0;
+
+    // Idle caching: the offscreen target doubles as a cache of the last
+    // marched image, reused while the view state is unchanged.
+    ViewState cachedView{};
+    bool haveCachedFrame = false;
+    bool idle = false;
+    int  lastFbWidth = 0, lastFbHeight = 0;
+
+    // ----------------------- Profiler ---------------------- //
+    FrameProfiler profiler;
+    const int gpuPrepass = profiler.addGpuPass("Depth prepass");
+    const int gpuFractal = profiler.addGpuPass("Fractal pass (fragment)");
+    const int gpuCompute = profiler.addGpuPass("Fractal pass (compute)");
+    const int gpuBake    = profiler.addGpuPass("Distance cache bake");
+    const int gpuLightBake = profiler.addGpuPass("Lighting cache bake");
+    const int gpuTaa     = profiler.addGpuPass("Temporal AA resolve");
+    const int gpuUpscale = profiler.addGpuPass("Upscale pass");
+    const int gpuImGui   = profiler.addGpuPass("ImGui pass");
+    const int cpuPacing  = profiler.addCpuSection("Frame pacing wait");
+    const int cpuEvents  = profiler.addCpuSection("Poll/wait events");
+    const int cpuUI      = profiler.addCpuSection("Build UI");
+    const int cpuFractal = profiler.addCpuSection("Fractal submit");
+    const int cpuImGui   = profiler.addCpuSection("ImGui submit");
+    const int cpuSwap    = profiler.addCpuSection("Swap buffers");
+    profiler.init();
+
+    // Camera input: auto-rotation and dragging the view outside ImGui
+    // windows. Latched either right after the events or, later, right
+    // before the camera basis is computed for the fractal draw.
+    float  time = 0.0f;
+    bool   orbiting = false;
+    double orbitX = 0.0, orbitY = 0.0;
+    auto latchCameraInput = [&]() {
+        time = static_cast<float>(glfwGetTime());
+        if (settings.autoRotate) {
+            settings.camYaw = time * settings.rotationSpeed;
+        }
+
+        double x, y;
+        glfwGetCursorPos(window, &x, &y);
+        bool dragging = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS &&
+                        (orbiting || !ImGui::GetIO().WantCaptureMouse);
+        if (dragging && orbiting) {
+            const double speed = kOrbitRadiansPerPixel * settings.fov;
+            settings.camYaw  -= (x - orbitX) * speed;
+            settings.camPitch = std::clamp(settings.camPitch + (y - orbitY) * speed, -1.5, 1.5);
+        }
+        orbiting = dragging;
+        orbitX = x;
+        orbitY = y;
+    };
+
+    // Keyframe animation: preview playback in the view, and video export
+    // through an offscreen renderer of its own, one frame per loop.
+    Timeline timeline;
+    float  timelineTime = 0.0f;
+    bool   timelinePlaying = false;
+    double timelineClock = 0.0;
+    int    keyInterpolation = static_cast<int>(Interpolation::Spline);
+    char   timelinePath[256] = "animation.timeline";
+    VideoExportOptions exportOptions;
+    char   exportPath[256] = "animation.mp4";
+    std::unique_ptr<VideoExport> videoExport;
+    std::string animationStatus;
+
     // ------------------------ Main loop -------------------- //
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        profiler.beginFrame();
+
+        // Waits for the GPU and the limiter come before input is read, so
+        // they don't add to its latency.
+        profiler.beginCpu(cpuPacing);
+        settings.presentMode    = std::clamp(settings.presentMode, 0, 3);
+        settings.fpsLimit       = std::clamp(settings.fpsLimit, 10.0f, 1000.0f);
+        settings.maxFramesAhead = std::clamp(settings.maxFramesAhead, 1, FramePacer::kMaxFramesAhead);
+        pacer.setMode(static_cast<PresentMode>(settings.presentMode));
+        pacer.wait(settings.maxFramesAhead, settings.fpsLimit);
+        profiler.endCpu(cpuPacing);
+
+        profiler.beginCpu(cpuEvents);
+        if (idle) {
+            glfwWaitEventsTimeout(kIdleWaitSeconds);
+        } else {
+            glfwPollEvents();
+        }
+        profiler.endCpu(cpuEvents);
+
+        if (reloader.update(glfwGetTime())) {
+            // Replaced programs invalidate cached locations, and the cached
+            // image was drawn by the old shader.
+            genericFractal  = fractalVariants.get({});
+            genericPrepass  = fractalVariants.get({{"DEPTH_PREPASS", ""}});
+            upscale         = loadUpscaleProgram(programCache.get(kVertexShader, kUpscaleShader));
+            genericGBuffer  = fractalVariants.get({{"GBUFFER", ""}});
+            genericLighting = lightingVariants.get({});
+            genericShade    = shadeVariants.get({});
+            haveCachedFrame = false;
+        }
 
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
             glfwSetWindowShouldClose(window, GLFW_TRUE);
         }
 
-        float time = static_cast<float>(glfwGetTime());
-        if (settings.autoRotate) {
-            settings.camYaw = time * settings.rotationSpeed;
+        if (!settings.lateLatch) {
+            latchCameraInput();
         }
 
+        stepStats.poll();
+        costCounters.poll();
+
         // Start ImGui frame
+        profiler.beginCpu(cpuUI);
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -286,15 +428,49 @@ int main() {
 
         if (ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen)) {
             ImGui::Checkbox("Auto rotate", &settings.autoRotate);
-            ImGui::SliderFloat("Distance", &settings.camDistance, 2.0f, 12.0f);
-            ImGui::SliderFloat("Yaw", &settings.camYaw, -3.1415f, 3.1415f);
-            ImGui::SliderFloat("Pitch", &settings.camPitch, -1.5f, 1.5f);
-            ImGui::SliderFloat("FOV", &settings.fov, 0.3f, 2.0f);
+            const bool deep = settings.deepZoom != 0;
+            if (deep) {
+                // Drags scaled to the field of view, so a zoomed-in view
+                // still moves a fraction of its width per pixel.
+                const double speed = 1e-3 * settings.fov;
+                ImGui::DragScalar("Distance", ImGuiDataType_Double, &settings.camDistance,
+                                  static_cast<float>(speed * settings.camDistance),
+                                  nullptr, nullptr, "%.12f");
+                ImGui::DragScalar("Yaw", ImGuiDataType_Double, &settings.camYaw,
+                                  static_cast<float>(speed), nullptr, nullptr, "%.12f");
+                ImGui::DragScalar("Pitch", ImGuiDataType_Double, &settings.camPitch,
+                                  static_cast<float>(speed), nullptr, nullptr, "%.12f");
+                ImGui::SliderFloat("FOV", &settings.fov, 1e-7f, 2.0f, "%.3g",
+                                   ImGuiSliderFlags_Logarithmic);
+            } else {
+                const double distRange[2] = {2.0, 12.0};
+                const double yawRange[2]  = {-3.1415, 3.1415};
+                const double pitchRange[2] = {-1.5, 1.5};
+                ImGui::SliderScalar("Distance", ImGuiDataType_Double, &settings.camDistance,
+                                    &distRange[0], &distRange[1], "%.3f");
+                ImGui::SliderScalar("Yaw", ImGuiDataType_Double, &settings.camYaw,
+                                    &yawRange[0], &yawRange[1], "%.3f");
+                ImGui::SliderScalar("Pitch", ImGuiDataType_Double, &settings.camPitch,
+                                    &pitchRange[0], &pitchRange[1], "%.3f");
+                ImGui::SliderFloat("FOV", &settings.fov, 0.3f, 2.0f);
+            }
+            ImGui::Text("Deep zoom:");
+            ImGui::SameLine();
+            ImGui::RadioButton("Off", &settings.deepZoom, 0);
+            ImGui::SameLine();
+            ImGui::RadioButton("df64", &settings.deepZoom, 1);
+            if (fp64Available) {
+                ImGui::SameLine();
+                ImGui::RadioButton("fp64", &settings.deepZoom, 2);
+            }
+            if (deep) {
+                ImGui::TextDisabled("Integer powers only; fp64 is fast on few GPUs");
+            }
             ImGui::SliderFloat("Rotation speed", &settings.rotationSpeed, 0.0f, 1.0f);
             if (ImGui::Button("Reset camera")) {
-                settings.camDistance = 4.0f;
-                settings.camYaw      = 0.0f;
-                settings.camPitch    = 0.4f;
+                settings.camDistance = 4.0;
+                settings.camYaw      = 0.0;
+                settings.camPitch    = 0.4;
                 settings.fov         = 1.0f;
             }
         }
@@ -311,11 +487,187 @@ int main() {
             ImGui::SliderFloat("Epsilon", &settings.epsilon,
                                0.0001f, 0.01f, "%.5f",
                                ImGuiSliderFlags_Logarithmic);
+            ImGui::Checkbox("Depth prepass", &settings.depthPrepass);
+            ImGui::SameLine();
+            ImGui::RadioButton("1/4", &settings.prepassFactor, 4);
+            ImGui::SameLine();
+            ImGui::RadioButton("1/8", &settings.prepassFactor, 8);
+            ImGui::Checkbox("Reproject last frame's depth", &settings.reprojectDepth);
+            ImGui::SliderFloat("Reprojection margin", &settings.reprojectMargin, 0.0f, 0.25f);
+            ImGui::Checkbox("Specialized shader variants", &settings.specializeShaders);
+            ImGui::SameLine();
+            ImGui::TextDisabled("(%zu built, %d from disk)", programCache.size(),
+                                binaryCache.hits());
+            ImGui::Checkbox("Distance cache", &settings.distanceCache);
+            if (settings.distanceCache) {
+                ImGui::SameLine();
+                if (distanceCache.baking()) {
+                    ImGui::TextDisabled("(baking %.0f%%)", distanceCache.progress() * 100.0f);
+                } else {
+                    ImGui::TextDisabled("(%d^3, %.0f MB)", distanceCache.resolution(),
+                                        distanceCache.memoryBytes() / 1048576.0);
+                }
+                ImGui::SliderInt("Cache budget (MB)", &settings.distanceCacheMB, 8, 512);
+            }
+            ImGui::Checkbox("Bounding sphere + over-relaxation", &settings.boundedMarch);
+            if (settings.boundedMarch) {
+                ImGui::SliderFloat("Relaxation", &settings.relaxation, 1.0f, 1.8f);
+            }
+            ImGui::Checkbox("Footprint LOD", &settings.distanceLod);
+            if (settings.distanceLod) {
+                ImGui::SliderFloat("LOD threshold (pixels)", &settings.lodBias, 0.1f, 2.0f);
+                ImGui::SliderFloat("LOD iteration falloff", &settings.lodIterBias, 0.0f, 3.0f);
+            }
+            if (stepStats.valid()) {
+                ImGui::TextDisabled("%.1f steps / pixel (avg)", stepStats.averageSteps());
+            }
+            if (computeAvailable) {
+                ImGui::Text("Backend:");
+                ImGui::SameLine();
+                if (ImGui::RadioButton("Fragment", !useCompute)) useCompute = false;
+                ImGui::SameLine();
+                if (ImGui::RadioButton("Compute", useCompute)) useCompute = true;
+                if (useCompute) {
+                    int roundSteps = computeMarcher.roundSteps();
+                    if (ImGui::SliderInt("Steps per round", &roundSteps, 4, 128)) {
+                        computeMarcher.setRoundSteps(roundSteps);
+                    }
+                    ImGui::TextDisabled("Compute ignores depth reprojection and deferred shading");
+                }
+                ImGui::Checkbox("A/B: alternate backends every frame", &compareBackends);
+            } else {
+                ImGui::TextDisabled("Compute backend needs OpenGL 4.3");
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Cost analysis")) {
+            ImGui::Text("Heatmap:");
+            ImGui::SameLine();
+            ImGui::RadioButton("Off##cost", &settings.costView, 0);
+            ImGui::SameLine();
+            ImGui::RadioButton("Steps", &settings.costView, 1);
+            ImGui::SameLine();
+            ImGui::RadioButton("DE evaluations", &settings.costView, 2);
+            ImGui::SameLine();
+            ImGui::RadioButton("Outcome", &settings.costView, 3);
+            if (settings.costView == 2) {
+                ImGui::TextDisabled("Log scale, 1 to 2048 per pixel");
+            } else if (settings.costView == 3) {
+                ImGui::TextDisabled("Blue miss, green hit, red out of steps");
+            }
+            if (costCountersAvailable) {
+                ImGui::Checkbox("GPU counters", &settings.costCounters);
+            } else {
+                ImGui::TextDisabled("GPU counters need OpenGL 4.3");
+            }
+            if (settings.costCounters && costCounters.valid()) {
+                const CostCountersStd430 &c = costCounters.totals();
+                const double pixels = std::max<GLuint>(c.pixels, 1);
+                ImGui::Text("%u pixels, %.1f steps / pixel", c.pixels, c.steps / pixels);
+                ImGui::Text("Hit %.1f%%, miss %.1f%%, out of steps %.1f%%",
+                            100.0 * c.outcomes[1] / pixels, 100.0 * c.outcomes[0] / pixels,
+                            100.0 * c.outcomes[2] / pixels);
+
+                static const char *const kPhases[4] = {"primary", "normal", "shadow", "AO"};
+                double evaluations = 0.0;
+                for (GLuint n : c.evaluations) evaluations += n;
+                ImGui::Text("%.1f DE evaluations / pixel", evaluations / pixels);
+                for (int k = 0; k < 4; k++) {
+                    ImGui::Text("  %-8s %6.1f (%.0f%%)", kPhases[k], c.evaluations[k] / pixels,
+                                evaluations > 0.0 ? 100.0 * c.evaluations[k] / evaluations : 0.0);
+                }
+
+                float stepBins[CostCountersStd430::kBins], evaluationBins[CostCountersStd430::kBins];
+                for (int k = 0; k < CostCountersStd430::kBins; k++) {
+                    stepBins[k]       = static_cast<float>(c.stepBins[k]);
+                    evaluationBins[k] = static_cast<float>(c.evaluationBins[k]);
+                }
+                ImGui::PlotHistogram("Steps", stepBins, CostCountersStd430::kBins, 0,
+                                     "0 to step limit", 0.0f, 3.4e38f, ImVec2(0.0f, 60.0f));
+                ImGui::PlotHistogram("DE evaluations", evaluationBins, CostCountersStd430::kBins, 0,
+                                     "log2", 0.0f, 3.4e38f, ImVec2(0.0f, 60.0f));
+            }
+            if (settings.costView > 0 || settings.costCounters) {
+                ImGui::TextDisabled("Forward fragment pass: no deferred shading or compute");
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Resolution")) {
+            ImGui::Checkbox("Dynamic resolution", &settings.dynamicResolution);
+            if (settings.dynamicResolution) {
+                ImGui::SliderFloat("Target FPS", &settings.targetFPS, 20.0f, 240.0f, "%.0f");
+                ImGui::SliderFloat("Min scale", &settings.minScale, 0.1f, 1.0f);
+                ImGui::SliderFloat("Max scale", &settings.maxScale, 0.1f, 1.0f);
+            } else {
+                ImGui::SliderFloat("Render scale", &settings.renderScale, 0.1f, 1.0f);
+            }
+            ImGui::Checkbox("Checkerboard while moving", &settings.checkerboard);
+            ImGui::SameLine();
+            ImGui::TextDisabled("(forward shading)");
+            if (shadingRateAvailable) {
+                ImGui::Checkbox("Coarse background shading", &settings.shadingRate);
+            }
+            ImGui::SliderFloat("Sharpness", &settings.sharpness, 0.0f, 1.0f);
+            ImGui::Checkbox("Cache idle frames", &settings.idleCaching);
+            ImGui::Text("Internal: %d x %d (%.0f%%)%s", internalWidth, internalHeight,
+                        resolution.scale() * 100.0f, idle ? " - cached" : "");
+        }
+
+        if (ImGui::CollapsingHeader("Frame pacing")) {
+            ImGui::RadioButton("Vsync", &settings.presentMode, 0);
+            ImGui::SameLine();
+            ImGui::RadioButton("Adaptive", &settings.presentMode, 1);
+            ImGui::SameLine();
+            ImGui::RadioButton("Uncapped", &settings.presentMode, 2);
+            ImGui::SameLine();
+            ImGui::RadioButton("Limit", &settings.presentMode, 3);
+            if (settings.presentMode == 1 && !pacer.adaptiveSupported()) {
+                ImGui::TextDisabled("No swap_control_tear: presenting with vsync");
+            }
+            if (settings.presentMode == 3) {
+                ImGui::SliderFloat("FPS limit", &settings.fpsLimit, 10.0f, 500.0f, "%.0f");
+            }
+            ImGui::SliderInt("Max frames ahead", &settings.maxFramesAhead, 1,
+                             FramePacer::kMaxFramesAhead);
+            ImGui::Checkbox("Late input latching", &settings.lateLatch);
+            ImGui::TextDisabled("Waited %.2f ms, %d frame(s) in flight; drag the view to orbit",
+                                pacer.waitMs(), pacer.framesInFlight());
+        }
+
+        if (ImGui::CollapsingHeader("Progressive refinement")) {
+            ImGui::Checkbox("Accumulate while static", &settings.progressive);
+            ImGui::SliderInt("Max samples", &settings.maxSamples, 1, 256);
+            ImGui::Checkbox("Raise steps / shadow samples", &settings.refineQuality);
+            ImGui::Checkbox("Temporal AA while moving", &settings.temporalAA);
+            char progress[32];
+            std::snprintf(progress, sizeof(progress), "%d / %d", sampleIndex, settings.maxSamples);
+            ImGui::ProgressBar(std::min(1.0f, sampleIndex / static_cast<float>(settings.maxSamples)),
+                               ImVec2(-1.0f, 0.0f), progress);
         }
 
         if (ImGui::CollapsingHeader("Shading / Colors", ImGuiTreeNodeFlags_DefaultOpen)) {
             ImGui::Checkbox("Ambient occlusion", &settings.enableAO);
             ImGui::Checkbox("Soft shadows", &settings.enableShadows);
+            ImGui::Checkbox("Analytic normals", &settings.analyticNormals);
+            ImGui::SameLine();
+            ImGui::TextDisabled("(finite differences when off)");
+            ImGui::Checkbox("Deferred shadows / AO", &settings.deferredShading);
+            ImGui::SameLine();
+            ImGui::RadioButton("1/2##lighting", &settings.lightingFactor, 2);
+            ImGui::SameLine();
+            ImGui::RadioButton("1/4##lighting", &settings.lightingFactor, 4);
+            ImGui::Checkbox("Lighting cache", &settings.lightingCache);
+            if (settings.lightingCache) {
+                ImGui::SameLine();
+                if (lightingCache.baking()) {
+                    ImGui::TextDisabled("(baking %.0f%%)", lightingCache.progress() * 100.0f);
+                } else {
+                    ImGui::TextDisabled("(%d^3, %.0f MB)", lightingCache.resolution(),
+                                        lightingCache.memoryBytes() / 1048576.0);
+                }
+                ImGui::Checkbox("Cached AO", &settings.lightingCacheAO);
+                ImGui::SliderInt("Lighting budget (MB)", &settings.lightingCacheMB, 8, 256);
+            }
             ImGui::ColorEdit3("Color A", settings.colorA);
             ImGui::ColorEdit3("Color B", settings.colorB);
         }
@@ -324,83 +676,622 @@ int main() {
             settings = RenderSettings(); // resets to defaults
         }
 
+        if (ImGui::CollapsingHeader("Parameter sweep")) {
+            ImGui::DragFloatRange2("Power", &sweepRanges.power.from, &sweepRanges.power.to,
+                                   0.05f, 2.0f, 16.0f);
+            ImGui::SliderInt("Power steps", &sweepRanges.power.steps, 1, 32);
+            int iterations[2] = {static_cast<int>(sweepRanges.iterations.from),
+                                 static_cast<int>(sweepRanges.iterations.to)};
+            if (ImGui::DragIntRange2("Iterations", &iterations[0], &iterations[1], 0.2f, 1, 64)) {
+                sweepRanges.iterations.from = static_cast<float>(iterations[0]);
+                sweepRanges.iterations.to   = static_cast<float>(iterations[1]);
+            }
+            ImGui::SliderInt("Iteration steps", &sweepRanges.iterations.steps, 1, 32);
+            ImGui::DragFloatRange2("Bailout", &sweepRanges.bailout.from, &sweepRanges.bailout.to,
+                                   0.01f, 1.0f, 6.0f);
+            ImGui::SliderInt("Bailout steps", &sweepRanges.bailout.steps, 1, 32);
+            ImGui::SliderInt("Tile size", &sweepRanges.tileSize, 32, 256);
+            ImGui::SliderInt("Thumbnail size", &sweepThumbnail, 32, 256);
+
+            int tiles = sweepRanges.power.steps * sweepRanges.iterations.steps *
+                        sweepRanges.bailout.steps;
+            if (tiles > ParameterSweep::kMaxTiles) {
+                ImGui::TextDisabled("%d tiles; at most %d", tiles, ParameterSweep::kMaxTiles);
+            } else if (ImGui::Button("Render sweep")) {
+                // init() of its buffers takes the FractalParams binding.
+                parameterSweep.start(settings, sweepRanges);
+                fractalParams.invalidate();
+            }
+            if (parameterSweep.count() > 0) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("%d tiles, %d/%d samples", parameterSweep.count(),
+                                    parameterSweep.samples(), ParameterSweep::kSamples);
+
+                // Wraps to the panel width; a click loads that tile's
+                // parameters into the view.
+                float thumb   = static_cast<float>(sweepThumbnail);
+                float spacing = ImGui::GetStyle().ItemSpacing.x;
+                int perRow = std::max(1, static_cast<int>((ImGui::GetContentRegionAvail().x + spacing) /
+                                                          (thumb + spacing + 2.0f)));
+                for (int i = 0; i < parameterSweep.count(); i++) {
+                    float uv0[2], uv1[2];
+                    parameterSweep.tileUV(i, uv0, uv1);
+                    char id[32];
+                    std::snprintf(id, sizeof(id), "##sweep%d", i);
+                    if (i % perRow != 0) ImGui::SameLine();
+                    const RenderSettings &preset = parameterSweep.preset(i);
+                    if (ImGui::ImageButton(id, (ImTextureID)(intptr_t)parameterSweep.texture(),
+                                           ImVec2(thumb, thumb), ImVec2(uv0[0], uv0[1]),
+                                           ImVec2(uv1[0], uv1[1]))) {
+                        settings.power         = preset.power;
+                        settings.maxIterations = preset.maxIterations;
+                        settings.bailout       = preset.bailout;
+                    }
+                    if (ImGui::IsItemHovered()) {
+                        ImGui::SetTooltip("Power %.2f, %d iterations, bailout %.2f",
+                                          preset.power, preset.maxIterations, preset.bailout);
+                    }
+                }
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Animation")) {
+            bool exporting = videoExport && videoExport->active();
+            bool scrubbed = ImGui::DragFloat("Time", &timelineTime, 0.01f, 0.0f, 3600.0f, "%.2f s",
+                                             ImGuiSliderFlags_AlwaysClamp);
+            if (ImGui::Button(timelinePlaying ? "Pause" : "Play") && !timeline.empty()) {
+                timelinePlaying = !timelinePlaying;
+                timelineClock = glfwGetTime();
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Set key")) {
+                RenderSettings key = settings;
+                key.autoRotate = false;
+                timeline.setKey(timelineTime, key, static_cast<Interpolation>(keyInterpolation));
+            }
+            ImGui::SameLine();
+            const char *modes[] = {"Step", "Linear", "Spline"};
+            ImGui::SetNextItemWidth(90.0f);
+            ImGui::Combo("##interpolation", &keyInterpolation, modes, IM_ARRAYSIZE(modes));
+            for (size_t i = 0; i < timeline.keys().size(); i++) {
+                const Keyframe &key = timeline.keys()[i];
+                char label[64];
+                std::snprintf(label, sizeof(label), "%.2f s  %s", key.time,
+                              interpolationName(key.interpolation));
+                ImGui::PushID(static_cast<int>(i));
+                if (ImGui::SmallButton("x")) {
+                    timeline.removeKey(i);
+                    ImGui::PopID();
+                    break;
+                }
+                ImGui::SameLine();
+                if (ImGui::Selectable(label, std::abs(key.time - timelineTime) < 1e-4)) {
+                    timelineTime = static_cast<float>(key.time);
+                    scrubbed = true;
+                }
+                ImGui::PopID();
+            }
+            if (scrubbed && !timeline.empty()) {
+                settings = timeline.evaluate(timelineTime, settings);
+            }
+
+            ImGui::InputText("Timeline file", timelinePath, sizeof(timelinePath));
+            if (ImGui::Button("Save timeline")) {
+                animationStatus = saveTimeline(timelinePath, timeline)
+                                      ? std::string("Saved ") + timelinePath
+                                      : std::string("Failed to write ") + timelinePath;
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Load timeline")) {
+                std::string error;
+                animationStatus = loadTimeline(timelinePath, settings, timeline, &error)
+                                      ? std::string("Loaded ") + timelinePath : error;
+            }
+
+            ImGui::Separator();
+            ImGui::InputText("Video", exportPath, sizeof(exportPath));
+            ImGui::InputInt("Width", &exportOptions.width);
+            ImGui::InputInt("Height", &exportOptions.height);
+            float fps = static_cast<float>(exportOptions.fps);
+            if (ImGui::DragFloat("FPS", &fps, 0.1f, 1.0f, 240.0f, "%.2f")) exportOptions.fps = fps;
+            ImGui::SliderInt("Samples / frame", &exportOptions.samples, 1, 256);
+            exportOptions.width  = std::clamp(exportOptions.width, 16, 16384);
+            exportOptions.height = std::clamp(exportOptions.height, 16, 16384);
+            if (exporting) {
+                char progress[32];
+                std::snprintf(progress, sizeof(progress), "%d / %d", videoExport->frame(),
+                              videoExport->frameCount());
+                ImGui::ProgressBar(videoExport->frame() / static_cast<float>(videoExport->frameCount()),
+                                   ImVec2(-1.0f, 0.0f), progress);
+                if (ImGui::Button("Cancel export")) {
+                    videoExport->finish();
+                    fractalParams.invalidate();
+                    animationStatus = "Export cancelled";
+                }
+            } else if (ImGui::Button("Export video")) {
+                if (!videoExport) videoExport = std::make_unique<VideoExport>(kShaderDir);
+                exportOptions.path = exportPath;
+                std::string error;
+                animationStatus = videoExport->start(timeline, exportOptions, &error)
+                                      ? "Exporting " + exportOptions.path : error;
+                fractalParams.invalidate();
+            }
+            if (!animationStatus.empty()) ImGui::TextDisabled("%s", animationStatus.c_str());
+        }
+
+        if (ImGui::CollapsingHeader("Profiler")) {
+            profiler.drawImGui();
+            const TimingHistory &fragmentTime = profiler.gpuHistory(gpuFractal);
+            const TimingHistory &computeTime  = profiler.gpuHistory(gpuCompute);
+            if (fragmentTime.size() > 0 && computeTime.size() > 0) {
+                float fragmentAvg = fragmentTime.stats().avg;
+                float computeAvg  = computeTime.stats().avg;
+                ImGui::Separator();
+                ImGui::Text("Fragment %.2f ms vs compute %.2f ms (avg): %.2fx", fragmentAvg,
+                            computeAvg, computeAvg > 0.0f ? fragmentAvg / computeAvg : 0.0f);
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Shaders")) {
+            ImGui::Text("Hot reload: %s", reloader.backendName());
+            if (reloader.busy()) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("(%d building)", reloader.pending());
+            }
+            drawShaderLog();
+        }
+
         ImGui::Text("Tip: tweak power, iterations and colors to\n"
                     "generate very different Mandelbulb looks.");
 
         ImGui::End();
+        profiler.endCpu(cpuUI);
+
+        if (timelinePlaying) {
+            // Preview playback follows the wall clock and loops; export
+            // steps through the timeline at its own fixed rate.
+            double now = glfwGetTime();
+            timelineTime += static_cast<float>(now - timelineClock);
+            timelineClock = now;
+            if (timelineTime > timeline.duration()) timelineTime = 0.0f;
+            settings = timeline.evaluate(timelineTime, settings);
+        }
+        if (videoExport && videoExport->active()) {
+            if (!videoExport->step()) {
+                animationStatus = videoExport->finish() ? "Wrote " + exportOptions.path
+                                                        : "Export failed (see the log)";
+            }
+            // It has its own FractalParams buffer at the same binding.
+            fractalParams.invalidate();
+        }
+        if (parameterSweep.refine(vao)) {
+            // As does the sweep.
+            fractalParams.invalidate();
+        }
 
         // -------------- Compute camera basis ---------------- //
-        settings.camPitch = std::clamp(settings.camPitch, -1.5f, 1.5f);
-        settings.camDistance = std::max(settings.camDistance, 0.5f);
-
-        float cp = std::cos(settings.camPitch);
-        float sp = std::sin(settings.camPitch);
-        float cy = std::cos(settings.camYaw);
-        float sy = std::sin(settings.camYaw);
-
-        Vec3 camPos = {
-            settings.camDistance * cp * cy,
-            settings.camDistance * sp,
-            settings.camDistance * cp * sy
-        };
-        Vec3 target  = {0.0f, 0.0f, 0.0f};
-
-        Vec3 forward = normalize_vec3(sub(target, camPos));
-        Vec3 worldUp = {0.0f, 1.0f, 0.0f};
-        Vec3 right   = normalize_vec3(cross(forward, worldUp));
-        Vec3 up      = cross(right, forward);
+        // Late latching: building the UI took a while, so pick up the
+        // input that arrived meanwhile. ImGui sees those events next frame.
+        if (settings.lateLatch) {
+            glfwPollEvents();
+            latchCameraInput();
+        }
+        CameraBasis cam = computeCameraBasis(settings);
 
         // -------------- Rendering: fractal ------------------ //
-        int width, height;
-        glfwGetFramebufferSize(window, &width, &height);
-        glViewport(0, 0, width, height);
+        profiler.beginCpu(cpuFractal);
+
+        int fbWidth, fbHeight;
+        glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
+
+        settings.minScale = std::clamp(settings.minScale, 0.1f, 1.0f);
+        settings.maxScale = std::clamp(settings.maxScale, settings.minScale, 1.0f);
+        if (settings.dynamicResolution) {
+            const TimingHistory &fractalTime = profiler.gpuHistory(useCompute ? gpuCompute : gpuFractal);
+            if (fractalTime.sampleCount() != lastScaleSample && lastRenderWasLive) {
+                lastScaleSample = fractalTime.sampleCount();
+                float fixedMs = profiler.gpuHistory(gpuUpscale).latest() +
+                                profiler.gpuHistory(gpuImGui).latest();
+                resolution.update(fractalTime.latest(), fixedMs, settings);
+            }
+        } else {
+            resolution.reset(std::clamp(settings.renderScale, 0.1f, 1.0f));
+        }
 
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+        float allocScale = settings.dynamicResolution ? settings.maxScale : 1.0f;
+        int allocWidth  = std::max(1, static_cast<int>(std::ceil(fbWidth * allocScale)));
+        int allocHeight = std::max(1, static_cast<int>(std::ceil(fbHeight * allocScale)));
+        bool reallocated = fractalTargets[0].width != allocWidth ||
+                           fractalTargets[0].height != allocHeight;
+        settings.prepassFactor = settings.prepassFactor <= 4 ? 4 : 8;
+        int prepassWidth  = (allocWidth + settings.prepassFactor - 1) / settings.prepassFactor;
+        int prepassHeight = (allocHeight + settings.prepassFactor - 1) / settings.prepassFactor;
+        if (!ensureRenderTarget(fractalTargets[0], allocWidth, allocHeight, {GL_RGBA16F, GL_RG32F}) ||
+            !ensureRenderTarget(fractalTargets[1], allocWidth, allocHeight, {GL_RGBA16F, GL_RG32F}) ||
+            !ensureRenderTarget(prepassTarget, prepassWidth, prepassHeight, {GL_RG32F})) {
+            break;
+        }
+        settings.lightingFactor = settings.lightingFactor <= 2 ? 2 : 4;
+        if (settings.deferredShading) {
+            int lightingWidth  = (allocWidth + settings.lightingFactor - 1) / settings.lightingFactor;
+            int lightingHeight = (allocHeight + settings.lightingFactor - 1) / settings.lightingFactor;
+            if (!ensureRenderTarget(gbufferTarget, allocWidth, allocHeight, {GL_RGBA16F, GL_RG32F}) ||
+                !ensureRenderTarget(lightingTarget, lightingWidth, lightingHeight, {GL_RG16F})) {
+                break;
+            }
+        }
 
-        glUseProgram(program);
-        glUniform1f(uTimeLoc, time);
-        glUniform2f(uResLoc, static_cast<float>(width), static_cast<float>(height));
+        int width  = std::clamp(static_cast<int>(fbWidth * resolution.scale() + 0.5f), 1, allocWidth);
+        int height = std::clamp(static_cast<int>(fbHeight * resolution.scale() + 0.5f), 1, allocHeight);
+        internalWidth  = width;
+        internalHeight = height;
+
+        ViewState view = makeViewState(settings, cam, width, height);
+        // A/B runs re-march live frames so both backends time equal work.
+        bool viewChanged = !haveCachedFrame || reallocated || view != cachedView;
+        // Checkerboarded frames are half reconstructed, so the first frame
+        // after the view stops is marched in full before anything
+        // accumulates onto it.
+        bool dirty = !settings.idleCaching || viewChanged || compareBackends ||
+                     lastFrameCheckerboard;
+        if (dirty) {
+            sampleIndex = 0;
+        }
+        bool refining = settings.progressive && sampleIndex < settings.maxSamples;
+        bool renderFractal = dirty || refining;
+
+        bool fbResized = fbWidth != lastFbWidth || fbHeight != lastFbHeight;
+        lastFbWidth  = fbWidth;
+        lastFbHeight = fbHeight;
+        // The distance cache bakes a few slices per frame until the
+        // surface parameters have a finished volume. A slider being
+        // dragged would restart it every frame, so that waits.
+        settings.distanceCacheMB = std::clamp(settings.distanceCacheMB, 8, 512);
+        distanceCache.setBudget(static_cast<size_t>(settings.distanceCacheMB) << 20);
+        bool baking = settings.distanceCache && distanceCache.needsBake(view) &&
+                      !ImGui::IsAnyItemActive();
+        if (!settings.distanceCache && distanceCache.memoryBytes() > 0) {
+            distanceCache.destroy();
+        }
+        // The lighting cache likewise, after the distance cache is done
+        // so that the two don't stack up in one frame.
+        settings.lightingCacheMB = std::clamp(settings.lightingCacheMB, 8, 256);
+        lightingCache.setBudget(static_cast<size_t>(settings.lightingCacheMB) << 20);
+        bool lightBaking = settings.lightingCache && (view.enableShadows || view.enableAO) &&
+                           view.deepZoom == 0 && lightingCache.needsBake(view) && !ImGui::IsAnyItemActive() &&
+                           !baking;
+        if (!settings.lightingCache && lightingCache.memoryBytes() > 0) {
+            lightingCache.destroy();
+        }
+        idle = !renderFractal && !fbResized && !settings.autoRotate && !reloader.busy() &&
+               !timelinePlaying && !(videoExport && videoExport->active()) &&
+               !parameterSweep.refining() &&
+               !baking && !lightBaking;
+
+        if (baking) {
+            FractalParamsStd140 params = packFractalParams(view);
+            fractalParams.update(&params);
+            profiler.beginGpu(gpuBake);
+            distanceCache.bake(view,
+                               settings.specializeShaders
+                                   ? fractalDefines(view, FrameParams{}, FractalPass::Bake)
+                                   : ShaderDefines{},
+                               vao);
+            profiler.endGpu(gpuBake);
+        }
+        if (lightBaking) {
+            FractalParamsStd140 params = packFractalParams(view);
+            fractalParams.update(&params);
+            profiler.beginGpu(gpuLightBake);
+            lightingCache.bake(view,
+                               settings.specializeShaders
+                                   ? fractalDefines(view, FrameParams{}, FractalPass::Bake)
+                                   : ShaderDefines{},
+                               vao);
+            profiler.endGpu(gpuLightBake);
+        }
 
-        glUniform3f(uCamPosLoc, camPos.x, camPos.y, camPos.z);
-        glUniform3f(uCamForwardLoc, forward.x, forward.y, forward.z);
-        glUniform3f(uCamRightLoc, right.x, right.y, right.z);
-        glUniform3f(uCamUpLoc, up.x, up.y, up.z);
-        glUniform1f(uFovLoc, settings.fov);
+        if (renderFractal) {
+            // Cost analysis is instrumented in the forward fragment pass
+            // only, and a heatmap would smear under temporal AA.
+            bool costAnalysis = view.costView > 0 || settings.costCounters;
+            bool taaFrame = settings.temporalAA && !costAnalysis &&
+                            temporalAA.prepare(allocWidth, allocHeight);
+
+            // Sample 0 goes through pixel centres, or a new Halton offset
+            // per frame under temporal AA; later samples jitter and may
+            // raise the step and shadow budgets.
+            float jitter[2] = {0.0f, 0.0f};
+            float boost = 0.0f;
+            if (sampleIndex > 0) {
+                jitter[0] = halton(sampleIndex, 2) - 0.5f;
+                jitter[1] = halton(sampleIndex, 3) - 0.5f;
+                if (settings.refineQuality) {
+                    boost = refineBoost(sampleIndex);
+                }
+            } else if (taaFrame) {
+                TemporalAA::jitter(frameIndex, jitter);
+            }
+            FrameParams frame;
+            frame.time        = time;
+            frame.jitter[0]   = jitter[0];
+            frame.jitter[1]   = jitter[1];
+            frame.sampleIndex = sampleIndex;
+            frame.stepLimit   = std::min(static_cast<int>(settings.maxSteps * (1.0f + boost)), 1024);
+            frame.shadowSteps = static_cast<int>(kBaseShadowSteps * (1.0f + boost));
+            frame.frameIndex  = frameIndex;
+            frame.lightingScale = view.lightingScale;
+            if (settings.distanceCache) {
+                distanceCache.apply(view, frame);
+            }
+            if (settings.lightingCache) {
+                lightingCache.apply(view, settings.lightingCacheAO, frame);
+            }
+            frame.costCounters = settings.costCounters && costCountersAvailable && costCounters.begin();
+            bool computeFrame = !costAnalysis && (compareBackends ? (frameIndex % 2) == 1 : useCompute);
+            // Checkerboarding is for moving views only, and forward-shaded.
+            frame.checkerboard = settings.checkerboard && viewChanged && !computeFrame &&
+                                 checkerboard.prepare(allocWidth, allocHeight);
+            frame.checkerParity = frameIndex & 1;
+            if (!computeFrame && settings.reprojectDepth && haveCachedFrame && !reallocated &&
+                sameSurface(view, cachedView)) {
+                frame.previous = &cachedView;
+                frame.reprojectMargin = settings.reprojectMargin;
+            }
 
-        glUniform1f(uPowerLoc, settings.power);
-        glUniform1i(uMaxIterLoc, settings.maxIterations);
-        glUniform1f(uBailoutLoc, settings.bailout);
+            FractalParamsStd140 params = packFractalParams(view);
+            fractalParams.update(&params);
+
+            // Dragging a slider would compile a variant per value, so the
+            // generic programs cover interaction.
+            const FractalProgram *fractal = genericFractal;
+            const FractalProgram *prepass = genericPrepass;
+            const FractalProgram *gbuffer  = genericGBuffer;
+            const FractalProgram *lighting = genericLighting;
+            const FractalProgram *shade    = genericShade;
+            bool deferred = view.lightingScale > 0 && !computeFrame && !costAnalysis &&
+                            !frame.checkerboard;
+            bool specialize = settings.specializeShaders && !ImGui::IsAnyItemActive();
+            if (specialize) {
+                if (const FractalProgram *fp = fractalVariants.get(fractalDefines(view, frame, FractalPass::Forward))) {
+                    fractal = fp;
+                }
+                if (deferred) {
+                    if (const FractalProgram *fp = fractalVariants.get(fractalDefines(view, frame, FractalPass::GBuffer))) {
+                        gbuffer = fp;
+                    }
+                    if (const FractalProgram *fp = lightingVariants.get(fractalDefines(view, frame, FractalPass::Lighting))) {
+                        lighting = fp;
+                    }
+                    if (const FractalProgram *fp = shadeVariants.get(fractalDefines(view, frame, FractalPass::Shade))) {
+                        shade = fp;
+                    }
+                }
+                if (view.prepassScale > 0 && dirty) {
+                    if (const FractalProgram *fp = fractalVariants.get(fractalDefines(view, frame, FractalPass::Prepass))) {
+                        prepass = fp;
+                    }
+                }
+            } else if (costAnalysis) {
+                if (const FractalProgram *fp = fractalVariants.get(costDefines(view, frame))) {
+                    fractal = fp;
+                }
+            }
 
-        glUniform1i(uMaxStepsLoc, settings.maxSteps);
-        glUniform1f(uMaxDistLoc, settings.maxDist);
-        glUniform1f(uEpsilonLoc, settings.epsilon);
+            // The prepass is jitter-safe, so refinement frames reuse it.
+            if (dirty && view.prepassScale > 0) {
+                int factor = view.prepassScale;
+                profiler.beginGpu(gpuPrepass);
+                glBindFramebuffer(GL_FRAMEBUFFER, prepassTarget.fbo);
+                glViewport(0, 0, (width + factor - 1) / factor, (height + factor - 1) / factor);
+
+                glUseProgram(prepass->program);
+                uploadFractalUniforms(*prepass, frame);
+                glBindVertexArray(vao);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                glBindVertexArray(0);
+                glUseProgram(0);
+                profiler.endGpu(gpuPrepass);
+            }
 
-        glUniform3f(uColorALoc, settings.colorA[0], settings.colorA[1], settings.colorA[2]);
-        glUniform3f(uColorBLoc, settings.colorB[0], settings.colorB[1], settings.colorB[2]);
-        glUniform1i(uEnableAOLoc, settings.enableAO ? 1 : 0);
-        glUniform1i(uEnableShadowsLoc, settings.enableShadows ? 1 : 0);
+            const RenderTarget &history = fractalTargets[currentTarget];
+            const RenderTarget &output  = fractalTargets[1 - currentTarget];
+
+            glActiveTexture(GL_TEXTURE0 + kUnitHistory);
+            glBindTexture(GL_TEXTURE_2D, history.color[0]);
+            glActiveTexture(GL_TEXTURE0 + kUnitStartDist);
+            glBindTexture(GL_TEXTURE_2D, prepassTarget.color[0]);
+            glActiveTexture(GL_TEXTURE0 + kUnitPrevHit);
+            glBindTexture(GL_TEXTURE_2D, history.color[1]);
+            glActiveTexture(GL_TEXTURE0 + kUnitDistanceCache);
+            glBindTexture(GL_TEXTURE_3D, frame.distanceCache ? distanceCache.texture() : 0);
+            glActiveTexture(GL_TEXTURE0 + kUnitLightingCache);
+            glBindTexture(GL_TEXTURE_3D, frame.lightCache ? lightingCache.texture() : 0);
+
+            bool marched = false;
+            if (computeFrame) {
+                profiler.beginGpu(gpuCompute);
+                marched = computeMarcher.render(
+                    frame, specialize ? fractalDefines(view, frame, FractalPass::Forward) : ShaderDefines{},
+                    output, width, height);
+                profiler.endGpu(gpuCompute);
+            }
+            if (!marched) {
+                profiler.beginGpu(gpuFractal);
+                glBindVertexArray(vao);
+                if (deferred && gbuffer && lighting && shade) {
+                    // Primary march into the G-buffer, shadow/AO at
+                    // 1/lightingScale, then full-resolution shading with
+                    // a bilateral upsample of those terms.
+                    glBindFramebuffer(GL_FRAMEBUFFER, gbufferTarget.fbo);
+                    glViewport(0, 0, width, height);
+                    glUseProgram(gbuffer->program);
+                    uploadFractalUniforms(*gbuffer, frame);
+                    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+                    glActiveTexture(GL_TEXTURE0 + kUnitGNormal);
+                    glBindTexture(GL_TEXTURE_2D, gbufferTarget.color[0]);
+                    glActiveTexture(GL_TEXTURE0 + kUnitGHit);
+                    glBindTexture(GL_TEXTURE_2D, gbufferTarget.color[1]);
+
+                    // Nothing to upsample with both terms off.
+                    if (view.enableAO || view.enableShadows) {
+                        int factor = frame.lightingScale;
+                        glBindFramebuffer(GL_FRAMEBUFFER, lightingTarget.fbo);
+                        glViewport(0, 0, (width + factor - 1) / factor, (height + factor - 1) / factor);
+                        glUseProgram(lighting->program);
+                        uploadFractalUniforms(*lighting, frame);
+                        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                    }
+
+                    glActiveTexture(GL_TEXTURE0 + kUnitLighting);
+                    glBindTexture(GL_TEXTURE_2D, lightingTarget.color[0]);
+                    glBindFramebuffer(GL_FRAMEBUFFER, output.fbo);
+                    glViewport(0, 0, width, height);
+                    glUseProgram(shade->program);
+                    uploadFractalUniforms(*shade, frame);
+                    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                } else {
+                    // The march target: the output, or the checkerboard's
+                    // half-width one.
+                    const RenderTarget &march = frame.checkerboard ? checkerboard.target() : output;
+                    int marchedWidth = frame.checkerboard ? Checkerboard::marchWidth(width) : width;
+
+                    // Coarse shading needs last frame's hits, and would
+                    // smear accumulated samples.
+                    bool coarse = settings.shadingRate && shadingRateAvailable && sampleIndex == 0 &&
+                                  haveCachedFrame && !reallocated &&
+                                  checkerboard.beginShadingRate(
+                                      marchedWidth, height, frame.checkerboard ? 2 : 1, width, height,
+                                      cachedView.width, cachedView.height, vao);
+
+                    glBindFramebuffer(GL_FRAMEBUFFER, march.fbo);
+                    glViewport(0, 0, marchedWidth, height);
+                    glUseProgram(fractal->program);
+                    uploadFractalUniforms(*fractal, frame);
+                    glBindVertexArray(vao);
+                    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                    if (coarse) checkerboard.endShadingRate();
+
+                    if (frame.checkerboard) {
+                        // The resolve reuses last frame's colours whenever
+                        // it has them, reprojection of depth or not.
+                        FrameParams resolve = frame;
+                        resolve.previous = haveCachedFrame && !reallocated && sameSurface(view, cachedView)
+                                         ? &cachedView : nullptr;
+                        glBindFramebuffer(GL_FRAMEBUFFER, output.fbo);
+                        glViewport(0, 0, width, height);
+                        checkerboard.resolve(resolve, vao);
+                    }
+                }
+                glBindVertexArray(0);
+                glUseProgram(0);
+
+                profiler.endGpu(gpuFractal);
+            }
+            costCounters.end();
+            for (int unit : {kUnitLighting, kUnitGHit, kUnitGNormal, kUnitPrevHit, kUnitStartDist,
+                             kUnitHistory}) {
+                glActiveTexture(GL_TEXTURE0 + unit);
+                glBindTexture(GL_TEXTURE_2D, 0);
+            }
+            for (int unit : {kUnitDistanceCache, kUnitLightingCache}) {
+                glActiveTexture(GL_TEXTURE0 + unit);
+                glBindTexture(GL_TEXTURE_3D, 0);
+            }
+            glActiveTexture(GL_TEXTURE0);
+
+            stepStats.measure(output.fbo, GL_COLOR_ATTACHMENT1, width, height);
+
+            if (taaFrame) {
+                // Moving frames blend in at kBlend; once the view stops the
+                // accumulated mean takes over within a few samples.
+                FrameParams taa = frame;
+                taa.previous = lastFrameTaa && !reallocated ? &cachedView : nullptr;
+                taa.taaBlend = std::min(1.0f, TemporalAA::kBlend * (sampleIndex + 1));
+                profiler.beginGpu(gpuTaa);
+                temporalAA.resolve(taa, output, width, height, vao);
+                profiler.endGpu(gpuTaa);
+            }
 
+            currentTarget = 1 - currentTarget;
+            lastRenderWasLive = dirty;
+            lastFrameCheckerboard = frame.checkerboard;
+            lastFrameTaa = taaFrame;
+            sampleIndex++;
+            frameIndex++;
+            cachedView = view;
+            haveCachedFrame = true;
+        }
+        const RenderTarget &fractalTarget = lastFrameTaa ? temporalAA.result()
+                                                         : fractalTargets[currentTarget];
+
+        // -------------- Upscale to the window --------------- //
+        profiler.beginGpu(gpuUpscale);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, fbWidth, fbHeight);
+
+        glUseProgram(upscale.program);
+        glUniform2f(upscale.uUVScale,
+                    static_cast<float>(width) / fractalTarget.width,
+                    static_cast<float>(height) / fractalTarget.height);
+        glUniform2f(upscale.uTexelSize, 1.0f / fractalTarget.width, 1.0f / fractalTarget.height);
+        glUniform1f(upscale.uSharpness, width < fbWidth ? settings.sharpness : 0.0f);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, fractalTarget.color[0]);
         glBindVertexArray(vao);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
         glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
         glUseProgram(0);
 
+        profiler.endGpu(gpuUpscale);
+        profiler.endCpu(cpuFractal);
+
         // -------------- ImGui render pass ------------------- //
+        profiler.beginCpu(cpuImGui);
+        profiler.beginGpu(gpuImGui);
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        profiler.endGpu(gpuImGui);
+        profiler.endCpu(cpuImGui);
 
+        profiler.beginCpu(cpuSwap);
         glfwSwapBuffers(window);
+        pacer.endFrame();
+        profiler.endCpu(cpuSwap);
+
+        profiler.endFrame();
     }
 
     // ---------------------- Cleanup ----------------------- //
+    reloader.shutdown();
+    profiler.shutdown();
+    pacer.destroy();
+    computeMarcher.destroy();
+    distanceCache.destroy();
+    lightingCache.destroy();
+    stepStats.destroy();
+    costCounters.destroy();
+    checkerboard.destroy();
+    videoExport.reset();
+    parameterSweep.destroy();
+    temporalAA.destroy();
+    fractalParams.destroy();
+    destroyRenderTarget(fractalTargets[0]);
+    destroyRenderTarget(fractalTargets[1]);
+    destroyRenderTarget(prepassTarget);
+    destroyRenderTarget(gbufferTarget);
+    destroyRenderTarget(lightingTarget);
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
     glDeleteBuffers(1, &vbo);
     glDeleteVertexArrays(1, &vao);
-    glDeleteProgram(program);
+    programCache.clear();
 
     glfwDestroyWindow(window);
     glfwTerminate();
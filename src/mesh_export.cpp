@@ -0,0 +1,317 @@
+#include "mesh_export.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+#include "baked_volume.h"
+#include "camera.h"
+#include "view_state.h"
+
+// Bytes per queued cell: mesh_extract.comp's uvec2.
+static constexpr size_t kCellBytes = 8;
+
+static const char *kStageDefine[] = {"MESH_SUBDIVIDE", "MESH_TRIANGULATE"};
+
+bool MeshExporter::supported() {
+    return GLEW_VERSION_4_3 != 0;
+}
+
+MeshExporter::MeshExporter(ProgramCache &cache, std::string csPath)
+    : cache_(cache), csPath_(std::move(csPath)) {}
+
+bool MeshExporter::init() {
+    for (int s = 0; s < kStageCount; s++) {
+        if (!stage(static_cast<Stage>(s), {})) return false;
+    }
+    if (!params_.init(kFractalParamsBinding, sizeof(FractalParamsStd140))) return false;
+    glGenBuffers(1, &counters_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counters_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_READ);
+    glGenBuffers(1, &triangles_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, triangles_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 static_cast<GLsizeiptr>(kLeafBatch) * kMaxLeafTriangles * 3 *
+                     sizeof(MeshVertexStd430),
+                 nullptr, GL_DYNAMIC_READ);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return counters_ != 0 && triangles_ != 0;
+}
+
+void MeshExporter::destroy() {
+    params_.destroy();
+    GLuint buffers[] = {counters_, triangles_};
+    glDeleteBuffers(2, buffers);
+    if (!cells_.empty()) glDeleteBuffers(static_cast<GLsizei>(cells_.size()), cells_.data());
+    counters_ = triangles_ = 0;
+    cells_.clear();
+    capacities_.clear();
+    loaded_.clear();
+}
+
+const MeshExporter::StageProgram *MeshExporter::stage(Stage s, const ShaderDefines &defines) {
+    // Same invalidation rule as FractalVariants.
+    if (cache_.generation() != generation_) {
+        loaded_.clear();
+        generation_ = cache_.generation();
+    }
+
+    ShaderDefines stageDefines = defines;
+    stageDefines[kStageDefine[s]] = "";
+    GLuint program = cache_.getCompute(csPath_, stageDefines);
+    if (!program) return nullptr;
+
+    auto it = loaded_.find(program);
+    if (it == loaded_.end()) {
+        StageProgram sp;
+        sp.fractal   = loadFractalProgram(program);
+        sp.uLevel    = glGetUniformLocation(program, "u_level");
+        sp.uFirst    = glGetUniformLocation(program, "u_first");
+        sp.uCount    = glGetUniformLocation(program, "u_count");
+        sp.uCapacity = glGetUniformLocation(program, "u_capacity");
+        sp.uExtent   = glGetUniformLocation(program, "u_meshExtent");
+        sp.uIso      = glGetUniformLocation(program, "u_meshIso");
+        it = loaded_.emplace(program, sp).first;
+    }
+    return &it->second;
+}
+
+GLuint MeshExporter::cellBuffer(int level) {
+    if (static_cast<int>(cells_.size()) <= level) {
+        size_t first = cells_.size();
+        cells_.resize(level + 1, 0);
+        capacities_.resize(level + 1, 0);
+        glGenBuffers(static_cast<GLsizei>(cells_.size() - first), cells_.data() + first);
+    }
+    if (capacities_[level] == 0) {
+        // Level l has 8^l cells at most.
+        GLuint capacity = level >= 7 ? kCellCapacity
+                                     : std::min<GLuint>(kCellCapacity, 1u << (3 * level));
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, cells_[level]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(capacity * kCellBytes),
+                     nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        capacities_[level] = capacity;
+    }
+    return cells_[level];
+}
+
+void MeshExporter::resetCounters() {
+    const GLuint zero[2] = {0, 0};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counters_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+GLuint MeshExporter::readCounter(size_t offset) {
+    GLuint value = 0;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counters_);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, static_cast<GLintptr>(offset), sizeof(value),
+                       &value);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return value;
+}
+
+bool MeshExporter::extract(const RenderSettings &settings, int depth, MeshWriter &writer) {
+    stats_ = MeshStats{};
+    if (depth < 1 || depth > kMaxDepth || !writer.isOpen() || !counters_) return false;
+
+    // Only the surface parameters matter; the camera is whatever.
+    RenderSettings surface = settings;
+    ViewState view = makeViewState(surface, computeCameraBasis(surface), 1, 1);
+    ShaderDefines defines = fractalDefines(view, FrameParams{}, FractalPass::Bake);
+    subdivide_   = stage(kSubdivide, defines);
+    triangulate_ = stage(kTriangulate, defines);
+    if (!subdivide_ || !triangulate_) {
+        subdivide_   = stage(kSubdivide, {});
+        triangulate_ = stage(kTriangulate, {});
+        if (!subdivide_ || !triangulate_) return false;
+    }
+
+    FractalParamsStd140 params = packFractalParams(view);
+    params_.invalidate();
+    params_.update(&params);
+
+    depth_  = depth;
+    extent_ = bakedVolumeExtent(settings.bailout);  // the caches' cube
+    iso_    = std::max(settings.epsilon, extent_ / static_cast<float>(1 << depth));
+    writer_ = &writer;
+    open_.clear();
+
+    // The root cell.
+    const GLuint root[2] = {0, 0};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, cellBuffer(0));
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(root), root);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, counters_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, triangles_);
+
+    bool ok = refine(0, 1);
+
+    for (GLuint binding = 0; binding < 4; binding++) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+    }
+    glUseProgram(0);
+    writer_ = nullptr;
+    // Left open are edges whose other leaves were culled or overflowed.
+    open_.clear();
+
+    stats_.vertices  = writer.vertexCount();
+    stats_.triangles = writer.triangleCount();
+    stats_.gpuBytes  = static_cast<size_t>(kLeafBatch) * kMaxLeafTriangles * 3 *
+                       sizeof(MeshVertexStd430);
+    for (GLuint capacity : capacities_) stats_.gpuBytes += capacity * kCellBytes;
+    return ok;
+}
+
+bool MeshExporter::refine(int level, GLuint count) {
+    if (level == depth_) return triangulate(count);
+
+    // Eight children a cell, so a slice this size always fits.
+    const GLuint slice = kCellCapacity / 8;
+    const GLuint in = cellBuffer(level), out = cellBuffer(level + 1);
+    for (GLuint first = 0; first < count; first += slice) {
+        const GLuint n = std::min(slice, count - first);
+
+        resetCounters();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, in);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, out);
+        glUseProgram(subdivide_->fractal.program);
+        glUniform1i(subdivide_->uLevel, level);
+        glUniform1ui(subdivide_->uFirst, first);
+        glUniform1ui(subdivide_->uCount, n);
+        glUniform1ui(subdivide_->uCapacity, capacities_[level + 1]);
+        glUniform1f(subdivide_->uExtent, extent_);
+        glUniform1f(subdivide_->uIso, iso_);
+        glDispatchCompute((n * 8 + 63) / 64, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        GLuint kept = std::min(readCounter(0), capacities_[level + 1]);
+        stats_.cells += kept;
+        if (kept > 0 && !refine(level + 1, kept)) return false;
+    }
+    return true;
+}
+
+bool MeshExporter::triangulate(GLuint count) {
+    stats_.leaves += count;
+    const GLuint capacity = kLeafBatch * kMaxLeafTriangles;
+    for (GLuint first = 0; first < count; first += kLeafBatch) {
+        const GLuint n = std::min(kLeafBatch, count - first);
+
+        resetCounters();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cellBuffer(depth_));
+        glUseProgram(triangulate_->fractal.program);
+        glUniform1i(triangulate_->uLevel, depth_);
+        glUniform1ui(triangulate_->uFirst, first);
+        glUniform1ui(triangulate_->uCount, n);
+        glUniform1ui(triangulate_->uCapacity, capacity);
+        glUniform1f(triangulate_->uExtent, extent_);
+        glUniform1f(triangulate_->uIso, iso_);
+        glDispatchCompute((n + 63) / 64, 1, 1);
+
+        writeBatch(std::min(readCounter(sizeof(GLuint)), capacity), n);
+        if (!writer_->good()) return false;
+    }
+    return true;
+}
+
+// Leaves of the grid around an edge: on the axes the edge spans they
+// start at its lower corner, on the others they may also start one below,
+// where the grid has room.
+int MeshExporter::edgeLeaves(uint64_t key) const {
+    const uint32_t lo = static_cast<uint32_t>(key), hi = static_cast<uint32_t>(key >> 32);
+    const uint32_t corner[3] = {lo & 0x1FFFFu, (lo >> 17) | ((hi & 3u) << 15),
+                                (hi >> 2) & 0x1FFFFu};
+    const uint32_t direction = hi >> 19;
+    const uint32_t cells = 1u << depth_;
+    int leaves = 1;
+    for (int axis = 0; axis < 3; axis++) {
+        if (direction & (1u << axis)) continue;
+        leaves *= (corner[axis] > 0) + (corner[axis] < cells);
+    }
+    return leaves;
+}
+
+void MeshExporter::writeBatch(GLuint triangles, GLuint leaves) {
+    if (triangles == 0) return;
+
+    batch_.resize(static_cast<size_t>(triangles) * 3);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, triangles_);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                       static_cast<GLsizeiptr>(batch_.size() * sizeof(MeshVertexStd430)),
+                       batch_.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Triangles arrive interleaved across leaves; group them by leaf, so
+    // each leaf can be counted once against every edge it uses.
+    leafStart_.assign(static_cast<size_t>(leaves) + 1, 0);
+    for (GLuint t = 0; t < triangles; t++) leafStart_[batch_[t * 3].leaf + 1]++;
+    for (GLuint l = 0; l < leaves; l++) leafStart_[l + 1] += leafStart_[l];
+    byLeaf_.resize(triangles);
+    {
+        std::vector<uint32_t> next(leafStart_.begin(), leafStart_.end() - 1);
+        for (GLuint t = 0; t < triangles; t++) byLeaf_[next[batch_[t * 3].leaf]++] = t;
+    }
+
+    // Both leaves of an edge wrote the same key and position for it.
+    positions_.clear();
+    indices_.clear();
+    const uint32_t base = static_cast<uint32_t>(writer_->vertexCount());
+    for (GLuint l = 0; l < leaves; l++) {
+        leafEdges_.clear();
+        for (uint32_t i = leafStart_[l]; i < leafStart_[l + 1]; i++) {
+            for (int corner = 0; corner < 3; corner++) {
+                const MeshVertexStd430 &v = batch_[byLeaf_[i] * 3 + corner];
+                const uint64_t key = v.keyLo | static_cast<uint64_t>(v.keyHi) << 32;
+
+                // At most 19 edges a leaf: a scan beats a map.
+                auto seen = std::find_if(leafEdges_.begin(), leafEdges_.end(),
+                                         [key](const LeafEdge &e) { return e.key == key; });
+                if (seen != leafEdges_.end()) {
+                    indices_.push_back(seen->index);
+                    continue;
+                }
+                LeafEdge edge{key, 0, false};
+                auto found = open_.find(key);
+                if (found != open_.end()) {
+                    edge.index = found->second.index;
+                    edge.open  = true;
+                } else {
+                    edge.index = base + static_cast<uint32_t>(positions_.size() / 3);
+                    positions_.insert(positions_.end(), v.position, v.position + 3);
+                    int others = edgeLeaves(key);
+                    if (others > 1 && open_.size() < kMaxOpenEdges) {
+                        open_.emplace(key, OpenEdge{edge.index, others});
+                        edge.open = true;
+                    } else if (others > 1) {
+                        stats_.unmerged++;
+                    }
+                }
+                leafEdges_.push_back(edge);
+                indices_.push_back(edge.index);
+            }
+        }
+        // This leaf is done with its edges; close those no other needs.
+        for (const LeafEdge &edge : leafEdges_) {
+            if (!edge.open) continue;
+            auto it = open_.find(edge.key);
+            if (--it->second.leavesLeft == 0) open_.erase(it);
+        }
+    }
+    stats_.openEdges = std::max(stats_.openEdges, open_.size());
+
+    // Corners on the surface collapse triangles to a point or a line.
+    size_t kept = 0;
+    for (size_t i = 0; i < indices_.size(); i += 3) {
+        uint32_t a = indices_[i], b = indices_[i + 1], c = indices_[i + 2];
+        if (a == b || b == c || a == c) continue;
+        indices_[kept++] = a;
+        indices_[kept++] = b;
+        indices_[kept++] = c;
+    }
+
+    writer_->addVertices(positions_.data(), positions_.size() / 3);
+    writer_->addTriangles(indices_.data(), kept / 3);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "fractal_program.h"
+#include "mesh_io.h"
+#include "render_settings.h"
+#include "shader.h"
+#include "uniform_buffer.h"
+
+// --------------------------- mesh export --------------------------- //
+
+// std430 image of mesh_extract.comp's MeshVertex: an edge key, the
+// position on that edge and the leaf that wrote it. Three per triangle.
+struct MeshVertexStd430 {
+    GLuint keyLo, keyHi;
+    float  position[3];
+    GLuint leaf;
+};
+static_assert(sizeof(MeshVertexStd430) == 6 * 4, "must match the std430 struct");
+
+// What an extract() produced.
+struct MeshStats {
+    uint64_t cells     = 0;   // octree cells kept, leaves included
+    uint64_t leaves    = 0;
+    uint64_t vertices  = 0;
+    uint64_t triangles = 0;
+    uint64_t unmerged  = 0;   // seam vertices written twice, kMaxOpenEdges reached
+    size_t   openEdges = 0;   // seam edges held at once, at the peak
+    size_t   gpuBytes  = 0;   // buffer memory at its peak
+};
+
+// Triangulates the bulb's surface on GL 4.3 with mesh_extract.comp,
+// refining an octree over the cube the surface lies in down to
+// 2^depth cells per axis, but only where the surface passes. The
+// iso-surface is the estimate at half a leaf (at least the view's
+// epsilon), so features thinner than a leaf close up rather than alias.
+//
+// Refinement is depth first in slices: each level keeps one buffer of at
+// most kCellCapacity cells, and a level's cells are subdivided
+// kCellCapacity / 8 at a time, each slice's children refined completely
+// before the next slice. Leaves are triangulated kLeafBatch at a time and
+// every batch goes to the MeshWriter before the next runs, its vertices
+// merged by edge key. An edge some leaves around it have yet to reach
+// stays open, remembering its vertex, until the last of them has used
+// it, so the mesh is watertight across batches. GPU memory is thus
+// bounded by the depth whatever the surface's size, and host memory by
+// one batch and at most kMaxOpenEdges open edges; past that, new seam
+// vertices are written once per batch (MeshStats::unmerged).
+class MeshExporter {
+public:
+    static constexpr int    kMaxDepth     = 16;
+    static constexpr GLuint kCellCapacity = 1u << 20;
+    static constexpr GLuint kLeafBatch    = 1u << 16;
+    // Marching tetrahedra cut each of a leaf's six into two at most.
+    static constexpr GLuint kMaxLeafTriangles = 12;
+    static constexpr size_t kMaxOpenEdges = size_t(1) << 22;
+
+    // Compute shaders and SSBOs (GL 4.3).
+    static bool supported();
+
+    MeshExporter(ProgramCache &cache, std::string csPath);
+
+    // Builds the stage programs; false if they don't compile.
+    bool init();
+    void destroy();
+
+    // Writes the surface of settings' fractal at `depth` (1..kMaxDepth)
+    // into `writer`, which must be open.
+    bool extract(const RenderSettings &settings, int depth, MeshWriter &writer);
+    const MeshStats &stats() const { return stats_; }
+
+private:
+    enum Stage { kSubdivide, kTriangulate, kStageCount };
+
+    struct StageProgram {
+        FractalProgram fractal;
+        GLint uLevel = -1, uFirst = -1, uCount = -1, uCapacity = -1;
+        GLint uExtent = -1, uIso = -1;
+    };
+
+    const StageProgram *stage(Stage s, const ShaderDefines &defines);
+    GLuint cellBuffer(int level);
+    void   resetCounters();
+    GLuint readCounter(size_t offset);
+
+    bool refine(int level, GLuint count);
+    bool triangulate(GLuint count);
+    void writeBatch(GLuint triangles, GLuint leaves);
+    int  edgeLeaves(uint64_t key) const;
+
+    ProgramCache &cache_;
+    std::string   csPath_;
+    unsigned      generation_ = 0;
+    std::unordered_map<GLuint, StageProgram> loaded_;
+
+    UniformBuffer params_;
+    GLuint counters_  = 0;
+    GLuint triangles_ = 0;
+    std::vector<GLuint> cells_;       // per level
+    std::vector<GLuint> capacities_;  // cells each holds
+
+    // Set for the extract() in progress.
+    const StageProgram *subdivide_   = nullptr;
+    const StageProgram *triangulate_ = nullptr;
+    int   depth_  = 0;
+    float extent_ = 0.0f, iso_ = 0.0f;
+    MeshWriter *writer_ = nullptr;
+    MeshStats   stats_;
+
+    // An edge with leaves still to come: its vertex's index, and how many.
+    struct OpenEdge {
+        uint32_t index;
+        int      leavesLeft;
+    };
+    // An edge one leaf of the batch uses.
+    struct LeafEdge {
+        uint64_t key;
+        uint32_t index;
+        bool     open;
+    };
+
+    std::unordered_map<uint64_t, OpenEdge> open_;
+    std::vector<MeshVertexStd430> batch_;
+    std::vector<uint32_t>         byLeaf_;      // triangles, grouped by leaf
+    std::vector<uint32_t>         leafStart_;
+    std::vector<LeafEdge>         leafEdges_;
+    std::vector<float>            positions_;
+    std::vector<uint32_t>         indices_;
+};
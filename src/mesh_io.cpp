@@ -0,0 +1,116 @@
+#include "mesh_io.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+// Width the header reserves for each element count.
+static constexpr int kCountWidth = 20;
+
+static bool isPly(const std::string &path) {
+    if (path.size() < 4) return false;
+    std::string ext = path.substr(path.size() - 4);
+    for (char &c : ext) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return ext == ".ply";
+}
+
+// "element NAME N" padded with spaces to a fixed width, so it can be
+// rewritten in place once N is known.
+static std::string elementLine(const char *name, uint64_t count) {
+    std::string line = std::string("element ") + name + " " + std::to_string(count);
+    line.resize(line.size() + kCountWidth - std::to_string(count).size(), ' ');
+    return line + "\n";
+}
+
+MeshWriter::~MeshWriter() {
+    if (isOpen()) close();
+}
+
+bool MeshWriter::open(const std::string &path) {
+    path_ = path;
+    ply_  = isPly(path);
+    vertices_ = triangles_ = 0;
+    file_.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file_) return false;
+
+    if (ply_) {
+        faces_.open(path + ".faces", std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!faces_) {
+            file_.close();
+            return false;
+        }
+        file_ << "ply\nformat binary_little_endian 1.0\ncomment mandelbulb surface\n";
+        countsAt_ = file_.tellp();
+        file_ << elementLine("vertex", 0)
+              << "property float x\nproperty float y\nproperty float z\n"
+              << elementLine("face", 0)
+              << "property list uchar uint vertex_indices\nend_header\n";
+    } else {
+        file_ << "# mandelbulb surface\n";
+    }
+    ok_ = static_cast<bool>(file_);
+    return ok_;
+}
+
+uint32_t MeshWriter::addVertices(const float *xyz, size_t count) {
+    uint32_t first = static_cast<uint32_t>(vertices_);
+    if (ply_) {
+        file_.write(reinterpret_cast<const char *>(xyz),
+                    static_cast<std::streamsize>(count * 3 * sizeof(float)));
+    } else {
+        char line[96];
+        for (size_t i = 0; i < count; i++) {
+            int n = std::snprintf(line, sizeof(line), "v %.9g %.9g %.9g\n", xyz[i * 3],
+                                  xyz[i * 3 + 1], xyz[i * 3 + 2]);
+            file_.write(line, n);
+        }
+    }
+    vertices_ += count;
+    return first;
+}
+
+void MeshWriter::addTriangles(const uint32_t *indices, size_t count) {
+    if (ply_) {
+        // Thirteen bytes a face: the count byte, then the indices.
+        std::vector<char> packed(count * 13);
+        for (size_t i = 0; i < count; i++) {
+            packed[i * 13] = 3;
+            std::copy_n(reinterpret_cast<const char *>(indices + i * 3), 12, &packed[i * 13 + 1]);
+        }
+        faces_.write(packed.data(), static_cast<std::streamsize>(packed.size()));
+    } else {
+        char line[48];
+        for (size_t i = 0; i < count; i++) {
+            int n = std::snprintf(line, sizeof(line), "f %u %u %u\n", indices[i * 3] + 1,
+                                  indices[i * 3 + 1] + 1, indices[i * 3 + 2] + 1);
+            file_.write(line, n);
+        }
+    }
+    triangles_ += count;
+}
+
+bool MeshWriter::close() {
+    bool ok = ok_ && file_ && vertices_ <= std::numeric_limits<uint32_t>::max();
+    if (ply_) {
+        faces_.close();
+        ok = ok && !faces_.fail();
+        if (ok) {
+            std::ifstream faces(path_ + ".faces", std::ios::in | std::ios::binary);
+            if (triangles_ > 0) file_ << faces.rdbuf();
+            ok = static_cast<bool>(file_);
+        }
+        std::remove((path_ + ".faces").c_str());
+        if (ok) {
+            file_.seekp(countsAt_);
+            file_ << elementLine("vertex", vertices_)
+                  << "property float x\nproperty float y\nproperty float z\n"
+                  << elementLine("face", triangles_);
+            ok = static_cast<bool>(file_);
+        }
+    }
+    file_.close();
+    ok_ = false;
+    return ok && !file_.fail();
+}
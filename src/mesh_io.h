@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// ---------------------------- mesh output -------------------------- //
+
+// Streams an indexed triangle mesh to disk as it is produced, holding
+// none of it. A .ply path gets binary little-endian PLY: its header
+// reserves room for the element counts, filled in by close(), and faces
+// go to a side file (path + ".faces") that close() appends after the
+// vertices, as PLY wants them in that order. Any other path gets OBJ,
+// whose faces can simply follow the vertices they use.
+class MeshWriter {
+public:
+    ~MeshWriter();
+
+    bool open(const std::string &path);
+
+    // Appends `count` vertices, x y z each; returns the index of the first.
+    uint32_t addVertices(const float *xyz, size_t count);
+    // Appends `count` triangles of three indices into the vertices so far.
+    void addTriangles(const uint32_t *indices, size_t count);
+
+    // Finishes the file. False if anything failed to write, or if the
+    // mesh outgrew 32-bit indices.
+    bool close();
+
+    bool     isOpen() const { return file_.is_open(); }
+    // False once a write has failed.
+    bool     good() const { return ok_ && file_.good() && (!ply_ || faces_.good()); }
+    uint64_t vertexCount() const { return vertices_; }
+    uint64_t triangleCount() const { return triangles_; }
+
+private:
+    std::string  path_;
+    std::fstream file_;
+    std::ofstream faces_;   // PLY only
+    bool ply_ = false;
+    bool ok_  = false;
+    std::streampos countsAt_ = 0;
+    uint64_t vertices_ = 0, triangles_ = 0;
+};
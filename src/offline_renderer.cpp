@@ -0,0 +1,175 @@
+#include "offline_renderer.h"
+
+#include <algorithm>
+
+#include "camera.h"
+#include "sampling.h"
+#include "view_state.h"
+
+OfflineRenderer::OfflineRenderer(const std::string &shaderDir)
+    : vertexShader_(shaderDir + "/mandelbulb.vert"),
+      upscaleShader_(shaderDir + "/upscale.frag"),
+      binaryCache_("shader_cache"),
+      variants_(programs_, vertexShader_, shaderDir + "/mandelbulb.frag") {
+    programs_.setBinaryCache(&binaryCache_);
+}
+
+bool OfflineRenderer::init() {
+    upscaleProgram_ = programs_.get(vertexShader_, upscaleShader_);
+    if (!upscaleProgram_ || !variants_.get({})) return false;
+
+    glUseProgram(upscaleProgram_);
+    glUniform1i(glGetUniformLocation(upscaleProgram_, "u_source"), 0);
+    uUVScale_   = glGetUniformLocation(upscaleProgram_, "u_uvScale");
+    uTexelSize_ = glGetUniformLocation(upscaleProgram_, "u_texelSize");
+    uSharpness_ = glGetUniformLocation(upscaleProgram_, "u_sharpness");
+    glUseProgram(0);
+
+    float quad[] = {
+        -1.0f, -1.0f,  0.0f, 0.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,
+        -1.0f,  1.0f,  0.0f, 1.0f,
+         1.0f,  1.0f,  1.0f, 1.0f
+    };
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &vbo_);
+    glBindVertexArray(vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
+                          (void *)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+
+    GLint maxTexture = 0, maxViewport[2] = {0, 0};
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTexture);
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewport);
+    maxDimension_ = std::min({maxTexture, maxViewport[0], maxViewport[1]});
+
+    return params_.init(kFractalParamsBinding, sizeof(FractalParamsStd140));
+}
+
+void OfflineRenderer::shutdown() {
+    destroyRenderTarget(targets_[0]);
+    destroyRenderTarget(targets_[1]);
+    destroyRenderTarget(prepass_);
+    destroyRenderTarget(resolved_);
+    params_.destroy();
+    programs_.clear();
+    upscaleProgram_ = 0;
+    if (vbo_) glDeleteBuffers(1, &vbo_);
+    if (vao_) glDeleteVertexArrays(1, &vao_);
+    vbo_ = vao_ = 0;
+}
+
+void OfflineRenderer::drawQuad() {
+    glBindVertexArray(vao_);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+}
+
+bool OfflineRenderer::render(const RenderSettings &settings, int width, int height,
+                             int samples, float time) {
+    TileRect full;
+    full.width  = width;
+    full.height = height;
+    return renderTile(settings, width, height, full, samples, time);
+}
+
+bool OfflineRenderer::renderTile(const RenderSettings &settings, int width, int height,
+                                 const TileRect &tile, int samples, float time) {
+    if (tile.x % kTileAlignment != 0 || tile.y % kTileAlignment != 0) return false;
+
+    RenderSettings s = settings;
+    s.prepassFactor = s.prepassFactor <= 4 ? 4 : 8;
+    int factor = s.prepassFactor;
+    if (!ensureRenderTarget(targets_[0], tile.width, tile.height, {GL_RGBA16F, GL_RG32F}) ||
+        !ensureRenderTarget(targets_[1], tile.width, tile.height, {GL_RGBA16F, GL_RG32F}) ||
+        !ensureRenderTarget(prepass_, (tile.width + factor - 1) / factor,
+                            (tile.height + factor - 1) / factor, {GL_RG32F})) {
+        return false;
+    }
+
+    CameraBasis cam = computeCameraBasis(s);
+    ViewState view = makeViewState(s, cam, width, height);
+    FractalParamsStd140 params = packFractalParams(view);
+    params_.update(&params);
+
+    for (int sample = 0; sample < std::max(samples, 1); sample++) {
+        float boost = s.refineQuality ? refineBoost(sample) : 0.0f;
+        FrameParams frame;
+        frame.time        = time;
+        frame.sampleIndex = sample;
+        frame.frameIndex  = sample;
+        frame.tileOffset[0] = static_cast<float>(tile.x);
+        frame.tileOffset[1] = static_cast<float>(tile.y);
+        if (sample > 0) {
+            frame.jitter[0] = halton(sample, 2) - 0.5f;
+            frame.jitter[1] = halton(sample, 3) - 0.5f;
+        }
+        frame.stepLimit   = std::min(static_cast<int>(s.maxSteps * (1.0f + boost)), 1024);
+        frame.shadowSteps = static_cast<int>(kBaseShadowSteps * (1.0f + boost));
+
+        if (sample == 0 && view.prepassScale > 0) {
+            const FractalProgram *prepass = variants_.get(fractalDefines(view, frame, FractalPass::Prepass));
+            if (!prepass) prepass = variants_.get({{"DEPTH_PREPASS", ""}});
+            if (prepass) {
+                glBindFramebuffer(GL_FRAMEBUFFER, prepass_.fbo);
+                glViewport(0, 0, prepass_.width, prepass_.height);
+                glUseProgram(prepass->program);
+                uploadFractalUniforms(*prepass, frame);
+                drawQuad();
+            }
+        }
+
+        const FractalProgram *fractal = variants_.get(fractalDefines(view, frame, FractalPass::Forward));
+        if (!fractal) fractal = variants_.get({});
+        if (!fractal) return false;
+
+        const RenderTarget &history = targets_[current_];
+        const RenderTarget &output  = targets_[1 - current_];
+        glBindFramebuffer(GL_FRAMEBUFFER, output.fbo);
+        glViewport(0, 0, tile.width, tile.height);
+        glUseProgram(fractal->program);
+        uploadFractalUniforms(*fractal, frame);
+        glActiveTexture(GL_TEXTURE0 + kUnitHistory);
+        glBindTexture(GL_TEXTURE_2D, history.color[0]);
+        glActiveTexture(GL_TEXTURE0 + kUnitStartDist);
+        glBindTexture(GL_TEXTURE_2D, prepass_.color[0]);
+        drawQuad();
+        for (int unit : {kUnitStartDist, kUnitHistory}) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        current_ = 1 - current_;
+
+        // One submission per sample keeps long accumulations from
+        // queueing up a single huge batch.
+        glFlush();
+    }
+
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return true;
+}
+
+bool OfflineRenderer::resolve() {
+    const RenderTarget &src = linear();
+    if (!ensureRenderTarget(resolved_, src.width, src.height, {GL_RGBA8})) return false;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, resolved_.fbo);
+    glViewport(0, 0, src.width, src.height);
+    glUseProgram(upscaleProgram_);
+    glUniform2f(uUVScale_, 1.0f, 1.0f);
+    glUniform2f(uTexelSize_, 1.0f / src.width, 1.0f / src.height);
+    glUniform1f(uSharpness_, 0.0f);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, src.color[0]);
+    drawQuad();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return true;
+}
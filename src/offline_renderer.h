@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+
+#include <GL/glew.h>
+
+#include "fractal_program.h"
+#include "program_binary_cache.h"
+#include "render_settings.h"
+#include "render_target.h"
+#include "shader.h"
+#include "uniform_buffer.h"
+
+// ------------------------- offline renderer ------------------------ //
+
+// A rectangle of the full image in pixels, origin bottom-left as in GL.
+struct TileRect {
+    int x = 0, y = 0;
+    int width = 0, height = 0;
+};
+
+// Renders a view into offscreen targets with no window or UI state, for
+// headless batch output. Every image is accumulated from scratch (no idle
+// caching or reprojection), using the specialized shader variants.
+class OfflineRenderer {
+public:
+    // Both need a current GL context. `shaderDir` holds
+    // mandelbulb.vert/.frag and upscale.frag.
+    explicit OfflineRenderer(const std::string &shaderDir);
+    bool init();
+    void shutdown();
+
+    // Accumulates `samples` jittered samples at width x height into
+    // linear(). The view is taken as-is (autoRotate is ignored).
+    bool render(const RenderSettings &settings, int width, int height,
+                int samples, float time);
+
+    // Same, but only `tile` of the width x height image: linear() is
+    // tile-sized and holds exactly what that rectangle of a full render
+    // would. tile.x and tile.y must be multiples of kTileAlignment.
+    bool renderTile(const RenderSettings &settings, int width, int height,
+                    const TileRect &tile, int samples, float time);
+    // Tile origins stay on the depth prepass grid (its largest factor).
+    static constexpr int kTileAlignment = 8;
+
+    // Gamma-encodes linear() into the 8-bit resolved() target.
+    bool resolve();
+
+    const RenderTarget &linear() const { return targets_[current_]; }
+    const RenderTarget &resolved() const { return resolved_; }
+
+    // Largest width/height the targets can be allocated at.
+    int maxDimension() const { return maxDimension_; }
+
+private:
+    void drawQuad();
+
+    std::string vertexShader_, upscaleShader_;
+
+    ProgramBinaryCache binaryCache_;
+    ProgramCache       programs_;
+    FractalVariants    variants_;
+    UniformBuffer      params_;
+
+    GLuint upscaleProgram_ = 0;
+    GLint  uUVScale_ = -1, uTexelSize_ = -1, uSharpness_ = -1;
+
+    GLuint vao_ = 0, vbo_ = 0;
+    RenderTarget targets_[2];
+    RenderTarget prepass_;
+    RenderTarget resolved_;
+    int  current_ = 0;
+    int  maxDimension_ = 0;
+};
@@ -0,0 +1,170 @@
+#include "parameter_sweep.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "camera.h"
+#include "sampling.h"
+#include "view_state.h"
+
+ParameterSweep::ParameterSweep(ProgramCache &cache, std::string sweepVsPath, std::string fsPath,
+                               std::string vsPath, std::string upscalePath)
+    : cache_(cache), variants_(cache, std::move(sweepVsPath), std::move(fsPath)),
+      vsPath_(std::move(vsPath)), upscalePath_(std::move(upscalePath)) {}
+
+void ParameterSweep::destroy() {
+    destroyRenderTarget(targets_[0]);
+    destroyRenderTarget(targets_[1]);
+    destroyRenderTarget(display_);
+    params_.destroy();
+    tiles_.destroy();
+    presets_.clear();
+    active_ = false;
+}
+
+bool ParameterSweep::start(const RenderSettings &base, const SweepRanges &ranges) {
+    active_ = false;
+    int steps[3] = {std::max(ranges.power.steps, 1), std::max(ranges.iterations.steps, 1),
+                    std::max(ranges.bailout.steps, 1)};
+    long long total = 1LL * steps[0] * steps[1] * steps[2];
+    if (total > kMaxTiles || ranges.tileSize < 8) return false;
+
+    // Tiles march a plain forward pass: no prepass, deferred shading or
+    // cost view, whose inputs are per view rather than per tile.
+    base_ = base;
+    base_.autoRotate      = false;
+    base_.depthPrepass    = false;
+    base_.deferredShading = false;
+    base_.costView        = 0;
+    base_.deepZoom        = 0;
+
+    presets_.clear();
+    for (int b = 0; b < steps[2]; b++) {
+        for (int i = 0; i < steps[1]; i++) {
+            for (int p = 0; p < steps[0]; p++) {
+                RenderSettings s = base;
+                s.power         = ranges.power.value(p);
+                s.maxIterations = std::clamp(static_cast<int>(std::lround(ranges.iterations.value(i))),
+                                             1, 64);   // the generic variant's ITER_BOUND
+                s.bailout       = ranges.bailout.value(b);
+                presets_.push_back(s);
+            }
+        }
+    }
+
+    // As square as the grid allows, one row per power sweep when it fits.
+    tileSize_ = ranges.tileSize;
+    columns_  = steps[0];
+    while (columns_ * columns_ < count() / 2) columns_ *= 2;
+    columns_ = std::min(columns_, count());
+    rows_     = (count() + columns_ - 1) / columns_;
+
+    int width = columns_ * tileSize_, height = rows_ * tileSize_;
+    if (!ensureRenderTarget(targets_[0], width, height, {GL_RGBA16F}) ||
+        !ensureRenderTarget(targets_[1], width, height, {GL_RGBA16F}) ||
+        !ensureRenderTarget(display_, width, height, {GL_RGBA8})) {
+        return false;
+    }
+    if (!params_.size() && !params_.init(kFractalParamsBinding, sizeof(FractalParamsStd140))) {
+        return false;
+    }
+    if (!tiles_.size() && !tiles_.init(kSweepParamsBinding, kMaxTiles * 4 * sizeof(float))) {
+        return false;
+    }
+
+    sample_ = 0;
+    active_ = true;
+    return true;
+}
+
+bool ParameterSweep::refine(GLuint vao) {
+    if (!refining()) return false;
+
+    CameraBasis cam = computeCameraBasis(base_);
+    ViewState view = makeViewState(base_, cam, tileSize_, tileSize_);
+
+    float boost = base_.refineQuality ? refineBoost(sample_) : 0.0f;
+    FrameParams frame;
+    frame.sampleIndex = sample_;
+    frame.frameIndex  = sample_;
+    if (sample_ > 0) {
+        frame.jitter[0] = halton(sample_, 2) - 0.5f;
+        frame.jitter[1] = halton(sample_, 3) - 0.5f;
+    }
+    frame.stepLimit   = std::min(static_cast<int>(base_.maxSteps * (1.0f + boost)), 1024);
+    frame.shadowSteps = static_cast<int>(kBaseShadowSteps * (1.0f + boost));
+
+    // The tiles differ in exactly what POWER and MAX_ITER would bake in.
+    ShaderDefines defines = fractalDefines(view, frame, FractalPass::Forward);
+    defines.erase("POWER");
+    defines.erase("MAX_ITER");
+    defines["SWEEP"] = "";
+    const FractalProgram *fp = variants_.get(defines);
+    GLuint upscale = cache_.get(vsPath_, upscalePath_);
+    if (!fp || !upscale) {
+        active_ = false;
+        return false;
+    }
+
+    // The viewer's buffer has had the binding point since the last call.
+    FractalParamsStd140 params = packFractalParams(view);
+    params_.invalidate();
+    params_.update(&params);
+    std::vector<float> tiles(kMaxTiles * 4, 0.0f);
+    for (int i = 0; i < count(); i++) {
+        tiles[i * 4 + 0] = presets_[i].power;
+        tiles[i * 4 + 1] = presets_[i].bailout;
+        tiles[i * 4 + 2] = static_cast<float>(presets_[i].maxIterations);
+    }
+    tiles_.update(tiles.data());
+
+    glUseProgram(fp->program);
+    GLuint block = glGetUniformBlockIndex(fp->program, "SweepParams");
+    if (block != GL_INVALID_INDEX) glUniformBlockBinding(fp->program, block, kSweepParamsBinding);
+    uploadFractalUniforms(*fp, frame);
+    glUniform1i(glGetUniformLocation(fp->program, "u_sweepColumns"), columns_);
+    glUniform2f(glGetUniformLocation(fp->program, "u_sweepTileSize"),
+                static_cast<float>(tileSize_), static_cast<float>(tileSize_));
+    glUniform2f(glGetUniformLocation(fp->program, "u_sweepAtlasSize"),
+                static_cast<float>(columns_ * tileSize_), static_cast<float>(rows_ * tileSize_));
+
+    const RenderTarget &history = targets_[current_];
+    const RenderTarget &output  = targets_[1 - current_];
+    glBindFramebuffer(GL_FRAMEBUFFER, output.fbo);
+    glViewport(0, 0, output.width, output.height);
+    glActiveTexture(GL_TEXTURE0 + kUnitHistory);
+    glBindTexture(GL_TEXTURE_2D, history.color[0]);
+    glBindVertexArray(vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    current_ = 1 - current_;
+    sample_++;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, display_.fbo);
+    glUseProgram(upscale);
+    glUniform1i(glGetUniformLocation(upscale, "u_source"), 0);
+    glUniform2f(glGetUniformLocation(upscale, "u_uvScale"), 1.0f, 1.0f);
+    glUniform2f(glGetUniformLocation(upscale, "u_texelSize"),
+                1.0f / display_.width, 1.0f / display_.height);
+    glUniform1f(glGetUniformLocation(upscale, "u_sharpness"), 0.0f);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, output.color[0]);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return true;
+}
+
+void ParameterSweep::tileUV(int i, float uv0[2], float uv1[2]) const {
+    // Row 0 is at the bottom of the texture and ImGui draws v = 0 at the
+    // top, so the rows flip.
+    int column = i % columns_, row = i / columns_;
+    uv0[0] = static_cast<float>(column) / columns_;
+    uv1[0] = static_cast<float>(column + 1) / columns_;
+    uv0[1] = static_cast<float>(row + 1) / rows_;
+    uv1[1] = static_cast<float>(row) / rows_;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "fractal_program.h"
+#include "render_settings.h"
+#include "render_target.h"
+#include "shader.h"
+#include "uniform_buffer.h"
+
+// ------------------------- parameter sweep ------------------------- //
+
+// Uniform buffer binding point of sweep.vert's SweepParams block.
+constexpr GLuint kSweepParamsBinding = 1;
+
+// Evenly spaced values from `from` to `to`; one step is just `from`.
+struct SweepRange {
+    float from  = 0.0f;
+    float to    = 0.0f;
+    int   steps = 1;
+
+    float value(int i) const {
+        return steps > 1 ? from + (to - from) * i / (steps - 1) : from;
+    }
+};
+
+// The grid of a sweep: every combination of the three ranges, power
+// varying fastest.
+struct SweepRanges {
+    SweepRange power      {2.0f, 12.0f, 6};
+    SweepRange iterations {4.0f, 16.0f, 4};
+    SweepRange bailout    {2.0f, 2.0f, 1};
+    int tileSize = 96;
+};
+
+// Thumbnails of one view across many fractal parameter sets. All tiles
+// of an atlas render in one instanced draw per sample: sweep.vert places
+// instance i on tile i and reads its power, bailout and iterations from
+// the SweepParams block, and mandelbulb.frag (SWEEP) uses those in place
+// of the view's. Samples accumulate over refine() calls like the view's
+// progressive refinement, and an 8-bit gamma-encoded copy of the atlas
+// is kept for display.
+class ParameterSweep {
+public:
+    // Tiles one SweepParams block holds; mirrored by sweep.vert.
+    static constexpr int kMaxTiles = 1024;
+    // Samples accumulated per tile.
+    static constexpr int kSamples = 8;
+
+    // sweepVsPath is sweep.vert, fsPath mandelbulb.frag; the upscale
+    // program (vsPath, upscalePath) gamma-encodes the atlas.
+    ParameterSweep(ProgramCache &cache, std::string sweepVsPath, std::string fsPath,
+                   std::string vsPath, std::string upscalePath);
+    void destroy();
+
+    // Lays out the tiles of `ranges` over `base` (its camera, shading and
+    // quality) and restarts accumulation. False if the grid is empty or
+    // larger than kMaxTiles, or the atlas could not be allocated.
+    bool start(const RenderSettings &base, const SweepRanges &ranges);
+
+    // Adds one sample to every tile and refreshes texture(). Uses its own
+    // FractalParams buffer at kFractalParamsBinding and leaves the
+    // framebuffer and program bindings at 0. False once kSamples are in,
+    // or if the sweep program failed to build.
+    bool refine(GLuint vao);
+    bool refining() const { return active_ && sample_ < kSamples; }
+
+    int count() const { return static_cast<int>(presets_.size()); }
+    int columns() const { return columns_; }
+    int tileSize() const { return tileSize_; }
+    int samples() const { return sample_; }
+
+    // The settings tile i shows.
+    const RenderSettings &preset(int i) const { return presets_[i]; }
+
+    // Gamma-encoded atlas, and tile i's texture coordinates within it, top
+    // left (uv0) to bottom right (uv1) as ImGui::Image takes them.
+    GLuint texture() const { return display_.color[0]; }
+    void tileUV(int i, float uv0[2], float uv1[2]) const;
+
+private:
+    ProgramCache    &cache_;
+    FractalVariants  variants_;
+    std::string      vsPath_, upscalePath_;
+
+    UniformBuffer params_;
+    UniformBuffer tiles_;
+
+    RenderTarget targets_[2];
+    RenderTarget display_;
+    int current_ = 0;
+
+    RenderSettings base_;
+    std::vector<RenderSettings> presets_;
+    int  columns_ = 0, rows_ = 0, tileSize_ = 0;
+    int  sample_ = 0;
+    bool active_ = false;
+};
@@ -0,0 +1,113 @@
+#include "pixel_readback.h"
+
+#include <algorithm>
+#include <cstring>
+
+static size_t bytesPerPixel(Image::Format format) {
+    return format == Image::RgbaHalf ? 8 : 4;
+}
+
+void PixelReadback::destroy() {
+    for (Slot &slot : slots_) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        if (slot.pbo) glDeleteBuffers(1, &slot.pbo);
+        slot = Slot();
+    }
+    ready_.clear();
+}
+
+int PixelReadback::inFlight() const {
+    int n = 0;
+    for (const Slot &slot : slots_) n += slot.busy ? 1 : 0;
+    return n;
+}
+
+void PixelReadback::start(GLuint fbo, GLenum attachment, int width, int height,
+                          Image::Format format, int tag) {
+    Slot *slot = nullptr;
+    for (Slot &s : slots_) {
+        if (!s.busy) {
+            slot = &s;
+            break;
+        }
+    }
+    if (!slot) {
+        slot = &*std::min_element(slots_.begin(), slots_.end(),
+                                  [](const Slot &a, const Slot &b) { return a.order < b.order; });
+        finish(*slot, true);
+    }
+
+    size_t size = static_cast<size_t>(width) * height * bytesPerPixel(format);
+    if (!slot->pbo) glGenBuffers(1, &slot->pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    if (slot->capacity < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_READ);
+        slot->capacity = size;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glReadBuffer(attachment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA,
+                 format == Image::RgbaHalf ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE, nullptr);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot->fence  = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot->busy   = true;
+    slot->order  = nextOrder_++;
+    slot->tag    = tag;
+    slot->width  = width;
+    slot->height = height;
+    slot->format = format;
+    // Make sure the fence reaches the GPU even if nothing else flushes.
+    glFlush();
+}
+
+bool PixelReadback::finish(Slot &slot, bool wait) {
+    if (!slot.busy) return false;
+
+    GLenum status = glClientWaitSync(slot.fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        if (!wait) return false;
+        status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, ~GLuint64(0));
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    slot.busy  = false;
+
+    Result result;
+    result.tag = slot.tag;
+    result.image.width  = slot.width;
+    result.image.height = slot.height;
+    result.image.format = slot.format;
+    if (status != GL_WAIT_FAILED) {
+        size_t size = static_cast<size_t>(slot.width) * slot.height * bytesPerPixel(slot.format);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                            static_cast<GLsizeiptr>(size), GL_MAP_READ_BIT);
+        if (data) {
+            result.image.pixels.resize(size);
+            std::memcpy(result.image.pixels.data(), data, size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    ready_.push_back(std::move(result));
+    return true;
+}
+
+std::vector<PixelReadback::Result> PixelReadback::collect(bool wait) {
+    // Finish in submission order so frames come out in sequence.
+    for (;;) {
+        Slot *oldest = nullptr;
+        for (Slot &s : slots_) {
+            if (s.busy && (!oldest || s.order < oldest->order)) oldest = &s;
+        }
+        if (!oldest || !finish(*oldest, wait)) break;
+    }
+
+    std::vector<Result> out;
+    out.swap(ready_);
+    return out;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "image_io.h"
+
+// --------------------------- pixel readback ------------------------ //
+
+// glReadPixels into a ring of pixel pack buffers, each fenced, so reading
+// back a frame never waits for the GPU to finish it. The frame is mapped
+// and copied out a few frames later, once its fence has signalled.
+class PixelReadback {
+public:
+    static constexpr int kRing = 3;
+
+    struct Result {
+        int   tag = 0;
+        Image image;
+    };
+
+    void destroy();
+
+    // Queues a read of `attachment` of `fbo`. Image::Rgba8 reads
+    // GL_UNSIGNED_BYTE and Image::RgbaHalf reads GL_HALF_FLOAT, both RGBA.
+    // When every buffer is in flight the oldest one is finished first and
+    // held for the next collect().
+    void start(GLuint fbo, GLenum attachment, int width, int height,
+               Image::Format format, int tag);
+
+    // Finished reads, oldest first. With wait=true blocks until all
+    // outstanding reads are done.
+    std::vector<Result> collect(bool wait);
+
+    int inFlight() const;
+
+private:
+    struct Slot {
+        GLuint pbo      = 0;
+        size_t capacity = 0;
+        GLsync fence    = nullptr;
+        bool   busy     = false;
+        long long order = 0;
+        int    tag      = 0;
+        int    width = 0, height = 0;
+        Image::Format format = Image::Rgba8;
+    };
+
+    // Maps and copies a busy slot; blocks on its fence if `wait`.
+    bool finish(Slot &slot, bool wait);
+
+    std::array<Slot, kRing> slots_{};
+    long long nextOrder_ = 0;
+    std::vector<Result> ready_;
+};
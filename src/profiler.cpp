@@ -0,0 +1,182 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "imgui.h"
+
+// --------------------------- TimingHistory ------------------------- //
+
+void TimingHistory::push(float ms) {
+    samples_[head_] = ms;
+    head_ = (head_ + 1) % kCapacity;
+    count_ = std::min(count_ + 1, kCapacity);
+    total_++;
+}
+
+void TimingHistory::clear() {
+    head_  = 0;
+    count_ = 0;
+}
+
+float TimingHistory::latest() const {
+    if (count_ == 0) return 0.0f;
+    return samples_[(head_ + kCapacity - 1) % kCapacity];
+}
+
+TimingStats TimingHistory::stats() const {
+    TimingStats s;
+    if (count_ == 0) return s;
+
+    std::array<float, kCapacity> sorted;
+    std::copy(samples_.begin(), samples_.begin() + count_, sorted.begin());
+    std::sort(sorted.begin(), sorted.begin() + count_);
+
+    float sum = 0.0f;
+    for (int i = 0; i < count_; i++) sum += sorted[i];
+
+    int p99Index = static_cast<int>(std::ceil(0.99f * count_)) - 1;
+    s.min = sorted[0];
+    s.avg = sum / static_cast<float>(count_);
+    s.p99 = sorted[std::clamp(p99Index, 0, count_ - 1)];
+    return s;
+}
+
+// --------------------------- FrameProfiler ------------------------- //
+
+int FrameProfiler::addGpuPass(const std::string &name) {
+    GpuPass pass;
+    pass.name = name;
+    gpu_.push_back(pass);
+    return static_cast<int>(gpu_.size()) - 1;
+}
+
+int FrameProfiler::addCpuSection(const std::string &name) {
+    CpuSection section;
+    section.name = name;
+    cpu_.push_back(section);
+    return static_cast<int>(cpu_.size()) - 1;
+}
+
+void FrameProfiler::init() {
+    for (GpuPass &pass : gpu_) {
+        glGenQueries(kQueryRing, pass.queries.data());
+        pass.pending.fill(false);
+    }
+    initialized_ = true;
+}
+
+void FrameProfiler::shutdown() {
+    if (!initialized_) return;
+    for (GpuPass &pass : gpu_) {
+        glDeleteQueries(kQueryRing, pass.queries.data());
+        pass.queries.fill(0);
+        pass.pending.fill(false);
+    }
+    initialized_ = false;
+}
+
+void FrameProfiler::collectGpuResults() {
+    for (GpuPass &pass : gpu_) {
+        // Queries complete in submission order, so walk the ring from the
+        // oldest outstanding frame and stop at the first unfinished one.
+        for (int n = 0; n < kQueryRing; n++) {
+            int oldest = -1;
+            for (int i = 0; i < kQueryRing; i++) {
+                if (pass.pending[i] &&
+                    (oldest < 0 || pass.frameOf[i] < pass.frameOf[oldest])) {
+                    oldest = i;
+                }
+            }
+            if (oldest < 0) break;
+
+            GLint available = 0;
+            glGetQueryObjectiv(pass.queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) break;
+
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(pass.queries[oldest], GL_QUERY_RESULT, &ns);
+            pass.pending[oldest] = false;
+            pass.history.push(static_cast<float>(ns) * 1e-6f);
+        }
+    }
+}
+
+void FrameProfiler::beginFrame() {
+    frameStart_ = Clock::now();
+    for (CpuSection &section : cpu_) section.accumMs = 0.0f;
+    if (initialized_) collectGpuResults();
+}
+
+void FrameProfiler::endFrame() {
+    for (CpuSection &section : cpu_) section.history.push(section.accumMs);
+
+    std::chrono::duration<float, std::milli> total = Clock::now() - frameStart_;
+    frame_.push(total.count());
+    frameIndex_++;
+}
+
+void FrameProfiler::beginGpu(int pass) {
+    GpuPass &p = gpu_[pass];
+    int slot = static_cast<int>(frameIndex_ % kQueryRing);
+
+    // The slot's previous query is still running: drop this frame's sample
+    // rather than block on it.
+    p.active = initialized_ && !p.pending[slot];
+    if (!p.active) return;
+
+    glBeginQuery(GL_TIME_ELAPSED, p.queries[slot]);
+}
+
+void FrameProfiler::endGpu(int pass) {
+    GpuPass &p = gpu_[pass];
+    if (!p.active) return;
+
+    int slot = static_cast<int>(frameIndex_ % kQueryRing);
+    glEndQuery(GL_TIME_ELAPSED);
+    p.pending[slot] = true;
+    p.frameOf[slot] = frameIndex_;
+    p.active = false;
+}
+
+void FrameProfiler::beginCpu(int section) {
+    cpu_[section].start = Clock::now();
+}
+
+void FrameProfiler::endCpu(int section) {
+    std::chrono::duration<float, std::milli> elapsed = Clock::now() - cpu_[section].start;
+    cpu_[section].accumMs += elapsed.count();
+}
+
+// ------------------------------ UI --------------------------------- //
+
+static void drawTimingRow(const char *label, const TimingHistory &history) {
+    TimingStats s = history.stats();
+
+    char overlay[96];
+    std::snprintf(overlay, sizeof(overlay), "%.2f ms  (min %.2f / avg %.2f / p99 %.2f)",
+                  history.latest(), s.min, s.avg, s.p99);
+
+    ImGui::Text("%s", label);
+    ImGui::PushID(label);
+    ImGui::PlotLines("##graph", history.data(), history.size(), history.offset(),
+                     overlay, 0.0f, std::max(s.p99 * 1.25f, 1.0f), ImVec2(0.0f, 40.0f));
+    ImGui::PopID();
+}
+
+void FrameProfiler::drawImGui() {
+    drawTimingRow("Frame (CPU)", frame_);
+
+    ImGui::Separator();
+    ImGui::Text("GPU passes");
+    for (const GpuPass &pass : gpu_) {
+        drawTimingRow(pass.name.c_str(), pass.history);
+    }
+
+    ImGui::Separator();
+    ImGui::Text("CPU sections");
+    for (const CpuSection &section : cpu_) {
+        drawTimingRow(section.name.c_str(), section.history);
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+// --------------------------- timing stats -------------------------- //
+
+struct TimingStats {
+    float min = 0.0f;
+    float avg = 0.0f;
+    float p99 = 0.0f;
+};
+
+// Fixed-size ring of per-frame samples in milliseconds.
+class TimingHistory {
+public:
+    static constexpr int kCapacity = 240;
+
+    void  push(float ms);
+    void  clear();
+
+    int   size() const { return count_; }
+    float latest() const;
+    // Total samples ever pushed; lets consumers notice fresh results.
+    unsigned long long sampleCount() const { return total_; }
+    TimingStats stats() const;
+
+    // Raw ring storage plus the index of the oldest sample, in the form
+    // ImGui::PlotLines expects (values + values_offset).
+    const float *data() const { return samples_.data(); }
+    int   offset() const { return count_ < kCapacity ? 0 : head_; }
+
+private:
+    std::array<float, kCapacity> samples_{};
+    int head_  = 0;
+    int count_ = 0;
+    unsigned long long total_ = 0;
+};
+
+// ---------------------------- profiler ----------------------------- //
+
+// Collects GL_TIME_ELAPSED timings for GPU passes and steady_clock timings
+// for CPU sections of the main loop. GPU queries live in a small ring per
+// pass and are only read back once GL_QUERY_RESULT_AVAILABLE reports them
+// done, so the profiler never waits on the GPU.
+class FrameProfiler {
+public:
+    // Frames a query may stay in flight before its slot is reused.
+    static constexpr int kQueryRing = 3;
+
+    int  addGpuPass(const std::string &name);
+    int  addCpuSection(const std::string &name);
+
+    // Must be called with a current GL context, after all passes are added.
+    void init();
+    void shutdown();
+
+    void beginFrame();
+    void endFrame();
+
+    void beginGpu(int pass);
+    void endGpu(int pass);
+
+    void beginCpu(int section);
+    void endCpu(int section);
+
+    const TimingHistory &gpuHistory(int pass) const { return gpu_[pass].history; }
+    const TimingHistory &cpuHistory(int section) const { return cpu_[section].history; }
+    const TimingHistory &frameHistory() const { return frame_; }
+
+    // Draws the graphs and min/avg/p99 table into the current ImGui window.
+    void drawImGui();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct GpuPass {
+        std::string name;
+        std::array<GLuint, kQueryRing> queries{};
+        std::array<bool, kQueryRing>   pending{};
+        std::array<long long, kQueryRing> frameOf{};
+        bool active = false;
+        TimingHistory history;
+    };
+
+    struct CpuSection {
+        std::string name;
+        Clock::time_point start;
+        float accumMs = 0.0f;
+        TimingHistory history;
+    };
+
+    void collectGpuResults();
+
+    std::vector<GpuPass>    gpu_;
+    std::vector<CpuSection> cpu_;
+    TimingHistory      frame_;
+    Clock::time_point  frameStart_;
+    long long          frameIndex_ = 0;
+    bool               initialized_ = false;
+};
@@ -0,0 +1,176 @@
+#include "program_binary_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+#include "shader_log.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char     kMagic[4] = {'M', 'B', 'P', 'B'};
+constexpr uint32_t kFormatVersion = 1;
+
+struct EntryHeader {
+    char     magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t driverHash;
+    uint32_t binaryFormat;
+    uint32_t length;
+};
+
+// 64-bit FNV-1a; `seed` chains several strings into one hash.
+uint64_t fnv1a(const std::string &s, uint64_t seed = 1469598103934665603ull) {
+    uint64_t h = seed;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+uint64_t hashSources(const std::string &vsSource, const std::string &fsSource) {
+    return fnv1a(fsSource, fnv1a(std::string(1, '\0'), fnv1a(vsSource)));
+}
+
+std::string glString(GLenum name) {
+    const GLubyte *s = glGetString(name);
+    return s ? reinterpret_cast<const char *>(s) : "";
+}
+
+} // namespace
+
+ProgramBinaryCache::ProgramBinaryCache(std::string directory)
+    : directory_(std::move(directory)) {
+    GLint formats = 0;
+    if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    if (formats <= 0) return;
+
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    if (ec) {
+        shaderLog(ShaderLogLevel::Error, "Program cache disabled: can't create " +
+                                             directory_ + ": " + ec.message());
+        return;
+    }
+
+    std::string driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" +
+                         glString(GL_VERSION);
+    driverHash_ = fnv1a(driver);
+    enabled_ = true;
+}
+
+std::string ProgramBinaryCache::pathFor(uint64_t sourceHash) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin",
+                  static_cast<unsigned long long>(sourceHash));
+    return (fs::path(directory_) / name).string();
+}
+
+void ProgramBinaryCache::retire(const std::string &path, const char *reason) {
+    shaderLog(ShaderLogLevel::Info,
+              "Program cache: " + path + " " + reason + ", recompiling");
+    misses_++;
+    std::error_code ec;
+    fs::rename(path, path + ".stale", ec);
+    if (ec) fs::remove(path, ec);
+}
+
+GLuint ProgramBinaryCache::load(const std::string &vsSource, const std::string &fsSource) {
+    if (!enabled_) return 0;
+
+    uint64_t sourceHash = hashSources(vsSource, fsSource);
+    std::string path = pathFor(sourceHash);
+
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file) {
+        misses_++;
+        return 0;
+    }
+
+    EntryHeader header{};
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    std::vector<char> binary;
+    bool valid = file && std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+                 header.version == kFormatVersion && header.sourceHash == sourceHash;
+    if (valid) {
+        binary.resize(header.length);
+        file.read(binary.data(), header.length);
+        valid = static_cast<bool>(file);
+    }
+    file.close();
+
+    if (!valid) {
+        retire(path, "is unreadable");
+        return 0;
+    }
+    if (header.driverHash != driverHash_) {
+        retire(path, "was built by another driver");
+        return 0;
+    }
+
+    GLuint prog = glCreateProgram();
+    glProgramBinary(prog, header.binaryFormat, binary.data(),
+                    static_cast<GLsizei>(binary.size()));
+    GLint status = GL_FALSE;
+    glGetProgramiv(prog, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        glDeleteProgram(prog);
+        retire(path, "was rejected by the driver");
+        return 0;
+    }
+
+    hits_++;
+    return prog;
+}
+
+void ProgramBinaryCache::store(GLuint program, const std::string &vsSource,
+                               const std::string &fsSource) {
+    if (!enabled_ || !program) return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    uint64_t sourceHash = hashSources(vsSource, fsSource);
+    EntryHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version      = kFormatVersion;
+    header.sourceHash   = sourceHash;
+    header.driverHash   = driverHash_;
+    header.binaryFormat = format;
+    header.length       = static_cast<uint32_t>(length);
+
+    // Write beside the entry and rename over it, so a crash mid-write
+    // never leaves a truncated binary under the real name.
+    std::string path = pathFor(sourceHash);
+    std::string tmp  = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(binary.data(), length);
+        if (!file) {
+            shaderLog(ShaderLogLevel::Error, "Program cache: failed to write " + tmp);
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        shaderLog(ShaderLogLevel::Error,
+                  "Program cache: failed to replace " + path + ": " + ec.message());
+        fs::remove(tmp, ec);
+    }
+}
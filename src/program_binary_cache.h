@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <GL/glew.h>
+
+// ------------------------ program binary cache --------------------- //
+
+// Stores linked programs on disk with glGetProgramBinary so the next
+// launch can skip compiling. Entries are named by a hash of the final
+// sources (defines included) and carry a hash of the GL vendor, renderer
+// and version strings; an entry written by another driver, or one the
+// driver refuses to load, is renamed to *.stale and rebuilt from source.
+class ProgramBinaryCache {
+public:
+    // Needs a current GL context. Disabled when the driver exposes no
+    // binary formats or the directory can't be created.
+    explicit ProgramBinaryCache(std::string directory);
+
+    bool enabled() const { return enabled_; }
+
+    // A linked program for exactly these sources, or 0 on a miss.
+    GLuint load(const std::string &vsSource, const std::string &fsSource);
+    // Saves a program linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+    void   store(GLuint program, const std::string &vsSource, const std::string &fsSource);
+
+    int hits() const { return hits_; }
+    int misses() const { return misses_; }
+
+private:
+    std::string pathFor(uint64_t sourceHash) const;
+    void retire(const std::string &path, const char *reason);
+
+    std::string directory_;
+    uint64_t    driverHash_ = 0;
+    bool        enabled_ = false;
+    int         hits_ = 0;
+    int         misses_ = 0;
+};
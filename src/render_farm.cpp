@@ -0,0 +1,736 @@
+#include "render_farm.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <GL/glew.h>
+
+#include "image_io.h"
+#include "offline_renderer.h"
+#include "pixel_readback.h"
+#include "render_settings.h"
+#include "settings_io.h"
+
+#ifndef _WIN32
+
+using Clock = std::chrono::steady_clock;
+
+// ----------------------------- protocol ---------------------------- //
+
+// Header: kMagic, type, payload bytes, each a little-endian u32.
+static const uint32_t kMagic           = 0x46524d42;   // "BMRF"
+static const uint32_t kProtocolVersion = 2;
+static const uint32_t kMaxPayload      = 1u << 30;
+
+enum class MessageType : uint32_t {
+    Hello  = 1,   // worker: protocol version, host name, GL renderer, largest tile
+    Tile   = 2,   // coordinator: one tile to render (TileJob)
+    Result = 3,   // worker: tile id, format, width, height, pixels
+    Failed = 4,   // worker: tile id, message
+    Done   = 5,   // coordinator: no more work
+};
+
+namespace {
+
+struct PayloadWriter {
+    std::vector<uint8_t> bytes;
+
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; i++) bytes.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+    void i32(int v) { u32(static_cast<uint32_t>(v)); }
+    void f32(float v) {
+        uint32_t bits;
+        std::memcpy(&bits, &v, 4);
+        u32(bits);
+    }
+    void str(const std::string &s) {
+        u32(static_cast<uint32_t>(s.size()));
+        bytes.insert(bytes.end(), s.begin(), s.end());
+    }
+};
+
+// Reads past the end leave ok false and return zeros.
+struct PayloadReader {
+    const uint8_t *p, *end;
+    bool ok = true;
+
+    PayloadReader(const uint8_t *data, size_t size) : p(data), end(data + size) {}
+
+    uint32_t u32() {
+        if (end - p < 4) {
+            ok = false;
+            return 0;
+        }
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++) v |= static_cast<uint32_t>(p[i]) << (8 * i);
+        p += 4;
+        return v;
+    }
+    int i32() { return static_cast<int>(u32()); }
+    float f32() {
+        uint32_t bits = u32();
+        float v;
+        std::memcpy(&v, &bits, 4);
+        return v;
+    }
+    std::string str() {
+        uint32_t size = u32();
+        if (static_cast<size_t>(end - p) < size) {
+            ok = false;
+            return std::string();
+        }
+        std::string s(reinterpret_cast<const char *>(p), size);
+        p += size;
+        return s;
+    }
+};
+
+// What a worker needs for one tile, with nothing left to the worker's own
+// defaults.
+struct TileJob {
+    uint32_t id = 0;
+    int   frame = 0;
+    int   width = 0, height = 0;
+    int   samples = 0;
+    bool  hdr = false;
+    TileRect rect;
+    float time = 0.0f;
+    std::string settings;   // formatSettings
+};
+
+} // namespace
+
+static std::vector<uint8_t> encodeTileJob(const TileJob &job) {
+    PayloadWriter w;
+    w.u32(job.id);
+    w.i32(job.frame);
+    w.i32(job.width);
+    w.i32(job.height);
+    w.i32(job.samples);
+    w.u32(job.hdr ? 1 : 0);
+    w.i32(job.rect.x);
+    w.i32(job.rect.y);
+    w.i32(job.rect.width);
+    w.i32(job.rect.height);
+    w.f32(job.time);
+    w.str(job.settings);
+    return w.bytes;
+}
+
+static bool decodeTileJob(const std::vector<uint8_t> &payload, TileJob &job) {
+    PayloadReader r(payload.data(), payload.size());
+    job.id      = r.u32();
+    job.frame   = r.i32();
+    job.width   = r.i32();
+    job.height  = r.i32();
+    job.samples = r.i32();
+    job.hdr     = r.u32() != 0;
+    job.rect.x      = r.i32();
+    job.rect.y      = r.i32();
+    job.rect.width  = r.i32();
+    job.rect.height = r.i32();
+    job.time     = r.f32();
+    job.settings = r.str();
+    return r.ok;
+}
+
+static bool sendAll(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::send(fd, data, size, 0);
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool sendMessage(int fd, MessageType type, const std::vector<uint8_t> &payload) {
+    PayloadWriter header;
+    header.u32(kMagic);
+    header.u32(static_cast<uint32_t>(type));
+    header.u32(static_cast<uint32_t>(payload.size()));
+    return sendAll(fd, header.bytes.data(), header.bytes.size()) &&
+           sendAll(fd, payload.data(), payload.size());
+}
+
+static bool recvAll(int fd, uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::recv(fd, data, size, 0);
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Blocking; false when the connection closed or sent garbage.
+static bool recvMessage(int fd, MessageType &type, std::vector<uint8_t> &payload) {
+    uint8_t header[12];
+    if (!recvAll(fd, header, sizeof(header))) return false;
+    PayloadReader r(header, sizeof(header));
+    uint32_t magic = r.u32();
+    type = static_cast<MessageType>(r.u32());
+    uint32_t size = r.u32();
+    if (magic != kMagic || size > kMaxPayload) return false;
+    payload.resize(size);
+    return recvAll(fd, payload.data(), size);
+}
+
+// Takes one whole message off the front of `buffer`, if there is one.
+// Sets `bad` on a corrupt header.
+static bool popMessage(std::vector<uint8_t> &buffer, MessageType &type,
+                       std::vector<uint8_t> &payload, bool &bad) {
+    if (buffer.size() < 12) return false;
+    PayloadReader r(buffer.data(), 12);
+    uint32_t magic = r.u32();
+    type = static_cast<MessageType>(r.u32());
+    uint32_t size = r.u32();
+    if (magic != kMagic || size > kMaxPayload) {
+        bad = true;
+        return false;
+    }
+    if (buffer.size() < 12 + static_cast<size_t>(size)) return false;
+    payload.assign(buffer.begin() + 12, buffer.begin() + 12 + size);
+    buffer.erase(buffer.begin(), buffer.begin() + 12 + size);
+    return true;
+}
+
+static void setNoDelay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+// --------------------------- coordinator --------------------------- //
+
+namespace {
+
+struct TileState {
+    TileRect rect;
+    bool done   = false;
+    bool queued = false;   // waiting in the pending queue
+    int  copies = 0;       // workers currently holding it
+    int  attempts = 0;
+    Clock::time_point issued;
+};
+
+struct FrameState {
+    std::string settings;   // formatSettings
+    float time = 0.0f;
+    std::vector<TileState> tiles;
+    int remaining = 0;
+    std::vector<uint8_t> pixels;   // bottom-up, as the tiles come back
+};
+
+struct Connection {
+    int fd = -1;
+    std::string name;              // from Hello; empty until then
+    std::vector<uint8_t> in;       // received, not yet a whole message
+    std::vector<uint32_t> tiles;   // ids it holds
+    int rendered = 0;
+    std::string refused;           // why it was turned away, if it was
+};
+
+} // namespace
+
+static bool isExr(const std::string &path) {
+    if (path.size() < 4) return false;
+    std::string ext = path.substr(path.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    return ext == ".exr";
+}
+
+// Writes a finished frame in the strips renderTiledFrame streams, top
+// strip first, so the encoder sees the same row groups.
+static bool writeFrame(const std::string &path, int width, int height, bool hdr,
+                       const std::vector<uint8_t> &pixels, int tileSize) {
+    ImageStreamWriter writer;
+    if (!writer.open(path, width, height, hdr ? Image::RgbaHalf : Image::Rgba8)) return false;
+    const std::ptrdiff_t stride = static_cast<std::ptrdiff_t>(width) * (hdr ? 8 : 4);
+
+    bool ok = true;
+    const int stripCount = (height + tileSize - 1) / tileSize;
+    for (int k = stripCount - 1; k >= 0 && ok; k--) {
+        const int y0 = k * tileSize;
+        const int rows = std::min(tileSize, height - y0);
+        ok = writer.writeRows(pixels.data() + (y0 + rows - 1) * stride, rows, -stride);
+    }
+    return writer.close() && ok;
+}
+
+int runFarmCoordinator(const HeadlessOptions &options, const Timeline &timeline, int frames,
+                       int tileSize) {
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int listener = ::socket(AF_INET6, SOCK_STREAM, 0);
+    bool v6 = listener >= 0;
+    if (!v6) listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::perror("socket");
+        return 1;
+    }
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    int bound;
+    if (v6) {
+        // Dual-stack, so IPv4 workers can connect too.
+        int zero = 0;
+        setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+        sockaddr_in6 addr{};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_addr   = in6addr_any;
+        addr.sin6_port   = htons(static_cast<uint16_t>(options.farmPort));
+        bound = ::bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    } else {
+        sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port        = htons(static_cast<uint16_t>(options.farmPort));
+        bound = ::bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    }
+    if (bound != 0 || ::listen(listener, 64) != 0) {
+        std::perror("bind");
+        ::close(listener);
+        return 1;
+    }
+
+    const bool hdr = isExr(options.output);
+    const size_t pixelBytes = hdr ? 8 : 4;
+    const int columns = (options.width + tileSize - 1) / tileSize;
+    const int rows    = (options.height + tileSize - 1) / tileSize;
+    const int tilesPerFrame = columns * rows;
+    const int largestTile = std::min(tileSize, std::max(options.width, options.height));
+    const auto timeout = std::chrono::seconds(options.farmTimeout);
+
+    std::printf("Coordinating %d frame(s) of %dx%d in %d %dx%d tiles each on port %d\n",
+                frames, options.width, options.height, tilesPerFrame, tileSize, tileSize,
+                options.farmPort);
+    std::fflush(stdout);
+
+    std::map<int, FrameState> open;
+    std::deque<uint32_t> pending;   // re-issues go to the front
+    std::vector<Connection> workers;
+    RenderSettings settings = timeline.keys().front().settings;
+    int nextFrame = 0, written = 0, failed = 0;
+    std::future<bool> writing;
+    bool abandoned = false;
+
+    // The same settings chain as the single-node loop in runHeadless.
+    auto openFrames = [&] {
+        while (nextFrame < frames && static_cast<int>(open.size()) < kFarmFramesInFlight) {
+            int frame = nextFrame++;
+            settings = timeline.evaluate(frame / options.fps, settings);
+            FrameState &state = open[frame];
+            state.settings = formatSettings(settings);
+            state.time = static_cast<float>(frame / options.fps);
+            state.pixels.assign(static_cast<size_t>(options.width) * options.height * pixelBytes, 0);
+            state.tiles.resize(tilesPerFrame);
+            state.remaining = tilesPerFrame;
+            // Tiles in the order a single node renders them, top row first.
+            for (int k = rows - 1, t = 0; k >= 0; k--) {
+                for (int c = 0; c < columns; c++, t++) {
+                    TileState &tile = state.tiles[t];
+                    tile.rect.x = c * tileSize;
+                    tile.rect.y = k * tileSize;
+                    tile.rect.width  = std::min(tileSize, options.width - tile.rect.x);
+                    tile.rect.height = std::min(tileSize, options.height - tile.rect.y);
+                    tile.queued = true;
+                    pending.push_back(static_cast<uint32_t>(frame * tilesPerFrame + t));
+                }
+            }
+        }
+    };
+
+    auto tileOf = [&](uint32_t id, FrameState *&frame) -> TileState * {
+        auto it = open.find(static_cast<int>(id / tilesPerFrame));
+        if (it == open.end()) return nullptr;
+        frame = &it->second;
+        return &frame->tiles[id % tilesPerFrame];
+    };
+
+    // A copy of `id` that won't come back: queue it again if no other
+    // worker has one out.
+    auto release = [&](uint32_t id) {
+        FrameState *frame = nullptr;
+        TileState *tile = tileOf(id, frame);
+        if (!tile) return;
+        tile->copies = std::max(tile->copies - 1, 0);
+        if (!tile->done && tile->copies == 0 && !tile->queued) {
+            tile->queued = true;
+            pending.push_front(id);
+        }
+    };
+
+    auto drop = [&](size_t index, const char *why) {
+        Connection &c = workers[index];
+        std::printf("worker %s %s (%d tiles rendered)\n",
+                    c.name.empty() ? "(unnamed)" : c.name.c_str(), why, c.rendered);
+        ::close(c.fd);
+        std::vector<uint32_t> held = std::move(c.tiles);
+        workers.erase(workers.begin() + static_cast<std::ptrdiff_t>(index));
+        for (uint32_t id : held) release(id);
+    };
+
+    auto finishFrame = [&](int frame) {
+        FrameState &state = open[frame];
+        if (writing.valid()) {
+            if (writing.get()) written++;
+            else failed++;
+        }
+        std::string path = framePath(options.output, frame, frames);
+        writing = std::async(std::launch::async,
+                             [path, pixels = std::move(state.pixels), &options, hdr, tileSize] {
+            bool ok = writeFrame(path, options.width, options.height, hdr, pixels, tileSize);
+            if (!ok) std::cerr << "Failed to write " << path << std::endl;
+            return ok;
+        });
+        open.erase(frame);
+        std::printf("frame %d/%d assembled, %zu worker(s)\n", frame + 1, frames, workers.size());
+        std::fflush(stdout);
+    };
+
+    auto handle = [&](size_t index, MessageType type, const std::vector<uint8_t> &payload) -> bool {
+        Connection &c = workers[index];
+        PayloadReader r(payload.data(), payload.size());
+        if (type == MessageType::Hello) {
+            uint32_t version = r.u32();
+            std::string host = r.str(), renderer = r.str();
+            int maxTile = r.i32();
+            if (!r.ok || version != kProtocolVersion) return false;
+            c.name = host.empty() ? "?" : host;
+            // Its targets couldn't hold a tile: every one would fail.
+            if (maxTile < largestTile) {
+                c.refused = "can't allocate " + std::to_string(largestTile) + "-pixel tiles (" +
+                            std::to_string(maxTile) + " at most; lower --tile) and was dropped";
+                return false;
+            }
+            std::printf("worker %s joined (%s)\n", c.name.c_str(), renderer.c_str());
+            return true;
+        }
+        if (c.name.empty() || (type != MessageType::Result && type != MessageType::Failed)) {
+            return false;
+        }
+
+        uint32_t id = r.u32();
+        auto held = std::find(c.tiles.begin(), c.tiles.end(), id);
+        if (held == c.tiles.end()) return false;
+        c.tiles.erase(held);
+
+        FrameState *frame = nullptr;
+        TileState *tile = tileOf(id, frame);
+        if (type == MessageType::Failed) {
+            std::string message = r.str();
+            std::printf("worker %s failed a tile: %s\n", c.name.c_str(), message.c_str());
+            release(id);
+            return true;
+        }
+
+        uint32_t format = r.u32();
+        int width = r.i32(), height = r.i32();
+        // Late copies of a tile that was re-issued are dropped.
+        if (!tile || tile->done) {
+            if (tile) tile->copies = std::max(tile->copies - 1, 0);
+            return r.ok;
+        }
+
+        size_t rowBytes = static_cast<size_t>(tile->rect.width) * pixelBytes;
+        if (!r.ok || format != (hdr ? 1u : 0u) || width != tile->rect.width ||
+            height != tile->rect.height ||
+            static_cast<size_t>(r.end - r.p) != rowBytes * height) {
+            release(id);   // its copy, once
+            return false;
+        }
+        tile->copies = std::max(tile->copies - 1, 0);
+        const size_t stride = static_cast<size_t>(options.width) * pixelBytes;
+        for (int y = 0; y < height; y++) {
+            std::memcpy(frame->pixels.data() + (tile->rect.y + y) * stride +
+                            tile->rect.x * pixelBytes,
+                        r.p + y * rowBytes, rowBytes);
+        }
+        tile->done = true;
+        c.rendered++;
+        if (--frame->remaining == 0) {
+            finishFrame(static_cast<int>(id / tilesPerFrame));
+            openFrames();
+        }
+        return true;
+    };
+
+    // Hands the front of the queue to free workers.
+    auto issue = [&] {
+        for (Connection &c : workers) {
+            while (!c.name.empty() && static_cast<int>(c.tiles.size()) < kFarmWorkerQueue &&
+                   !abandoned) {
+                // The first tile this worker doesn't already hold; finished
+                // ones are dropped on the way.
+                TileState *tile = nullptr;
+                FrameState *frame = nullptr;
+                auto it = pending.begin();
+                while (it != pending.end()) {
+                    tile = tileOf(*it, frame);
+                    if (!tile || tile->done) {
+                        if (tile) tile->queued = false;
+                        it = pending.erase(it);
+                    } else if (std::find(c.tiles.begin(), c.tiles.end(), *it) != c.tiles.end()) {
+                        ++it;
+                    } else {
+                        break;
+                    }
+                }
+                if (it == pending.end()) break;
+                uint32_t id = *it;
+                pending.erase(it);
+                tile->queued = false;
+                if (++tile->attempts > kFarmMaxAttempts) {
+                    std::cerr << "A tile of frame " << id / tilesPerFrame + 1 << " failed "
+                              << kFarmMaxAttempts << " times; giving up" << std::endl;
+                    abandoned = true;
+                    return;
+                }
+
+                TileJob job;
+                job.id      = id;
+                job.frame   = static_cast<int>(id / tilesPerFrame);
+                job.width   = options.width;
+                job.height  = options.height;
+                job.samples = options.samples;
+                job.hdr     = hdr;
+                job.rect    = tile->rect;
+                job.time    = frame->time;
+                job.settings = frame->settings;
+                // A failed send shows up as a hang-up on the next poll.
+                sendMessage(c.fd, MessageType::Tile, encodeTileJob(job));
+                c.tiles.push_back(id);
+                tile->copies++;
+                tile->issued = Clock::now();
+            }
+        }
+    };
+
+    openFrames();
+    auto start = Clock::now();
+    while (!open.empty() && !abandoned) {
+        issue();
+
+        std::vector<pollfd> fds(workers.size() + 1);
+        fds[0] = {listener, POLLIN, 0};
+        for (size_t i = 0; i < workers.size(); i++) fds[i + 1] = {workers[i].fd, POLLIN, 0};
+        if (::poll(fds.data(), fds.size(), 1000) < 0) continue;
+
+        if (fds[0].revents & POLLIN) {
+            int fd = ::accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                setNoDelay(fd);
+                Connection c;
+                c.fd = fd;
+                workers.push_back(std::move(c));
+            }
+        }
+
+        // Backwards, so dropping a worker keeps the earlier indices valid.
+        for (size_t i = fds.size() - 1; i >= 1; i--) {
+            size_t index = i - 1;
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            uint8_t buffer[1 << 16];
+            ssize_t n = ::recv(workers[index].fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                drop(index, "left");
+                continue;
+            }
+            Connection &c = workers[index];
+            c.in.insert(c.in.end(), buffer, buffer + n);
+
+            MessageType type;
+            std::vector<uint8_t> payload;
+            bool bad = false, ok = true;
+            while (ok && popMessage(workers[index].in, type, payload, bad)) {
+                ok = handle(index, type, payload);
+            }
+            if (bad || !ok) {
+                drop(index, workers[index].refused.empty()
+                                ? "sent a bad message and was dropped"
+                                : workers[index].refused.c_str());
+            }
+        }
+
+        // Tiles out too long go to the next free worker too.
+        auto now = Clock::now();
+        for (auto &entry : open) {
+            for (size_t t = 0; t < entry.second.tiles.size(); t++) {
+                TileState &tile = entry.second.tiles[t];
+                if (!tile.done && !tile.queued && tile.copies > 0 && now - tile.issued > timeout) {
+                    tile.queued = true;
+                    pending.push_front(static_cast<uint32_t>(entry.first * tilesPerFrame + t));
+                }
+            }
+        }
+    }
+
+    if (writing.valid()) {
+        if (writing.get()) written++;
+        else failed++;
+    }
+    for (Connection &c : workers) {
+        sendMessage(c.fd, MessageType::Done, {});
+        ::close(c.fd);
+    }
+    ::close(listener);
+
+    std::chrono::duration<double> total = Clock::now() - start;
+    std::printf("%d frame(s) written, %d failed, %.2f s\n", written, failed, total.count());
+    return abandoned || failed > 0 || written < frames ? 1 : 0;
+}
+
+// ------------------------------ worker ----------------------------- //
+
+static int connectTo(const std::string &address) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon == 0) return -1;
+    std::string host = address.substr(0, colon), port = address.substr(colon + 1);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    addrinfo hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *found = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0) return -1;
+    int fd = -1;
+    for (addrinfo *a = found; a && fd < 0; a = a->ai_next) {
+        fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+int runFarmWorker(const HeadlessOptions &options, const std::string &shaderDir) {
+    std::signal(SIGPIPE, SIG_IGN);
+
+    // The coordinator may still be starting up.
+    int fd = -1;
+    for (int attempt = 0; attempt < 30 && fd < 0; attempt++) {
+        fd = connectTo(options.farmCoordinator);
+        if (fd < 0) std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    if (fd < 0) {
+        std::cerr << "Can't reach the coordinator at " << options.farmCoordinator << std::endl;
+        return 1;
+    }
+    setNoDelay(fd);
+
+    OfflineRenderer renderer(shaderDir);
+    if (!renderer.init()) {
+        flushShaderLog();
+        renderer.shutdown();
+        ::close(fd);
+        return 1;
+    }
+    flushShaderLog();
+
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    PayloadWriter hello;
+    hello.u32(kProtocolVersion);
+    hello.str(host);
+    const GLubyte *gpu = glGetString(GL_RENDERER);
+    hello.str(gpu ? reinterpret_cast<const char *>(gpu) : "");
+    hello.i32(renderer.maxDimension());
+    bool ok = sendMessage(fd, MessageType::Hello, hello.bytes);
+
+    PixelReadback readback;
+    auto sendFinished = [&](bool wait) {
+        for (PixelReadback::Result &r : readback.collect(wait)) {
+            PayloadWriter w;
+            w.u32(static_cast<uint32_t>(r.tag));
+            w.u32(r.image.format == Image::RgbaHalf ? 1 : 0);
+            w.i32(r.image.width);
+            w.i32(r.image.height);
+            w.bytes.insert(w.bytes.end(), r.image.pixels.begin(), r.image.pixels.end());
+            ok = sendMessage(fd, MessageType::Result, w.bytes) && ok;
+        }
+    };
+
+    int rendered = 0;
+    MessageType type = MessageType::Hello;
+    std::vector<uint8_t> payload;
+    while (ok) {
+        // With no tile waiting, the reads in flight won't overlap any
+        // rendering: send them now.
+        pollfd p = {fd, POLLIN, 0};
+        if (readback.inFlight() > 0 && ::poll(&p, 1, 0) == 0) sendFinished(true);
+
+        if (!recvMessage(fd, type, payload)) break;
+        if (type == MessageType::Done) break;
+        TileJob job;
+        if (type != MessageType::Tile || !decodeTileJob(payload, job)) break;
+
+        RenderSettings settings;
+        std::string error;
+        bool tileOk =
+            parseSettings(job.settings, "tile settings", settings, &error) &&
+            renderer.renderTile(settings, job.width, job.height, job.rect, job.samples,
+                                job.time) &&
+            (job.hdr || renderer.resolve());
+        flushShaderLog();
+        if (!tileOk) {
+            PayloadWriter w;
+            w.u32(job.id);
+            w.str(error.empty() ? "failed to render the tile" : error);
+            ok = sendMessage(fd, MessageType::Failed, w.bytes);
+            continue;
+        }
+
+        const RenderTarget &source = job.hdr ? renderer.linear() : renderer.resolved();
+        readback.start(source.fbo, GL_COLOR_ATTACHMENT0, source.width, source.height,
+                       job.hdr ? Image::RgbaHalf : Image::Rgba8, static_cast<int>(job.id));
+        sendFinished(false);
+        rendered++;
+    }
+    if (ok) sendFinished(true);
+
+    readback.destroy();
+    renderer.shutdown();
+    ::close(fd);
+    std::printf("%d tile(s) rendered\n", rendered);
+    return type == MessageType::Done ? 0 : 1;
+}
+
+#else
+
+int runFarmCoordinator(const HeadlessOptions &, const Timeline &, int, int) {
+    std::cerr << "The render farm needs POSIX sockets" << std::endl;
+    return 1;
+}
+
+int runFarmWorker(const HeadlessOptions &, const std::string &) {
+    std::cerr << "The render farm needs POSIX sockets" << std::endl;
+    return 1;
+}
+
+#endif
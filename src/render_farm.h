@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+
+#include "headless.h"
+#include "timeline.h"
+
+// --------------------------- render farm --------------------------- //
+
+// Spreads headless renders over machines. The coordinator (no GL) cuts
+// every frame into tiles the way a tiled single-node render does and
+// hands them to workers over TCP: each tile travels with its frame's
+// settings in text form (which round-trips exactly), its time and the
+// image size, and comes back as read-back pixels.
+//
+// Workers pull: each holds at most kFarmWorkerQueue tiles, taking a new one
+// whenever one comes back, so faster GPUs end up rendering more of them.
+// A tile out for longer than --farm-timeout is handed to the next free
+// worker as well and whichever copy arrives first is used; a worker that
+// disconnects has its tiles re-issued at once. Frames are assembled as
+// their tiles arrive, at most kFarmFramesInFlight at a time, and written
+// through the same strip writer as renderTiledFrame, so with the same
+// --tile, shaders and GPU model the files match a single-node render
+// byte for byte.
+//
+// Messages are a little-endian header (magic, type, payload size) and a
+// payload; see render_farm.cpp.
+
+constexpr int kFarmWorkerQueue    = 2;
+constexpr int kFarmFramesInFlight = 2;
+// Attempts of one tile, counting timeouts and worker failures, before
+// the render is abandoned.
+constexpr int kFarmMaxAttempts    = 4;
+// Largest --tile a coordinator accepts, the texture size limit of current
+// GPUs. Workers also report their own limit on joining, and one that
+// can't take the tile size is dropped rather than failing every tile.
+constexpr int kFarmMaxTileSize    = 16384;
+
+// Serves options.farmPort until every frame of the timeline is written.
+// tileSize as chooseTileSize, but never 0. Returns the exit code.
+int runFarmCoordinator(const HeadlessOptions &options, const Timeline &timeline, int frames,
+                       int tileSize);
+
+// Connects to options.farmCoordinator and renders tiles until told to
+// stop. Needs a current GL context; returns the exit code.
+int runFarmWorker(const HeadlessOptions &options, const std::string &shaderDir);
@@ -0,0 +1,75 @@
+#pragma once
+
+// ------------------------ render settings -------------------------- //
+
+struct RenderSettings {
+    // Camera. Placement is in double so deep zoom can position it finely.
+    double camDistance = 4.0;
+    double camYaw      = 0.0;   // around Y
+    double camPitch    = 0.4;   // up/down
+    float fov         = 1.0f;
+    bool  autoRotate  = true;
+    float rotationSpeed = 0.2f; // radians per second
+
+    // Fractal
+    float power       = 8.0f;
+    int   maxIterations = 18;
+    float bailout     = 2.0f;
+
+    // Raymarch
+    int   maxSteps    = 200;
+    float maxDist     = 25.0f;
+    float epsilon     = 0.001f;
+    bool  depthPrepass  = true;   // cone-marched start distances
+    int   prepassFactor = 8;      // coarse tile size in pixels (4 or 8)
+    bool  reprojectDepth  = true; // start from last frame's reprojected depth
+    float reprojectMargin = 0.05f;
+    bool  specializeShaders = true; // bake toggles/limits into cached variants
+    bool  distanceCache   = true;   // march coarse steps through a baked volume
+    int   distanceCacheMB = 64;     // for both of its volumes
+    bool  boundedMarch    = true;   // clip rays to the bailout sphere
+    float relaxation      = 1.3f;   // over-relaxed step factor (1 = plain)
+    bool  distanceLod     = true;   // coarser threshold/iterations with distance
+    float lodBias         = 0.5f;   // hit threshold in pixel footprints
+    float lodIterBias     = 1.0f;   // iterations dropped per power-fold coarser
+    int   deepZoom        = 0;      // 0 off, 1 emulated double-float, 2 native fp64
+
+    // Shading
+    bool  enableAO      = true;
+    bool  enableShadows = true;
+    bool  analyticNormals = false; // dual-number gradient instead of differences
+    bool  deferredShading = true; // shadows/AO at coarse resolution, upsampled
+    int   lightingFactor  = 2;    // coarse lighting scale (2 or 4)
+    bool  lightingCache   = true; // shadows from a baked volume
+    bool  lightingCacheAO = false;// and AO (blurrier than traced)
+    int   lightingCacheMB = 32;   // for both of its volumes
+    float colorA[3]   = {0.2f, 0.3f, 0.6f};
+    float colorB[3]   = {0.8f, 0.9f, 1.0f};
+
+    // Resolution
+    bool  dynamicResolution = true;
+    float targetFPS   = 60.0f;
+    float minScale    = 0.35f;  // fraction of framebuffer size
+    float maxScale    = 1.0f;
+    float renderScale = 1.0f;   // used when dynamic resolution is off
+    bool  checkerboard = false; // march half the pixels of moving frames
+    bool  shadingRate  = false; // coarse background shading (NV_shading_rate_image)
+    float sharpness   = 0.25f;  // edge-aware sharpening in the upscale pass
+    bool  idleCaching = true;   // reuse the last image while nothing changes
+
+    // Frame pacing
+    int   presentMode    = 0;     // 0 vsync, 1 adaptive vsync, 2 uncapped, 3 FPS limit
+    float fpsLimit       = 60.0f;
+    int   maxFramesAhead = 2;     // CPU frames queued before waiting on the GPU
+    bool  lateLatch      = true;  // sample camera input after building the UI
+
+    // Progressive refinement (while the view is static)
+    bool  progressive   = true;
+    int   maxSamples    = 64;     // accumulated jittered samples
+    bool  refineQuality = true;   // ramp step/shadow budgets while refining
+    bool  temporalAA    = true;   // jittered frames blended over time while moving
+
+    // Cost analysis (forward fragment pass only)
+    int   costView      = 0;      // heatmap: 0 off, 1 steps, 2 DE evaluations, 3 outcome
+    bool  costCounters  = false;  // per-frame totals and histograms in the UI
+};
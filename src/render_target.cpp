@@ -0,0 +1,92 @@
+#include "render_target.h"
+
+#include <iostream>
+
+static void externalFormatFor(GLenum internalFormat, GLenum &format, GLenum &type) {
+    switch (internalFormat) {
+    case GL_R32F:
+    case GL_R16F:
+        format = GL_RED;
+        type   = GL_FLOAT;
+        break;
+    case GL_RG32F:
+    case GL_RG16F:
+        format = GL_RG;
+        type   = GL_FLOAT;
+        break;
+    case GL_RGBA32F:
+    case GL_RGBA16F:
+        format = GL_RGBA;
+        type   = GL_FLOAT;
+        break;
+    default:
+        format = GL_RGBA;
+        type   = GL_UNSIGNED_BYTE;
+        break;
+    }
+}
+
+bool ensureRenderTarget(RenderTarget &rt, int width, int height,
+                        std::initializer_list<GLenum> formats) {
+    bool same = rt.fbo != 0 && rt.width == width && rt.height == height &&
+                rt.attachments == static_cast<int>(formats.size());
+    if (same) {
+        int i = 0;
+        for (GLenum f : formats) same = same && rt.formats[i++] == f;
+    }
+    if (same) return true;
+
+    destroyRenderTarget(rt);
+
+    rt.width  = width;
+    rt.height = height;
+    rt.attachments = static_cast<int>(formats.size());
+
+    glGenFramebuffers(1, &rt.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, rt.fbo);
+
+    GLenum drawBuffers[RenderTarget::kMaxAttachments];
+    int i = 0;
+    for (GLenum internalFormat : formats) {
+        GLenum format, type;
+        externalFormatFor(internalFormat, format, type);
+
+        glGenTextures(1, &rt.color[i]);
+        glBindTexture(GL_TEXTURE_2D, rt.color[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0,
+                     format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i,
+                               GL_TEXTURE_2D, rt.color[i], 0);
+        rt.formats[i] = internalFormat;
+        drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+        i++;
+    }
+    glDrawBuffers(rt.attachments, drawBuffers);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Offscreen framebuffer incomplete (0x" << std::hex << status
+                  << std::dec << ")" << std::endl;
+        destroyRenderTarget(rt);
+        return false;
+    }
+    return true;
+}
+
+void destroyRenderTarget(RenderTarget &rt) {
+    if (rt.attachments > 0) {
+        glDeleteTextures(rt.attachments, rt.color);
+    }
+    if (rt.fbo) {
+        glDeleteFramebuffers(1, &rt.fbo);
+    }
+    rt = RenderTarget();
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <initializer_list>
+
+#include <GL/glew.h>
+
+// ------------------------- offscreen targets ----------------------- //
+
+// A framebuffer with up to kMaxAttachments colour textures of one size.
+struct RenderTarget {
+    static constexpr int kMaxAttachments = 4;
+
+    GLuint fbo = 0;
+    GLuint color[kMaxAttachments] = {};
+    GLenum formats[kMaxAttachments] = {};
+    int    attachments = 0;
+    int    width  = 0;
+    int    height = 0;
+};
+
+// (Re)allocates the target when its size or formats differ from the
+// request. Textures are linear-filtered and clamped to edge. Returns false
+// if the resulting framebuffer is incomplete.
+bool ensureRenderTarget(RenderTarget &rt, int width, int height,
+                        std::initializer_list<GLenum> formats);
+void destroyRenderTarget(RenderTarget &rt);
@@ -0,0 +1,33 @@
+#include "resolution_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "render_settings.h"
+
+// Leave a little slack so small spikes don't miss the vsync deadline.
+static constexpr float kBudgetHeadroom = 0.9f;
+// Fraction of the way to the ideal scale taken per measurement.
+static constexpr float kDamping = 0.2f;
+// Ignore corrections smaller than this to avoid visible resolution jitter.
+static constexpr float kDeadband = 0.02f;
+
+void ResolutionController::update(float fractalMs, float fixedMs,
+                                  const RenderSettings &settings) {
+    float lo = std::min(settings.minScale, settings.maxScale);
+    float hi = std::max(settings.minScale, settings.maxScale);
+
+    if (fractalMs > 0.0f && settings.targetFPS > 0.0f) {
+        float budgetMs  = kBudgetHeadroom * 1000.0f / settings.targetFPS - fixedMs;
+        budgetMs        = std::max(budgetMs, 0.1f);
+
+        float ideal = scale_ * std::sqrt(budgetMs / fractalMs);
+        ideal = std::clamp(ideal, lo, hi);
+
+        if (std::fabs(ideal - scale_) > kDeadband * scale_) {
+            scale_ += (ideal - scale_) * kDamping;
+        }
+    }
+
+    scale_ = std::clamp(scale_, lo, hi);
+}
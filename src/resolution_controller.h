@@ -0,0 +1,21 @@
+#pragma once
+
+struct RenderSettings;
+
+// ----------------------- dynamic resolution ------------------------ //
+
+// Picks the fractal render scale (fraction of the framebuffer) so that
+// the GPU frame fits in 1 / targetFPS. Raymarch cost is roughly
+// proportional to pixel count, so the scale moves with the square root of
+// the budget ratio, damped to hide the query latency.
+class ResolutionController {
+public:
+    // fractalMs: GPU time of the scaled fractal pass.
+    // fixedMs:   GPU time of passes that don't scale (upscale, ImGui).
+    void  update(float fractalMs, float fixedMs, const RenderSettings &settings);
+    void  reset(float scale) { scale_ = scale; }
+    float scale() const { return scale_; }
+
+private:
+    float scale_ = 1.0f;
+};
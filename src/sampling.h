@@ -0,0 +1,31 @@
+#pragma once
+
+#include <algorithm>
+
+// ------------------------- sample sequences ------------------------ //
+
+// Radical inverse of index in the given base, in [0, 1). Bases 2 and 3
+// together give a well-stratified 2D sub-pixel jitter sequence.
+inline float halton(int index, int base) {
+    float f = 1.0f;
+    float r = 0.0f;
+    while (index > 0) {
+        f /= static_cast<float>(base);
+        r += f * static_cast<float>(index % base);
+        index /= base;
+    }
+    return r;
+}
+
+// ------------------------ refinement schedule ---------------------- //
+
+// Progressive refinement ramps the step/shadow budgets up to 2x over this
+// many accumulated samples.
+constexpr int kRefineRampSamples = 16;
+constexpr int kBaseShadowSteps   = 50;
+
+// Budget multiplier minus one for a sample: 0 for the first, 1 once the
+// ramp is done.
+inline float refineBoost(int sampleIndex) {
+    return std::min(sampleIndex, kRefineRampSamples) / static_cast<float>(kRefineRampSamples);
+}
@@ -0,0 +1,248 @@
+#include "settings_io.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+enum class FieldType { Float, Double, Int, Bool, Color };
+
+struct Field {
+    const char *name;
+    FieldType   type;
+    void       *ptr;
+};
+
+// One table drives parsing and formatting, so both stay in sync with
+// RenderSettings.
+std::vector<Field> fieldsOf(RenderSettings &s) {
+    return {
+        {"camDistance",       FieldType::Double, &s.camDistance},
+        {"camYaw",            FieldType::Double, &s.camYaw},
+        {"camPitch",          FieldType::Double, &s.camPitch},
+        {"fov",               FieldType::Float, &s.fov},
+        {"autoRotate",        FieldType::Bool,  &s.autoRotate},
+        {"rotationSpeed",     FieldType::Float, &s.rotationSpeed},
+        {"power",             FieldType::Float, &s.power},
+        {"maxIterations",     FieldType::Int,   &s.maxIterations},
+        {"bailout",           FieldType::Float, &s.bailout},
+        {"maxSteps",          FieldType::Int,   &s.maxSteps},
+        {"maxDist",           FieldType::Float, &s.maxDist},
+        {"epsilon",           FieldType::Float, &s.epsilon},
+        {"depthPrepass",      FieldType::Bool,  &s.depthPrepass},
+        {"prepassFactor",     FieldType::Int,   &s.prepassFactor},
+        {"reprojectDepth",    FieldType::Bool,  &s.reprojectDepth},
+        {"reprojectMargin",   FieldType::Float, &s.reprojectMargin},
+        {"specializeShaders", FieldType::Bool,  &s.specializeShaders},
+        {"distanceCache",     FieldType::Bool,  &s.distanceCache},
+        {"distanceCacheMB",   FieldType::Int,   &s.distanceCacheMB},
+        {"boundedMarch",      FieldType::Bool,  &s.boundedMarch},
+        {"relaxation",        FieldType::Float, &s.relaxation},
+        {"distanceLod",       FieldType::Bool,  &s.distanceLod},
+        {"lodBias",           FieldType::Float, &s.lodBias},
+        {"lodIterBias",       FieldType::Float, &s.lodIterBias},
+        {"deepZoom",          FieldType::Int,   &s.deepZoom},
+        {"enableAO",          FieldType::Bool,  &s.enableAO},
+        {"enableShadows",     FieldType::Bool,  &s.enableShadows},
+        {"analyticNormals",   FieldType::Bool,  &s.analyticNormals},
+        {"deferredShading",   FieldType::Bool,  &s.deferredShading},
+        {"lightingFactor",    FieldType::Int,   &s.lightingFactor},
+        {"lightingCache",     FieldType::Bool,  &s.lightingCache},
+        {"lightingCacheAO",   FieldType::Bool,  &s.lightingCacheAO},
+        {"lightingCacheMB",   FieldType::Int,   &s.lightingCacheMB},
+        {"colorA",            FieldType::Color, s.colorA},
+        {"colorB",            FieldType::Color, s.colorB},
+        {"dynamicResolution", FieldType::Bool,  &s.dynamicResolution},
+        {"targetFPS",         FieldType::Float, &s.targetFPS},
+        {"minScale",          FieldType::Float, &s.minScale},
+        {"maxScale",          FieldType::Float, &s.maxScale},
+        {"renderScale",       FieldType::Float, &s.renderScale},
+        {"checkerboard",      FieldType::Bool,  &s.checkerboard},
+        {"shadingRate",       FieldType::Bool,  &s.shadingRate},
+        {"sharpness",         FieldType::Float, &s.sharpness},
+        {"idleCaching",       FieldType::Bool,  &s.idleCaching},
+        {"presentMode",       FieldType::Int,   &s.presentMode},
+        {"fpsLimit",          FieldType::Float, &s.fpsLimit},
+        {"maxFramesAhead",    FieldType::Int,   &s.maxFramesAhead},
+        {"lateLatch",         FieldType::Bool,  &s.lateLatch},
+        {"progressive",       FieldType::Bool,  &s.progressive},
+        {"maxSamples",        FieldType::Int,   &s.maxSamples},
+        {"temporalAA",        FieldType::Bool,  &s.temporalAA},
+        {"refineQuality",     FieldType::Bool,  &s.refineQuality},
+        {"costView",          FieldType::Int,   &s.costView},
+        {"costCounters",      FieldType::Bool,  &s.costCounters},
+    };
+}
+
+std::string trim(const std::string &s) {
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return "";
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+}
+
+bool parseBool(const std::string &v, bool &out) {
+    if (v == "1" || v == "true" || v == "on" || v == "yes")  { out = true;  return true; }
+    if (v == "0" || v == "false" || v == "off" || v == "no") { out = false; return true; }
+    return false;
+}
+
+} // namespace
+
+bool applySetting(RenderSettings &settings, const std::string &name,
+                  const std::string &value, std::string *error) {
+    for (const Field &field : fieldsOf(settings)) {
+        if (name != field.name) continue;
+
+        std::istringstream in(value);
+        bool ok = false;
+        switch (field.type) {
+        case FieldType::Float:
+            ok = static_cast<bool>(in >> *static_cast<float *>(field.ptr));
+            break;
+        case FieldType::Double:
+            ok = static_cast<bool>(in >> *static_cast<double *>(field.ptr));
+            break;
+        case FieldType::Int:
+            ok = static_cast<bool>(in >> *static_cast<int *>(field.ptr));
+            break;
+        case FieldType::Bool:
+            ok = parseBool(trim(value), *static_cast<bool *>(field.ptr));
+            break;
+        case FieldType::Color: {
+            float *c = static_cast<float *>(field.ptr);
+            ok = static_cast<bool>(in >> c[0] >> c[1] >> c[2]);
+            break;
+        }
+        }
+        if (!ok && error) *error = "bad value for " + name + ": '" + value + "'";
+        return ok;
+    }
+    if (error) *error = "unknown setting '" + name + "'";
+    return false;
+}
+
+bool applySettingAssignment(RenderSettings &settings, const std::string &assignment,
+                            std::string *error) {
+    size_t eq = assignment.find('=');
+    if (eq == std::string::npos) {
+        if (error) *error = "expected name=value, got '" + assignment + "'";
+        return false;
+    }
+    return applySetting(settings, trim(assignment.substr(0, eq)),
+                        trim(assignment.substr(eq + 1)), error);
+}
+
+static bool applySettingLines(std::istream &in, const std::string &source,
+                              RenderSettings &settings, std::string *error) {
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(in, line)) {
+        lineNo++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+
+        std::string message;
+        if (!applySettingAssignment(settings, line, &message)) {
+            if (error) *error = source + ":" + std::to_string(lineNo) + ": " + message;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadSettingsFile(const std::string &path, RenderSettings &settings,
+                      std::string *error) {
+    std::ifstream file(path);
+    if (!file) {
+        if (error) *error = "can't open " + path;
+        return false;
+    }
+    return applySettingLines(file, path, settings, error);
+}
+
+bool parseSettings(const std::string &text, const std::string &source,
+                   RenderSettings &settings, std::string *error) {
+    std::istringstream in(text);
+    return applySettingLines(in, source, settings, error);
+}
+
+RenderSettings combineSettings(const RenderSettings *const *keys, const double *weights,
+                               int count, const RenderSettings &discrete) {
+    RenderSettings out = discrete;
+    std::vector<Field> outFields = fieldsOf(out);
+    for (int k = 0; k < count; k++) {
+        RenderSettings key = *keys[k];
+        std::vector<Field> keyFields = fieldsOf(key);
+        for (size_t i = 0; i < outFields.size(); i++) {
+            const double w = weights[k];
+            void *dst = outFields[i].ptr;
+            const void *src = keyFields[i].ptr;
+            switch (outFields[i].type) {
+            case FieldType::Float: {
+                float &v = *static_cast<float *>(dst);
+                v = static_cast<float>((k == 0 ? 0.0 : v) + w * *static_cast<const float *>(src));
+                break;
+            }
+            case FieldType::Double: {
+                double &v = *static_cast<double *>(dst);
+                v = (k == 0 ? 0.0 : v) + w * *static_cast<const double *>(src);
+                break;
+            }
+            case FieldType::Color:
+                for (int c = 0; c < 3; c++) {
+                    float &v = static_cast<float *>(dst)[c];
+                    v = static_cast<float>((k == 0 ? 0.0 : v) +
+                                           w * static_cast<const float *>(src)[c]);
+                }
+                break;
+            case FieldType::Int:
+            case FieldType::Bool:
+                break;
+            }
+        }
+    }
+    return out;
+}
+
+std::string formatSettings(const RenderSettings &settings) {
+    RenderSettings copy = settings;
+    std::string out;
+    char buf[128];
+    for (const Field &field : fieldsOf(copy)) {
+        switch (field.type) {
+        case FieldType::Float:
+            std::snprintf(buf, sizeof(buf), "%s = %.9g\n", field.name,
+                          *static_cast<const float *>(field.ptr));
+            break;
+        case FieldType::Double:
+            std::snprintf(buf, sizeof(buf), "%s = %.17g\n", field.name,
+                          *static_cast<const double *>(field.ptr));
+            break;
+        case FieldType::Int:
+            std::snprintf(buf, sizeof(buf), "%s = %d\n", field.name,
+                          *static_cast<const int *>(field.ptr));
+            break;
+        case FieldType::Bool:
+            std::snprintf(buf, sizeof(buf), "%s = %s\n", field.name,
+                          *static_cast<const bool *>(field.ptr) ? "true" : "false");
+            break;
+        case FieldType::Color: {
+            const float *c = static_cast<const float *>(field.ptr);
+            std::snprintf(buf, sizeof(buf), "%s = %.9g %.9g %.9g\n", field.name,
+                          c[0], c[1], c[2]);
+            break;
+        }
+        }
+        out += buf;
+    }
+    return out;
+}
+
+bool saveSettingsFile(const std::string &path, const RenderSettings &settings) {
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    file << formatSettings(settings);
+    return static_cast<bool>(file);
+}
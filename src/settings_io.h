@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+
+#include "render_settings.h"
+
+// ------------------------- settings files -------------------------- //
+
+// Text form of RenderSettings: one "name = value" per line, names as in
+// the struct, colours as three numbers, '#' starts a comment. Unknown
+// names are errors so typos don't go unnoticed.
+
+// Applies one setting. Returns false (with a message in *error) if the
+// name is unknown or the value doesn't parse.
+bool applySetting(RenderSettings &settings, const std::string &name,
+                  const std::string &value, std::string *error = nullptr);
+
+// Accepts "name=value"; used for --set on the command line.
+bool applySettingAssignment(RenderSettings &settings, const std::string &assignment,
+                            std::string *error = nullptr);
+
+bool loadSettingsFile(const std::string &path, RenderSettings &settings,
+                      std::string *error = nullptr);
+// The same for text already in memory; errors name `source` as the file.
+bool parseSettings(const std::string &text, const std::string &source,
+                   RenderSettings &settings, std::string *error = nullptr);
+
+// Keyframe blending: every Float, Double and Color field is the weighted
+// sum of that field over `keys`; Int and Bool fields are copied from
+// `discrete`.
+RenderSettings combineSettings(const RenderSettings *const *keys, const double *weights,
+                               int count, const RenderSettings &discrete);
+
+// Every field, in the same format loadSettingsFile reads.
+std::string formatSettings(const RenderSettings &settings);
+bool saveSettingsFile(const std::string &path, const RenderSettings &settings);
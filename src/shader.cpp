@@ -0,0 +1,207 @@
+#include "shader.h"
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "program_binary_cache.h"
+#include "shader_log.h"
+
+std::string readFile(const std::string &path) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+static void expandIncludes(const std::string &path, std::string &out,
+                           std::vector<std::string> &seen, int depth) {
+    if (depth > 16) throw std::runtime_error("Includes nested too deeply: " + path);
+
+    std::istringstream source(readFile(path));
+    std::string line;
+    while (std::getline(source, line)) {
+        size_t pos = line.find_first_not_of(" \t");
+        if (pos != std::string::npos && line.compare(pos, 8, "#include") == 0) {
+            size_t open  = line.find('"', pos + 8);
+            size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+            if (close == std::string::npos) {
+                throw std::runtime_error("Malformed #include in " + path + ": " + line);
+            }
+            std::filesystem::path dir = std::filesystem::path(path).parent_path();
+            std::string included =
+                (dir / line.substr(open + 1, close - open - 1)).generic_string();
+            if (std::find(seen.begin(), seen.end(), included) == seen.end()) {
+                seen.push_back(included);
+                expandIncludes(included, out, seen, depth + 1);
+            }
+            continue;
+        }
+        out += line;
+        out += '\n';
+    }
+}
+
+std::string readShaderSource(const std::string &path, std::vector<std::string> *includes) {
+    std::string out;
+    std::vector<std::string> seen;
+    expandIncludes(path, out, seen, 0);
+    if (includes) includes->insert(includes->end(), seen.begin(), seen.end());
+    return out;
+}
+
+std::string injectDefines(const std::string &source, const std::string &defines) {
+    if (defines.empty()) return source;
+
+    size_t pos = source.find("#version");
+    if (pos == std::string::npos) return defines + source;
+
+    size_t eol = source.find('\n', pos);
+    if (eol == std::string::npos) return source + "\n" + defines;
+
+    return source.substr(0, eol + 1) + defines + source.substr(eol + 1);
+}
+
+GLuint compileShader(GLenum type, const std::string &src) {
+    GLuint shader = glCreateShader(type);
+    const char *c_str = src.c_str();
+    glShaderSource(shader, 1, &c_str, nullptr);
+    glCompileShader(shader);
+
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE) {
+        GLint logLen = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLen);
+        std::string log(logLen, '\0');
+        glGetShaderInfoLog(shader, logLen, nullptr, log.data());
+        std::string typeStr = type == GL_VERTEX_SHADER   ? "VERTEX"
+                            : type == GL_COMPUTE_SHADER ? "COMPUTE"
+                                                        : "FRAGMENT";
+        shaderLog(ShaderLogLevel::Error, "Error compiling " + typeStr + " shader:\n" + log);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+GLuint linkProgram(const std::string &vsSource, const std::string &fsSource,
+                   bool retrievable) {
+    bool compute = vsSource.empty();
+    GLuint vs = 0;
+    if (!compute) {
+        vs = compileShader(GL_VERTEX_SHADER, vsSource);
+        if (!vs) return 0;
+    }
+    GLuint fs = compileShader(compute ? GL_COMPUTE_SHADER : GL_FRAGMENT_SHADER, fsSource);
+    if (!fs) {
+        if (vs) glDeleteShader(vs);
+        return 0;
+    }
+
+    GLuint prog = glCreateProgram();
+    if (retrievable) {
+        glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    if (vs) glAttachShader(prog, vs);
+    glAttachShader(prog, fs);
+    glLinkProgram(prog);
+
+    if (vs) glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(prog, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        GLint logLen = 0;
+        glGetProgramiv(prog, GL_INFO_LOG_LENGTH, &logLen);
+        std::string log(logLen, '\0');
+        glGetProgramInfoLog(prog, logLen, nullptr, log.data());
+        shaderLog(ShaderLogLevel::Error, "Error linking shader program:\n" + log);
+        glDeleteProgram(prog);
+        return 0;
+    }
+
+    return prog;
+}
+
+GLuint createProgram(const std::string &vsPath, const std::string &fsPath,
+                     const std::string &defines) {
+    return linkProgram(readShaderSource(vsPath),
+                       injectDefines(readShaderSource(fsPath), defines));
+}
+
+// --------------------------- permutations -------------------------- //
+
+std::string definesPreamble(const ShaderDefines &defines) {
+    std::string preamble;
+    for (const auto &[name, value] : defines) {
+        preamble += "#define " + name;
+        if (!value.empty()) preamble += " " + value;
+        preamble += "\n";
+    }
+    return preamble;
+}
+
+bool ProgramCache::binaryCacheEnabled() const {
+    return binaryCache_ && binaryCache_->enabled();
+}
+
+GLuint ProgramCache::get(const std::string &vsPath, const std::string &fsPath,
+                         const ShaderDefines &defines) {
+    std::string preamble = definesPreamble(defines);
+    std::string key = vsPath + "|" + fsPath + "|" + preamble;
+
+    auto it = programs_.find(key);
+    if (it != programs_.end()) return it->second.program;
+
+    GLuint prog = 0;
+    try {
+        std::string vsSource = vsPath.empty() ? std::string() : readShaderSource(vsPath);
+        std::string fsSource = injectDefines(readShaderSource(fsPath), preamble);
+        bool useBinary = binaryCacheEnabled();
+        if (useBinary) prog = binaryCache_->load(vsSource, fsSource);
+        if (!prog) {
+            prog = linkProgram(vsSource, fsSource, useBinary);
+            if (prog && useBinary) binaryCache_->store(prog, vsSource, fsSource);
+        }
+    } catch (const std::exception &e) {
+        shaderLog(ShaderLogLevel::Error, std::string("Exception while creating program: ") + e.what());
+    }
+    if (!prog && !preamble.empty()) {
+        shaderLog(ShaderLogLevel::Error, "Variant defines:\n" + preamble);
+    }
+    programs_.emplace(key, Variant{vsPath, fsPath, preamble, prog});
+    return prog;
+}
+
+void ProgramCache::replace(const std::string &key, GLuint program,
+                           const std::string &vsSource, const std::string &fsSource) {
+    auto it = programs_.find(key);
+    if (it == programs_.end()) {
+        glDeleteProgram(program);
+        return;
+    }
+    if (it->second.program) glDeleteProgram(it->second.program);
+    it->second.program = program;
+    generation_++;
+
+    if (binaryCache_ && binaryCache_->enabled()) {
+        binaryCache_->store(program, vsSource, fsSource);
+    }
+}
+
+void ProgramCache::clear() {
+    for (auto &entry : programs_) {
+        if (entry.second.program) glDeleteProgram(entry.second.program);
+    }
+    programs_.clear();
+    generation_++;
+}
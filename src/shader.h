@@ -0,0 +1,89 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+class ProgramBinaryCache;
+
+// ----------------------------- shaders ----------------------------- //
+
+// Reads a whole file; throws std::runtime_error if it can't be opened.
+std::string readFile(const std::string &path);
+
+// Reads a shader and splices in each `#include "file"` line, resolved
+// relative to the including file. A file is included at most once. The
+// included paths are appended to `includes` if given. Throws like readFile.
+std::string readShaderSource(const std::string &path,
+                             std::vector<std::string> *includes = nullptr);
+
+// Inserts `defines` (complete "#define ..." lines) right after the
+// #version line, so one source file can be compiled in several modes.
+std::string injectDefines(const std::string &source, const std::string &defines);
+
+GLuint compileShader(GLenum type, const std::string &src);
+
+// Compiles and links already-loaded sources. `retrievable` sets
+// GL_PROGRAM_BINARY_RETRIEVABLE_HINT so the result can be cached. An
+// empty vsSource links fsSource alone as a compute shader.
+GLuint linkProgram(const std::string &vsSource, const std::string &fsSource,
+                   bool retrievable = false);
+
+// Compiles and links a vertex + fragment program. Returns 0 on failure
+// after printing the log; throws if a file can't be read.
+GLuint createProgram(const std::string &vsPath, const std::string &fsPath,
+                     const std::string &defines = "");
+
+// --------------------------- permutations -------------------------- //
+
+// Preprocessor symbols for one shader variant, name -> value ("" for a
+// bare #define). Ordered, so equal sets always build the same key.
+using ShaderDefines = std::map<std::string, std::string>;
+
+// "#define NAME VALUE\n" lines in key order, for injectDefines.
+std::string definesPreamble(const ShaderDefines &defines);
+
+// Compiles each (vertex, fragment, defines) combination once and hands
+// back the same program afterwards. Failed builds are remembered as 0 so
+// a broken variant isn't recompiled every frame. With a binary cache
+// attached, new variants are first looked up on disk.
+class ProgramCache {
+public:
+    // One cached combination; the sources are re-read to rebuild it.
+    // Compute programs leave vsPath empty and keep their stage in fsPath.
+    struct Variant {
+        std::string vsPath, fsPath, preamble;
+        GLuint program = 0;
+    };
+
+    void setBinaryCache(ProgramBinaryCache *binaryCache) { binaryCache_ = binaryCache; }
+    // Whether programs should be linked retrievable, for the binary cache.
+    bool binaryCacheEnabled() const;
+
+    GLuint get(const std::string &vsPath, const std::string &fsPath,
+               const ShaderDefines &defines = {});
+    GLuint getCompute(const std::string &csPath, const ShaderDefines &defines = {}) {
+        return get("", csPath, defines);
+    }
+
+    // Every cached combination by key, for rebuilding after an edit.
+    const std::unordered_map<std::string, Variant> &variants() const { return programs_; }
+    // Installs a rebuilt program for `key`, deleting the one it replaces.
+    void replace(const std::string &key, GLuint program,
+                 const std::string &vsSource, const std::string &fsSource);
+    // Bumped whenever a cached program is replaced or deleted, so users
+    // holding per-program state (uniform locations) know to refresh it.
+    unsigned generation() const { return generation_; }
+
+    size_t size() const { return programs_.size(); }
+    // Deletes every cached program; call before the context goes away.
+    void   clear();
+
+private:
+    std::unordered_map<std::string, Variant> programs_;
+    unsigned generation_ = 0;
+    ProgramBinaryCache *binaryCache_ = nullptr;
+};
@@ -0,0 +1,70 @@
+#include "shader_log.h"
+
+#include <ctime>
+#include <deque>
+#include <mutex>
+
+#include "imgui.h"
+
+namespace {
+
+constexpr size_t kMaxEntries = 200;
+
+std::mutex                 gMutex;
+std::deque<ShaderLogEntry> gEntries;
+
+std::string timeStamp() {
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    char buf[16];
+    std::strftime(buf, sizeof(buf), "%H:%M:%S", &local);
+    return buf;
+}
+
+} // namespace
+
+void shaderLog(ShaderLogLevel level, const std::string &text) {
+    ShaderLogEntry entry;
+    entry.level = level;
+    entry.stamp = timeStamp();
+    entry.text  = text;
+
+    std::lock_guard<std::mutex> lock(gMutex);
+    gEntries.push_back(std::move(entry));
+    if (gEntries.size() > kMaxEntries) gEntries.pop_front();
+}
+
+std::vector<ShaderLogEntry> shaderLogEntries() {
+    std::lock_guard<std::mutex> lock(gMutex);
+    return std::vector<ShaderLogEntry>(gEntries.begin(), gEntries.end());
+}
+
+void clearShaderLog() {
+    std::lock_guard<std::mutex> lock(gMutex);
+    gEntries.clear();
+}
+
+void drawShaderLog() {
+    std::vector<ShaderLogEntry> entries = shaderLogEntries();
+
+    if (ImGui::SmallButton("Clear")) clearShaderLog();
+    ImGui::SameLine();
+    ImGui::TextDisabled("%zu messages", entries.size());
+
+    ImGui::BeginChild("##shaderlog", ImVec2(0.0f, 160.0f), true);
+    for (const ShaderLogEntry &e : entries) {
+        ImVec4 color = e.level == ShaderLogLevel::Error ? ImVec4(1.0f, 0.45f, 0.4f, 1.0f)
+                                                        : ImVec4(0.75f, 0.75f, 0.75f, 1.0f);
+        ImGui::PushStyleColor(ImGuiCol_Text, color);
+        ImGui::TextWrapped("[%s] %s", e.stamp.c_str(), e.text.c_str());
+        ImGui::PopStyleColor();
+    }
+    // Follow new messages unless the user scrolled up.
+    if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY()) ImGui::SetScrollHereY(1.0f);
+    ImGui::EndChild();
+}
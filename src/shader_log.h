@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// ---------------------------- shader log --------------------------- //
+
+// Compile, link and reload messages, kept for the UI rather than printed.
+// Safe to call from the shader reload worker thread.
+enum class ShaderLogLevel {
+    Info,
+    Error,
+};
+
+struct ShaderLogEntry {
+    ShaderLogLevel level = ShaderLogLevel::Info;
+    std::string    stamp;   // local wall-clock time, HH:MM:SS
+    std::string    text;
+};
+
+void shaderLog(ShaderLogLevel level, const std::string &text);
+
+// Copy of the retained entries, oldest first.
+std::vector<ShaderLogEntry> shaderLogEntries();
+void clearShaderLog();
+
+// Draws the log into the current ImGui window.
+void drawShaderLog();
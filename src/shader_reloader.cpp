@@ -0,0 +1,299 @@
+#include "shader_reloader.h"
+
+#include <algorithm>
+#include <exception>
+#include <system_error>
+
+#include <GLFW/glfw3.h>
+
+#include "shader_log.h"
+
+// How often watched files are stat'ed.
+static constexpr double kWatchIntervalSeconds = 0.25;
+
+static std::string infoLog(GLuint object, bool isProgram) {
+    GLint logLen = 0;
+    if (isProgram) glGetProgramiv(object, GL_INFO_LOG_LENGTH, &logLen);
+    else           glGetShaderiv(object, GL_INFO_LOG_LENGTH, &logLen);
+    std::string log(std::max(logLen, 0), '\0');
+    if (logLen <= 0) return log;
+    if (isProgram) glGetProgramInfoLog(object, logLen, nullptr, log.data());
+    else           glGetShaderInfoLog(object, logLen, nullptr, log.data());
+    return log;
+}
+
+// ------------------------------ setup ------------------------------ //
+
+void ShaderReloader::init(GLFWwindow *mainWindow) {
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        backend_ = Backend::ParallelCompile;
+        return;
+    }
+    if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+        backend_ = Backend::ParallelCompile;
+        return;
+    }
+
+    // Same context hints as the main window, which are still set.
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    workerWindow_ = glfwCreateWindow(1, 1, "Shader compiler", nullptr, mainWindow);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (!workerWindow_) {
+        shaderLog(ShaderLogLevel::Info, "Hot reload: no shared context, rebuilds will block");
+        return;
+    }
+
+    backend_ = Backend::WorkerThread;
+    worker_ = std::thread(&ShaderReloader::workerLoop, this);
+}
+
+void ShaderReloader::stopWorker() {
+    if (!worker_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    worker_.join();
+}
+
+void ShaderReloader::shutdown() {
+    stopWorker();
+    if (workerWindow_) {
+        glfwDestroyWindow(workerWindow_);
+        workerWindow_ = nullptr;
+    }
+
+    for (Job &job : compiling_) {
+        glDeleteShader(job.vs);
+        glDeleteShader(job.fs);
+        glDeleteProgram(job.program);
+    }
+    compiling_.clear();
+    for (Job &job : finished_) glDeleteProgram(job.program);
+    finished_.clear();
+    queue_.clear();
+    pending_ = 0;
+}
+
+const char *ShaderReloader::backendName() const {
+    switch (backend_) {
+    case Backend::ParallelCompile: return "parallel compile";
+    case Backend::WorkerThread:    return "worker thread";
+    default:                       return "synchronous";
+    }
+}
+
+// ----------------------------- watching ---------------------------- //
+
+void ShaderReloader::watch(const std::string &path) {
+    std::error_code ec;
+    WatchedFile file;
+    file.path  = path;
+    file.mtime = std::filesystem::last_write_time(path, ec);
+    watched_.push_back(file);
+}
+
+void ShaderReloader::rebuildUsing(const std::string &path) {
+    int queued = 0;
+    for (const auto &[key, variant] : cache_.variants()) {
+        Job job;
+        job.key = key;
+        std::vector<std::string> files = {variant.vsPath, variant.fsPath};
+        try {
+            if (!variant.vsPath.empty()) job.vsSource = readShaderSource(variant.vsPath, &files);
+            job.fsSource = injectDefines(readShaderSource(variant.fsPath, &files),
+                                         variant.preamble);
+        } catch (const std::exception &e) {
+            // Most likely caught mid-save; the next write triggers again.
+            shaderLog(ShaderLogLevel::Error, std::string("Hot reload: ") + e.what());
+            return;
+        }
+        if (std::find(files.begin(), files.end(), path) == files.end()) continue;
+        job.serial = ++serial_;
+        latest_[key] = job.serial;
+        submit(std::move(job));
+        queued++;
+    }
+    if (queued > 0) {
+        shaderLog(ShaderLogLevel::Info, path + " changed, rebuilding " +
+                                            std::to_string(queued) + " program(s)");
+    }
+}
+
+// ----------------------------- building ---------------------------- //
+
+void ShaderReloader::submit(Job job) {
+    pending_++;
+    // The hint needs GL 4.1 or ARB_get_program_binary, which an enabled
+    // binary cache implies.
+    job.retrievable = cache_.binaryCacheEnabled();
+
+    switch (backend_) {
+    case Backend::ParallelCompile: {
+        // With parallel compile enabled these calls queue work and return;
+        // nothing here asks for a status until GL_COMPLETION_STATUS says so.
+        // Compute programs (no vertex source) have their stage in fs.
+        bool compute = job.vsSource.empty();
+        const char *vsText = job.vsSource.c_str();
+        const char *fsText = job.fsSource.c_str();
+        if (!compute) {
+            job.vs = glCreateShader(GL_VERTEX_SHADER);
+            glShaderSource(job.vs, 1, &vsText, nullptr);
+            glCompileShader(job.vs);
+        }
+        job.fs = glCreateShader(compute ? GL_COMPUTE_SHADER : GL_FRAGMENT_SHADER);
+        glShaderSource(job.fs, 1, &fsText, nullptr);
+        glCompileShader(job.fs);
+
+        job.program = glCreateProgram();
+        if (job.retrievable) {
+            glProgramParameteri(job.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        if (job.vs) glAttachShader(job.program, job.vs);
+        glAttachShader(job.program, job.fs);
+        glLinkProgram(job.program);
+        compiling_.push_back(std::move(job));
+        break;
+    }
+    case Backend::WorkerThread: {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(job));
+        }
+        wake_.notify_one();
+        break;
+    }
+    default:
+        job.program = linkProgram(job.vsSource, job.fsSource, job.retrievable);
+        install(job);
+        break;
+    }
+}
+
+bool ShaderReloader::pollParallel(Job &job) {
+    GLint done = GL_FALSE;
+    glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &done);
+    if (!done) return false;
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(job.program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        for (GLuint shader : {job.vs, job.fs}) {
+            if (!shader) continue;
+            GLint compiled = GL_FALSE;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+            if (!compiled) {
+                const char *type = shader == job.vs ? "VERTEX"
+                                 : job.vs           ? "FRAGMENT"
+                                                    : "COMPUTE";
+                shaderLog(ShaderLogLevel::Error, std::string("Error compiling ") + type +
+                                                     " shader:\n" + infoLog(shader, false));
+            }
+        }
+        shaderLog(ShaderLogLevel::Error, "Error linking shader program:\n" +
+                                             infoLog(job.program, true));
+        glDeleteProgram(job.program);
+        job.program = 0;
+    } else {
+        if (job.vs) glDetachShader(job.program, job.vs);
+        glDetachShader(job.program, job.fs);
+    }
+    glDeleteShader(job.vs);
+    glDeleteShader(job.fs);
+    job.vs = job.fs = 0;
+    return true;
+}
+
+void ShaderReloader::install(Job &job) {
+    pending_--;
+
+    auto latest = latest_.find(job.key);
+    bool superseded = latest == latest_.end() || latest->second != job.serial;
+    if (superseded) {
+        glDeleteProgram(job.program);
+    } else if (job.program) {
+        cache_.replace(job.key, job.program, job.vsSource, job.fsSource);
+        batchOk_++;
+    } else {
+        batchFailed_++;
+    }
+
+    if (pending_ == 0 && batchOk_ + batchFailed_ > 0) {
+        if (batchFailed_ == 0) {
+            shaderLog(ShaderLogLevel::Info, "Reloaded " + std::to_string(batchOk_) + " program(s)");
+        } else {
+            shaderLog(ShaderLogLevel::Error,
+                      std::to_string(batchFailed_) + " program(s) failed to rebuild; "
+                      "still using the previous version");
+        }
+        batchOk_ = batchFailed_ = 0;
+    }
+}
+
+void ShaderReloader::workerLoop() {
+    glfwMakeContextCurrent(workerWindow_);
+
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (stop_) break;
+            job = std::move(queue_.front());
+            queue_.pop_front();
+        }
+
+        job.program = linkProgram(job.vsSource, job.fsSource, job.retrievable);
+        // The main context may only use the program once this context's
+        // commands have completed.
+        glFinish();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_.push_back(std::move(job));
+        }
+        // Wake the main loop if it is idling in glfwWaitEventsTimeout.
+        glfwPostEmptyEvent();
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
+
+// ------------------------------ update ----------------------------- //
+
+bool ShaderReloader::update(double now) {
+    unsigned before = cache_.generation();
+
+    if (now >= nextCheck_) {
+        nextCheck_ = now + kWatchIntervalSeconds;
+        for (WatchedFile &file : watched_) {
+            std::error_code ec;
+            auto mtime = std::filesystem::last_write_time(file.path, ec);
+            if (ec || mtime == file.mtime) continue;
+            file.mtime = mtime;
+            rebuildUsing(file.path);
+        }
+    }
+
+    for (size_t i = 0; i < compiling_.size();) {
+        if (pollParallel(compiling_[i])) {
+            Job job = std::move(compiling_[i]);
+            compiling_.erase(compiling_.begin() + i);
+            install(job);
+        } else {
+            i++;
+        }
+    }
+
+    std::vector<Job> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done.swap(finished_);
+    }
+    for (Job &job : done) install(job);
+
+    return cache_.generation() != before;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "shader.h"
+
+struct GLFWwindow;
+
+// ------------------------- shader hot reload ----------------------- //
+
+// Watches shader source files and rebuilds every ProgramCache variant that
+// uses a changed file without stalling the frame: through
+// GL_KHR_parallel_shader_compile when the driver has it, otherwise on a
+// worker thread with a hidden context shared with the main window. The
+// old program keeps rendering until its replacement links; a failed build
+// only logs and leaves it in place.
+class ShaderReloader {
+public:
+    enum class Backend {
+        Synchronous,      // no parallel compile and no shared context
+        ParallelCompile,
+        WorkerThread,
+    };
+
+    explicit ShaderReloader(ProgramCache &cache) : cache_(cache) {}
+    ~ShaderReloader() { stopWorker(); }
+
+    // Call with mainWindow's context current.
+    void init(GLFWwindow *mainWindow);
+    // Joins the worker and deletes unfinished builds; needs the context.
+    void shutdown();
+
+    void watch(const std::string &path);
+
+    // Once per frame: checks file times (throttled) and installs finished
+    // builds. Returns true if any cached program was replaced.
+    bool update(double now);
+
+    bool busy() const { return pending_ > 0; }
+    int  pending() const { return pending_; }
+    const char *backendName() const;
+
+private:
+    struct Job {
+        std::string key;
+        std::string vsSource, fsSource;
+        unsigned    serial = 0;
+        bool        retrievable = false;   // the binary cache wants it
+        GLuint vs = 0, fs = 0;   // ParallelCompile only
+        GLuint program = 0;
+    };
+
+    struct WatchedFile {
+        std::string path;
+        std::filesystem::file_time_type mtime;
+    };
+
+    void rebuildUsing(const std::string &path);
+    void submit(Job job);
+    bool pollParallel(Job &job);
+    void install(Job &job);
+    void workerLoop();
+    void stopWorker();
+
+    ProgramCache &cache_;
+    Backend backend_ = Backend::Synchronous;
+
+    std::vector<WatchedFile> watched_;
+    double nextCheck_ = 0.0;
+
+    // Latest serial per key, so a superseded build never wins.
+    std::unordered_map<std::string, unsigned> latest_;
+    unsigned serial_  = 0;
+    int      pending_ = 0;
+    int      batchOk_ = 0, batchFailed_ = 0;
+
+    std::vector<Job> compiling_;    // ParallelCompile, main thread only
+
+    GLFWwindow             *workerWindow_ = nullptr;
+    std::thread             worker_;
+    std::mutex              mutex_;
+    std::condition_variable wake_;
+    std::deque<Job>         queue_;     // guarded by mutex_
+    std::vector<Job>        finished_;  // guarded by mutex_
+    bool                    stop_ = false;
+};
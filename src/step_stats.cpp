@@ -0,0 +1,89 @@
+#include "step_stats.h"
+
+// log2(kSize): the 1x1 mip level.
+static constexpr int kTopLevel = 8;
+static_assert((1 << kTopLevel) == StepStats::kSize, "kTopLevel must match kSize");
+
+void StepStats::destroy() {
+    for (Slot &slot : slots_) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        if (slot.pbo) glDeleteBuffers(1, &slot.pbo);
+        slot = Slot();
+    }
+    if (fbo_) glDeleteFramebuffers(1, &fbo_);
+    if (texture_) glDeleteTextures(1, &texture_);
+    fbo_ = texture_ = 0;
+    head_ = inFlight_ = 0;
+    valid_ = false;
+}
+
+void StepStats::measure(GLuint fbo, GLenum attachment, int width, int height) {
+    if (inFlight_ == kRing) return;
+
+    if (!texture_) {
+        glGenTextures(1, &texture_);
+        glBindTexture(GL_TEXTURE_2D, texture_);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, kSize, kSize, 0, GL_RG, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &fbo_);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                               texture_, 0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glReadBuffer(attachment);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, kSize, kSize, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    Slot &slot = slots_[(head_ + inFlight_) % kRing];
+    if (!slot.pbo) {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, 2 * sizeof(float), nullptr, GL_STREAM_READ);
+    } else {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, kTopLevel, GL_RG, GL_FLOAT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    inFlight_++;
+}
+
+bool StepStats::poll() {
+    bool updated = false;
+    while (inFlight_ > 0) {
+        Slot &slot = slots_[head_];
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) break;
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        head_ = (head_ + 1) % kRing;
+        inFlight_--;
+        if (status == GL_WAIT_FAILED) continue;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const float *mean = static_cast<const float *>(
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 2 * sizeof(float), GL_MAP_READ_BIT));
+        if (mean) {
+            averageSteps_ = mean[1];
+            valid_   = true;
+            updated  = true;
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    return updated;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+
+#include <GL/glew.h>
+
+// --------------------------- step statistics ----------------------- //
+
+// Average primary-march steps per pixel, for comparing marcher modes. The
+// steps channel of a HitInfo attachment is subsampled (a nearest-filtered
+// blit) into a kSize x kSize RG32F texture whose mip chain averages it on
+// the GPU; the 1x1 level is read through a ring of fenced pixel pack
+// buffers like PixelReadback, so a value arrives a few frames late but
+// never stalls the frame.
+class StepStats {
+public:
+    static constexpr int kSize = 256;
+    static constexpr int kRing = 3;
+
+    void destroy();
+
+    // Queues a measurement of the width x height region of `attachment`
+    // of `fbo` (RG: hit distance, steps). Skipped while every buffer is
+    // still in flight.
+    void measure(GLuint fbo, GLenum attachment, int width, int height);
+
+    // Picks up finished measurements; true if a new value arrived.
+    bool poll();
+
+    bool  valid() const { return valid_; }
+    float averageSteps() const { return averageSteps_; }
+
+private:
+    struct Slot {
+        GLuint pbo   = 0;
+        GLsync fence = nullptr;
+    };
+
+    GLuint texture_ = 0;
+    GLuint fbo_     = 0;
+    std::array<Slot, kRing> slots_{};
+    int head_     = 0;   // oldest slot in flight
+    int inFlight_ = 0;
+
+    bool  valid_ = false;
+    float averageSteps_ = 0.0f;
+};
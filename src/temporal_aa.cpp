@@ -0,0 +1,56 @@
+#include "temporal_aa.h"
+
+#include <utility>
+
+#include "sampling.h"
+
+TemporalAA::TemporalAA(ProgramCache &cache, std::string vsPath, std::string fsPath)
+    : variants_(cache, std::move(vsPath), std::move(fsPath)) {}
+
+void TemporalAA::destroy() {
+    destroyRenderTarget(targets_[0]);
+    destroyRenderTarget(targets_[1]);
+}
+
+void TemporalAA::jitter(int frameIndex, float out[2]) {
+    // Index 0 of the sequence is the pixel centre.
+    int index = frameIndex % kJitterPeriod + 1;
+    out[0] = halton(index, 2) - 0.5f;
+    out[1] = halton(index, 3) - 0.5f;
+}
+
+bool TemporalAA::prepare(int allocWidth, int allocHeight) {
+    program_ = variants_.get({});
+    return program_ &&
+           ensureRenderTarget(targets_[0], allocWidth, allocHeight, {GL_RGBA16F}) &&
+           ensureRenderTarget(targets_[1], allocWidth, allocHeight, {GL_RGBA16F});
+}
+
+void TemporalAA::resolve(const FrameParams &frame, const RenderTarget &current, int width,
+                         int height, GLuint vao) {
+    const RenderTarget &history = targets_[current_];
+    const RenderTarget &output  = targets_[1 - current_];
+
+    glActiveTexture(GL_TEXTURE0 + kUnitTaaColor);
+    glBindTexture(GL_TEXTURE_2D, current.color[0]);
+    glActiveTexture(GL_TEXTURE0 + kUnitTaaHit);
+    glBindTexture(GL_TEXTURE_2D, current.color[1]);
+    glActiveTexture(GL_TEXTURE0 + kUnitTaaHistory);
+    glBindTexture(GL_TEXTURE_2D, history.color[0]);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, output.fbo);
+    glViewport(0, 0, width, height);
+    glUseProgram(program_->program);
+    uploadFractalUniforms(*program_, frame);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    for (int unit : {kUnitTaaHistory, kUnitTaaHit, kUnitTaaColor}) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    current_ = 1 - current_;
+}
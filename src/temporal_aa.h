@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+
+#include <GL/glew.h>
+
+#include "fractal_program.h"
+#include "render_target.h"
+#include "shader.h"
+#include "view_state.h"
+
+// ------------------------- temporal AA ---------------------------- //
+
+// Anti-aliases moving frames over time instead of per frame. The fractal
+// pass marches each frame through a different Halton sub-pixel offset
+// (jitter()); taa_resolve.frag reprojects the previous resolved frame by
+// hit depth, clamps it to this frame's neighbourhood and blends the two
+// into the next of a pair of RGBA16F targets. One full-screen pass; the
+// march itself is unchanged.
+class TemporalAA {
+public:
+    TemporalAA(ProgramCache &cache, std::string vsPath, std::string fsPath);
+    void destroy();
+
+    // Weight of a new frame while the view moves.
+    static constexpr float kBlend = 0.1f;
+    // Jitter offsets cycle over this many frames.
+    static constexpr int kJitterPeriod = 8;
+
+    // Sub-pixel ray offset for a frame, in [-0.5, 0.5) pixels.
+    static void jitter(int frameIndex, float out[2]);
+
+    // Allocates the targets for views up to allocWidth x allocHeight and
+    // builds the resolve program. False if either failed: skip the pass.
+    bool prepare(int allocWidth, int allocHeight);
+
+    // Resolves the frame in `current` (colour + HitInfo, marched with
+    // frame.jitter) into the next target and makes it result(). Expects
+    // the FractalParams buffer to hold the view; frame.previous is the
+    // view result() was resolved with, or null to restart the history.
+    // After prepare().
+    void resolve(const FrameParams &frame, const RenderTarget &current, int width, int height,
+                 GLuint vao);
+    const RenderTarget &result() const { return targets_[current_]; }
+
+private:
+    FractalVariants variants_;
+    const FractalProgram *program_ = nullptr;   // from prepare()
+
+    RenderTarget targets_[2];
+    int current_ = 0;
+};
@@ -0,0 +1,169 @@
+#include "timeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "settings_io.h"
+
+void Timeline::setKey(double time, const RenderSettings &settings, Interpolation interpolation) {
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), time,
+                               [](const Keyframe &k, double t) { return k.time < t; });
+    if (it == keys_.end() || it->time != time) it = keys_.insert(it, Keyframe());
+    it->time = time;
+    it->interpolation = interpolation;
+    it->settings = settings;
+}
+
+void Timeline::removeKey(size_t index) {
+    if (index < keys_.size()) keys_.erase(keys_.begin() + static_cast<std::ptrdiff_t>(index));
+}
+
+RenderSettings Timeline::evaluate(double time, const RenderSettings &fallback) const {
+    if (keys_.empty()) return fallback;
+    if (time <= keys_.front().time) return keys_.front().settings;
+    if (time >= keys_.back().time) return keys_.back().settings;
+
+    // Segment b..c holds `time`; a and d are its neighbours, or b and c
+    // themselves at the ends.
+    size_t c = static_cast<size_t>(
+        std::upper_bound(keys_.begin(), keys_.end(), time,
+                         [](double t, const Keyframe &k) { return t < k.time; }) -
+        keys_.begin());
+    size_t b = c - 1;
+    size_t a = b > 0 ? b - 1 : b;
+    size_t d = c + 1 < keys_.size() ? c + 1 : c;
+    const Keyframe &kb = keys_[b], &kc = keys_[c];
+    const double span = kc.time - kb.time;
+    const double u = (time - kb.time) / span;
+
+    const RenderSettings *points[4] = {&keys_[a].settings, &kb.settings, &kc.settings,
+                                       &keys_[d].settings};
+    double weights[4] = {0.0, 1.0, 0.0, 0.0};
+    switch (kb.interpolation) {
+    case Interpolation::Step:
+        break;
+    case Interpolation::Linear:
+        weights[1] = 1.0 - u;
+        weights[2] = u;
+        break;
+    case Interpolation::Spline: {
+        // Cubic Hermite with finite-difference tangents per second,
+        // (c - a) / (tc - ta) at b and (d - b) / (td - tb) at c.
+        const double u2 = u * u, u3 = u2 * u;
+        const double h00 = 2.0 * u3 - 3.0 * u2 + 1.0;
+        const double h10 = u3 - 2.0 * u2 + u;
+        const double h01 = -2.0 * u3 + 3.0 * u2;
+        const double h11 = u3 - u2;
+        const double sb = span / (kc.time - keys_[a].time);
+        const double sc = span / (keys_[d].time - kb.time);
+        weights[0] = -h10 * sb;
+        weights[1] = h00 - h11 * sc;
+        weights[2] = h01 + h10 * sb;
+        weights[3] = h11 * sc;
+        break;
+    }
+    }
+    return combineSettings(points, weights, 4, kb.settings);
+}
+
+int timelineFrameCount(const Timeline &timeline, double fps) {
+    return static_cast<int>(std::floor(timeline.duration() * fps + 1e-6)) + 1;
+}
+
+const char *interpolationName(Interpolation interpolation) {
+    switch (interpolation) {
+    case Interpolation::Step:   return "step";
+    case Interpolation::Linear: return "linear";
+    case Interpolation::Spline: return "spline";
+    }
+    return "spline";
+}
+
+static bool parseInterpolation(const std::string &name, Interpolation &out) {
+    for (Interpolation i : {Interpolation::Step, Interpolation::Linear, Interpolation::Spline}) {
+        if (name == interpolationName(i)) {
+            out = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool loadTimeline(const std::string &path, const RenderSettings &base, Timeline &timeline,
+                  std::string *error) {
+    std::ifstream file(path);
+    if (!file) {
+        if (error) *error = "can't open " + path;
+        return false;
+    }
+
+    std::vector<Keyframe> keys;
+    RenderSettings current = base;
+    std::string line;
+    int lineNo = 0;
+    auto fail = [&](const std::string &message) {
+        if (error) *error = path + ":" + std::to_string(lineNo) + ": " + message;
+        return false;
+    };
+    while (std::getline(file, line)) {
+        lineNo++;
+        size_t hash = line.find('#');
+        line = line.substr(0, hash);
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) continue;
+        line = line.substr(begin);
+
+        if (line[0] == '[') {
+            std::istringstream in(line.substr(1, line.find(']') - 1));
+            std::string word, mode = "spline";
+            Keyframe key;
+            if (line.find(']') == std::string::npos || !(in >> word >> key.time) || word != "key") {
+                return fail("expected [key TIME MODE], got '" + line + "'");
+            }
+            in >> mode;
+            if (!parseInterpolation(mode, key.interpolation)) {
+                return fail("unknown interpolation '" + mode + "'");
+            }
+            if (!keys.empty() && key.time <= keys.back().time) {
+                return fail("keys must be in increasing time");
+            }
+            if (!keys.empty()) current = keys.back().settings;
+            keys.push_back(key);
+            keys.back().settings = current;
+            continue;
+        }
+
+        if (keys.empty()) return fail("setting before the first [key]");
+        std::string message;
+        if (!applySettingAssignment(keys.back().settings, line, &message)) return fail(message);
+    }
+
+    timeline.clear();
+    for (const Keyframe &key : keys) timeline.setKey(key.time, key.settings, key.interpolation);
+    return true;
+}
+
+bool saveTimeline(const std::string &path, const Timeline &timeline) {
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    file << "# Mandelbulb timeline: each [key TIME MODE] starts from the previous key\n";
+
+    std::vector<std::string> previous;
+    for (const Keyframe &key : timeline.keys()) {
+        char header[64];
+        std::snprintf(header, sizeof(header), "[key %.9g %s]\n", key.time,
+                      interpolationName(key.interpolation));
+        file << header;
+
+        std::vector<std::string> lines;
+        std::istringstream in(formatSettings(key.settings));
+        for (std::string line; std::getline(in, line);) lines.push_back(line);
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (previous.empty() || lines[i] != previous[i]) file << lines[i] << "\n";
+        }
+        previous.swap(lines);
+    }
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "render_settings.h"
+
+// ---------------------------- timeline ----------------------------- //
+
+// How a key moves on to the next one. Spline is a Catmull-Rom curve
+// through the neighbouring keys, with tangents scaled for their spacing
+// in time; its first and last keys have one-sided tangents.
+enum class Interpolation { Step, Linear, Spline };
+
+struct Keyframe {
+    double time = 0.0;   // seconds
+    Interpolation interpolation = Interpolation::Spline;   // to the next key
+    RenderSettings settings;
+};
+
+// Keyframes over RenderSettings for animation export. Between two keys
+// the continuous fields (floats, doubles, colours: camera, power,
+// colorA/B, ...) are interpolated by the first key's mode; integer and
+// boolean fields hold the first key's values until the next key.
+class Timeline {
+public:
+    const std::vector<Keyframe> &keys() const { return keys_; }
+    bool empty() const { return keys_.empty(); }
+
+    // Inserts a key, replacing one at the same time; keys stay sorted.
+    void setKey(double time, const RenderSettings &settings, Interpolation interpolation);
+    void removeKey(size_t index);
+    void clear() { keys_.clear(); }
+
+    // Time of the last key.
+    double duration() const { return keys_.empty() ? 0.0 : keys_.back().time; }
+
+    // The settings at `time`, held constant before the first key and after
+    // the last. An empty timeline gives `fallback`.
+    RenderSettings evaluate(double time, const RenderSettings &fallback) const;
+
+private:
+    std::vector<Keyframe> keys_;
+};
+
+// Frames in a timeline sampled at `fps`, both ends included.
+int timelineFrameCount(const Timeline &timeline, double fps);
+
+// Text form: a "[key TIME MODE]" line (MODE step, linear or spline) starts
+// each key as a copy of the previous one, and settings-file lines below it
+// change what differs. The first key starts from `base`.
+bool loadTimeline(const std::string &path, const RenderSettings &base, Timeline &timeline,
+                  std::string *error = nullptr);
+// The first key is written in full, later ones as their differences.
+bool saveTimeline(const std::string &path, const Timeline &timeline);
+
+const char *interpolationName(Interpolation interpolation);
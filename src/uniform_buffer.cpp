@@ -0,0 +1,104 @@
+#include "uniform_buffer.h"
+
+#include <cstring>
+
+bool UniformBuffer::init(GLuint bindingPoint, size_t size) {
+    destroy();
+    binding_ = bindingPoint;
+    size_    = size;
+    shadow_.assign(size, 0);
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = alignment > 0 ? alignment : 256;
+    stride_ = (size + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+
+    if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, stride_ * kRing, nullptr, flags);
+        mapped_ = static_cast<unsigned char *>(
+            glMapBufferRange(GL_UNIFORM_BUFFER, 0, stride_ * kRing, flags));
+    }
+    if (!mapped_) {
+        // Either no buffer storage, or mapping failed: the buffer is
+        // immutable in the latter case, so start over with a plain one.
+        if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            glDeleteBuffers(1, &buffer_);
+            glGenBuffers(1, &buffer_);
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+        }
+        glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding_, buffer_);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    valid_ = false;
+    return buffer_ != 0;
+}
+
+void UniformBuffer::destroy() {
+    for (GLsync &fence : fences_) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (buffer_) {
+        if (mapped_) {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &buffer_);
+    }
+    buffer_ = 0;
+    mapped_ = nullptr;
+    valid_  = false;
+}
+
+bool UniformBuffer::update(const void *data) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+
+    size_t first = 0, last = size_;
+    const bool rebind = !valid_;
+    if (valid_) {
+        while (first < size_ && bytes[first] == shadow_[first]) first++;
+        if (first == size_) return false;
+        while (last > first && bytes[last - 1] == shadow_[last - 1]) last--;
+    }
+    std::memcpy(shadow_.data(), bytes, size_);
+    valid_ = true;
+
+    if (mapped_) {
+        // Draws issued so far read the current slot; fence them before
+        // moving on, and make sure the slot we reuse is no longer read.
+        if (fences_[slot_]) glDeleteSync(fences_[slot_]);
+        fences_[slot_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        slot_ = (slot_ + 1) % kRing;
+        if (fences_[slot_]) {
+            glClientWaitSync(fences_[slot_], GL_SYNC_FLUSH_COMMANDS_BIT, ~GLuint64(0));
+            glDeleteSync(fences_[slot_]);
+            fences_[slot_] = nullptr;
+        }
+
+        // The slot holds contents from kRing updates ago, so it gets the
+        // whole block rather than just this update's dirty range.
+        std::memcpy(mapped_ + slot_ * stride_, shadow_.data(), size_);
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding_, buffer_,
+                          static_cast<GLintptr>(slot_ * stride_),
+                          static_cast<GLsizeiptr>(size_));
+        lastUpload_ = size_;
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+        glBufferSubData(GL_UNIFORM_BUFFER, static_cast<GLintptr>(first),
+                        static_cast<GLsizeiptr>(last - first), bytes + first);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        // After invalidate() the binding point may hold another buffer.
+        if (rebind) glBindBufferBase(GL_UNIFORM_BUFFER, binding_, buffer_);
+        lastUpload_ = last - first;
+    }
+    return true;
+}
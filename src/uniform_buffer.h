@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+// -------------------------- uniform buffer ------------------------- //
+
+// One uniform block's contents in a buffer object bound to a fixed
+// binding point, so every program using the block sees the same data and
+// switching programs costs no uploads. update() compares against the last
+// contents it sent and does nothing when they match.
+//
+// With GL 4.4 / ARB_buffer_storage the buffer is persistently mapped and
+// split into kRing slots; a change is written to the next slot (guarded by
+// a fence in case the GPU still reads it) and bound with glBindBufferRange.
+// Otherwise only the changed byte range goes up through glBufferSubData.
+class UniformBuffer {
+public:
+    static constexpr int kRing = 3;
+
+    bool init(GLuint bindingPoint, size_t size);
+    void destroy();
+
+    // `data` must hold size() bytes. Returns true if anything was sent.
+    bool update(const void *data);
+    // Makes the next update() send and bind everything, for when another
+    // buffer has been bound to the binding point meanwhile.
+    void invalidate() { valid_ = false; }
+
+    size_t size() const { return size_; }
+    bool   persistent() const { return mapped_ != nullptr; }
+    // Bytes sent by the most recent update() that changed something.
+    size_t lastUploadBytes() const { return lastUpload_; }
+
+private:
+    GLuint buffer_  = 0;
+    GLuint binding_ = 0;
+    size_t size_    = 0;
+    size_t stride_  = 0;   // slot size rounded to the offset alignment
+    bool   valid_   = false;   // shadow_ matches the GPU copy
+
+    std::vector<unsigned char> shadow_;
+
+    unsigned char *mapped_ = nullptr;
+    int            slot_   = 0;
+    std::array<GLsync, kRing> fences_{};
+
+    size_t lastUpload_ = 0;
+};
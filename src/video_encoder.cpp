@@ -0,0 +1,141 @@
+#include "video_encoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <csignal>
+#include <iostream>
+
+#ifdef _WIN32
+#define popen  _popen
+#define pclose _pclose
+#endif
+
+// One argument for the platform shell.
+static std::string shellQuote(const std::string &arg) {
+#ifdef _WIN32
+    return "\"" + arg + "\"";
+#else
+    std::string out = "'";
+    for (char c : arg) {
+        if (c == '\'') out += "'\\''";
+        else           out += c;
+    }
+    return out + "'";
+#endif
+}
+
+static std::string lowerExtension(const std::string &path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return "";
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext;
+}
+
+VideoEncoder::~VideoEncoder() {
+    close();
+}
+
+bool VideoEncoder::open(const std::string &path, int width, int height, double fps,
+                        const std::string &ffmpeg) {
+    close();
+
+    char input[160];
+    std::snprintf(input, sizeof(input),
+                  " -hide_banner -loglevel error -y -f rawvideo -pixel_format rgba"
+                  " -video_size %dx%d -framerate %.9g -i -", width, height, fps);
+    // Read-back rows are bottom-up.
+    std::string command = shellQuote(ffmpeg) + input +
+                          " -vf " + shellQuote("vflip,pad=ceil(iw/2)*2:ceil(ih/2)*2");
+    std::string ext = lowerExtension(path);
+    if (ext == "mp4" || ext == "mov" || ext == "mkv") {
+        command += " -c:v libx264 -preset medium -crf 18 -pix_fmt yuv420p";
+    }
+    command += " " + shellQuote(path);
+
+#ifndef _WIN32
+    // An encoder that exits early must fail the writes, not kill us.
+    std::signal(SIGPIPE, SIG_IGN);
+    pipe_ = popen(command.c_str(), "w");
+#else
+    pipe_ = popen(command.c_str(), "wb");
+#endif
+    if (!pipe_) {
+        std::cerr << "Failed to start " << ffmpeg << std::endl;
+        return false;
+    }
+
+    frameBytes_ = static_cast<size_t>(width) * height * 4;
+    stop_    = false;
+    failed_  = false;
+    written_ = 0;
+    writer_  = std::thread(&VideoEncoder::writerLoop, this);
+    return true;
+}
+
+bool VideoEncoder::submit(Image image) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    hasRoom_.wait(lock, [this] { return failed_ || static_cast<int>(queue_.size()) < kQueueDepth; });
+    if (failed_ || !pipe_) return false;
+    queue_.push_back(std::move(image));
+    lock.unlock();
+    hasWork_.notify_one();
+    return true;
+}
+
+bool VideoEncoder::close() {
+    if (!pipe_) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    hasWork_.notify_all();
+    writer_.join();
+
+    int status = pclose(pipe_);
+    pipe_ = nullptr;
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.clear();
+    if (status != 0) {
+        std::cerr << "Video encoder exited with status " << status << std::endl;
+        failed_ = true;
+    }
+    return !failed_;
+}
+
+int VideoEncoder::written() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_;
+}
+
+void VideoEncoder::writerLoop() {
+    for (;;) {
+        Image image;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            hasWork_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) return;   // stopping
+            image = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        hasRoom_.notify_one();
+
+        bool ok = image.format == Image::Rgba8 && image.pixels.size() == frameBytes_ &&
+                  std::fwrite(image.pixels.data(), 1, frameBytes_, pipe_) == frameBytes_;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!ok) {
+                failed_ = true;
+                queue_.clear();
+            } else {
+                written_++;
+            }
+        }
+        if (!ok) {
+            hasRoom_.notify_all();
+            return;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "image_io.h"
+
+// --------------------------- video encoder ------------------------- //
+
+// Pipes raw RGBA frames into an ffmpeg process from a writer thread.
+// submit() blocks while kQueueDepth frames are waiting, so a slow encoder
+// holds the renderer back instead of memory growing with the length of
+// the video.
+class VideoEncoder {
+public:
+    static constexpr int kQueueDepth = 4;
+
+    ~VideoEncoder();
+
+    // Starts `ffmpeg` writing `path` at `fps`; the container and codec
+    // follow the extension (H.264 for .mp4, .mov and .mkv). Odd sizes are
+    // padded to even for it.
+    bool open(const std::string &path, int width, int height, double fps,
+              const std::string &ffmpeg = "ffmpeg");
+
+    // Queues an Rgba8 width x height image, rows bottom-up as read back.
+    // False once the encoder has failed.
+    bool submit(Image image);
+
+    // Writes what is queued and waits for the encoder to exit. True if
+    // every frame went in and it exited cleanly.
+    bool close();
+
+    bool isOpen() const { return pipe_ != nullptr; }
+    int  written() const;
+
+private:
+    void writerLoop();
+
+    FILE       *pipe_ = nullptr;
+    size_t      frameBytes_ = 0;
+    std::thread writer_;
+
+    mutable std::mutex      mutex_;
+    std::condition_variable hasWork_, hasRoom_;
+    std::deque<Image>       queue_;
+    bool stop_    = false;
+    bool failed_  = false;
+    int  written_ = 0;
+};
@@ -0,0 +1,70 @@
+#include "video_export.h"
+
+#include <utility>
+
+VideoExport::VideoExport(const std::string &shaderDir) : renderer_(shaderDir) {}
+
+VideoExport::~VideoExport() {
+    if (active_) finish();
+    readback_.destroy();
+    if (rendererReady_) renderer_.shutdown();
+}
+
+bool VideoExport::start(const Timeline &timeline, const VideoExportOptions &options,
+                        std::string *error) {
+    if (active_) finish();
+    if (timeline.empty() || options.fps <= 0.0) {
+        if (error) *error = "nothing to export: no keys or no frame rate";
+        return false;
+    }
+    if (!rendererReady_ && !(rendererReady_ = renderer_.init())) {
+        if (error) *error = "failed to build the offline renderer's shaders";
+        return false;
+    }
+    if (!encoder_.open(options.path, options.width, options.height, options.fps, options.ffmpeg)) {
+        if (error) *error = "failed to start " + options.ffmpeg;
+        return false;
+    }
+
+    timeline_   = timeline;
+    options_    = options;
+    frame_      = 0;
+    frameCount_ = options.frames > 0 ? options.frames : timelineFrameCount(timeline, options.fps);
+    active_     = true;
+    ok_         = true;
+    return true;
+}
+
+bool VideoExport::step() {
+    if (!active_ || !ok_ || frame_ >= frameCount_) return false;
+
+    const double time = frame_ / options_.fps;
+    RenderSettings settings = timeline_.evaluate(time, RenderSettings());
+    if (!renderer_.render(settings, options_.width, options_.height, options_.samples,
+                          static_cast<float>(time)) ||
+        !renderer_.resolve()) {
+        ok_ = false;
+        return false;
+    }
+    const RenderTarget &source = renderer_.resolved();
+    readback_.start(source.fbo, GL_COLOR_ATTACHMENT0, source.width, source.height,
+                    Image::Rgba8, frame_);
+    frame_++;
+    encodeFinished(false);
+    return ok_ && frame_ < frameCount_;
+}
+
+bool VideoExport::finish() {
+    if (!active_) return false;
+    encodeFinished(true);
+    ok_ = encoder_.close() && ok_ && encoder_.written() == frameCount_;
+    active_ = false;
+    return ok_;
+}
+
+void VideoExport::encodeFinished(bool wait) {
+    // The ring hands frames back in submission order.
+    for (PixelReadback::Result &r : readback_.collect(wait)) {
+        if (ok_ && !encoder_.submit(std::move(r.image))) ok_ = false;
+    }
+}
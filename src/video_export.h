@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+
+#include "offline_renderer.h"
+#include "pixel_readback.h"
+#include "timeline.h"
+#include "video_encoder.h"
+
+// --------------------------- video export -------------------------- //
+
+struct VideoExportOptions {
+    std::string path = "animation.mp4";
+    int    width   = 1920;
+    int    height  = 1080;
+    double fps     = 30.0;
+    int    samples = 16;     // accumulated samples per frame
+    int    frames  = 0;      // 0 = the whole timeline at fps
+    std::string ffmpeg = "ffmpeg";
+};
+
+// Renders a timeline offscreen into a video. Frame i shows the timeline
+// at i / fps and gets that as its shader time, whatever the wall clock
+// does. Each frame goes through the readback ring into the encoder, so at
+// most PixelReadback::kRing frames are in flight on the GPU and
+// VideoEncoder::kQueueDepth wait for the encoder.
+class VideoExport {
+public:
+    // Needs a current GL context, as do all other calls.
+    explicit VideoExport(const std::string &shaderDir);
+    ~VideoExport();
+
+    bool start(const Timeline &timeline, const VideoExportOptions &options,
+               std::string *error = nullptr);
+
+    // Renders the next frame and hands finished ones to the encoder.
+    // False once every frame is rendered or something failed; then call
+    // finish().
+    bool step();
+
+    // Waits for the frames in flight and the encoder. True if the whole
+    // video was written.
+    bool finish();
+
+    bool active() const { return active_; }
+    int  frame() const { return frame_; }
+    int  frameCount() const { return frameCount_; }
+
+private:
+    void encodeFinished(bool wait);
+
+    OfflineRenderer renderer_;
+    bool rendererReady_ = false;
+    PixelReadback readback_;
+    VideoEncoder  encoder_;
+
+    Timeline timeline_;
+    VideoExportOptions options_;
+    int  frame_ = 0, frameCount_ = 0;
+    bool active_ = false;
+    bool ok_ = false;
+};
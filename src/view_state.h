@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "camera.h"
+#include "render_settings.h"
+
+// ---------------------------- view state --------------------------- //
+
+// Everything the fractal pass output depends on, packed as 4-byte fields
+// with no padding so two snapshots compare with memcmp. u_time is left
+// out on purpose: the shader doesn't use it.
+struct ViewState {
+    float   camPos[3];
+    float   camForward[3];
+    float   camRight[3];
+    float   camUp[3];
+    float   camPosLo[3];   // camPos's rounding error: the double position
+                           // is camPos + camPosLo
+    float   fov;
+
+    float   power;
+    int32_t maxIterations;
+    float   bailout;
+
+    int32_t maxSteps;
+    float   maxDist;
+    float   epsilon;
+    int32_t boundedMarch;  // bounding sphere + over-relaxed steps
+    float   relaxation;
+    int32_t lod;           // footprint-scaled hit threshold and iterations
+    float   lodBias;
+    float   lodIterBias;
+    int32_t deepZoom;      // RenderSettings::deepZoom
+
+    int32_t enableAO;
+    int32_t enableShadows;
+    int32_t analyticNormals;
+    float   colorA[3];
+    float   colorB[3];
+
+    int32_t prepassScale;  // coarse tile size of the depth prepass, 0 = off
+    int32_t lightingScale; // deferred shadow/AO scale, 0 = forward shading
+    int32_t costView;      // RenderSettings::costView
+
+    int32_t width;   // internal render size
+    int32_t height;
+};
+
+static_assert(sizeof(ViewState) == 42 * 4, "ViewState must stay padding-free");
+
+inline ViewState makeViewState(const RenderSettings &s, const CameraBasis &cam,
+                               int width, int height) {
+    ViewState v;
+    std::memset(&v, 0, sizeof(v));
+
+    const Vec3d *basis[4] = {&cam.pos, &cam.forward, &cam.right, &cam.up};
+    float *dst[4] = {v.camPos, v.camForward, v.camRight, v.camUp};
+    for (int i = 0; i < 4; i++) {
+        dst[i][0] = static_cast<float>(basis[i]->x);
+        dst[i][1] = static_cast<float>(basis[i]->y);
+        dst[i][2] = static_cast<float>(basis[i]->z);
+    }
+    const double pos[3] = {cam.pos.x, cam.pos.y, cam.pos.z};
+    for (int i = 0; i < 3; i++) {
+        v.camPosLo[i] = static_cast<float>(pos[i] - v.camPos[i]);
+    }
+    v.fov = s.fov;
+
+    v.power         = s.power;
+    v.maxIterations = s.maxIterations;
+    v.bailout       = s.bailout;
+
+    v.maxSteps = s.maxSteps;
+    v.maxDist  = s.maxDist;
+    v.epsilon  = s.epsilon;
+    v.boundedMarch = s.boundedMarch ? 1 : 0;
+    v.relaxation   = s.relaxation;
+    v.lod          = s.distanceLod ? 1 : 0;
+    v.lodBias      = s.lodBias;
+    v.lodIterBias  = s.lodIterBias;
+    v.deepZoom     = s.deepZoom;
+
+    v.enableAO      = s.enableAO ? 1 : 0;
+    v.enableShadows = s.enableShadows ? 1 : 0;
+    v.analyticNormals = s.analyticNormals ? 1 : 0;
+    std::memcpy(v.colorA, s.colorA, sizeof(v.colorA));
+    std::memcpy(v.colorB, s.colorB, sizeof(v.colorB));
+
+    v.prepassScale  = s.depthPrepass ? s.prepassFactor : 0;
+    v.lightingScale = s.deferredShading ? s.lightingFactor : 0;
+    v.costView      = s.costView >= 1 && s.costView <= 3 ? s.costView : 0;
+
+    v.width  = width;
+    v.height = height;
+    return v;
+}
+
+inline bool operator==(const ViewState &a, const ViewState &b) {
+    return std::memcmp(&a, &b, sizeof(ViewState)) == 0;
+}
+
+inline bool operator!=(const ViewState &a, const ViewState &b) {
+    return !(a == b);
+}
+
+// True when both views march the same surface, so hit distances from one
+// are meaningful in the other whatever the cameras.
+inline bool sameSurface(const ViewState &a, const ViewState &b) {
+    return a.power == b.power && a.maxIterations == b.maxIterations &&
+           a.bailout == b.bailout && a.epsilon == b.epsilon;
+}
@@ -0,0 +1,84 @@
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(int threads) {
+    if (threads <= 0) threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int i = 0; i < threads; i++) queues_.push_back(std::make_unique<Queue>());
+    // Worker 0 is whichever thread calls run().
+    for (int i = 1; i < threads; i++) workers_.emplace_back(&WorkStealingPool::workerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread &t : workers_) t.join();
+}
+
+void WorkStealingPool::run(int count, const std::function<void(int, int)> &task) {
+    if (count <= 0) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        remaining_ = count;
+        // Contiguous runs: neighbouring tiles cost about the same, so a
+        // worker only steals once the image's cost is actually uneven.
+        const int n = threads();
+        for (int w = 0; w < n; w++) {
+            Queue &q = *queues_[w];
+            std::lock_guard<std::mutex> qlock(q.mutex);
+            for (int i = count * w / n; i < count * (w + 1) / n; i++) q.tasks.push_back(i);
+        }
+        batch_++;
+    }
+    wake_.notify_all();
+
+    while (runOne(0)) {}
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return remaining_.load() == 0; });
+    task_ = nullptr;
+}
+
+bool WorkStealingPool::runOne(int worker) {
+    const int n = threads();
+    int index = -1;
+    for (int k = 0; k < n && index < 0; k++) {
+        Queue &q = *queues_[(worker + k) % n];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) continue;
+        if (k == 0) {
+            index = q.tasks.back();
+            q.tasks.pop_back();
+        } else {
+            index = q.tasks.front();
+            q.tasks.pop_front();
+        }
+    }
+    if (index < 0) return false;
+
+    // Every task was queued after task_ was set, under the queue's lock.
+    (*task_)(index, worker);
+    if (--remaining_ == 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_.notify_all();
+    }
+    return true;
+}
+
+void WorkStealingPool::workerLoop(int worker) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || batch_ != seen; });
+            if (stop_) return;
+            seen = batch_;
+        }
+        while (runOne(worker)) {}
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ------------------------ work-stealing pool ----------------------- //
+
+// Runs batches of independent tasks on a fixed set of threads. Each
+// worker owns a deque of task indices, dealt out in contiguous runs; it
+// takes from the back of its own and, once that runs dry, steals from the
+// front of the others'. Image tiles vary a lot in cost (open sky against
+// fractal surface), so stealing keeps every core busy to the end of a
+// batch where a static split would wait on the slowest run.
+class WorkStealingPool {
+public:
+    // 0 threads = every hardware thread. The thread calling run() counts
+    // as one of them.
+    explicit WorkStealingPool(int threads = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    int threads() const { return static_cast<int>(queues_.size()); }
+
+    // Calls task(index, worker) for every index in [0, count), worker
+    // being in [0, threads()), and returns once all of them finished.
+    void run(int count, const std::function<void(int, int)> &task);
+
+private:
+    struct Queue {
+        std::mutex      mutex;
+        std::deque<int> tasks;
+    };
+
+    void workerLoop(int worker);
+    // Runs one task from the worker's own queue or a stolen one; false
+    // when every queue is empty.
+    bool runOne(int worker);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::mutex              mutex_;
+    std::condition_variable wake_, done_;
+    const std::function<void(int, int)> *task_ = nullptr;
+    uint64_t         batch_ = 0;
+    std::atomic<int> remaining_{0};   // tasks of this batch not finished
+    bool             stop_ = false;
+};